@@ -8,11 +8,41 @@ server.py - SAMDEMO ダッシュボードサーバー
 ブラウザでアクセス:
   http://localhost:8080
 
+サーバー自身の状態:
+  http://localhost:8080/metrics          Prometheus テキスト形式
+  http://localhost:8080/profile/start    サンプリングプロファイラ開始 (--profile で起動時から)
+  http://localhost:8080/profile/stop     停止して結果 (関数別 + collapsed stacks) を返す
+
+遅い回線 (WiFi / VPN) のブラウザ:
+  http://localhost:8080/?enc=batch       sensor を 250ms 毎の列形式フレームにまとめて受け取る
+  permessage-deflate はブラウザが対応していれば自動で有効 (--no-deflate で無効)
+
+GR-SAKURA の Ethernet (ESP32 を通さず LAN で直接):
+  python server.py --eth                 UDP 50500 で配信を受け、送り元の TCP 50501 へコマンド
+  python server.py --eth 192.168.1.10:50500   受ける NIC / ポートを指定
+
+ESP32 のまとめ送り (sensor を N 件 1 フレームにした {"type":"sbatch"}) は
+どの経路でも sensor に展開してから記録 / 配信する
+
+記録データの再生 (実機なしで事後解析 / 配信経路の負荷確認):
+  python server.py --replay history.db --device esp32 --speed 10
+  python server.py --replay capture.jsonl   1 行 1 メッセージ (received_at か ts で時刻順)
+  速度 (1〜1000 倍)・一時停止・シークはブラウザの再生バーから
+
+記録データのエクスポート (受信メッセージは --db の SQLite に記録される):
+  http://localhost:8080/history          記録中のデバイスと期間 (JSON)
+  http://localhost:8080/export?from=2025-01-01T00:00&to=2025-01-08&devices=esp32&fields=temp,pwm&format=csv
+    format=parquet は pyarrow が必要。from/to は ISO 8601 (ローカル時刻) か UNIX 秒
+
 必要ライブラリ:
   pip install pyserial websockets
+  pip install pyarrow        /export?format=parquet を使うときだけ (無ければ 501 を返す)
 """
 
 import asyncio
+import base64
+import binascii
+import bisect
 import json
 import math
 import random
@@ -21,8 +51,15 @@ import datetime
 import socket
 import threading
 import argparse
+import csv
+import io
 import os
-from http.server import HTTPServer, SimpleHTTPRequestHandler
+import queue
+import sqlite3
+import sys
+from collections import Counter
+from http.server import ThreadingHTTPServer, SimpleHTTPRequestHandler
+from urllib.parse import parse_qs
 
 try:
     import serial
@@ -32,6 +69,7 @@ except ImportError:
 
 from websockets.asyncio.server import serve
 from websockets.asyncio.client import connect as ws_connect
+from websockets.extensions.permessage_deflate import ServerPerMessageDeflateFactory
 import websockets.exceptions
 
 # ============================================================
@@ -41,40 +79,794 @@ HTTP_PORT = 8080   # ブラウザでアクセスするポート
 WS_PORT   = 8765   # WebSocket ポート（内部通信）
 BAUD      = 115200
 
+SYNC_INTERVAL = 2.0   # ESP32 との時刻合わせ周期 [秒]（WiFi モード）
+LAG_INTERVAL  = 0.1   # イベントループ遅れの計測周期 [秒]
+PROFILE_INTERVAL = 0.005   # プロファイラのサンプリング周期 [秒]
+CMD_TIMEOUT   = 2.0   # コマンドの ack 待ち上限 [秒]
+REPLAY_SPEED_MAX = 1000   # 再生速度の上限 [倍]
+REPLAY_STATE_SEC = 1.0    # 再生位置をブラウザへ通知する周期 [秒]
+ETH_TELEM_PORT = 50500    # GR-SAKURA Ethernet: UDP 配信 (net_task.h と同じ)
+ETH_CMD_PORT   = 50501    # GR-SAKURA Ethernet: TCP コマンド
+ETH_RETRY_SEC  = 3.0      # コマンド接続の再接続間隔 [秒]
+
+# ブラウザへの WebSocket
+BATCH_MS        = 250   # enc=batch: sensor をまとめて送る周期 [ms]
+WS_DEFLATE_BITS = 12    # permessage-deflate の窓 (2^12 = 4KB/接続)
+
+RECORD_TYPES  = ("sensor", "ctrl", "link")     # 記録するメッセージ
+EXPORT_FIELDS = ("temp", "humi", "pres", "pwm", "duty", "vtemp", "sp")  # fields 省略時
+EXPORT_BATCH  = 2000       # エクスポート 1 回の読み出し行数 (= CSV チャンク)
+PARQUET_ROW_GROUP = 65536  # Parquet の行グループ
+
 # 接続中ブラウザクライアント
 clients: set = set()
+client_enc: dict = {}   # ws -> "json" | "batch" (接続 URL の ?enc=)
+
+# 記録時のデバイス名（--device、省略時はデータソースから決める）
+device_name = "demo"
 
 # シリアルポート参照（ブラウザ→ESP32 コマンド転送用）
 ser_port = None
 
+# ============================================================
+# 時刻合わせ / 遅延計測（ESP32 の latency_trace と同じ方式）
+# ============================================================
+def _now_us() -> int:
+    """ESP32 の micros() と同じく 32bit で一周する µs 時刻"""
+    return (time.monotonic_ns() // 1000) & 0xFFFFFFFF
+
+def _s32(x: int) -> int:
+    x &= 0xFFFFFFFF
+    return x - (1 << 32) if x & 0x80000000 else x
+
+class ClockSync:
+    """NTP 方式: offset = ((t1-t0)+(t2-t3))/2, delay = (t3-t0)-(t2-t1)
+    直近 FILTER 回のうち往復遅延が最小のサンプルを採用し、ドリフトも推定する"""
+    FILTER   = 8
+    DRIFT_US = 10_000_000
+    RESYNC_US = 50_000
+
+    def __init__(self):
+        self.win = []
+        self.off = None          # ref 時点の remote - local
+        self.ref = 0
+        self.drift = 0.0
+        self.delay = 0
+
+    def sample(self, t0, t1, t2, t3):
+        a, b = (t1 - t0) & 0xFFFFFFFF, (t2 - t3) & 0xFFFFFFFF
+        off = (a + _s32(b - a) // 2) & 0xFFFFFFFF
+        delay = max(0, _s32((t3 - t0) - (t2 - t1)))
+        if self.off is not None and \
+                abs(_s32(off - self._offset_at(t3))) > self.RESYNC_US + delay:
+            self.win.clear()
+            self.off = None
+        self.win = (self.win + [(delay, off, t3)])[-self.FILTER:]
+        self.delay, best_off, best_t = min(self.win)
+        if self.off is None:
+            self.off, self.ref, self.drift = best_off, best_t, 0.0
+            return
+        dt = _s32(best_t - self.ref)
+        if dt >= self.DRIFT_US:
+            slope = _s32(best_off - self.off) / dt
+            self.drift = self.drift * 0.75 + slope * 0.25
+            self.off, self.ref = best_off, best_t
+
+    def _offset_at(self, local):
+        return (self.off + int(self.drift * _s32(local - self.ref))) & 0xFFFFFFFF
+
+    def to_local(self, remote):
+        return (remote - self._offset_at(remote - self.off)) & 0xFFFFFFFF
+
+    @property
+    def valid(self):
+        return self.off is not None
+
+class LatencyHist:
+    """log2 ヒストグラム: b[k] = [2^k, 2^(k+1)) µs（ESP32 側と同じ形式）"""
+    BUCKETS = 16
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self.n = self.total = self.max = 0
+        self.b = [0] * self.BUCKETS
+
+    def add(self, us):
+        us = max(0, int(us))
+        self.b[min(max(us.bit_length() - 1, 0), self.BUCKETS - 1)] += 1
+        self.n += 1
+        self.total += us
+        self.max = max(self.max, us)
+
+    def percentile(self, pct):
+        need, acc = (self.n * pct + 99) // 100, 0
+        for k, c in enumerate(self.b):
+            acc += c
+            if self.n and acc >= need:
+                return min(2 << k, self.max)
+        return self.max
+
+    def to_dict(self):
+        return {"n": self.n, "mean": self.total // self.n if self.n else 0,
+                "p50": self.percentile(50), "p99": self.percentile(99),
+                "max": self.max, "b": list(self.b)}
+
+esp_sync = ClockSync()      # ESP32 micros() ↔ サーバー
+ws_hist  = LatencyHist()    # ESP32 配信 → サーバー受信
+
+def trace_message(data: dict):
+    """ESP32 からのメッセージに WS 配信区間の計測を反映する"""
+    if data.get("type") == "sensor" and "t_us" in data and esp_sync.valid:
+        us = _s32(_now_us() - esp_sync.to_local(data["t_us"]))
+        ws_hist.add(us)
+        metrics.observe("esp32_ws_delay_seconds", us)
+    elif data.get("type") == "latency":
+        # ESP32 の区間ヒストグラムに WS 区間を足してブラウザへ
+        data.setdefault("hops", {})["ws"] = ws_hist.to_dict()
+        data["ws_off_us"] = _s32(esp_sync.off) if esp_sync.valid else 0
+        data["ws_drift_ppm"] = round(esp_sync.drift * 1e6, 1)
+        hops = data["hops"]
+        print("[TRACE] " + " ".join(
+            f"{k}={v.get('p50', 0)}/{v.get('p99', 0)}us" for k, v in hops.items()))
+        ws_hist.reset()
+
+# ============================================================
+# サーバー自身のメトリクス（/metrics）
+# ============================================================
+class PromHist(LatencyHist):
+    """LatencyHist と同じ log2 バケットの累積ヒストグラム（リセットしない）
+    Prometheus の histogram として秒単位で出力する"""
+    def __init__(self, buckets=24):
+        self.BUCKETS = buckets      # 2^23 µs ≈ 8 秒まで
+        super().__init__()
+
+    def render(self, name, labels=""):
+        out, acc = [], 0
+        pre = labels + "," if labels else ""
+        tail = f"{{{labels}}}" if labels else ""
+        for k, c in enumerate(self.b[:-1]):
+            acc += c
+            out.append(f'{name}_bucket{{{pre}le="{(2 << k) / 1e6:g}"}} {acc}')
+        out.append(f'{name}_bucket{{{pre}le="+Inf"}} {self.n}')
+        out.append(f"{name}_sum{tail} {self.total / 1e6:g}")
+        out.append(f"{name}_count{tail} {self.n}")
+        return out
+
+class Metrics:
+    """取り込み / 配信の経路で都度更新し、/metrics では整形だけを行う
+    HTTP サーバーは別スレッドなのでロックで保護する"""
+    PREFIX = "samdemo_"
+    HELP = {
+        "uptime_seconds":               ("gauge",     "サーバー起動からの経過秒"),
+        "ws_clients":                   ("gauge",     "接続中のブラウザ数"),
+        "ws_connects_total":            ("counter",   "ブラウザ接続数"),
+        "ws_disconnects_total":         ("counter",   "ブラウザ切断数"),
+        "ws_client_write_buffer_bytes": ("gauge",     "ブラウザごとの未送信バイト (直近の配信後)"),
+        "commands_total":               ("counter",   "ブラウザからのコマンド数"),
+        "ws_handler_errors_total":      ("counter",   "ブラウザのメッセージ処理で起きた想定外の例外 (種類別)"),
+        "commands_sent_total":          ("counter",   "ファームウェアへ送ったコマンド数"),
+        "command_timeouts_total":       ("counter",   "CMD_TIMEOUT 内に ack が来なかったコマンド数"),
+        "command_rejected_total":       ("counter",   "未知 / 未接続で送らなかったコマンド数"),
+        "command_rtt_seconds":          ("histogram", "コマンド送信 → ack 受信の往復時間 (種類別)"),
+        "ingest_messages_total":        ("counter",   "データソースから受け取ったメッセージ数"),
+        "ingest_bytes_total":           ("counter",   "データソースから受け取ったバイト数"),
+        "parse_errors_total":           ("counter",   "JSON として読めなかった行 / メッセージ"),
+        "sbatch_frames_total":          ("counter",   "まとめ送り (sbatch) のフレーム数"),
+        "sbatch_samples_total":         ("counter",   "sbatch から展開した sensor サンプル数"),
+        "broadcast_messages_total":     ("counter",   "ブラウザへの配信回数"),
+        "broadcast_bytes_total":        ("counter",   "ブラウザへの送信バイト (全クライアント合計)"),
+        "broadcast_errors_total":       ("counter",   "送信に失敗して外したクライアント数"),
+        "broadcast_seconds":            ("histogram", "1 回の配信 (全クライアントへの送信) にかかった時間"),
+        "esp32_ws_delay_seconds":       ("histogram", "ESP32 配信 → サーバー受信の遅延 (時刻合わせ後)"),
+        "source_connected":             ("gauge",     "データソース (ESP32 / シリアル) に接続中なら 1"),
+        "source_connects_total":        ("counter",   "データソースへの接続成功数 (再接続を含む)"),
+        "source_errors_total":          ("counter",   "データソースの接続エラー数"),
+        "event_loop_lag_seconds":       ("histogram", "asyncio イベントループの遅れ (sleep の超過分)"),
+        "record_rows_total":            ("counter",   "履歴 DB に書き込んだ行数"),
+        "record_dropped_total":         ("counter",   "書き込みが追いつかず / 書き込めずに捨てた行数"),
+        "record_errors_total":          ("counter",   "履歴 DB の書き込みエラー数 (開き直して再試行)"),
+        "record_queue_depth":           ("gauge",     "履歴 DB への書き込み待ち行数 (直近の書き込み時)"),
+        "export_requests_total":        ("counter",   "エクスポート要求数"),
+        "export_rows_total":            ("counter",   "エクスポートした行数"),
+        "replay_position_seconds":      ("gauge",     "再生中の記録時刻 (UNIX 秒)"),
+        "replay_speed":                 ("gauge",     "再生速度 [倍] (一時停止中は 0)"),
+    }
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.started = time.monotonic()
+        self.values = {}     # name -> {labels: value}
+        self.hists = {}      # name -> {labels: PromHist}
+
+    @staticmethod
+    def _key(labels):
+        return tuple(sorted(labels.items()))
+
+    def inc(self, name, n=1, **labels):
+        with self.lock:
+            series = self.values.setdefault(name, {})
+            key = self._key(labels)
+            series[key] = series.get(key, 0) + n
+
+    def set(self, name, value, **labels):
+        with self.lock:
+            self.values.setdefault(name, {})[self._key(labels)] = value
+
+    def remove(self, name, **labels):
+        with self.lock:
+            self.values.get(name, {}).pop(self._key(labels), None)
+
+    def observe(self, name, us, **labels):
+        with self.lock:
+            series = self.hists.setdefault(name, {})
+            key = self._key(labels)
+            if key not in series:
+                series[key] = PromHist()
+            series[key].add(us)
+
+    def render(self) -> str:
+        self.set("uptime_seconds", int(time.monotonic() - self.started))
+        out = []
+        with self.lock:
+            for name in sorted(set(self.values) | set(self.hists)):
+                kind, text = self.HELP.get(name, ("untyped", ""))
+                full = self.PREFIX + name
+                out.append(f"# HELP {full} {text}")
+                out.append(f"# TYPE {full} {kind}")
+                if name in self.hists:
+                    for key, h in sorted(self.hists[name].items()):
+                        out.extend(h.render(full, ",".join(f'{k}="{lv}"' for k, lv in key)))
+                    continue
+                for key, v in sorted(self.values[name].items()):
+                    val = v if isinstance(v, int) else f"{v:g}"
+                    lbl = ",".join(f'{k}="{lv}"' for k, lv in key)
+                    out.append(f"{full}{{{lbl}}} {val}" if lbl else f"{full} {val}")
+        return "\n".join(out) + "\n"
+
+metrics = Metrics()
+
+async def loop_lag_monitor():
+    """sleep の超過分 = 他の処理がループを塞いでいた時間"""
+    while True:
+        t = time.perf_counter()
+        await asyncio.sleep(LAG_INTERVAL)
+        metrics.observe("event_loop_lag_seconds",
+                        (time.perf_counter() - t - LAG_INTERVAL) * 1e6)
+
+# ============================================================
+# サンプリングプロファイラ（/profile/start, /profile/stop）
+# ============================================================
+class SamplingProfiler:
+    """イベントループのスレッドのスタックを PROFILE_INTERVAL 毎に数える
+    計測対象のコードには手を入れないので、止めている間のコストはゼロ"""
+    IDLE = ("select", "poll", "_poll")     # selectors / proactor の待ち
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.thread_id = None
+        self.stacks = Counter()
+        self.samples = 0
+        self.started = 0.0
+        self._stop = None
+
+    @property
+    def running(self):
+        return self._stop is not None
+
+    def start(self, thread_id):
+        if self.running:
+            return
+        with self.lock:
+            self.thread_id = thread_id
+            self.stacks.clear()
+            self.samples = 0
+            self.started = time.monotonic()
+        self._stop = threading.Event()
+        threading.Thread(target=self._run, args=(self._stop,), daemon=True).start()
+
+    def stop(self):
+        if self._stop:
+            self._stop.set()
+            self._stop = None
+
+    def _run(self, stop):
+        while not stop.wait(PROFILE_INTERVAL):
+            frame = sys._current_frames().get(self.thread_id)
+            stack = []
+            while frame is not None:
+                code = frame.f_code
+                stack.append(f"{os.path.basename(code.co_filename)}:{code.co_name}")
+                frame = frame.f_back
+            if not stack:
+                continue
+            with self.lock:
+                self.stacks[";".join(reversed(stack))] += 1
+                self.samples += 1
+
+    def report(self, top=25) -> str:
+        with self.lock:
+            stacks, n = Counter(self.stacks), self.samples
+        elapsed = (time.monotonic() - self.started) if self.started else 0.0
+        leaf = Counter()
+        for stack, c in stacks.items():
+            func = stack.rsplit(";", 1)[-1]
+            leaf["(idle) " + func if func.split(":")[-1] in self.IDLE else func] += c
+        out = [f"# {'running' if self.running else 'stopped'}: {n} samples, "
+               f"{elapsed:.1f} s, interval {PROFILE_INTERVAL * 1000:g} ms",
+               f"# self time top {top}"]
+        for func, c in leaf.most_common(top):
+            out.append(f"{100.0 * c / n:6.1f}% {c:7d}  {func}")
+        out.append("")
+        out.append("# collapsed stacks (flamegraph.pl / speedscope)")
+        for stack, c in stacks.most_common():
+            out.append(f"{stack} {c}")
+        return "\n".join(out) + "\n"
+
+profiler = SamplingProfiler()
+loop_thread_id = None       # main() で設定（プロファイル対象）
+
+# ============================================================
+# 履歴の記録とエクスポート（/history, /export）
+# ============================================================
+class Recorder:
+    """受信メッセージを SQLite (WAL) に追記する
+    イベントループは Queue に積むだけで、書き込みは専用スレッドがまとめて行う
+    エクスポートは別接続で読むので記録を止めない"""
+    SCHEMA = """
+        CREATE TABLE IF NOT EXISTS samples (
+            ts     REAL NOT NULL,     -- 受信時刻 (UNIX 秒)
+            device TEXT NOT NULL,
+            type   TEXT NOT NULL,
+            data   TEXT NOT NULL      -- 受信したメッセージ (JSON)
+        );
+        CREATE INDEX IF NOT EXISTS samples_ts ON samples (ts);
+        CREATE INDEX IF NOT EXISTS samples_device_ts ON samples (device, ts);
+    """
+    BATCH = 500
+    FLUSH_SEC = 1.0
+    RETRY_SEC = (1, 2, 5, 10, 30)   # 書き込みエラー後の待ち。使い切ったらその回の行は捨てる
+
+    def __init__(self, path: str):
+        self.path = path
+        self.q = queue.Queue(maxsize=100_000)
+        db = self.open()
+        db.executescript(self.SCHEMA)
+        db.close()
+        threading.Thread(target=self._run, daemon=True).start()
+
+    def open(self):
+        db = sqlite3.connect(self.path, timeout=10, check_same_thread=False)
+        db.execute("PRAGMA journal_mode=WAL")
+        db.execute("PRAGMA synchronous=NORMAL")
+        return db
+
+    def record(self, device: str, data: dict):
+        if data.get("type") not in RECORD_TYPES:
+            return
+        row = (data.get("received_at") or time.time(), device, data["type"],
+               json.dumps(data, separators=(",", ":"), ensure_ascii=False))
+        try:
+            self.q.put_nowait(row)
+        except queue.Full:
+            metrics.inc("record_dropped_total")
+
+    def _run(self):
+        db = None
+        while True:
+            rows = [self.q.get()]
+            deadline = time.monotonic() + self.FLUSH_SEC
+            while len(rows) < self.BATCH:
+                try:
+                    rows.append(self.q.get(timeout=max(0.0, deadline - time.monotonic())))
+                except queue.Empty:
+                    break
+            db = self._write(db, rows)
+            metrics.set("record_queue_depth", self.q.qsize())
+
+    def _write(self, db, rows):
+        """rows を書く。エラー (ディスク満杯 / ロック / ファイルが消えた) は接続を開き直して
+        RETRY_SEC の間隔で再試行する。その間に積まれた行は Queue があふれれば record() が捨てる"""
+        for wait in self.RETRY_SEC + (None,):
+            try:
+                if db is None:
+                    db = self.open()
+                    db.executescript(self.SCHEMA)
+                with db:
+                    db.executemany("INSERT INTO samples VALUES (?, ?, ?, ?)", rows)
+                metrics.inc("record_rows_total", len(rows))
+                return db
+            except sqlite3.Error as e:
+                metrics.inc("record_errors_total")
+                if db is not None:
+                    db.close()
+                    db = None
+                if wait is None:
+                    return self._write_each(rows, e)
+                print(f"[DB] 書き込み失敗: {e} → {wait}s 後に開き直して再試行")
+                time.sleep(wait)
+
+    def _write_each(self, rows, err):
+        """再試行を使い切った: 1 行ずつ書いて、書けない行 (値の型など) だけを捨てる"""
+        dropped = 0
+        try:
+            db = self.open()
+            db.executescript(self.SCHEMA)
+        except sqlite3.Error:
+            db, dropped = None, len(rows)
+        for row in rows if db is not None else ():
+            try:
+                with db:
+                    db.execute("INSERT INTO samples VALUES (?, ?, ?, ?)", row)
+                metrics.inc("record_rows_total")
+            except sqlite3.Error:
+                dropped += 1
+        print(f"[DB] 書き込み失敗: {err} → {dropped}/{len(rows)} 行を捨てる")
+        metrics.inc("record_dropped_total", dropped)
+        return db
+
+    def devices(self):
+        db = self.open()
+        try:
+            return [{"device": d, "first": t0, "last": t1, "n": n} for d, t0, t1, n in
+                    db.execute("SELECT device, MIN(ts), MAX(ts), COUNT(*) "
+                               "FROM samples GROUP BY device")]
+        finally:
+            db.close()
+
+    def query(self, t0, t1, devices, types, fields):
+        """(ts, device, type, field...) を EXPORT_BATCH 行ずつ返すジェネレータ
+        fields は JSON から SQLite 側で取り出すので、メッセージ全体は Python に来ない"""
+        cols = ", ".join("json_extract(data, ?)" for _ in fields)
+        sql = f"SELECT ts, device, type{', ' + cols if cols else ''} FROM samples " \
+              "WHERE ts >= ? AND ts < ?"
+        params = [f"$.{f}" for f in fields] + [t0, t1]
+        for name, vals in (("device", devices), ("type", types)):
+            if vals:
+                sql += f" AND {name} IN ({', '.join('?' * len(vals))})"
+                params += vals
+        sql += " ORDER BY ts"
+        db = self.open()
+        try:
+            cur = db.execute(sql, params)
+            while True:
+                rows = cur.fetchmany(EXPORT_BATCH)
+                if not rows:
+                    break
+                yield rows
+        finally:
+            db.close()
+
+recorder = None     # main() で作る (--db "" なら記録しない)
+
+def _parse_time(text: str, default: float) -> float:
+    if not text:
+        return default
+    try:
+        return float(text)
+    except ValueError:
+        return datetime.datetime.fromisoformat(text).timestamp()
+
+def _csv_chunks(batches, header):
+    buf = io.StringIO()
+    w = csv.writer(buf, lineterminator="\n")
+    w.writerow(header)
+    for rows in batches:
+        w.writerows(rows)
+        yield buf.getvalue().encode("utf-8")
+        buf.seek(0)
+        buf.truncate()
+        metrics.inc("export_rows_total", len(rows))
+
+class _ChunkSink:
+    """pyarrow の書き込み先: 書かれたバイト列をそのまま HTTP チャンクとして送る"""
+    def __init__(self, send):
+        self.send, self.pos, self.closed = send, 0, False
+    def write(self, data):
+        self.send(bytes(data))
+        self.pos += len(data)
+        return len(data)
+    def tell(self):
+        return self.pos
+    def flush(self):
+        pass
+    def close(self):
+        self.closed = True
+
+def _parquet_unavailable():
+    """format=parquet を書けない理由 (書けるなら None)"""
+    try:
+        import pyarrow as pa
+        import pyarrow.parquet  # noqa: F401
+    except ImportError:
+        return "parquet export needs pyarrow (pip install pyarrow)"
+    if not pa.Codec.is_available("zstd"):
+        return "parquet export needs a pyarrow build with zstd"
+    return None
+
+def _write_parquet(batches, fields, send):
+    import pyarrow as pa
+    import pyarrow.parquet as pq
+    schema = pa.schema([("ts", pa.timestamp("ms", tz="UTC")), ("device", pa.string()),
+                        ("type", pa.string())] + [(f, pa.float64()) for f in fields])
+    num = lambda v: float(v) if isinstance(v, (int, float)) else None
+    sink = _ChunkSink(send)
+    with pq.ParquetWriter(sink, schema, compression="zstd") as writer:
+        pending = []
+        for rows in batches:
+            pending += rows
+            if len(pending) < PARQUET_ROW_GROUP:
+                continue
+            _parquet_group(pa, writer, schema, pending, num)
+            pending = []
+        if pending:
+            _parquet_group(pa, writer, schema, pending, num)
+
+def _parquet_group(pa, writer, schema, rows, num):
+    cols = list(zip(*rows))
+    arrays = [pa.array([int(t * 1000) for t in cols[0]], pa.int64()).cast(schema.field(0).type),
+              pa.array(cols[1], pa.string()), pa.array(cols[2], pa.string())]
+    arrays += [pa.array([num(v) for v in c], pa.float64()) for c in cols[3:]]
+    writer.write_batch(pa.RecordBatch.from_arrays(arrays, schema=schema))
+    metrics.inc("export_rows_total", len(rows))
+
 # ============================================================
 # HTTP サーバー（index.html を配信）
 # ============================================================
 def start_http_server(directory: str):
     """index.html などの静的ファイルを HTTP で配信する"""
     class Handler(SimpleHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"   # エクスポートをチャンク転送する
+
         def __init__(self, *args, **kwargs):
             super().__init__(*args, directory=directory, **kwargs)
         def log_message(self, *args):
             pass  # アクセスログを非表示
 
-    httpd = HTTPServer(("", HTTP_PORT), Handler)
+        def do_GET(self):
+            path = self.path.split("?", 1)[0]
+            if path == "/metrics":
+                self._send_text(metrics.render(), "text/plain; version=0.0.4")
+            elif path == "/profile/start":
+                profiler.start(loop_thread_id)
+                self._send_text("profiler started\n")
+            elif path == "/profile/stop":
+                profiler.stop()
+                self._send_text(profiler.report())
+            elif path == "/profile":
+                self._send_text(profiler.report())
+            elif path == "/history":
+                if recorder is None:
+                    self.send_error(404, "recording disabled (--db)")
+                    return
+                self._send_text(json.dumps(recorder.devices()), "application/json")
+            elif path == "/export":
+                self._export(parse_qs(self.path.partition("?")[2]))
+            else:
+                super().do_GET()
+
+        def _export(self, q):
+            """from / to / devices / types / fields / format で範囲を指定して書き出す"""
+            if recorder is None:
+                self.send_error(404, "recording disabled (--db)")
+                return
+            arg = lambda k: q.get(k, [""])[0]
+            split = lambda k: [v for v in arg(k).split(",") if v]
+            fmt = arg("format") or "csv"
+            fields = split("fields") or list(EXPORT_FIELDS)
+            try:
+                t0 = _parse_time(arg("from"), 0.0)
+                t1 = _parse_time(arg("to"), time.time() + 1)
+            except ValueError as e:
+                self.send_error(400, f"bad time: {e}")
+                return
+            if fmt not in ("csv", "parquet"):
+                self.send_error(400, "format must be csv or parquet")
+                return
+            if fmt == "parquet":
+                # チャンク転送を始めた後では状態コードを返せないので、書けるかを先に確かめる
+                missing = _parquet_unavailable()
+                if missing:
+                    self.send_error(501, missing)
+                    return
+            metrics.inc("export_requests_total", format=fmt)
+
+            batches = recorder.query(t0, t1, split("devices"), split("types"), fields)
+            stamp = datetime.datetime.now().strftime("%Y%m%d_%H%M%S")
+            self.send_response(200)
+            self.send_header("Content-Type", "text/csv; charset=utf-8" if fmt == "csv"
+                             else "application/vnd.apache.parquet")
+            self.send_header("Content-Disposition",
+                             f'attachment; filename="samdemo_{stamp}.{fmt}"')
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            try:
+                if fmt == "csv":
+                    for chunk in _csv_chunks(batches, ["ts", "device", "type"] + fields):
+                        self._chunk(chunk)
+                else:
+                    _write_parquet(batches, fields, self._chunk)
+                self.wfile.write(b"0\r\n\r\n")
+            except (BrokenPipeError, ConnectionResetError):
+                pass
+            finally:
+                batches.close()
+            self.close_connection = True
+
+        def _chunk(self, data: bytes):
+            if data:
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(data), data))
+
+        def _send_text(self, body: str, ctype="text/plain"):
+            data = body.encode("utf-8")
+            self.send_response(200)
+            self.send_header("Content-Type", f"{ctype}; charset=utf-8")
+            self.send_header("Content-Length", str(len(data)))
+            self.end_headers()
+            self.wfile.write(data)
+
+    # エクスポート中も /metrics などに応答できるよう要求ごとにスレッド
+    httpd = ThreadingHTTPServer(("", HTTP_PORT), Handler)
     httpd.serve_forever()
 
 # ============================================================
 # ブラウザへのブロードキャスト
 # ============================================================
+def encode_json(data: dict) -> str:
+    """1 メッセージ 1 フレーム (enc=json)。区切りの空白は付けない"""
+    return json.dumps(data, ensure_ascii=False, separators=(",", ":"))
+
+def encode_batch(rows: list) -> str:
+    """sensor をまとめた列形式フレーム (enc=batch)
+    {"type":"batch","t0":受信時刻[ms],"keys":[..],"rows":[[t0 からの ms, 値..],..]}
+    type / received_at はフレーム側に 1 回だけ持つ"""
+    keys = []
+    for d in rows:
+        keys += [k for k in d if k not in ("type", "received_at") and k not in keys]
+    t0 = int(rows[0].get("received_at", time.time()) * 1000)
+    out = [[int(d.get("received_at", time.time()) * 1000) - t0] + [d.get(k) for k in keys]
+           for d in rows]
+    return json.dumps({"type": "batch", "t0": t0, "keys": keys, "rows": out},
+                      ensure_ascii=False, separators=(",", ":"))
+
+class Batcher:
+    """enc=batch のクライアント向けに sensor を BATCH_MS 毎にまとめて送る"""
+    def __init__(self):
+        self.rows = []
+
+    def add(self, data: dict):
+        data.setdefault("received_at", time.time())
+        self.rows.append(data)
+
+    async def run(self):
+        while True:
+            await asyncio.sleep(BATCH_MS / 1000)
+            if not self.rows:
+                continue
+            rows, self.rows = self.rows, []
+            targets = [ws for ws in clients if client_enc.get(ws) == "batch"]
+            if targets:
+                await _fanout(encode_batch(rows), targets, "batch", "batch")
+
+batcher = Batcher()
+
 async def broadcast(data: dict):
     if not clients:
         return
-    msg = json.dumps(data, ensure_ascii=False)
+    batch = [ws for ws in clients if client_enc.get(ws) == "batch"]
+    if batch and data.get("type") == "sensor":
+        batcher.add(data)
+        batch = []
+    targets = [ws for ws in clients if client_enc.get(ws) != "batch"] + batch
+    if targets:
+        await _fanout(encode_json(data), targets, data.get("type", ""), "json")
+
+async def _fanout(msg: str, targets: list, mtype: str, enc: str):
+    t0 = time.perf_counter()
     dead = set()
-    for ws in clients:
+    for ws in targets:
         try:
             await ws.send(msg)
         except Exception:
             dead.add(ws)
+            continue
+        # 送信できずに溜まっている量（遅いブラウザの検出）
+        transport = getattr(ws, "transport", None)
+        if transport is not None:
+            metrics.set("ws_client_write_buffer_bytes",
+                        transport.get_write_buffer_size(), client=_peer(ws))
     clients.difference_update(dead)
+    metrics.inc("broadcast_messages_total", type=mtype)
+    # 圧縮前のバイト数（deflate 後は ws_encoding_bench.py で見積もる）
+    metrics.inc("broadcast_bytes_total", len(msg.encode("utf-8")) * len(targets), enc=enc)
+    if dead:
+        metrics.inc("broadcast_errors_total", len(dead))
+    metrics.set("ws_clients", len(clients))
+    metrics.observe("broadcast_seconds", (time.perf_counter() - t0) * 1e6)
+
+def _deflated(ws) -> bool:
+    return any(e.name == "permessage-deflate" for e in getattr(ws.protocol, "extensions", []))
+
+def _peer(ws) -> str:
+    addr = ws.remote_address
+    return f"{addr[0]}:{addr[1]}" if addr else "?"
+
+# ============================================================
+# コマンド経路（ブラウザ → ファームウェア → ack）
+# ============================================================
+class CommandPipeline:
+    """ブラウザのコマンドをファームウェアの JSON 形式 ({"type":"cmd",...}) に変換して
+    データソース (ESP32 WebSocket / シリアル) へ送り、"cid" で ack と対応付ける
+    GR-SAKURA は "cid" 付きコマンドを処理した後 {"type":"ack","cid":..,"ok":..} を返す"""
+
+    def __init__(self):
+        self.sender = None      # async (line: str) -> None。データソース接続中だけ設定
+        self.next_cid = 1
+        self.pending = {}       # cid -> (cmd, 送信時刻)
+
+    def attach(self, sender):
+        self.sender = sender
+
+    def detach(self):
+        self.sender = None
+
+    @staticmethod
+    def translate(data: dict):
+        """ブラウザ形式 → ファームウェア形式。未知なら None"""
+        cmd = data.get("cmd", "")
+        if cmd in ("start", "heater_on"):
+            return {"type": "cmd", "cmd": "start"}
+        if cmd in ("stop", "heater_off"):
+            return {"type": "cmd", "cmd": "stop"}
+        if cmd == "set_target":
+            # スライダーは 0.01℃ 単位の整数 ("value")、ファームウェアは ℃ ("sp")
+            sp = data["sp"] if "sp" in data else data.get("value", 2500) / 100
+            return {"type": "cmd", "cmd": "set_target", "sp": round(float(sp), 2)}
+        if cmd == "set_pid":
+            return {"type": "cmd", "cmd": "set_pid", "kp": int(data.get("kp", 300)),
+                    "ki": int(data.get("ki", 80)), "kd": int(data.get("kd", 20))}
+        return None
+
+    async def submit(self, data: dict):
+        fw = self.translate(data)
+        name = fw["cmd"] if fw else data.get("cmd", "")
+        if fw is None or self.sender is None:
+            reason = "unknown command" if fw is None else "not connected"
+            metrics.inc("command_rejected_total", cmd=name)
+            print(f"[CMD] {name} （{reason}・スキップ）")
+            await broadcast({"type": "cmd_result", "cmd": name, "ok": False, "error": reason})
+            return
+        cid = self.next_cid
+        self.next_cid = self.next_cid % 1_000_000_000 + 1
+        fw["cid"] = cid
+        self.pending[cid] = (name, time.perf_counter())
+        asyncio.get_running_loop().call_later(CMD_TIMEOUT, self._expire, cid)
+        metrics.inc("commands_sent_total", cmd=name)
+        await self.sender(json.dumps(fw, separators=(",", ":")))
+
+    async def on_ack(self, data: dict):
+        entry = self.pending.pop(data.get("cid"), None)
+        if entry is None:
+            return      # タイムアウト済み / 他のサーバーが送ったもの
+        name, t0 = entry
+        us = (time.perf_counter() - t0) * 1e6
+        metrics.observe("command_rtt_seconds", us, cmd=name)
+        ok = bool(data.get("ok", 1))
+        print(f"[CMD] {name} cid={data['cid']} {'ok' if ok else 'NG'} {us / 1000:.1f}ms")
+        await broadcast({"type": "cmd_result", "cmd": name, "cid": data["cid"],
+                         "ok": ok, "rtt_ms": round(us / 1000, 1)})
+
+    def _expire(self, cid):
+        entry = self.pending.pop(cid, None)
+        if entry is None:
+            return
+        metrics.inc("command_timeouts_total", cmd=entry[0])
+        print(f"[CMD] {entry[0]} cid={cid} ack なし ({CMD_TIMEOUT:g}s)")
+        asyncio.create_task(broadcast({"type": "cmd_result", "cmd": entry[0], "cid": cid,
+                                       "ok": False, "error": "timeout"}))
+
+commands = CommandPipeline()
 
 # ============================================================
 # WebSocket ハンドラ
@@ -82,48 +874,113 @@ async def broadcast(data: dict):
 async def ws_handler(websocket):
     clients.add(websocket)
     addr = websocket.remote_address
-    print(f"[WS] ブラウザ接続: {addr}")
+    query = parse_qs(websocket.request.path.partition("?")[2]) if websocket.request else {}
+    client_enc[websocket] = "batch" if query.get("enc") == ["batch"] else "json"
+    metrics.inc("ws_connects_total")
+    metrics.set("ws_clients", len(clients))
+    print(f"[WS] ブラウザ接続: {addr} (enc={client_enc[websocket]}, "
+          f"{'deflate' if _deflated(websocket) else '非圧縮'})")
     try:
         await websocket.send(json.dumps({"type": "connected", "message": "接続しました"}))
+        if replay:
+            await websocket.send(json.dumps(replay.state()))
         async for message in websocket:
-            # ブラウザからのコマンドを ESP32 へ転送
+            # ブラウザからのコマンドをファームウェアへ転送
+            data = None
             try:
                 data = json.loads(message)
-                cmd = data.get("cmd", "")
-                if cmd in ("heater_on", "heater_off"):
-                    uart_cmd = b"HEATER_ON\n" if cmd == "heater_on" else b"HEATER_OFF\n"
-                    if ser_port and ser_port.is_open:
-                        loop = asyncio.get_event_loop()
-                        await loop.run_in_executor(None, ser_port.write, uart_cmd)
-                        print(f"[CMD] {cmd.upper()} → RX63N")
-                    else:
-                        print(f"[CMD] {cmd.upper()} （シリアル未接続・スキップ）")
-                elif cmd == "set_target":
-                    val = data.get("value", 2500)
-                    uart_cmd = f"SET_TARGET {val}\n".encode()
-                    if ser_port and ser_port.is_open:
-                        loop = asyncio.get_event_loop()
-                        await loop.run_in_executor(None, ser_port.write, uart_cmd)
-                        print(f"[CMD] SET_TARGET {val} → RX63N")
-                    else:
-                        print(f"[CMD] SET_TARGET {val} （シリアル未接続・スキップ）")
-                elif cmd == "set_pid":
-                    kp = data.get("kp", 500)
-                    ki = data.get("ki", 10)
-                    kd = data.get("kd", 100)
-                    uart_cmd = f"SET_PID {kp} {ki} {kd}\n".encode()
-                    if ser_port and ser_port.is_open:
-                        loop = asyncio.get_event_loop()
-                        await loop.run_in_executor(None, ser_port.write, uart_cmd)
-                        print(f"[CMD] SET_PID {kp} {ki} {kd} → RX63N")
-            except (json.JSONDecodeError, Exception):
-                pass
+                if not isinstance(data, dict):
+                    raise ValueError("JSON オブジェクトではない")
+                if data.get("type") == "replay":
+                    if replay:
+                        await replay.control(data)
+                elif "cmd" in data:
+                    metrics.inc("commands_total", cmd=data["cmd"])
+                    await commands.submit(data)
+            except json.JSONDecodeError as e:
+                metrics.inc("parse_errors_total", source="browser")
+                await websocket.send(json.dumps({"type": "error", "error": f"JSON として読めない: {e}"}))
+            except (KeyError, ValueError, TypeError) as e:
+                # 値の欠け / 型違い (set_target の sp が数値でない等) はそのブラウザにだけ返す
+                detail = f"{type(e).__name__}: {e}"
+                if isinstance(data, dict) and "cmd" in data:
+                    await websocket.send(json.dumps({"type": "cmd_result", "cmd": str(data["cmd"]),
+                                                     "ok": False, "error": f"不正な要求 ({detail})"}))
+                else:
+                    await websocket.send(json.dumps({"type": "error", "error": f"不正な要求 ({detail})"}))
+            except websockets.exceptions.ConnectionClosed:
+                raise
+            except Exception as e:
+                # 想定外はサーバー側の不具合: 接続は保ったまま記録して数える
+                metrics.inc("ws_handler_errors_total", error=type(e).__name__)
+                print(f"[WS] {addr} のメッセージ処理で例外: {type(e).__name__}: {e} "
+                      f"(受信 {message[:200]!r})")
+                await websocket.send(json.dumps({"type": "error", "error": "サーバー内部エラー"}))
     except websockets.exceptions.ConnectionClosed:
         pass
     finally:
         clients.discard(websocket)
+        client_enc.pop(websocket, None)
+        metrics.inc("ws_disconnects_total")
+        metrics.set("ws_clients", len(clients))
+        metrics.remove("ws_client_write_buffer_bytes", client=_peer(websocket))
         print(f"[WS] 切断: {addr}")
 
+# ============================================================
+# まとめ送り (sbatch) の展開
+# ============================================================
+SBATCH_KEYS = ("temp", "humi", "pres")   # sample_batch.h のチャンネル順 (×100)
+
+def decode_sbatch(data: dict) -> list:
+    """{"type":"sbatch","t0":..,"dt":..,"n":..,"id":..,"d":".."} → sensor の dict のリスト
+    d = サンプルごとに各チャンネルの直前との差 (zigzag + varint) を base64 (パディングなし)
+    received_at はフレームの受信時刻を最後のサンプルとし、dt ずつ遡る"""
+    raw = base64.b64decode(data["d"] + "=" * (-len(data["d"]) % 4), validate=True)
+    n, dt = int(data["n"]), int(data.get("dt", 0))
+    t_last = data.get("received_at", time.time())
+    vals = [0] * len(SBATCH_KEYS)
+    pos = 0
+    rows = []
+    for i in range(n):
+        for c in range(len(vals)):
+            z = shift = 0
+            while True:
+                b = raw[pos]
+                pos += 1
+                z |= (b & 0x7F) << shift
+                shift += 7
+                if not b & 0x80:
+                    break
+            # 送信側は int32 で差を取る (折り返しもそのまま戻す)
+            vals[c] = (vals[c] + ((z >> 1) ^ -(z & 1)) + 2**31) % 2**32 - 2**31
+        row = {"type": "sensor"}
+        row.update((k, v / 100) for k, v in zip(SBATCH_KEYS, vals))
+        if "id" in data:
+            row["id"] = int(data["id"]) + i
+        row["received_at"] = t_last - (n - 1 - i) * dt / 1000
+        rows.append(row)
+    return rows
+
+def expand_sbatch(data: dict, source: str) -> list:
+    """sbatch なら sensor に展開、それ以外はそのまま 1 件"""
+    if data.get("type") != "sbatch":
+        return [data]
+    try:
+        rows = decode_sbatch(data)
+    except (KeyError, ValueError, IndexError, TypeError, binascii.Error):
+        metrics.inc("parse_errors_total", source=source)
+        return []
+    metrics.inc("sbatch_frames_total", source=source)
+    metrics.inc("sbatch_samples_total", len(rows), source=source)
+    return rows
+
+async def _publish(items: list):
+    """記録 + ブラウザ配信"""
+    for item in items:
+        if recorder:
+            recorder.record(device_name, item)
+        await broadcast(item)
+
 # ============================================================
 # シリアル受信（ESP32 からの JSON を読む）
 # ============================================================
@@ -138,25 +995,40 @@ async def serial_reader(port: str):
         ser = serial.Serial(port, BAUD, timeout=1.0)
         global ser_port
         ser_port = ser
+        metrics.inc("source_connects_total", source="serial")
+        metrics.set("source_connected", 1, source="serial")
         print(f"[SERIAL] 接続成功 ({BAUD}bps)")
         loop = asyncio.get_event_loop()
+
+        async def send_line(line: str):
+            await loop.run_in_executor(None, ser.write, (line + "\n").encode())
+        commands.attach(send_line)
         while True:
             raw = await loop.run_in_executor(None, ser.readline)
             if not raw:
                 continue
+            metrics.inc("ingest_bytes_total", len(raw), source="serial")
             line = raw.decode("utf-8", errors="replace").strip()
             if not line:
                 continue
             print(f"[DATA] {line}")
             try:
                 data = json.loads(line)
+                if data.get("type") == "ack":
+                    await commands.on_ack(data)
+                    continue
                 data.setdefault("type", "sensor")
                 data.setdefault("received_at", time.time())
-                await broadcast(data)
+                metrics.inc("ingest_messages_total", source="serial", type=data["type"])
+                await _publish(expand_sbatch(data, "serial"))
             except json.JSONDecodeError:
+                metrics.inc("parse_errors_total", source="serial")
                 await broadcast({"type": "log", "message": line,
                                  "timestamp": time.time()})
     except serial.SerialException as e:
+        commands.detach()
+        metrics.inc("source_errors_total", source="serial")
+        metrics.set("source_connected", 0, source="serial")
         msg = str(e)
         print(f"[SERIAL] エラー: {msg}")
         if "PermissionError" in msg or "アクセスが拒否" in msg:
@@ -174,39 +1046,141 @@ async def wifi_reader(esp32_url: str):
     while True:
         try:
             async with ws_connect(esp32_url) as esp_ws:
+                metrics.inc("source_connects_total", source="wifi")
+                metrics.set("source_connected", 1, source="wifi")
                 print(f"[WIFI] ESP32 に接続成功")
-                # ブラウザコマンドを ESP32 に転送するためのタスク
-                async def forward_commands():
-                    """ブラウザからのコマンドを ESP32 に転送（将来拡張用）"""
-                    await asyncio.Future()  # 無限待ち
+                # ブラウザのコマンドは ESP32 が UART で GR-SAKURA へ転送する
+                commands.attach(esp_ws.send)
 
-                fwd_task = asyncio.create_task(forward_commands())
+                # ESP32 との時刻合わせ（WS 配信遅延の計測用）
+                async def clock_sync():
+                    while True:
+                        await esp_ws.send(json.dumps({"type": "sync", "t0": _now_us()}))
+                        await asyncio.sleep(SYNC_INTERVAL)
+
+                sync_task = asyncio.create_task(clock_sync())
                 try:
                     async for message in esp_ws:
+                        t3 = _now_us()
+                        metrics.inc("ingest_bytes_total", len(message), source="wifi")
                         try:
                             data = json.loads(message)
+                            metrics.inc("ingest_messages_total", source="wifi",
+                                        type=data.get("type", ""))
+                            if data.get("type") == "sync":
+                                esp_sync.sample(data["t0"], data["t1"], data["t2"], t3)
+                                continue
+                            if data.get("type") == "ack":
+                                await commands.on_ack(data)
+                                continue
+                            trace_message(data)
                             data.setdefault("received_at", time.time())
-                            await broadcast(data)
+                            await _publish(expand_sbatch(data, "wifi"))
                             if data.get("type") == "sensor":
                                 t = data.get("temp", "?")
                                 h = data.get("humi", "?")
                                 print(f"[WIFI] T={t} H={h}")
                         except json.JSONDecodeError:
+                            metrics.inc("parse_errors_total", source="wifi")
                             await broadcast({"type": "log", "message": message,
                                              "timestamp": time.time()})
                 except websockets.exceptions.ConnectionClosed:
                     pass
                 finally:
-                    fwd_task.cancel()
+                    commands.detach()
+                    sync_task.cancel()
+                    metrics.set("source_connected", 0, source="wifi")
         except (OSError, websockets.exceptions.WebSocketException) as e:
+            metrics.inc("source_errors_total", source="wifi")
             print(f"[WIFI] 接続エラー: {e} — 3秒後に再接続")
             await asyncio.sleep(3.0)
 
+# ============================================================
+# Ethernet モード（GR-SAKURA の lwIP と直接）
+# ============================================================
+def _handle_line(line: str, source: str):
+    """ファームウェアの 1 行 → ブラウザ / 記録。ack ならコルーチンを返す"""
+    try:
+        data = json.loads(line)
+    except json.JSONDecodeError:
+        metrics.inc("parse_errors_total", source=source)
+        return broadcast({"type": "log", "message": line, "timestamp": time.time()})
+    if data.get("type") == "ack":
+        return commands.on_ack(data)
+    data.setdefault("type", "sensor")
+    data.setdefault("received_at", time.time())
+    metrics.inc("ingest_messages_total", source=source, type=data["type"])
+    return _publish(expand_sbatch(data, source))
+
+async def eth_reader(bind: str):
+    """UDP で配信を受け、送り元 (GR-SAKURA) の ETH_CMD_PORT へ TCP でつないでコマンドを送る
+    GR-SAKURA のアドレスは最初のデータグラムで知る (設定不要)"""
+    host, _, port = bind.rpartition(":")
+    device = {"ip": None, "seen": asyncio.Event()}
+    loop = asyncio.get_running_loop()
+
+    class Telemetry(asyncio.DatagramProtocol):
+        def datagram_received(self, payload, addr):
+            metrics.inc("ingest_bytes_total", len(payload), source="eth")
+            if device["ip"] != addr[0]:
+                print(f"[ETH] GR-SAKURA {addr[0]} から受信")
+                device["ip"] = addr[0]
+                device["seen"].set()
+            for line in payload.decode("utf-8", errors="replace").splitlines():
+                if line.strip():
+                    asyncio.ensure_future(_handle_line(line.strip(), "eth"))
+
+    transport, _ = await loop.create_datagram_endpoint(
+        Telemetry, local_addr=(host or "0.0.0.0", int(port or ETH_TELEM_PORT)),
+        allow_broadcast=True)
+    print(f"[ETH] UDP {host or '0.0.0.0'}:{port or ETH_TELEM_PORT} で待ち受け")
+    try:
+        while True:
+            await device["seen"].wait()
+            try:
+                reader, writer = await asyncio.open_connection(device["ip"], ETH_CMD_PORT)
+            except OSError as e:
+                metrics.inc("source_errors_total", source="eth")
+                print(f"[ETH] コマンド接続エラー: {e} — {ETH_RETRY_SEC:g}秒後に再接続")
+                await asyncio.sleep(ETH_RETRY_SEC)
+                continue
+            metrics.inc("source_connects_total", source="eth")
+            metrics.set("source_connected", 1, source="eth")
+
+            async def send_line(line: str):
+                writer.write((line + "\n").encode())
+                await writer.drain()
+            commands.attach(send_line)
+            try:
+                # GR-SAKURA は無通信が続くと切るので、EOF ならすぐつなぎ直す
+                while raw := await reader.readline():
+                    line = raw.decode("utf-8", errors="replace").strip()
+                    if line:
+                        await _handle_line(line, "eth")
+            except OSError:
+                metrics.inc("source_errors_total", source="eth")
+                await asyncio.sleep(ETH_RETRY_SEC)
+            finally:
+                commands.detach()
+                metrics.set("source_connected", 0, source="eth")
+                writer.close()
+    finally:
+        transport.close()
+
 # ============================================================
 # デモモード（ESP32 なしで動作確認）
 # ============================================================
 async def demo_generator():
     print("[DEMO] 擬似センサーデータを生成します（ESP32 なし確認用）")
+
+    async def fake_ack(cid: int):
+        await asyncio.sleep(0.02)
+        await commands.on_ack({"type": "ack", "cid": cid, "ok": 1})
+
+    async def send_line(line: str):
+        # GR-SAKURA の代わりに 20ms 後 ack を返す
+        asyncio.create_task(fake_ack(json.loads(line)["cid"]))
+    commands.attach(send_line)
     t = 0
     while True:
         data = {
@@ -217,6 +1191,9 @@ async def demo_generator():
             "ts":        int(time.time()),
             "demo":      True,
         }
+        metrics.inc("ingest_messages_total", source="demo", type="sensor")
+        if recorder:
+            recorder.record(device_name, data)
         await broadcast(data)
         if clients:
             print(f"[DEMO] {data['temp']}°C {data['humidity']}% "
@@ -224,10 +1201,177 @@ async def demo_generator():
         t += 1
         await asyncio.sleep(1.0)
 
+# ============================================================
+# リプレイ（記録済みデータを通常の取り込み経路に流す）
+# ============================================================
+class ReplaySource:
+    """Recorder の SQLite か JSON Lines のキャプチャを記録時刻どおりに再生する
+    記録時刻 pos と実時間の対応 (anchor) を持ち、速度変更 / 一時停止 / シークで張り直す"""
+    READ_BATCH = 500
+
+    def __init__(self, path: str, device: str = None, speed: float = 1.0):
+        self.path = path
+        self.device = device
+        self.is_db = path.endswith((".db", ".sqlite", ".sqlite3"))
+        self.lines = None if self.is_db else self._load_lines(path)
+        self.t0, self.t1, self.count = self._extent()
+        self.pos = self.t0
+        self.speed = min(max(float(speed), 1.0), REPLAY_SPEED_MAX)
+        self.paused = False
+        self.changed = asyncio.Event()
+        self.seek_to = None
+        self._anchor()
+
+    @staticmethod
+    def _load_lines(path):
+        """(時刻, JSON 文字列) を時刻順に。時刻の無い行 / JSON でない行は飛ばす"""
+        rows = []
+        with open(path, encoding="utf-8") as f:
+            for line in f:
+                try:
+                    data = json.loads(line)
+                    ts = float(data.get("received_at") or data["ts"])
+                except (ValueError, KeyError, TypeError, AttributeError):
+                    continue
+                rows.append((ts, line.strip()))
+        rows.sort(key=lambda r: r[0])
+        return rows
+
+    def _extent(self):
+        if self.lines is not None:
+            if not self.lines:
+                return 0.0, 0.0, 0
+            return self.lines[0][0], self.lines[-1][0], len(self.lines)
+        db = sqlite3.connect(self.path)
+        try:
+            sql, params = "SELECT MIN(ts), MAX(ts), COUNT(*) FROM samples", []
+            if self.device:
+                sql, params = sql + " WHERE device = ?", [self.device]
+            t0, t1, n = db.execute(sql, params).fetchone()
+            return t0 or 0.0, t1 or 0.0, n
+        finally:
+            db.close()
+
+    def _rows(self, start: float):
+        """start 以降の (時刻, JSON 文字列)。DB はカーソルで少しずつ読む"""
+        if self.lines is not None:
+            i = bisect.bisect_left(self.lines, (start, ""))
+            yield from self.lines[i:]
+            return
+        sql, params = "SELECT ts, data FROM samples WHERE ts >= ?", [start]
+        if self.device:
+            sql, params = sql + " AND device = ?", params + [self.device]
+        db = sqlite3.connect(self.path)
+        try:
+            cur = db.execute(sql + " ORDER BY ts", params)
+            while True:
+                rows = cur.fetchmany(self.READ_BATCH)
+                if not rows:
+                    break
+                yield from rows
+        finally:
+            db.close()
+
+    def _anchor(self):
+        self.wall0, self.rec0 = time.monotonic(), self.pos
+
+    def _now(self) -> float:
+        """現在再生しているべき記録時刻"""
+        if self.paused:
+            return self.pos
+        return self.rec0 + (time.monotonic() - self.wall0) * self.speed
+
+    def state(self) -> dict:
+        return {"type": "replay_state", "pos": round(self.pos, 3), "t0": self.t0,
+                "t1": self.t1, "speed": self.speed, "paused": self.paused,
+                "ended": self.pos >= self.t1 and self.paused}
+
+    async def control(self, data: dict):
+        """ブラウザから {"type":"replay","action":"pause|play|speed|seek","value":..}"""
+        action = data.get("action")
+        self.pos = self._now()
+        if action == "pause":
+            self.paused = True
+        elif action == "play":
+            if self.pos >= self.t1:
+                self.seek_to = self.t0      # 末尾からは頭出し
+            self.paused = False
+        elif action == "speed":
+            self.speed = min(max(float(data.get("value", 1)), 1.0), REPLAY_SPEED_MAX)
+        elif action == "seek":
+            self.seek_to = min(max(float(data.get("value", self.t0)), self.t0), self.t1)
+            self.pos = self.seek_to
+        else:
+            return
+        self._anchor()
+        self.changed.set()
+        await broadcast(self.state())
+
+    async def _wait(self, ts: float) -> bool:
+        """記録時刻 ts まで待つ。操作が入ったら False (シーク等を反映して読み直す)"""
+        while self.paused or ts > self._now():
+            self.changed.clear()
+            timeout = None if self.paused else (ts - self._now()) / self.speed
+            try:
+                await asyncio.wait_for(self.changed.wait(), timeout)
+            except asyncio.TimeoutError:
+                pass
+            if self.seek_to is not None:
+                return False
+        return True
+
+    async def run(self):
+        print(f"[REPLAY] {self.path}: {self.count} 件 "
+              f"{datetime.datetime.fromtimestamp(self.t0):%Y-%m-%d %H:%M:%S} 〜 "
+              f"{datetime.datetime.fromtimestamp(self.t1):%H:%M:%S} ({self.speed:g} 倍)")
+        last_state = 0.0
+        while True:
+            start, self.seek_to = (self.seek_to if self.seek_to is not None else self.pos), None
+            self.pos = start
+            self._anchor()
+            rows = self._rows(start)
+            for n, (ts, line) in enumerate(rows):
+                if not await self._wait(ts):
+                    break
+                self.pos = ts
+                metrics.inc("ingest_bytes_total", len(line), source="replay")
+                data = json.loads(line)
+                metrics.inc("ingest_messages_total", source="replay", type=data.get("type", ""))
+                await broadcast(data)
+                now = time.monotonic()
+                if now - last_state >= REPLAY_STATE_SEC:
+                    last_state = now
+                    metrics.set("replay_position_seconds", round(ts, 3))
+                    metrics.set("replay_speed", 0 if self.paused else self.speed)
+                    await broadcast(self.state())
+                elif n % 100 == 99:
+                    await asyncio.sleep(0)  # 高倍速で待ちが無くてもブラウザの操作を受け付ける
+            else:
+                # 末尾: 一時停止してシーク / 再生を待つ
+                self.pos, self.paused = self.t1, True
+                print("[REPLAY] 末尾に到達（ブラウザから再生で頭出し）")
+                await broadcast(self.state())
+                while self.paused and self.seek_to is None:
+                    self.changed.clear()
+                    await self.changed.wait()
+            rows.close()
+
+replay = None       # --replay のとき main() で作る
+
 # ============================================================
 # メイン
 # ============================================================
 async def main(args):
+    global loop_thread_id, recorder, device_name, replay
+    loop_thread_id = threading.get_ident()
+    device_name = args.device or (args.wifi or args.port or ("eth" if args.eth else "demo"))
+    if args.replay:
+        # 再生したものを記録し直さない (同じ DB を再生すると自分を追いかけてしまう)
+        replay = ReplaySource(args.replay, args.device, args.speed)
+    elif args.db:
+        recorder = Recorder(args.db)
+    if args.profile:
+        profiler.start(loop_thread_id)
     my_ip = _local_ip()
     dashboard_dir = os.path.dirname(os.path.abspath(__file__))
 
@@ -244,26 +1388,48 @@ async def main(args):
     print(f"  ★ ブラウザで開く → http://localhost:{HTTP_PORT}")
     print(f"  　 同一LAN内から → http://{my_ip}:{HTTP_PORT}")
     print()
-    if args.wifi:
+    if args.replay:
+        print(f"  [モード] リプレイ ({args.replay}{', ' + args.device if args.device else ''})")
+    elif args.eth:
+        print(f"  [モード] Ethernet (UDP {args.eth} / TCP {ETH_CMD_PORT})")
+    elif args.wifi:
         print(f"  [モード] WiFi ({args.wifi})")
     elif args.port:
         print(f"  [モード] シリアル ({args.port})")
     else:
-        print(f"  [モード] デモ（--port COM4 / --wifi 192.168.4.1 で実機接続）")
+        print(f"  [モード] デモ（--port COM4 / --wifi 192.168.4.1 / --eth で実機接続）")
+    print(f"  メトリクス : http://localhost:{HTTP_PORT}/metrics")
+    if recorder:
+        print(f"  記録       : {args.db} (デバイス名 {device_name}) → /export")
+    if args.profile:
+        print(f"  プロファイラ動作中 → http://localhost:{HTTP_PORT}/profile/stop で結果")
     print("=" * 50)
     print()
 
     # データソース起動
-    if args.wifi:
+    if replay:
+        data_task = asyncio.create_task(replay.run())
+    elif args.eth:
+        data_task = asyncio.create_task(eth_reader(args.eth))
+    elif args.wifi:
         esp_url = args.wifi if args.wifi.startswith("ws") else f"ws://{args.wifi}/ws"
         data_task = asyncio.create_task(wifi_reader(esp_url))
     elif args.port:
         data_task = asyncio.create_task(serial_reader(args.port))
     else:
         data_task = asyncio.create_task(demo_generator())
+    lag_task = asyncio.create_task(loop_lag_monitor())
+    batch_task = asyncio.create_task(batcher.run())
+
+    # permessage-deflate はブラウザが要求したときだけ有効になる
+    # 窓を小さくして接続あたりのメモリを抑える (websockets の既定と同じ値を明示)
+    deflate = [] if args.no_deflate else [ServerPerMessageDeflateFactory(
+        server_max_window_bits=WS_DEFLATE_BITS, client_max_window_bits=WS_DEFLATE_BITS,
+        compress_settings={"memLevel": 5})]
 
     # WebSocket サーバー起動
-    async with serve(ws_handler, "0.0.0.0", WS_PORT, reuse_address=True):
+    async with serve(ws_handler, "0.0.0.0", WS_PORT, reuse_address=True,
+                     compression=None, extensions=deflate):
         print(f"[WS]   WebSocket  ws://localhost:{WS_PORT}")
         print(f"[HTTP] HTTP       http://localhost:{HTTP_PORT}")
         print()
@@ -275,6 +1441,8 @@ async def main(args):
             pass
         finally:
             data_task.cancel()
+            lag_task.cancel()
+            batch_task.cancel()
 
     print("\n=== 停止しました ===")
 
@@ -292,6 +1460,20 @@ if __name__ == "__main__":
     parser = argparse.ArgumentParser(description="SAMDEMO ダッシュボード")
     parser.add_argument("--port", "-p", help="COM ポート (例: COM4)")
     parser.add_argument("--wifi", "-w", help="ESP32 WiFi IP (例: 192.168.4.1)")
+    parser.add_argument("--eth", "-e", nargs="?", const=str(ETH_TELEM_PORT),
+                        help=f"GR-SAKURA の Ethernet から受ける ([BIND:]PORT, 既定 {ETH_TELEM_PORT})")
+    parser.add_argument("--db", default=os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                     "history.db"),
+                        help='受信データの記録先 SQLite ("" で記録しない)')
+    parser.add_argument("--device", "-d", help="記録するデバイス名 (省略時は --wifi / --port の値)。"
+                                                  "--replay では再生するデバイス")
+    parser.add_argument("--replay", "-r", help="記録済みデータを再生する (history.db か JSON Lines)")
+    parser.add_argument("--speed", type=float, default=1.0,
+                        help=f"--replay の初期速度 [倍] (1〜{REPLAY_SPEED_MAX})")
+    parser.add_argument("--no-deflate", action="store_true",
+                        help="ブラウザへの permessage-deflate を無効にする (比較用)")
+    parser.add_argument("--profile", action="store_true",
+                        help="起動時からサンプリングプロファイラを動かす")
     args = parser.parse_args()
     try:
         asyncio.run(main(args))
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+ws_encoding_bench.py - ブラウザ向け WebSocket の 1 クライアントあたり bytes/s 見積もり
+
+server.py のエンコーダ (encode_json / encode_batch) で ESP32 の sensor を模擬的に
+エンコードし、permessage-deflate (server.py と同じ窓 / memLevel、コンテキスト引継ぎあり)
+の有無でフレームヘッダ込みのバイト数を数える。ネットワークは使わない。
+
+使い方:
+  python ws_encoding_bench.py                 # 1 / 10 / 50 / 100 Hz, 各 60 秒分
+  python ws_encoding_bench.py --rates 1 20 --seconds 300
+"""
+
+import argparse
+import json
+import math
+import random
+import zlib
+
+import server
+
+
+def frame_overhead(n: int) -> int:
+    """サーバー → ブラウザのフレームヘッダ (マスクなし)"""
+    return 2 if n < 126 else 4 if n < 65536 else 10
+
+
+class Deflate:
+    """permessage-deflate: メッセージ毎に SYNC_FLUSH し末尾 00 00 ff ff を落とす"""
+    def __init__(self):
+        self.c = zlib.compressobj(wbits=-server.WS_DEFLATE_BITS, memLevel=5)
+
+    def size(self, data: bytes) -> int:
+        return len(self.c.compress(data) + self.c.flush(zlib.Z_SYNC_FLUSH)) - 4
+
+
+def samples(rate: float, seconds: float):
+    """ESP32 が WiFi で送る sensor + server.py が付ける received_at"""
+    t, us, n = 1_700_000_000.0, 0, int(rate * seconds)
+    for i in range(n):
+        temp = 25.0 + 5.0 * math.sin(i / rate * 0.05) + random.gauss(0, 0.05)
+        yield {"type": "sensor", "temp": round(temp, 1),
+               "humi": round(45.0 + random.gauss(0, 0.2), 1),
+               "pres": round(1013.25 + random.gauss(0, 0.02), 2),
+               "pwm": 128 + i % 7, "duty": 5000 + i % 97, "id": i,
+               "t_us": us & 0xFFFFFFFF, "received_at": round(t + i / rate, 6)}
+        us += int(1e6 / rate)
+
+
+def measure(rate: float, seconds: float) -> dict:
+    msgs = list(samples(rate, seconds))
+    frames = {
+        "json (従来)":   [json.dumps(d, ensure_ascii=False) for d in msgs],
+        "json compact": [server.encode_json(d) for d in msgs],
+        "batch":        [],
+    }
+    per = max(1, int(rate * server.BATCH_MS / 1000))
+    for i in range(0, len(msgs), per):
+        frames["batch"].append(server.encode_batch(msgs[i:i + per]))
+
+    out = {}
+    for name, fs in frames.items():
+        raw = deflated = 0
+        z = Deflate()
+        for f in fs:
+            b = f.encode("utf-8")
+            raw += len(b) + frame_overhead(len(b))
+            c = z.size(b)
+            deflated += c + frame_overhead(c)
+        out[name] = (raw / seconds, deflated / seconds)
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description="WebSocket エンコード別 bytes/s")
+    parser.add_argument("--rates", type=float, nargs="+", default=[1, 10, 50, 100])
+    parser.add_argument("--seconds", type=float, default=60)
+    args = parser.parse_args()
+
+    random.seed(1)
+    print(f"batch 周期 {server.BATCH_MS} ms, deflate 窓 2^{server.WS_DEFLATE_BITS}")
+    print(f"{'Hz':>5}  {'エンコード':<14}{'非圧縮 B/s':>12}{'deflate B/s':>13}{'比 (従来比)':>12}")
+    for rate in args.rates:
+        res = measure(rate, args.seconds)
+        base = res["json (従来)"][0]
+        for name, (raw, defl) in res.items():
+            print(f"{rate:>5g}  {name:<14}{raw:>12.0f}{defl:>13.0f}{defl / base:>12.1%}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,577 @@
+/**
+ * ホスト (native) ベンチマーク
+ *
+ * src/ のアプリ (setup / loop, 各クラス) をフェイク周辺の上で Linux 実行し、
+ * GR-SAKURA・ヒーター・ブラウザを模擬して次を計測する:
+ *   - loop() 1 回あたりの CPU 時間 (待ち時間を除く)
+ *   - センサー 1 サンプルあたりのヒープ確保回数 / バイト数 (loop タスク分)
+ *   - ブラウザのコマンド → UART 送出までの遅延
+ *   - まとめ送り (SENSOR_BATCH_MS, env:native-batch): 圧縮率とサンプルの待ち時間
+ *   - 複数ヒーターの位相ずらし: ピーク電流 / ピーク対平均比 / 電流予算 (HeaterPwm)
+ *
+ * フェーズ:
+ *   idle  WS 1 台, コマンド 10 件/秒
+ *   load  WS 4 台, コマンド 200 件/秒, GR-SAKURA から応答以外の ctrl を --flood Hz
+ *
+ * 実行: pio run -e native -t exec
+ *       pio run -e native-batch -t exec      (sensor を sbatch でまとめて送る)
+ *       .pio/build/native/program --seconds 10 --flood 2000
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "fake_hw.h"
+#include "heater_pwm.h"
+#include "sample_batch.h"
+#include "uart_comm.h"
+#include "web_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+void setup();
+void loop();
+
+typedef std::chrono::steady_clock Clock;
+
+// ---------------------------------------------------------------- ヒープ計数
+// glibc の malloc を差し替え、計数中のスレッド (loop タスク) の分だけ数える
+
+static thread_local bool countAllocs = false;
+static std::atomic<uint64_t> allocCount{0};
+static std::atomic<uint64_t> allocBytes{0};
+
+#ifdef __GLIBC__
+#define HAVE_ALLOC_COUNT 1
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+
+extern "C" void *malloc(size_t size) {
+    if (countAllocs) {
+        allocCount++;
+        allocBytes += size;
+    }
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size) {
+    if (countAllocs) {
+        allocCount++;
+        allocBytes += n * size;
+    }
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size) {
+    if (countAllocs) {
+        allocCount++;
+        allocBytes += size;
+    }
+    return __libc_realloc(p, size);
+}
+#else
+#define HAVE_ALLOC_COUNT 0
+#endif
+
+// ベンチ側の処理 (フック内) は数えない
+class NoCount {
+public:
+    NoCount() : prev_(countAllocs) { countAllocs = false; }
+    ~NoCount() { countAllocs = prev_; }
+private:
+    bool prev_;
+};
+
+static uint64_t threadCpuUs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// ---------------------------------------------------------------- 集計
+
+struct Samples {
+    std::vector<uint32_t> v;
+    void add(uint32_t x) { v.push_back(x); }
+    uint32_t pct(int p) {
+        if (v.empty()) return 0;
+        std::sort(v.begin(), v.end());
+        size_t i = (v.size() - 1) * p / 100;
+        return v[i];
+    }
+    uint32_t max() { return v.empty() ? 0 : *std::max_element(v.begin(), v.end()); }
+};
+
+// ---------------------------------------------------------------- 模擬 GR-SAKURA
+// sensor を受けたら配線時間 + 処理時間の後に ctrl を返す。flood 指定時は
+// 応答とは別に ctrl を周期送信する (iot-demo-rx-test の pid_task 相当)
+
+class GrSakuraSim {
+public:
+    void start() {
+        running_ = true;
+        worker_ = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        running_ = false;
+        cv_.notify_all();
+        worker_.join();
+        if (flooder_.joinable()) flooder_.join();
+    }
+
+    void flood(uint32_t hz) {
+        if (hz == 0) return;
+        flooder_ = std::thread([this, hz] {
+            auto period = std::chrono::microseconds(1000000 / hz);
+            auto next = Clock::now();
+            while (running_) {
+                next += period;
+                std::this_thread::sleep_until(next);
+                reply(0, false);
+            }
+        });
+    }
+
+    // uart_write_bytes のフック (loop タスクで実行)
+    void onUart(const char *data, size_t len) {
+        NoCount nc;
+        Clock::time_point now = Clock::now();
+        for (size_t i = 0; i < len; i++) {
+            if (data[i] != '\n') {
+                partial_ += data[i];
+                continue;
+            }
+            if (partial_.find("\"cmd\"") != std::string::npos) {
+                onCommand(partial_, now);
+            } else {
+                std::lock_guard<std::mutex> lock(mutex_);
+                lines_.push_back({partial_, now});
+                cv_.notify_one();
+            }
+            partial_.clear();
+        }
+    }
+
+    // コマンド遅延の起点 (ブラウザ側で送った時刻)
+    void commandSent(uint32_t n, Clock::time_point t) {
+        std::lock_guard<std::mutex> lock(cmdMutex_);
+        if (n < sentAt_.size()) sentAt_[n] = t;
+    }
+
+    void resetStats(size_t maxCommands) {
+        std::lock_guard<std::mutex> lock(cmdMutex_);
+        sentAt_.assign(maxCommands, Clock::time_point());
+        cmdLatency_.v.clear();
+        cmdLatency_.v.reserve(maxCommands);
+        sensors_ = 0;
+        replies_ = 0;
+        frames_ = 0;
+        wireBytes_ = 0;
+        jsonBytes_ = 0;
+        batchErrors_ = 0;
+        wait_.v.clear();
+    }
+
+    uint32_t sensors() const { return sensors_; }
+    uint32_t replies() const { return replies_; }
+    Samples &cmdLatency() { return cmdLatency_; }
+    // sensor / sbatch の行数とバイト数、同じサンプルを sensor フレームで送った場合のバイト数
+    uint32_t frames() const { return frames_; }
+    uint64_t wireBytes() const { return wireBytes_; }
+    uint64_t jsonBytes() const { return jsonBytes_; }
+    uint32_t batchErrors() const { return batchErrors_; }
+    // 読取 (t0 + i*dt) → 受信完了 [ms]
+    Samples &wait() { return wait_; }
+
+    float sp() const { return 28.0f; }
+
+private:
+    struct Line {
+        std::string text;
+        Clock::time_point at;
+    };
+
+    void onCommand(const std::string &line, Clock::time_point now) {
+        size_t p = line.find("\"n\":");
+        if (p == std::string::npos) return;
+        uint32_t n = (uint32_t)strtoul(line.c_str() + p + 4, nullptr, 10);
+        std::lock_guard<std::mutex> lock(cmdMutex_);
+        if (n >= sentAt_.size() || sentAt_[n] == Clock::time_point()) return;
+        cmdLatency_.add((uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            now - sentAt_[n]).count());
+    }
+
+    void run() {
+        for (;;) {
+            Line line;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return !lines_.empty() || !running_; });
+                if (!running_) return;
+                line = lines_.front();
+                lines_.pop_front();
+            }
+            JsonDocument doc;
+            if (deserializeJson(doc, line.text)) continue;
+            uint32_t id = doc["id"] | 0UL;
+            if (strcmp(doc["type"] | "", "sbatch") == 0) {
+                id = onBatch(doc, line);
+            } else if (strcmp(doc["type"] | "", "sensor") == 0) {
+                sensors_++;
+                frames_++;
+                wireBytes_ += line.text.size() + 1;
+                jsonBytes_ += line.text.size() + 1;
+                temp_ = doc["temp"] | 25.0f;
+            } else {
+                continue;
+            }
+
+            // 往復の配線時間 (10bit/文字) + PID 処理 200us
+            uint32_t baud = fake::uartBaud(UART_PORT);
+            uint32_t wireUs = (uint32_t)((line.text.size() + 1 + 110) * 10ULL * 1000000ULL / baud);
+            std::this_thread::sleep_until(line.at + std::chrono::microseconds(wireUs / 2));
+            uint32_t t1 = micros() + CLOCK_OFFSET_US;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            reply(id, true, t1);
+            std::this_thread::sleep_for(std::chrono::microseconds(wireUs / 2));
+            replies_++;
+        }
+    }
+
+    // 展開して UartComm::sendSensor と同じ形の行に直したときの長さを数える。
+    // 戻り値は応答に載せる id (最後のサンプル)
+    uint32_t onBatch(JsonDocument &doc, const Line &line) {
+        uint32_t n = doc["n"] | 0UL, dt = doc["dt"] | 0UL, t0 = doc["t0"] | 0UL;
+        uint32_t id = doc["id"] | 0UL;
+        uint32_t now = millis();
+        SampleBatchReader rd;
+        rd.begin(doc["d"] | "", n);
+        int32_t v[SBATCH_CHANNELS];
+        uint32_t i = 0;
+        while (rd.next(v)) {
+            JsonDocument s;
+            s["type"] = "sensor";
+            s["temp"] = v[0] / 100.0f;
+            s["humi"] = v[1] / 100.0f;
+            s["pres"] = v[2] / 100.0f;
+            s["id"]   = id + i;
+            jsonBytes_ += measureJson(s) + 1;
+            // 周期からのずれ (半周期未満) で最後のサンプルが先に見えることがある
+            int32_t w = (int32_t)(now - (t0 + i * dt));
+            wait_.add(w > 0 ? (uint32_t)w : 0);
+            temp_ = v[0] / 100.0f;
+            i++;
+        }
+        if (rd.error() || i != n) batchErrors_++;
+        sensors_ += i;
+        frames_++;
+        wireBytes_ += line.text.size() + 1;
+        return id + n - 1;
+    }
+
+    // P 制御で duty を決めて ctrl を返す
+    void reply(uint32_t id, bool withId, uint32_t t1 = 0) {
+        float err = sp() - temp_;
+        int duty = (int)(err * 2000.0f);
+        duty = duty < 0 ? 0 : duty > 10000 ? 10000 : duty;
+
+        char buf[192];
+        int n;
+        if (withId) {
+            uint32_t t2 = micros() + CLOCK_OFFSET_US;
+            n = snprintf(buf, sizeof(buf),
+                         "{\"type\":\"ctrl\",\"vtemp\":%.1f,\"pwm\":%d,\"duty\":%d,\"sp\":%.1f,"
+                         "\"id\":%lu,\"t1\":%lu,\"t2\":%lu,\"pu\":50}\n",
+                         temp_.load(), duty * 255 / 10000, duty, sp(), (unsigned long)id,
+                         (unsigned long)t1, (unsigned long)t2);
+        } else {
+            n = snprintf(buf, sizeof(buf),
+                         "{\"type\":\"ctrl\",\"vtemp\":%.1f,\"pwm\":%d,\"duty\":%d,\"sp\":%.1f}\n",
+                         temp_.load(), duty * 255 / 10000, duty, sp());
+        }
+        fake::uartFeed(UART_PORT, buf, (size_t)n);
+    }
+
+    static const uint32_t CLOCK_OFFSET_US = 123456789;
+
+    std::atomic<bool> running_{false};
+    std::thread worker_;
+    std::thread flooder_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Line> lines_;
+    std::string partial_;
+    std::atomic<float> temp_{25.0f};
+    std::atomic<uint32_t> sensors_{0};
+    std::atomic<uint32_t> replies_{0};
+    std::atomic<uint32_t> frames_{0};
+    std::atomic<uint64_t> wireBytes_{0};
+    std::atomic<uint64_t> jsonBytes_{0};
+    std::atomic<uint32_t> batchErrors_{0};
+    Samples wait_;
+
+    std::mutex cmdMutex_;
+    std::vector<Clock::time_point> sentAt_;
+    Samples cmdLatency_;
+};
+
+static GrSakuraSim gr;
+
+// ---------------------------------------------------------------- 模擬ヒーター
+// 1 次遅れ: 全出力で周囲 +20℃, 時定数 2 秒 (ベンチ用に速く)
+
+static std::atomic<bool> plantRunning{false};
+
+static void plantTask() {
+    float temp = 25.0f;
+    const float ambient = 25.0f, gain = 20.0f, tau = 2.0f, dt = 0.01f;
+    while (plantRunning) {
+        float u = (float)fake::ledcDuty(HEATER_PWM_CH) / HEATER_PWM_MAX;
+        temp += (ambient + gain * u - temp) * dt / tau;
+        fake::bmeSet(temp, 45.0f, 1013.25f);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+// ---------------------------------------------------------------- WebSocket 受信側
+
+static std::mutex wsMutex;
+static std::string lastSched;
+static std::atomic<uint64_t> wsMessages{0};
+static std::atomic<uint64_t> wsBytes{0};
+
+static void onWsText(uint32_t id, const char *msg, size_t len) {
+    (void)id;
+    NoCount nc;
+    wsMessages++;
+    wsBytes += len;
+    if (len > 16 && strncmp(msg, "{\"type\":\"sched\"", 15) == 0) {
+        std::lock_guard<std::mutex> lock(wsMutex);
+        lastSched.assign(msg, len);
+    }
+}
+
+// ---------------------------------------------------------------- フェーズ
+
+struct Phase {
+    const char *name;
+    uint32_t seconds;
+    uint32_t clients;
+    uint32_t cmdPerSec;
+    uint32_t floodHz;
+};
+
+static void runPhase(const Phase &ph) {
+    size_t maxCmds = (size_t)ph.cmdPerSec * ph.seconds + 16;
+    gr.resetStats(maxCmds);
+
+    std::vector<AsyncWebSocketClient *> clients;
+    for (uint32_t i = 0; i < ph.clients; i++) clients.push_back(fake::wsConnect());
+
+    gr.start();
+    gr.flood(ph.floodHz);
+
+    // AsyncTCP 役: ブラウザからのコマンド
+    std::atomic<bool> sending{true};
+    std::atomic<uint32_t> sent{0};
+    std::thread sender([&] {
+        auto period = std::chrono::microseconds(1000000 / ph.cmdPerSec);
+        auto next = Clock::now();
+        for (uint32_t n = 0; sending && n < maxCmds; n++) {
+            next += period;
+            std::this_thread::sleep_until(next);
+            char buf[96];
+            snprintf(buf, sizeof(buf),
+                     "{\"type\":\"cmd\",\"cmd\":\"set_target\",\"sp\":%.1f,\"n\":%lu}",
+                     gr.sp(), (unsigned long)n);
+            gr.commandSent(n, Clock::now());
+            fake::wsSend(clients[n % clients.size()], buf);
+            sent++;
+        }
+    });
+
+    Samples iter;
+    iter.v.reserve(4000000);
+    allocCount = 0;
+    allocBytes = 0;
+    wsMessages = 0;
+    wsBytes = 0;
+
+    uint64_t cpuTotal = 0;
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::seconds(ph.seconds);
+    while (Clock::now() < end) {
+        uint64_t c0 = threadCpuUs();
+        countAllocs = true;
+        loop();
+        countAllocs = false;
+        uint64_t dt = threadCpuUs() - c0;
+        cpuTotal += dt;
+        if (iter.v.size() < iter.v.capacity()) iter.add((uint32_t)dt);
+    }
+    double wallS = std::chrono::duration<double>(Clock::now() - start).count();
+
+    sending = false;
+    sender.join();
+    gr.stop();
+    for (AsyncWebSocketClient *c : clients) fake::wsDisconnect(c);
+
+    uint32_t samples = gr.sensors();
+    Samples &lat = gr.cmdLatency();
+
+    printf("\n== %s (%us, WS %u 台, コマンド %u/s, flood %u Hz) ==\n",
+           ph.name, ph.seconds, ph.clients, ph.cmdPerSec, ph.floodHz);
+    printf("loop()       %zu 回 (%.0f/s)  CPU p50 %u us  p99 %u us  max %u us  使用率 %.2f %%\n",
+           iter.v.size(), iter.v.size() / wallS, iter.pct(50), iter.pct(99), iter.max(),
+           cpuTotal / (wallS * 1e4));
+    printf("sensor       %u 件 → ctrl 応答 %u 件, WS 送信 %llu 件 (%.1f kB/s)\n",
+           samples, gr.replies(), (unsigned long long)wsMessages.load(),
+           wsBytes.load() / wallS / 1000.0);
+#if HAVE_ALLOC_COUNT
+    if (samples > 0) {
+        printf("heap         %.1f 回/サンプル  %.0f B/サンプル (loop タスク)\n",
+               (double)allocCount / samples, (double)allocBytes / samples);
+    }
+#else
+    printf("heap         (glibc 以外では計数しない)\n");
+#endif
+    if (gr.frames() > 0) {
+        Samples &w = gr.wait();
+        printf("sensor UART  %u 行 %.1f B/サンプル (sensor フレームなら %.1f B, 圧縮率 %.2f)"
+               "  読取→受信 p50 %u ms  p99 %u ms  max %u ms  復号エラー %u\n",
+               gr.frames(), (double)gr.wireBytes() / (samples ? samples : 1),
+               (double)gr.jsonBytes() / (samples ? samples : 1),
+               gr.wireBytes() ? (double)gr.jsonBytes() / gr.wireBytes() : 0.0,
+               w.pct(50), w.pct(99), w.max(), gr.batchErrors());
+    }
+    printf("cmd → UART   %zu/%u 件  p50 %u us  p99 %u us  max %u us\n",
+           lat.v.size(), sent.load(), lat.pct(50), lat.pct(99), lat.max());
+
+    std::lock_guard<std::mutex> lock(wsMutex);
+    if (!lastSched.empty()) printf("sched        %s\n", lastSched.c_str());
+}
+
+// 上限を超えて接続し、/metrics で受け付け数と拒否数を確かめる
+static void checkAdmission() {
+    std::vector<AsyncWebSocketClient *> clients;
+    for (int i = 0; i < WS_MAX_CLIENTS + 2; i++) clients.push_back(fake::wsConnect());
+
+    std::string body;
+    int code = fake::httpGet("/metrics", &body);
+    printf("\n== /metrics (WS %d 台接続, 上限 %d) ==\nHTTP %d, %zu B\n",
+           WS_MAX_CLIENTS + 2, WS_MAX_CLIENTS, code, body.size());
+    static const char *const keys[] = {
+        "esp32_ws_clients ", "esp32_ws_rejected_total", "esp32_loop_rate_hz ",
+        "esp32_uart_rx_bytes_total ", "esp32_uart_dropped_lines_total ",
+    };
+    size_t pos = 0;
+    while (pos < body.size()) {
+        size_t end = body.find('\n', pos);
+        if (end == std::string::npos) end = body.size();
+        std::string line = body.substr(pos, end - pos);
+        for (const char *k : keys) {
+            if (line.compare(0, strlen(k), k) == 0) printf("  %s\n", line.c_str());
+        }
+        pos = end + 1;
+    }
+    for (AsyncWebSocketClient *c : clients) fake::wsDisconnect(c);
+}
+
+// 同じ電源の 4 チャンネルに乱数の duty を入れ、hpoint をずらしたピークと
+// そろえたまま (従来) のピーク、予算超過の有無を比べる。LEDC 4-7 を使う
+#define BENCH_HEATERS     4
+#define BENCH_HEATER_MA   2500
+#define BENCH_BUDGET_MA   6000
+#define BENCH_HEATER_SETS 2000
+
+static void checkHeaterPhase() {
+    static HeaterPwm h;
+    for (int i = 0; i < BENCH_HEATERS; i++) h.add(12 + i, 4 + i, BENCH_HEATER_MA);
+    h.begin();
+
+    for (uint32_t budget : {0u, (uint32_t)BENCH_BUDGET_MA}) {
+        h.setBudget(budget);
+        uint64_t rng = 88172645463325252ULL;
+        double aligned = 0, peak = 0, par = 0, scale = 0;
+        uint32_t over = 0, parN = 0;
+        uint64_t ns = 0;
+        for (int k = 0; k < BENCH_HEATER_SETS; k++) {
+            uint16_t duty[BENCH_HEATERS];
+            for (int i = 0; i < BENCH_HEATERS; i++) {
+                rng ^= rng << 13;
+                rng ^= rng >> 7;
+                rng ^= rng << 17;
+                duty[i] = (uint16_t)(rng % (HEATER_DUTY_FULL + 1));
+            }
+            auto t0 = Clock::now();
+            for (int i = 0; i < BENCH_HEATERS; i++) h.setDuty((uint8_t)i, duty[i]);
+            ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      Clock::now() - t0).count();
+
+            const HeaterLoad &l = h.load();
+            aligned += l.alignedMa;
+            peak += l.peakMa;
+            scale += l.scale;
+            if (l.avgMa) {
+                par += h.peakToAvg();
+                parN++;
+            }
+            if (budget && l.peakMa > budget) over++;
+            // 書いた hpoint が LEDC に届いているか
+            for (int i = 0; i < BENCH_HEATERS; i++) {
+                if (fake::ledcHpoint((uint8_t)(4 + i)) != h.hpoint((uint8_t)i)) over++;
+            }
+        }
+        printf("\n== ヒーター位相 (%d ch x %d mA, 予算 %u mA, %d 組) ==\n",
+               BENCH_HEATERS, BENCH_HEATER_MA, budget, BENCH_HEATER_SETS);
+        printf("  ピーク 平均 %.0f mA (ずらさない場合 %.0f mA), ピーク/平均 %.2f\n",
+               peak / BENCH_HEATER_SETS, aligned / BENCH_HEATER_SETS, parN ? par / parN : 0);
+        printf("  duty の倍率 平均 %.1f%%, 予算超過 / 不一致 %u, setDuty %.2f us/回\n",
+               scale / BENCH_HEATER_SETS / 100.0, over,
+               ns / 1000.0 / (BENCH_HEATER_SETS * BENCH_HEATERS));
+    }
+    h.off();
+}
+
+int main(int argc, char **argv) {
+    uint32_t seconds = 5;
+    uint32_t floodHz = 1000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--seconds") == 0) seconds = (uint32_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--flood") == 0) floodHz = (uint32_t)atoi(argv[i + 1]);
+    }
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    fake::uartOnWrite(UART_PORT, [](const char *d, size_t n) { gr.onUart(d, n); });
+    fake::wsOnText(onWsText);
+    fake::bmeSet(25.0f, 45.0f, 1013.25f);
+
+    plantRunning = true;
+    std::thread plant(plantTask);
+
+    setup();
+
+    const Phase phases[] = {
+        {"idle", seconds, 1, 10, 0},
+        {"load", seconds, 4, 200, floodHz},
+    };
+    for (const Phase &ph : phases) runPhase(ph);
+    checkAdmission();
+    checkHeaterPhase();
+
+    plantRunning = false;
+    plant.join();
+    fflush(stdout);
+    // UART 受信 / ログのタスクは止まらないので後始末せずに終了
+    _Exit(0);
+}
@@ -0,0 +1,17 @@
+#ifndef FAKE_ADAFRUIT_BME280_H
+#define FAKE_ADAFRUIT_BME280_H
+
+// BME280 フェイク: 値は fake::bmeSet() で与える (fake_hw.h)
+
+#include <Arduino.h>
+#include <Wire.h>
+
+class Adafruit_BME280 {
+public:
+    bool begin(uint8_t addr = 0x77, TwoWire *wire = &Wire);
+    float readTemperature();
+    float readHumidity();
+    float readPressure();   // [Pa]
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef FAKE_ARDUINO_H
+#define FAKE_ARDUINO_H
+
+// ホスト (native) 用の Arduino-ESP32 フェイク。
+// src/ が使う範囲だけを実装する。時刻は実時間 (fake_clock.cpp)。
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+class Print;
+
+class Printable {
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print &p) const = 0;
+};
+
+class String {
+public:
+    String() {}
+    String(const char *s) : s_(s ? s : "") {}
+    String(const std::string &s) : s_(s) {}
+    const char *c_str() const { return s_.c_str(); }
+    size_t length() const { return s_.size(); }
+    String &operator+=(const String &o) { s_ += o.s_; return *this; }
+    String &operator+=(const char *o) { s_ += o; return *this; }
+    String operator+(const String &o) const { String r(*this); r += o; return r; }
+    bool operator==(const char *o) const { return s_ == o; }
+private:
+    std::string s_;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t len);
+    size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(const String &s) { return write(s.c_str()); }
+    size_t print(const Printable &p) { return p.printTo(*this); }
+    size_t print(long v);
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T &v) { size_t n = print(v); return n + println(); }
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+// Serial: 標準出力へ (複数タスクから書いても行が混ざらない程度に排他)
+class HardwareSerial : public Print {
+public:
+    explicit HardwareSerial(int num) : num_(num) {}
+    void begin(unsigned long baud) { (void)baud; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t len) override;
+    using Print::write;
+private:
+    int num_;
+};
+
+extern HardwareSerial Serial;
+
+// LEDC: 書き込まれた値を覚えるだけ (fake_hw.h で参照)
+double ledcSetup(uint8_t ch, double freq, uint8_t bits);
+void ledcAttachPin(uint8_t pin, uint8_t ch);
+void ledcWrite(uint8_t ch, uint32_t duty);
+uint32_t ledcRead(uint8_t ch);
+
+uint32_t getCpuFrequencyMhz();
+
+// ESP: ヒープ量は fake::heapSet() で与える (既定 200KB 空き)
+class EspClass {
+public:
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef FAKE_ESP_ASYNC_WEB_SERVER_H
+#define FAKE_ESP_ASYNC_WEB_SERVER_H
+
+// ESPAsyncWebServer / AsyncWebSocket フェイク。
+// ネットワークは使わず、fake_hw.h の wsConnect / wsSend / httpGet で
+// AsyncTCP タスクの代わりにイベントを起こす。送信はフックへ渡す。
+
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define DEFAULT_MAX_WS_CLIENTS 8
+#define WS_MAX_QUEUED_MESSAGES 32
+
+typedef enum { WS_EVT_CONNECT, WS_EVT_DISCONNECT, WS_EVT_PONG, WS_EVT_ERROR, WS_EVT_DATA } AwsEventType;
+typedef enum { WS_CONTINUATION, WS_TEXT, WS_BINARY, WS_DISCONNECT = 0x08, WS_PING, WS_PONG } AwsFrameType;
+typedef enum { WS_DISCONNECTED, WS_CONNECTED, WS_DISCONNECTING } AwsClientStatus;
+typedef enum { HTTP_GET = 1, HTTP_POST = 2, HTTP_ANY = 127 } WebRequestMethod;
+
+struct AwsFrameInfo {
+    uint8_t message_opcode;
+    uint32_t num;
+    uint8_t final;
+    uint8_t masked;
+    uint8_t opcode;
+    uint64_t len;
+    uint8_t mask[4];
+    uint64_t index;
+};
+
+class AsyncWebSocket;
+
+// AsyncTCP の接続。送信はフックへ即渡すので送信バッファは常に空
+class AsyncClient {
+public:
+    size_t space() const { return 5744; }
+};
+
+class AsyncWebSocketClient {
+public:
+    AsyncWebSocketClient(AsyncWebSocket *server, uint32_t id) : server_(server), id_(id) {}
+    uint32_t id() const { return id_; }
+    AwsClientStatus status() const { return status_; }
+    AsyncWebSocket *server() { return server_; }
+    AsyncClient *client() { return &tcp_; }
+    // 送信キューを持たないので切断後だけ満杯扱い (実装と同じ)
+    bool queueIsFull() const { return status_ != WS_CONNECTED; }
+    void text(const char *msg) { text(msg, strlen(msg)); }
+    void text(const char *msg, size_t len);
+    void close(uint16_t code = 0, const char *message = nullptr);
+private:
+    friend class AsyncWebSocket;
+    AsyncWebSocket *server_;
+    uint32_t id_;
+    AwsClientStatus status_ = WS_CONNECTED;
+    AsyncClient tcp_;
+};
+
+typedef std::function<void(AsyncWebSocket *, AsyncWebSocketClient *, AwsEventType,
+                           void *, uint8_t *, size_t)> AwsEventHandler;
+
+class AsyncWebHandler {
+public:
+    virtual ~AsyncWebHandler() {}
+};
+
+class AsyncWebSocket : public AsyncWebHandler {
+public:
+    explicit AsyncWebSocket(const char *url) : url_(url) {}
+    void onEvent(AwsEventHandler handler) { handler_ = handler; }
+    void textAll(const char *msg) { textAll(msg, strlen(msg)); }
+    void textAll(const char *msg, size_t len);
+    size_t count() const;
+    AsyncWebSocketClient *client(uint32_t id);
+    // 切断済みを解放し、maxClients を超えた古い接続を閉じる
+    void cleanupClients(uint16_t maxClients = DEFAULT_MAX_WS_CLIENTS);
+
+    // ---- フェイク専用 (fake_hw.h から呼ぶ)
+    AsyncWebSocketClient *fakeConnect();
+    void fakeData(AsyncWebSocketClient *client, const char *data, size_t len);
+    void fakeDisconnect(AsyncWebSocketClient *client);
+    static AsyncWebSocket *fakeInstance() { return instance_; }
+    void fakeAttach() { instance_ = this; }
+private:
+    friend class AsyncWebSocketClient;
+    std::string url_;
+    AwsEventHandler handler_;
+    std::list<AsyncWebSocketClient> clients_;
+    uint32_t nextId_ = 1;
+    mutable std::recursive_mutex mutex_;
+    static AsyncWebSocket *instance_;
+};
+
+class AsyncWebServerResponse {
+public:
+    virtual ~AsyncWebServerResponse() {}
+};
+
+// beginResponseStream(): printf で本文を組み立てる応答
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+public:
+    size_t write(uint8_t c) override { body_ += (char)c; return 1; }
+    size_t write(const uint8_t *buf, size_t len) override {
+        body_.append((const char *)buf, len);
+        return len;
+    }
+    using Print::write;
+    const std::string &body() const { return body_; }
+private:
+    std::string body_;
+};
+
+class AsyncWebServerRequest {
+public:
+    explicit AsyncWebServerRequest(const char *url) : url_(url) {}
+    const char *url() const { return url_.c_str(); }
+    void send(int code, const char *contentType = "", const String &body = String());
+    void send(fs::FS &fs, const char *path, const char *contentType);
+    // 実装と同じく send() に渡した応答はリクエスト側が解放する
+    AsyncResponseStream *beginResponseStream(const char *contentType);
+    void send(AsyncWebServerResponse *response);
+
+    int fakeCode() const { return code_; }
+    const std::string &fakeBody() const { return body_; }
+private:
+    std::string url_;
+    int code_ = 0;
+    std::string body_;
+};
+
+typedef std::function<void(AsyncWebServerRequest *)> ArRequestHandlerFunction;
+
+class AsyncStaticWebHandler : public AsyncWebHandler {
+public:
+    AsyncStaticWebHandler &setDefaultFile(const char *file) { (void)file; return *this; }
+};
+
+class AsyncWebServer {
+public:
+    explicit AsyncWebServer(uint16_t port) : port_(port) { instance_ = this; }
+    void begin() {}
+    AsyncWebHandler &addHandler(AsyncWebHandler *handler);
+    void on(const char *uri, WebRequestMethod method, ArRequestHandlerFunction fn);
+    AsyncStaticWebHandler &serveStatic(const char *uri, fs::FS &fs, const char *path);
+
+    // ---- フェイク専用: 登録済みハンドラを直接呼ぶ (見つからなければ 404)
+    int fakeGet(const char *uri, std::string *body);
+    static AsyncWebServer *fakeInstance() { return instance_; }
+private:
+    struct Route {
+        std::string uri;
+        WebRequestMethod method;
+        ArRequestHandlerFunction fn;
+    };
+    uint16_t port_;
+    std::vector<Route> routes_;
+    AsyncStaticWebHandler static_;
+    static AsyncWebServer *instance_;
+};
+
+#endif
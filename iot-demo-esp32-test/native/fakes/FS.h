@@ -0,0 +1,14 @@
+#ifndef FAKE_FS_H
+#define FAKE_FS_H
+
+namespace fs {
+
+class FS {
+public:
+    virtual ~FS() {}
+    bool begin(bool formatOnFail = false) { (void)formatOnFail; return true; }
+};
+
+}  // namespace fs
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef FAKE_SPIFFS_H
+#define FAKE_SPIFFS_H
+
+#include <FS.h>
+
+namespace fs {
+class SPIFFSFS : public FS {};
+}  // namespace fs
+
+extern fs::SPIFFSFS SPIFFS;
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef FAKE_WIFI_H
+#define FAKE_WIFI_H
+
+#include <Arduino.h>
+
+class IPAddress : public Printable {
+public:
+    IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : b_{a, b, c, d} {}
+    size_t printTo(Print &p) const override {
+        return p.printf("%u.%u.%u.%u", b_[0], b_[1], b_[2], b_[3]);
+    }
+private:
+    uint8_t b_[4];
+};
+
+class WiFiClass {
+public:
+    bool softAP(const char *ssid, const char *pass = nullptr) { (void)ssid; (void)pass; return true; }
+    IPAddress softAPIP() const { return IPAddress(192, 168, 4, 1); }
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef FAKE_WIRE_H
+#define FAKE_WIRE_H
+
+#include <Arduino.h>
+
+class TwoWire {
+public:
+    bool begin(int sda = -1, int scl = -1) { (void)sda; (void)scl; return true; }
+};
+
+extern TwoWire Wire;
+
+#endif
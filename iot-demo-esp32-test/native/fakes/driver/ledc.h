@@ -0,0 +1,48 @@
+#ifndef FAKE_DRIVER_LEDC_H
+#define FAKE_DRIVER_LEDC_H
+
+// ESP-IDF LEDC ドライバのフェイク (heater_pwm が使う範囲)。
+// チャンネルは Arduino の ledcWrite と同じ番号 (高速 0-7, 低速 8-15) に重ねるので
+// fake::ledcDuty() / ledcWrites() でどちらから書いた値も見える。
+// duty / hpoint は ledc_update_duty() で反映する (実機と同じ)。
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum { LEDC_HIGH_SPEED_MODE, LEDC_LOW_SPEED_MODE, LEDC_SPEED_MODE_MAX } ledc_mode_t;
+typedef enum { LEDC_TIMER_0, LEDC_TIMER_1, LEDC_TIMER_2, LEDC_TIMER_3, LEDC_TIMER_MAX } ledc_timer_t;
+typedef enum {
+    LEDC_CHANNEL_0, LEDC_CHANNEL_1, LEDC_CHANNEL_2, LEDC_CHANNEL_3,
+    LEDC_CHANNEL_4, LEDC_CHANNEL_5, LEDC_CHANNEL_6, LEDC_CHANNEL_7, LEDC_CHANNEL_MAX
+} ledc_channel_t;
+typedef enum { LEDC_INTR_DISABLE, LEDC_INTR_FADE_END } ledc_intr_type_t;
+typedef enum { LEDC_AUTO_CLK } ledc_clk_cfg_t;
+typedef int ledc_timer_bit_t;
+
+typedef struct {
+    ledc_mode_t speed_mode;
+    ledc_timer_bit_t duty_resolution;
+    ledc_timer_t timer_num;
+    uint32_t freq_hz;
+    ledc_clk_cfg_t clk_cfg;
+} ledc_timer_config_t;
+
+typedef struct {
+    int gpio_num;
+    ledc_mode_t speed_mode;
+    ledc_channel_t channel;
+    ledc_intr_type_t intr_type;
+    ledc_timer_t timer_sel;
+    uint32_t duty;
+    int hpoint;
+} ledc_channel_config_t;
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *conf);
+esp_err_t ledc_channel_config(const ledc_channel_config_t *conf);
+esp_err_t ledc_set_duty_with_hpoint(ledc_mode_t mode, ledc_channel_t ch, uint32_t duty,
+                                    uint32_t hpoint);
+esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t ch);
+uint32_t ledc_get_duty(ledc_mode_t mode, ledc_channel_t ch);
+int ledc_get_hpoint(ledc_mode_t mode, ledc_channel_t ch);
+
+#endif
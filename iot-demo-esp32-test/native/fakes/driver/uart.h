@@ -0,0 +1,65 @@
+#ifndef FAKE_DRIVER_UART_H
+#define FAKE_DRIVER_UART_H
+
+// ESP-IDF UART ドライバのフェイク。
+// 受信は fake::uartFeed() で流し込み、パターン文字ごとに UART_PATTERN_DET を
+// イベントキューへ送る。送信は fake::uartOnWrite() のフックへ渡す。
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef enum { UART_NUM_0, UART_NUM_1, UART_NUM_2, UART_NUM_MAX } uart_port_t;
+
+typedef enum {
+    UART_DATA,
+    UART_BREAK,
+    UART_BUFFER_FULL,
+    UART_FIFO_OVF,
+    UART_FRAME_ERR,
+    UART_PARITY_ERR,
+    UART_DATA_BREAK,
+    UART_PATTERN_DET,
+    UART_EVENT_MAX,
+} uart_event_type_t;
+
+typedef struct {
+    uart_event_type_t type;
+    size_t size;
+    bool timeout_flag;
+} uart_event_t;
+
+typedef enum { UART_DATA_5_BITS, UART_DATA_6_BITS, UART_DATA_7_BITS, UART_DATA_8_BITS } uart_word_length_t;
+typedef enum { UART_PARITY_DISABLE = 0, UART_PARITY_EVEN = 2, UART_PARITY_ODD = 3 } uart_parity_t;
+typedef enum { UART_STOP_BITS_1 = 1, UART_STOP_BITS_1_5, UART_STOP_BITS_2 } uart_stop_bits_t;
+typedef enum { UART_HW_FLOWCTRL_DISABLE = 0 } uart_hw_flowcontrol_t;
+typedef enum { UART_SCLK_APB = 4, UART_SCLK_REF_TICK = 5 } uart_sclk_t;
+
+typedef struct {
+    int baud_rate;
+    uart_word_length_t data_bits;
+    uart_parity_t parity;
+    uart_stop_bits_t stop_bits;
+    uart_hw_flowcontrol_t flow_ctrl;
+    uint8_t rx_flow_ctrl_thresh;
+    uart_sclk_t source_clk;
+} uart_config_t;
+
+#define UART_PIN_NO_CHANGE (-1)
+
+esp_err_t uart_driver_install(uart_port_t port, int rxBufSize, int txBufSize,
+                              int queueSize, QueueHandle_t *queue, int intrFlags);
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t *cfg);
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts);
+esp_err_t uart_set_baudrate(uart_port_t port, uint32_t baud);
+esp_err_t uart_get_baudrate(uart_port_t port, uint32_t *baud);
+esp_err_t uart_enable_pattern_det_baud_intr(uart_port_t port, char chr, uint8_t num,
+                                            int chrTout, int postIdle, int preIdle);
+esp_err_t uart_pattern_queue_reset(uart_port_t port, int queueLength);
+int uart_pattern_pop_pos(uart_port_t port);
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t len, TickType_t ticks);
+int uart_write_bytes(uart_port_t port, const void *src, size_t size);
+esp_err_t uart_flush_input(uart_port_t port);
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef FAKE_ESP_ERR_H
+#define FAKE_ESP_ERR_H
+
+typedef int esp_err_t;
+
+#define ESP_OK                 0
+#define ESP_FAIL              -1
+#define ESP_ERR_INVALID_ARG    0x102
+#define ESP_ERR_INVALID_STATE  0x103
+#define ESP_ERR_NOT_SUPPORTED  0x106
+
+const char *esp_err_to_name(esp_err_t err);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef FAKE_ESP_PM_H
+#define FAKE_ESP_PM_H
+
+// 電源管理のフェイク: 設定とロックは受け付けるだけ (周波数は変わらない)
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP,
+} esp_pm_lock_type_t;
+
+struct FakePmLock;
+typedef FakePmLock *esp_pm_lock_handle_t;
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_esp32_t;
+
+esp_err_t esp_pm_configure(const void *config);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char *name,
+                             esp_pm_lock_handle_t *handle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef FAKE_ESP_WIFI_H
+#define FAKE_ESP_WIFI_H
+
+// SoftAP の接続端末一覧だけ。端末は fake::staAdd() で足す
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_WIFI_MAX_CONN_NUM 10
+
+typedef struct {
+    uint8_t mac[6];
+    int8_t rssi;
+} wifi_sta_info_t;
+
+typedef struct {
+    wifi_sta_info_t sta[ESP_WIFI_MAX_CONN_NUM];
+    int num;
+} wifi_sta_list_t;
+
+esp_err_t esp_wifi_ap_get_sta_list(wifi_sta_list_t *sta);
+
+#endif
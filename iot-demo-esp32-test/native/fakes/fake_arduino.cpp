@@ -0,0 +1,208 @@
+// Arduino コア / 単純な周辺 (LEDC, Wire, WiFi, SPIFFS, BME280) のフェイク
+// 時刻 (millis / delay) は fake_clock.cpp
+
+#include <Arduino.h>
+#include <Adafruit_BME280.h>
+#include <SPIFFS.h>
+#include <WiFi.h>
+#include <Wire.h>
+#include <driver/ledc.h>
+#include <esp_wifi.h>
+#include "fake_hw.h"
+
+#include <atomic>
+#include <mutex>
+
+// ---------------------------------------------------------------- Print / Serial
+
+size_t Print::write(const uint8_t *buf, size_t len) {
+    size_t n = 0;
+    while (len--) n += write(*buf++);
+    return n;
+}
+
+size_t Print::print(long v) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%ld", v);
+    return write(buf);
+}
+
+size_t Print::printf(const char *fmt, ...) {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    return write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+static std::mutex serialMutex;
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len) {
+    std::lock_guard<std::mutex> lock(serialMutex);
+    return fwrite(buf, 1, len, stdout);
+}
+
+HardwareSerial Serial(0);
+
+// ---------------------------------------------------------------- LEDC
+
+#define FAKE_LEDC_CHANNELS 16
+
+static std::atomic<uint32_t> ledcValue[FAKE_LEDC_CHANNELS];
+static std::atomic<uint32_t> ledcCount[FAKE_LEDC_CHANNELS];
+
+double ledcSetup(uint8_t ch, double freq, uint8_t bits) {
+    (void)ch;
+    (void)bits;
+    return freq;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t ch) {
+    (void)pin;
+    (void)ch;
+}
+
+void ledcWrite(uint8_t ch, uint32_t duty) {
+    if (ch >= FAKE_LEDC_CHANNELS) return;
+    ledcValue[ch] = duty;
+    ledcCount[ch]++;
+}
+
+uint32_t ledcRead(uint8_t ch) {
+    return ch < FAKE_LEDC_CHANNELS ? ledcValue[ch].load() : 0;
+}
+
+// ESP-IDF 側: duty / hpoint は ledc_update_duty() まで保留
+static uint32_t ledcPendDuty[FAKE_LEDC_CHANNELS];
+static uint32_t ledcPendHpoint[FAKE_LEDC_CHANNELS];
+static std::atomic<uint32_t> ledcHpointValue[FAKE_LEDC_CHANNELS];
+
+static int ledcIndex(ledc_mode_t mode, ledc_channel_t ch) {
+    if (mode >= LEDC_SPEED_MODE_MAX || ch >= LEDC_CHANNEL_MAX) return -1;
+    return (int)mode * LEDC_CHANNEL_MAX + (int)ch;
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *conf) {
+    if (conf->speed_mode >= LEDC_SPEED_MODE_MAX || conf->timer_num >= LEDC_TIMER_MAX)
+        return ESP_ERR_INVALID_ARG;
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *conf) {
+    if (ledcIndex(conf->speed_mode, conf->channel) < 0) return ESP_ERR_INVALID_ARG;
+    ledc_set_duty_with_hpoint(conf->speed_mode, conf->channel, conf->duty, conf->hpoint);
+    return ledc_update_duty(conf->speed_mode, conf->channel);
+}
+
+esp_err_t ledc_set_duty_with_hpoint(ledc_mode_t mode, ledc_channel_t ch, uint32_t duty,
+                                    uint32_t hpoint) {
+    int i = ledcIndex(mode, ch);
+    if (i < 0) return ESP_ERR_INVALID_ARG;
+    ledcPendDuty[i] = duty;
+    ledcPendHpoint[i] = hpoint;
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t ch) {
+    int i = ledcIndex(mode, ch);
+    if (i < 0) return ESP_ERR_INVALID_ARG;
+    ledcHpointValue[i] = ledcPendHpoint[i];
+    ledcWrite((uint8_t)i, ledcPendDuty[i]);
+    return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t mode, ledc_channel_t ch) {
+    int i = ledcIndex(mode, ch);
+    return i < 0 ? 0 : ledcValue[i].load();
+}
+
+int ledc_get_hpoint(ledc_mode_t mode, ledc_channel_t ch) {
+    int i = ledcIndex(mode, ch);
+    return i < 0 ? -1 : (int)ledcHpointValue[i].load();
+}
+
+uint32_t getCpuFrequencyMhz() {
+    return 240;
+}
+
+EspClass ESP;
+
+static std::atomic<uint32_t> heapFree{200000};
+static std::atomic<uint32_t> heapMin{200000};
+
+uint32_t EspClass::getFreeHeap() { return heapFree; }
+uint32_t EspClass::getMinFreeHeap() { return heapMin; }
+// 断片化はないものとして空きと同じ値を返す
+uint32_t EspClass::getMaxAllocHeap() { return heapFree; }
+
+// ---------------------------------------------------------------- WiFi (SoftAP)
+
+static std::mutex staMutex;
+static wifi_sta_list_t staList;
+
+esp_err_t esp_wifi_ap_get_sta_list(wifi_sta_list_t *sta) {
+    std::lock_guard<std::mutex> lock(staMutex);
+    *sta = staList;
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------- その他の周辺
+
+TwoWire Wire;
+WiFiClass WiFi;
+fs::SPIFFSFS SPIFFS;
+
+static std::atomic<float> bmeTemp{25.0f};
+static std::atomic<float> bmeHumi{50.0f};
+static std::atomic<float> bmePres{1013.25f};
+static std::atomic<bool> bmeFound{true};
+
+bool Adafruit_BME280::begin(uint8_t addr, TwoWire *wire) {
+    (void)wire;
+    return bmeFound && addr == 0x76;
+}
+
+float Adafruit_BME280::readTemperature() { return bmeTemp; }
+float Adafruit_BME280::readHumidity() { return bmeHumi; }
+float Adafruit_BME280::readPressure() { return bmePres * 100.0f; }
+
+const char *esp_err_to_name(esp_err_t err) {
+    switch (err) {
+    case ESP_OK:                return "ESP_OK";
+    case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    default:                    return "ESP_FAIL";
+    }
+}
+
+namespace fake {
+
+void heapSet(uint32_t freeBytes) {
+    heapFree = freeBytes;
+    if (freeBytes < heapMin) heapMin = freeBytes;
+}
+
+void staAdd(const uint8_t mac[6], int8_t rssi) {
+    std::lock_guard<std::mutex> lock(staMutex);
+    if (staList.num >= ESP_WIFI_MAX_CONN_NUM) return;
+    wifi_sta_info_t &s = staList.sta[staList.num++];
+    memcpy(s.mac, mac, 6);
+    s.rssi = rssi;
+}
+
+uint32_t ledcDuty(uint8_t ch) { return ledcRead(ch); }
+uint32_t ledcWrites(uint8_t ch) { return ch < FAKE_LEDC_CHANNELS ? ledcCount[ch].load() : 0; }
+uint32_t ledcHpoint(uint8_t ch) { return ch < FAKE_LEDC_CHANNELS ? ledcHpointValue[ch].load() : 0; }
+
+void bmeSet(float temp, float humi, float presHpa) {
+    bmeTemp = temp;
+    bmeHumi = humi;
+    bmePres = presHpa;
+}
+
+void bmePresent(bool present) { bmeFound = present; }
+
+}  // namespace fake
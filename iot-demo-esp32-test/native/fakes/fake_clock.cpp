@@ -0,0 +1,32 @@
+// 時刻のフェイク: 実時間 (steady_clock)
+// 仮想時刻で動かす協調シミュレーション (sim/) はこのファイルを差し替える
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+// ESP32 と同じく 32bit で一周する
+unsigned long millis() {
+    auto d = std::chrono::steady_clock::now() - startTime;
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+unsigned long micros() {
+    auto d = std::chrono::steady_clock::now() - startTime;
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
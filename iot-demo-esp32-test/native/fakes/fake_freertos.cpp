@@ -0,0 +1,144 @@
+// FreeRTOS (タスク / 通知 / キュー) のフェイク (esp_pm は fake_pm.cpp)
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <Arduino.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ticks → 待ち期限 (portMAX_DELAY は無期限)
+template <typename Cv, typename Lock, typename Pred>
+static bool waitTicks(Cv &cv, Lock &lock, TickType_t ticks, Pred pred) {
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, pred);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), pred);
+}
+
+// ---------------------------------------------------------------- タスク
+
+struct FakeTask {
+    std::string name;
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t notify = 0;
+};
+
+static thread_local FakeTask *currentTask = nullptr;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *handle,
+                                   BaseType_t core) {
+    (void)stack;
+    (void)prio;
+    (void)core;
+    FakeTask *task = new FakeTask;
+    task->name = name ? name : "";
+    if (handle) *handle = task;
+
+    // タスクは戻らない前提。プロセス終了時はそのまま捨てる
+    std::thread([fn, arg, task]() {
+        currentTask = task;
+        fn(arg);
+    }).detach();
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    // setup() / loop() を回すメインスレッドは初回呼び出しで登録
+    if (!currentTask) {
+        currentTask = new FakeTask;
+        currentTask->name = "loopTask";
+    }
+    return currentTask;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)millis();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    FakeTask *task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    waitTicks(task->cv, lock, ticks, [task] { return task->notify > 0; });
+
+    uint32_t value = task->notify;
+    if (value > 0) task->notify = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notify++;
+    }
+    task->cv.notify_one();
+    return pdPASS;
+}
+
+// ---------------------------------------------------------------- キュー
+
+struct FakeQueue {
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    FakeQueue *q = new FakeQueue;
+    q->length = length;
+    q->itemSize = itemSize;
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!waitTicks(q->cv, lock, ticks, [q] { return q->items.size() < q->length; })) {
+        return pdFALSE;
+    }
+    const uint8_t *p = static_cast<const uint8_t *>(item);
+    q->items.emplace_back(p, p + q->itemSize);
+    lock.unlock();
+    q->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!waitTicks(q->cv, lock, ticks, [q] { return !q->items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, q->items.front().data(), q->itemSize);
+    q->items.pop_front();
+    lock.unlock();
+    q->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q) {
+    {
+        std::lock_guard<std::mutex> lock(q->mutex);
+        q->items.clear();
+    }
+    q->cv.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    std::lock_guard<std::mutex> lock(q->mutex);
+    return (UBaseType_t)q->items.size();
+}
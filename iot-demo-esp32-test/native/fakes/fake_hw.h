@@ -0,0 +1,50 @@
+#ifndef FAKE_HW_H
+#define FAKE_HW_H
+
+// ホスト側からフェイク周辺を操作する API (ベンチ / シミュレーション用)
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <driver/uart.h>
+#include <functional>
+#include <string>
+
+namespace fake {
+
+// ---- UART
+// 相手 (GR-SAKURA) からの受信データを流し込む。'\n' ごとに UART_PATTERN_DET
+void uartFeed(uart_port_t port, const char *data, size_t len);
+// uart_write_bytes の内容を受け取る (呼び出し元タスクで実行)
+void uartOnWrite(uart_port_t port, std::function<void(const char *, size_t)> hook);
+uint32_t uartBaud(uart_port_t port);
+// 速度違いなどで壊れたバイトを受けた (UART_FRAME_ERR)
+void uartFrameError(uart_port_t port);
+
+// ---- LEDC
+uint32_t ledcDuty(uint8_t ch);
+uint32_t ledcWrites(uint8_t ch);
+// ledc_set_duty_with_hpoint で書いた hpoint (ledcWrite のチャンネルは 0)
+uint32_t ledcHpoint(uint8_t ch);
+
+// ---- BME280
+void bmeSet(float temp, float humi, float presHpa);
+void bmePresent(bool present);
+
+// ---- WebSocket / HTTP (AsyncTCP タスクの代わりに呼び出し元で実行)
+AsyncWebSocketClient *wsConnect();
+void wsSend(AsyncWebSocketClient *client, const char *text);
+void wsDisconnect(AsyncWebSocketClient *client);
+// ESP32 → ブラウザの送信 (textAll / client->text)
+void wsOnText(std::function<void(uint32_t id, const char *, size_t)> hook);
+int httpGet(const char *uri, std::string *body);
+
+// ---- ヒープ / SoftAP
+void heapSet(uint32_t freeBytes);
+void staAdd(const uint8_t mac[6], int8_t rssi);
+
+// ---- 電源管理
+int pmLocksHeld();
+
+}  // namespace fake
+
+#endif
@@ -0,0 +1,49 @@
+// esp_pm (電源管理ロック) のフェイク
+
+#include <esp_pm.h>
+#include "fake_hw.h"
+
+#include <atomic>
+
+struct FakePmLock {
+    esp_pm_lock_type_t type;
+    std::atomic<int> count{0};
+};
+
+static std::atomic<int> pmHeld{0};
+
+esp_err_t esp_pm_configure(const void *config) {
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char *name,
+                             esp_pm_lock_handle_t *handle) {
+    (void)arg;
+    (void)name;
+    FakePmLock *lock = new FakePmLock;
+    lock->type = type;
+    *handle = lock;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+    if (handle->count.fetch_add(1) == 0) pmHeld++;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+    int prev = handle->count.fetch_sub(1);
+    if (prev <= 0) {
+        handle->count++;
+        return ESP_ERR_INVALID_STATE;   // IDF と同じく取っていないロックの解放はエラー
+    }
+    if (prev == 1) pmHeld--;
+    return ESP_OK;
+}
+
+namespace fake {
+
+int pmLocksHeld() { return pmHeld; }
+
+}  // namespace fake
@@ -0,0 +1,166 @@
+// ESP-IDF UART ドライバのフェイク (パターン検出つき受信バッファ)
+
+#include <driver/uart.h>
+#include "fake_hw.h"
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+struct FakeUart {
+    std::mutex mutex;
+    QueueHandle_t queue = nullptr;
+    size_t rxBufSize = 0;
+    std::string rx;                 // 未読データ
+    uint64_t readPos = 0;           // rx 先頭の通算位置
+    std::deque<uint64_t> patterns;  // パターン文字の通算位置
+    size_t patternQueueLen = 0;
+    char patternChr = 0;
+    uint32_t baud = 115200;
+    std::function<void(const char *, size_t)> onWrite;
+};
+
+static FakeUart uarts[UART_NUM_MAX];
+
+static void postEvent(FakeUart &u, uart_event_type_t type, size_t size) {
+    if (!u.queue) return;
+    uart_event_t ev = {};
+    ev.type = type;
+    ev.size = size;
+    // 実機と同じくイベントキューが一杯なら捨てる
+    xQueueSend(u.queue, &ev, 0);
+}
+
+esp_err_t uart_driver_install(uart_port_t port, int rxBufSize, int txBufSize,
+                              int queueSize, QueueHandle_t *queue, int intrFlags) {
+    (void)txBufSize;
+    (void)intrFlags;
+    FakeUart &u = uarts[port];
+    u.rxBufSize = rxBufSize;
+    u.queue = queueSize > 0 ? xQueueCreate(queueSize, sizeof(uart_event_t)) : nullptr;
+    if (queue) *queue = u.queue;
+    return ESP_OK;
+}
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t *cfg) {
+    uarts[port].baud = cfg->baud_rate;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts) {
+    (void)port; (void)tx; (void)rx; (void)rts; (void)cts;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_baudrate(uart_port_t port, uint32_t baud) {
+    uarts[port].baud = baud;
+    return ESP_OK;
+}
+
+esp_err_t uart_get_baudrate(uart_port_t port, uint32_t *baud) {
+    *baud = uarts[port].baud;
+    return ESP_OK;
+}
+
+esp_err_t uart_enable_pattern_det_baud_intr(uart_port_t port, char chr, uint8_t num,
+                                            int chrTout, int postIdle, int preIdle) {
+    (void)num; (void)chrTout; (void)postIdle; (void)preIdle;
+    uarts[port].patternChr = chr;
+    return ESP_OK;
+}
+
+esp_err_t uart_pattern_queue_reset(uart_port_t port, int queueLength) {
+    FakeUart &u = uarts[port];
+    std::lock_guard<std::mutex> lock(u.mutex);
+    u.patterns.clear();
+    u.patternQueueLen = queueLength;
+    return ESP_OK;
+}
+
+int uart_pattern_pop_pos(uart_port_t port) {
+    FakeUart &u = uarts[port];
+    std::lock_guard<std::mutex> lock(u.mutex);
+    if (u.patterns.empty()) return -1;
+    uint64_t pos = u.patterns.front();
+    u.patterns.pop_front();
+    return (int)(pos - u.readPos);
+}
+
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t len, TickType_t ticks) {
+    (void)ticks;
+    FakeUart &u = uarts[port];
+    std::lock_guard<std::mutex> lock(u.mutex);
+    size_t n = len < u.rx.size() ? len : u.rx.size();
+    memcpy(buf, u.rx.data(), n);
+    u.rx.erase(0, n);
+    u.readPos += n;
+    return (int)n;
+}
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t size) {
+    std::function<void(const char *, size_t)> hook;
+    {
+        std::lock_guard<std::mutex> lock(uarts[port].mutex);
+        hook = uarts[port].onWrite;
+    }
+    if (hook) hook(static_cast<const char *>(src), size);
+    return (int)size;
+}
+
+esp_err_t uart_flush_input(uart_port_t port) {
+    FakeUart &u = uarts[port];
+    std::lock_guard<std::mutex> lock(u.mutex);
+    u.readPos += u.rx.size();
+    u.rx.clear();
+    u.patterns.clear();
+    return ESP_OK;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks) {
+    (void)port;
+    (void)ticks;
+    return ESP_OK;
+}
+
+namespace fake {
+
+void uartFeed(uart_port_t port, const char *data, size_t len) {
+    FakeUart &u = uarts[port];
+    size_t found = 0;
+    bool full = false;
+    {
+        std::lock_guard<std::mutex> lock(u.mutex);
+        if (u.rx.size() + len > u.rxBufSize) {
+            full = true;    // 収まらない分はドライバと同じく捨てる
+        } else {
+            uint64_t base = u.readPos + u.rx.size();
+            u.rx.append(data, len);
+            for (size_t i = 0; i < len; i++) {
+                if (data[i] != u.patternChr) continue;
+                if (u.patterns.size() < u.patternQueueLen) u.patterns.push_back(base + i);
+                found++;
+            }
+        }
+    }
+    if (full) {
+        postEvent(u, UART_BUFFER_FULL, 0);
+        return;
+    }
+    for (size_t i = 0; i < found; i++) postEvent(u, UART_PATTERN_DET, 0);
+}
+
+void uartOnWrite(uart_port_t port, std::function<void(const char *, size_t)> hook) {
+    std::lock_guard<std::mutex> lock(uarts[port].mutex);
+    uarts[port].onWrite = hook;
+}
+
+uint32_t uartBaud(uart_port_t port) {
+    return uarts[port].baud;
+}
+
+void uartFrameError(uart_port_t port) {
+    postEvent(uarts[port], UART_FRAME_ERR, 0);
+}
+
+}  // namespace fake
@@ -0,0 +1,177 @@
+// ESPAsyncWebServer / AsyncWebSocket のフェイク
+
+#include <ESPAsyncWebServer.h>
+#include "fake_hw.h"
+
+AsyncWebSocket *AsyncWebSocket::instance_ = nullptr;
+AsyncWebServer *AsyncWebServer::instance_ = nullptr;
+
+static std::mutex hookMutex;
+static std::function<void(uint32_t, const char *, size_t)> textHook;
+
+static void deliver(uint32_t id, const char *msg, size_t len) {
+    std::function<void(uint32_t, const char *, size_t)> hook;
+    {
+        std::lock_guard<std::mutex> lock(hookMutex);
+        hook = textHook;
+    }
+    if (hook) hook(id, msg, len);
+}
+
+// ---------------------------------------------------------------- WebSocket
+
+void AsyncWebSocketClient::text(const char *msg, size_t len) {
+    if (status_ != WS_CONNECTED) return;
+    deliver(id_, msg, len);
+}
+
+void AsyncWebSocketClient::close(uint16_t code, const char *message) {
+    (void)code;
+    (void)message;
+    if (status_ != WS_CONNECTED) return;
+    status_ = WS_DISCONNECTED;
+    if (server_->handler_) server_->handler_(server_, this, WS_EVT_DISCONNECT, nullptr, nullptr, 0);
+}
+
+void AsyncWebSocket::textAll(const char *msg, size_t len) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    for (AsyncWebSocketClient &c : clients_) c.text(msg, len);
+}
+
+size_t AsyncWebSocket::count() const {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    size_t n = 0;
+    for (const AsyncWebSocketClient &c : clients_) {
+        if (c.status_ == WS_CONNECTED) n++;
+    }
+    return n;
+}
+
+AsyncWebSocketClient *AsyncWebSocket::client(uint32_t id) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    for (AsyncWebSocketClient &c : clients_) {
+        if (c.id_ == id && c.status_ == WS_CONNECTED) return &c;
+    }
+    return nullptr;
+}
+
+void AsyncWebSocket::cleanupClients(uint16_t maxClients) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    clients_.remove_if([](const AsyncWebSocketClient &c) {
+        return c.status_ == WS_DISCONNECTED;
+    });
+    // 上限超過分は古い接続から閉じる (実装と同じ)。解放は次回
+    size_t n = count();
+    for (AsyncWebSocketClient &c : clients_) {
+        if (n <= maxClients) break;
+        if (c.status_ != WS_CONNECTED) continue;
+        c.close();
+        n--;
+    }
+}
+
+AsyncWebSocketClient *AsyncWebSocket::fakeConnect() {
+    AsyncWebSocketClient *c;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        clients_.emplace_back(this, nextId_++);
+        c = &clients_.back();
+    }
+    if (handler_) handler_(this, c, WS_EVT_CONNECT, nullptr, nullptr, 0);
+    return c;
+}
+
+void AsyncWebSocket::fakeData(AsyncWebSocketClient *client, const char *data, size_t len) {
+    if (client->status_ != WS_CONNECTED || !handler_) return;
+    AwsFrameInfo info = {};
+    info.message_opcode = WS_TEXT;
+    info.final = 1;
+    info.opcode = WS_TEXT;
+    info.len = len;
+    info.index = 0;
+    handler_(this, client, WS_EVT_DATA, &info, (uint8_t *)data, len);
+}
+
+void AsyncWebSocket::fakeDisconnect(AsyncWebSocketClient *client) {
+    client->close();
+}
+
+// ---------------------------------------------------------------- HTTP
+
+void AsyncWebServerRequest::send(int code, const char *contentType, const String &body) {
+    (void)contentType;
+    code_ = code;
+    body_ = body.c_str();
+}
+
+void AsyncWebServerRequest::send(fs::FS &fs, const char *path, const char *contentType) {
+    (void)fs;
+    (void)path;
+    (void)contentType;
+    code_ = 200;
+}
+
+AsyncResponseStream *AsyncWebServerRequest::beginResponseStream(const char *contentType) {
+    (void)contentType;
+    return new AsyncResponseStream();
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse *response) {
+    code_ = 200;
+    if (AsyncResponseStream *s = dynamic_cast<AsyncResponseStream *>(response)) body_ = s->body();
+    delete response;
+}
+
+AsyncWebHandler &AsyncWebServer::addHandler(AsyncWebHandler *handler) {
+    if (AsyncWebSocket *ws = dynamic_cast<AsyncWebSocket *>(handler)) ws->fakeAttach();
+    return *handler;
+}
+
+void AsyncWebServer::on(const char *uri, WebRequestMethod method, ArRequestHandlerFunction fn) {
+    routes_.push_back({uri, method, fn});
+}
+
+AsyncStaticWebHandler &AsyncWebServer::serveStatic(const char *uri, fs::FS &fs, const char *path) {
+    (void)uri;
+    (void)fs;
+    (void)path;
+    return static_;
+}
+
+int AsyncWebServer::fakeGet(const char *uri, std::string *body) {
+    for (const Route &r : routes_) {
+        if (r.uri != uri || !(r.method & HTTP_GET)) continue;
+        AsyncWebServerRequest req(uri);
+        r.fn(&req);
+        if (body) *body = req.fakeBody();
+        return req.fakeCode();
+    }
+    return 404;
+}
+
+namespace fake {
+
+AsyncWebSocketClient *wsConnect() {
+    AsyncWebSocket *ws = AsyncWebSocket::fakeInstance();
+    return ws ? ws->fakeConnect() : nullptr;
+}
+
+void wsSend(AsyncWebSocketClient *client, const char *text) {
+    client->server()->fakeData(client, text, strlen(text));
+}
+
+void wsDisconnect(AsyncWebSocketClient *client) {
+    client->server()->fakeDisconnect(client);
+}
+
+void wsOnText(std::function<void(uint32_t, const char *, size_t)> hook) {
+    std::lock_guard<std::mutex> lock(hookMutex);
+    textHook = hook;
+}
+
+int httpGet(const char *uri, std::string *body) {
+    AsyncWebServer *server = AsyncWebServer::fakeInstance();
+    return server ? server->fakeGet(uri, body) : 404;
+}
+
+}  // namespace fake
@@ -0,0 +1,22 @@
+#ifndef FAKE_FREERTOS_H
+#define FAKE_FREERTOS_H
+
+// FreeRTOS フェイク: タスク = std::thread, 1 tick = 1ms
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE   1
+#define pdFALSE  0
+#define pdPASS   1
+#define pdFAIL   0
+#define portMAX_DELAY       0xFFFFFFFFu
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define tskNO_AFFINITY      0x7FFFFFFF
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef FAKE_FREERTOS_QUEUE_H
+#define FAKE_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+
+struct FakeQueue;
+typedef FakeQueue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks);
+BaseType_t xQueueReset(QueueHandle_t q);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef FAKE_FREERTOS_TASK_H
+#define FAKE_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+struct FakeTask;
+typedef FakeTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+// 優先度とコア指定は無視 (ホストのスケジューラ任せ)
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *handle,
+                                   BaseType_t core);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+#endif
@@ -0,0 +1,74 @@
+#include "async_log.h"
+
+AsyncLog Log;
+
+void AsyncLog::begin() {
+    for (uint32_t i = 0; i < LOG_SLOTS; i++) {
+        slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    xTaskCreatePinnedToCore(task, "log", LOG_TASK_STACK, this,
+                            LOG_TASK_PRIO, &task_, LOG_TASK_CORE);
+}
+
+bool AsyncLog::write(const char *fmt, ...) {
+    uint32_t pos = head_.load(std::memory_order_relaxed);
+    Slot *s;
+
+    // 書き込み位置を CAS で確保
+    for (;;) {
+        s = &slots_[pos & (LOG_SLOTS - 1)];
+        uint32_t seq = s->seq.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(s->msg, LOG_MSG_LEN, fmt, ap);
+    va_end(ap);
+
+    s->seq.store(pos + 1, std::memory_order_release);
+    // 空 → 非空: ログタスクが眠っている (眠ろうとしている) ときだけ起こす。
+    // exchange 同士で順序が決まるので、タスクが先なら通知、後ならタスクがこの行を見る
+    if (waiting_.exchange(false, std::memory_order_acq_rel)) xTaskNotifyGive(task_);
+    return true;
+}
+
+bool AsyncLog::drainOne() {
+    Slot &s = slots_[tail_ & (LOG_SLOTS - 1)];
+    if (s.seq.load(std::memory_order_acquire) != tail_ + 1) return false;
+
+    Serial.print(s.msg);
+    s.seq.store(tail_ + LOG_SLOTS, std::memory_order_release);
+    tail_++;
+    return true;
+}
+
+void AsyncLog::task(void *arg) {
+    AsyncLog *self = static_cast<AsyncLog *>(arg);
+
+    for (;;) {
+        while (self->drainOne()) {
+        }
+        uint32_t d = self->dropped();
+        if (d != self->reported_) {
+            Serial.printf("[LOG] %lu 件破棄\n", (unsigned long)(d - self->reported_));
+            self->reported_ = d;
+        }
+        // 眠る前に印を立ててからもう一度見る (その間に積まれた行を取りこぼさない)
+        self->waiting_.exchange(true, std::memory_order_acq_rel);
+        if (self->drainOne()) {
+            // 書き込み側が印を落として通知していたら、次の Take で 1 回空振りするだけ
+            self->waiting_.store(false, std::memory_order_relaxed);
+            continue;
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// 非同期ログ: 呼び出し側は整形してリングに積むだけ。
+// Serial への書き出しは低優先度タスクが行うので、USB 送信バッファが
+// 詰まっても制御ループは待たされない (あふれた分は捨てて数える)。
+// ログタスクは空になると通知待ちで眠り、空 → 非空にした書き込みだけが起こす。
+//
+// レベルはコンパイル時に決まり、無効なレベルの LOG_x は引数ごと消える。
+//   build_flags = -DLOG_LEVEL=LOG_LEVEL_DEBUG
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_SLOTS       32      // 2 のべき乗
+#define LOG_MSG_LEN     128     // 1 メッセージの最大長 (超過分は切り詰め)
+#define LOG_TASK_PRIO   1       // コア0 の WiFi / AsyncTCP より低く
+#define LOG_TASK_CORE   0       // loop() (コア1) の時間を使わない
+#define LOG_TASK_STACK  3072
+
+class AsyncLog {
+public:
+    void begin();
+    // 複数タスクから同時に呼べる (ロックなし)。満杯なら false
+    bool write(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+    uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+private:
+    // 有界 MPSC キュー: seq == 書き込み位置 → 空き, 位置+1 → 書き込み済み
+    struct Slot {
+        std::atomic<uint32_t> seq;
+        char msg[LOG_MSG_LEN];
+    };
+
+    static void task(void *arg);
+    bool drainOne();
+
+    Slot slots_[LOG_SLOTS];
+    std::atomic<uint32_t> head_{0};
+    uint32_t tail_ = 0;                 // ログタスクだけが触る
+    // ログタスクが空を見て眠ろうとしている。最初に false に戻した書き込みが通知する
+    std::atomic<bool> waiting_{false};
+    TaskHandle_t task_ = nullptr;
+    std::atomic<uint32_t> dropped_{0};
+    uint32_t reported_ = 0;
+};
+
+extern AsyncLog Log;
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(fmt, ...) Log.write(fmt, ##__VA_ARGS__)
+#else
+#define LOG_E(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(fmt, ...) Log.write(fmt, ##__VA_ARGS__)
+#else
+#define LOG_W(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(fmt, ...) Log.write(fmt, ##__VA_ARGS__)
+#else
+#define LOG_I(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(fmt, ...) Log.write(fmt, ##__VA_ARGS__)
+#else
+#define LOG_D(fmt, ...) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,163 @@
+#include "baud_link.h"
+#include "async_log.h"
+#include "metrics.h"
+
+// 速い順。UART_BAUD_MAX を超えるものは飛ばす
+static const uint32_t kCandidates[] = {1000000, 921600, 460800, 230400};
+static const uint8_t kCandidateCount = sizeof(kCandidates) / sizeof(kCandidates[0]);
+
+void BaudLink::onMessage(JsonDocument &doc) {
+    const char *op = doc["op"] | "";
+    if (strcmp(op, "ack") == 0 || strcmp(op, "nak") == 0) {
+        snprintf(op_, sizeof(op_), "%s", op);
+        ackBaud_ = doc["baud"] | 0;
+    } else if (strcmp(op, "result") == 0) {
+        resultOk_ = doc["ok"] | 0;
+        resultErr_ = doc["err"] | 0L;
+    } else {
+        return;
+    }
+    msgEvent_.signal();
+}
+
+void BaudLink::request(uint32_t baud) {
+    char buf[64];
+    op_[0] = '\0';
+    ackBaud_ = 0;
+    resultOk_ = -1;
+    resultErr_ = 0;
+    lastReq_ = baud;
+    lastBaud_ = 0;
+    snprintf(buf, sizeof(buf), "{\"type\":\"baud\",\"op\":\"req\",\"baud\":%lu}",
+             (unsigned long)baud);
+    uart_.sendRaw(buf);
+}
+
+void BaudLink::sendTests() {
+    char buf[128];
+    for (int i = 0; i < BAUD_TEST_FRAMES; i++) {
+        snprintf(buf, sizeof(buf), "{\"type\":\"baud\",\"op\":\"test\",\"seq\":%d,\"pat\":\"%s\"}",
+                 i, BAUD_TEST_PATTERN);
+        uart_.sendRaw(buf);
+    }
+}
+
+// 1 候補の交渉結果を記録して配信
+void BaudLink::finish(const char *result) {
+    lastResult_ = result;
+    if (strcmp(result, "ok") == 0) {
+        Metrics.uartBaudUp.add();
+        LOG_W("[BAUD] %lu bps (req %lu)\n", (unsigned long)lastBaud_, (unsigned long)lastReq_);
+    } else {
+        Metrics.uartBaudFail.add();
+        LOG_W("[BAUD] req %lu: %s (ok=%d err=%ld)\n", (unsigned long)lastReq_, result,
+              resultOk_, resultErr_);
+    }
+    publish();
+}
+
+void BaudLink::publish() {
+    char buf[256];
+    if (report_ && report(buf, sizeof(buf))) report_(buf);
+}
+
+void BaudLink::run() {
+    CO_BEGIN();
+    CO_SLEEP(BAUD_START_MS);
+    retryMs_ = BAUD_RETRY_MS;
+    for (;;) {
+        for (idx_ = start_; idx_ < kCandidateCount; idx_++) {
+            if (kCandidates[idx_] > UART_BAUD_MAX || kCandidates[idx_] <= UART_BAUD) continue;
+            while (!uart_.linkAlive(millis())) CO_SLEEP(LINK_TIMEOUT_MS);
+
+            request(kCandidates[idx_]);
+            deadline_ = millis() + BAUD_REPLY_MS;
+            while (op_[0] == '\0' && (int32_t)(deadline_ - millis()) > 0) {
+                CO_WAIT_FOR(msgEvent_, deadline_ - millis());
+            }
+            if (strcmp(op_, "ack") != 0) {
+                finish(op_[0] ? "nak" : "timeout");
+                continue;
+            }
+
+            // GR-SAKURA は ack を送り終えて切り替え済み
+            lastBaud_ = ackBaud_;
+            prevBaud_ = uart_.baud();
+            probing_ = true;
+            uart_.setBaud(ackBaud_);
+            CO_SLEEP(BAUD_SETTLE_MS);
+            sendTests();
+            deadline_ = millis() + BAUD_RESULT_MS;
+            while (resultOk_ < 0 && (int32_t)(deadline_ - millis()) > 0) {
+                CO_WAIT_FOR(msgEvent_, deadline_ - millis());
+            }
+            probing_ = false;
+            if (resultOk_ == BAUD_TEST_FRAMES && resultErr_ == 0) {
+                uart_.sendRaw("{\"type\":\"baud\",\"op\":\"commit\"}");
+                finish("ok");
+                break;
+            }
+            uart_.setBaud(prevBaud_);
+            finish(resultOk_ < 0 ? "timeout" : "bad");
+            CO_SLEEP(BAUD_PROBE_MS);
+        }
+
+        // 確定した速度の監視: エラー過多 / ctrl 途絶で UART_BAUD へ
+        errBase_ = Metrics.uartFrameErr.get();
+        errWindowMs_ = millis();
+        while (uart_.baud() != UART_BAUD) {
+            CO_SLEEP(1000);
+            if (Metrics.uartFrameErr.get() - errBase_ > BAUD_ERR_MAX ||
+                !uart_.linkAlive(millis())) {
+                LOG_W("[BAUD] %lu bps: frame_err=%lu link=%d → %d bps\n",
+                      (unsigned long)uart_.baud(),
+                      (unsigned long)(Metrics.uartFrameErr.get() - errBase_),
+                      uart_.linkAlive(millis()), UART_BAUD);
+                uart_.setBaud(UART_BAUD);
+                Metrics.uartBaudFallback.add();
+                lastResult_ = "fallback";
+                publish();
+                start_ = idx_ + 1;      // 次は 1 段遅い候補から
+            } else if (millis() - errWindowMs_ >= BAUD_ERR_WINDOW_MS) {
+                errBase_ = Metrics.uartFrameErr.get();
+                errWindowMs_ = millis();
+            }
+        }
+
+        // 一巡しても上がらなければ間隔を倍に (古い GR-SAKURA は応答しない)
+        if (strcmp(lastResult_, "fallback") == 0) {
+            retryMs_ = BAUD_RETRY_MS;
+        } else if (retryMs_ < BAUD_RETRY_MAX_MS) {
+            retryMs_ *= 2;
+        }
+        CO_SLEEP(retryMs_);
+        if (start_ >= kCandidateCount) start_ = 0;
+    }
+    CO_END();
+}
+
+size_t BaudLink::report(char *buf, size_t bufSize) {
+    uint32_t err = Metrics.uartFrameErr.get();
+    uint32_t bytes = Metrics.uartRxBytes.get();
+    uint32_t dErr = err - repErr_;
+    uint32_t dBytes = bytes - repBytes_;
+    repErr_ = err;
+    repBytes_ = bytes;
+
+    JsonDocument doc;
+    doc["type"] = "baud";
+    doc["baud"] = uart_.baud();
+    doc["state"] = probing_ ? "probe" : uart_.baud() == UART_BAUD ? "base" : "up";
+    doc["frame_err"] = dErr;
+    doc["rx_bytes"] = dBytes;
+    doc["err_ppm"] = dBytes ? (uint32_t)((uint64_t)dErr * 1000000 / dBytes) : 0;
+    JsonObject last = doc["last"].to<JsonObject>();
+    last["req"] = lastReq_;
+    last["baud"] = lastBaud_;
+    last["result"] = lastResult_;
+    last["ok"] = resultOk_;
+    last["err"] = resultErr_;
+
+    if (measureJson(doc) >= bufSize) return 0;
+    return serializeJson(doc, buf, bufSize);
+}
@@ -0,0 +1,87 @@
+#ifndef BAUD_LINK_H
+#define BAUD_LINK_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "coro.h"
+#include "uart_comm.h"
+
+// GR-SAKURA とのボーレート交渉 (ESP32 主導, 手順は iot-demo-rx-test/src/baud_neg.h)
+//
+// UART_BAUD で起動し、リンクが生きていれば速い候補から 1 つずつ:
+//   req → ack (GR-SAKURA が PCLKB で作れる実際の値) → 両者切替
+//   → 試験フレーム × BAUD_TEST_FRAMES → result → 全数一致・エラー 0 なら commit
+// 不成立なら元の速度に戻り、GR-SAKURA の仮採用期限を待って次の候補へ。
+// 確定後、フレーミングエラーが BAUD_ERR_WINDOW_MS に BAUD_ERR_MAX 回を超えるか
+// ctrl が途絶えたら UART_BAUD へ戻し、BAUD_RETRY_MS 後に 1 段遅い候補から再交渉する。
+// 一巡して上がらなければ再交渉の間隔を BAUD_RETRY_MAX_MS まで倍々に延ばす。
+//
+// GR-SAKURA (SCI2, PCLKB 50MHz, MDDR なし) が作れるのは 50MHz / 16 / (N+1) 付近なので
+// 1000000 → 1041667, 460800 → 446429 のように名目値からずれる。ESP32 は分数分周で
+// その値に合わせる (両者の差は 0.1% 未満)。
+
+#ifndef UART_BAUD_MAX
+#define UART_BAUD_MAX 1000000
+#endif
+
+#define BAUD_START_MS      5000     // 起動後、最初の ctrl を待ってから
+#define BAUD_REPLY_MS      200      // req → ack / nak
+#define BAUD_SETTLE_MS     20       // 切替後、旧速度の行が抜けるまで
+#define BAUD_RESULT_MS     500      // 試験フレーム → result (GR-SAKURA の期限 1000ms の半分)
+#define BAUD_PROBE_MS      1000     // 不成立時、GR-SAKURA が元の速度へ戻るまで
+#define BAUD_TEST_FRAMES   8
+#define BAUD_ERR_MAX       4
+#define BAUD_ERR_WINDOW_MS 10000
+#define BAUD_RETRY_MS      60000
+#define BAUD_RETRY_MAX_MS  3600000
+
+// GR-SAKURA (baud_neg.h) と同じ文字列
+#define BAUD_TEST_PATTERN  "UUUUUUUU@@@@~~~~!!!!0123456789ABCDEFGHIJKLMNOPQRSTUV"
+
+class BaudLink : public Routine {
+public:
+    typedef void (*ReportFn)(const char *json);
+
+    explicit BaudLink(UartComm &uart) : Routine("baud"), uart_(uart) {}
+    // 交渉結果 / 速度変更のたびに report (ブラウザへの配信) を呼ぶ
+    void begin(ReportFn report) { report_ = report; }
+    // GR-SAKURA からの {"type":"baud",...}
+    void onMessage(JsonDocument &doc);
+    // {"type":"baud","baud":..,"state":..,"frame_err":..,"rx_bytes":..,"err_ppm":..,
+    //  "last":{"req":..,"baud":..,"result":..,"ok":..,"err":..}}
+    // err_ppm は前回の report 以降の受信バイトあたりのフレーミングエラー
+    size_t report(char *buf, size_t bufSize);
+protected:
+    void run() override;
+private:
+    void request(uint32_t baud);
+    void sendTests();
+    void finish(const char *result);
+    void publish();
+
+    UartComm &uart_;
+    ReportFn report_ = nullptr;
+    Event msgEvent_;
+    uint8_t idx_ = 0;           // 試している候補
+    uint8_t start_ = 0;         // 次の交渉を始める候補
+    uint32_t prevBaud_ = 0;
+    uint32_t deadline_ = 0;
+    uint32_t retryMs_ = BAUD_RETRY_MS;
+    bool probing_ = false;
+    // GR-SAKURA からの応答
+    char op_[8] = "";
+    uint32_t ackBaud_ = 0;
+    int resultOk_ = -1;
+    long resultErr_ = 0;
+    // 最後の交渉
+    uint32_t lastReq_ = 0;
+    uint32_t lastBaud_ = 0;
+    const char *lastResult_ = "none";
+    // エラー率
+    uint32_t errBase_ = 0;
+    uint32_t errWindowMs_ = 0;
+    uint32_t repErr_ = 0;
+    uint32_t repBytes_ = 0;
+};
+
+#endif
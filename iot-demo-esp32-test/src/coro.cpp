@@ -0,0 +1,81 @@
+#include "coro.h"
+
+TaskHandle_t Scheduler::owner_ = nullptr;
+
+void Event::signal() {
+    flag_.store(true);
+    Scheduler::notify();
+}
+
+void Scheduler::notify() {
+    if (owner_) xTaskNotifyGive(owner_);
+}
+
+void Scheduler::begin() {
+    owner_ = xTaskGetCurrentTaskHandle();
+}
+
+void Scheduler::add(Routine &r) {
+    r.link_ = nullptr;
+    if (tail_) tail_->link_ = &r;
+    else head_ = &r;
+    tail_ = &r;
+}
+
+bool Scheduler::ready(Routine *r, uint32_t now) {
+    bool due = r->timed_ && (int32_t)(now - r->wakeAt_) >= 0;
+
+    r->timedOut_ = false;
+    if (r->wait_) {
+        if (r->wait_->take()) return true;
+        r->timedOut_ = due;
+        return due;
+    }
+    return !r->timed_ || due;
+}
+
+void Scheduler::runOnce() {
+    uint32_t now = millis();
+
+    for (Routine *r = head_; r; r = r->link_) {
+        if (!ready(r, now)) continue;
+        r->wait_ = nullptr;
+        r->timed_ = false;
+
+        uint32_t t0 = micros();
+        r->run();
+        uint32_t dt = micros() - t0;
+
+        r->wakes_++;
+        r->runUs_ += dt;
+        if (dt > r->maxUs_) r->maxUs_ = dt;
+    }
+
+    // 次の期限まで眠る。YIELD 中 / イベント成立済みのルーチンがあれば眠らない
+    now = millis();
+    uint32_t sleepMs = UINT32_MAX;
+    for (Routine *r = head_; r && sleepMs; r = r->link_) {
+        if (r->wait_ && r->wait_->pending()) {
+            sleepMs = 0;
+        } else if (r->timed_) {
+            int32_t left = (int32_t)(r->wakeAt_ - now);
+            uint32_t ms = left > 0 ? (uint32_t)left : 0;
+            if (ms < sleepMs) sleepMs = ms;
+        } else if (!r->wait_) {
+            sleepMs = 0;
+        }
+    }
+    if (sleepMs > 0) {
+        ulTaskNotifyTake(pdTRUE, sleepMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(sleepMs));
+    }
+}
+
+void Scheduler::toJson(JsonArray arr) const {
+    for (Routine *r = head_; r; r = r->link_) {
+        JsonObject o = arr.add<JsonObject>();
+        o["name"]   = r->name();
+        o["wakes"]  = r->wakes();
+        o["run_us"] = r->runUs();
+        o["max_us"] = r->maxUs();
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef CORO_H
+#define CORO_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// スタックレス協調ルーチン (switch 方式のプロトスレッド)
+//
+// Routine を継承して run() を CO_BEGIN() 〜 CO_END() で書く。
+// 待ち (CO_SLEEP / CO_WAIT ...) の位置で run() から戻り、次回はその続きから
+// 再開する。スタックは保存されないので、待ちをまたぐ変数はメンバに置くこと。
+// switch を使うため、待ちマクロを自前の switch 文の中に書いてはいけない。
+
+// ---------------------------------------------------------------- イベント
+
+// 別タスク (UART 受信, AsyncTCP) から立てるフラグ。
+// 立てると loop() タスクを起こす。待っていない間に立った分も失われない。
+class Event {
+public:
+    void signal();
+    bool take() { return flag_.exchange(false); }
+    bool pending() const { return flag_.load(); }
+private:
+    std::atomic<bool> flag_{false};
+};
+
+// ---------------------------------------------------------------- ルーチン
+
+class Routine {
+public:
+    explicit Routine(const char *name) : name_(name) {}
+    virtual ~Routine() {}
+    const char *name() const { return name_; }
+    uint32_t wakes() const { return wakes_; }
+    uint64_t runUs() const { return runUs_; }
+    uint32_t maxUs() const { return maxUs_; }
+protected:
+    virtual void run() = 0;
+    // 直前の CO_WAIT_FOR がタイムアウトで戻ったか
+    bool timedOut() const { return timedOut_; }
+
+    // CO_* マクロが使う再開状態
+    uint16_t line_ = 0;
+    uint32_t wakeAt_ = 0;       // ms
+    bool timed_ = false;        // wakeAt_ が有効
+    Event *wait_ = nullptr;
+    bool timedOut_ = false;
+private:
+    friend class Scheduler;
+    const char *name_;
+    Routine *link_ = nullptr;
+    uint32_t wakes_ = 0;
+    uint64_t runUs_ = 0;
+    uint32_t maxUs_ = 0;
+};
+
+#define CO_BEGIN()  switch (line_) { case 0:
+#define CO_END()    } line_ = 0
+
+#define CO_SUSPEND_() line_ = __LINE__; return; case __LINE__:;
+
+// 他のルーチンに順番を譲る
+#define CO_YIELD() \
+    do { timed_ = false; CO_SUSPEND_(); } while (0)
+// ms 待つ / 指定時刻 (millis) まで待つ
+#define CO_SLEEP(ms) \
+    do { wakeAt_ = millis() + (ms); timed_ = true; CO_SUSPEND_(); } while (0)
+#define CO_SLEEP_UNTIL(t) \
+    do { wakeAt_ = (t); timed_ = true; CO_SUSPEND_(); } while (0)
+// イベントを待つ / タイムアウト付き (timedOut() で判定)
+#define CO_WAIT(ev) \
+    do { wait_ = &(ev); timed_ = false; CO_SUSPEND_(); } while (0)
+#define CO_WAIT_FOR(ev, ms) \
+    do { wait_ = &(ev); wakeAt_ = millis() + (ms); timed_ = true; CO_SUSPEND_(); } while (0)
+
+// ---------------------------------------------------------------- スケジューラ
+
+class Scheduler {
+public:
+    // loop() と同じタスクから呼ぶ (Event::signal の起床先になる)
+    void begin();
+    void add(Routine &r);
+    // 実行可能なルーチンを一巡し、次の期限まで待つ (イベントで即起床)
+    void runOnce();
+    // [{"name":..,"wakes":..,"run_us":..,"max_us":..}, ...]
+    void toJson(JsonArray arr) const;
+    Routine *first() const { return head_; }
+    Routine *next(const Routine *r) const { return r->link_; }
+
+    static void notify();
+private:
+    bool ready(Routine *r, uint32_t now);
+
+    Routine *head_ = nullptr;
+    Routine *tail_ = nullptr;
+    static TaskHandle_t owner_;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "fallback_ctrl.h"
+#include <math.h>
+
+static uint8_t clampDuty(float v) {
+    if (v < 0.0f) return 0;
+    if (v > FALLBACK_MAX_DUTY) return FALLBACK_MAX_DUTY;
+    return (uint8_t)(v + 0.5f);
+}
+
+uint8_t FallbackCtrl::engage(float temp, uint8_t duty, unsigned long now) {
+    out_ = duty > FALLBACK_MAX_DUTY ? FALLBACK_MAX_DUTY : duty;
+    // 出力 = P + I が現在のデューティになるよう積分値を初期化
+    float err = isnan(temp) ? 0.0f : target_ - temp;
+    integral_ = out_ - FALLBACK_KP * err;
+    lastMs_ = now;
+    state_ = LinkState::Fallback;
+    return enabled_ ? out_ : 0;
+}
+
+uint8_t FallbackCtrl::update(float temp, unsigned long now) {
+    float dt = (now - lastMs_) / 1000.0f;
+    lastMs_ = now;
+
+    if (!enabled_) {
+        integral_ = 0.0f;
+        out_ = 0;
+        return out_;
+    }
+#if FALLBACK_USE_PID
+    float err = target_ - temp;
+    float p = FALLBACK_KP * err;
+    integral_ += FALLBACK_KI * err * dt;
+    // アンチワインドアップ: 出力が上限/下限に張り付く方向には積まない
+    if (p + integral_ > FALLBACK_MAX_DUTY) integral_ = FALLBACK_MAX_DUTY - p;
+    if (p + integral_ < 0.0f) integral_ = -p;
+    out_ = clampDuty(p + integral_);
+#else
+    (void)temp;
+#endif
+    return out_;
+}
+
+void FallbackCtrl::release(unsigned long now) {
+    handbackMs_ = now;
+    state_ = LinkState::Handback;
+}
+
+uint8_t FallbackCtrl::apply(uint8_t rxDuty, unsigned long now) {
+    if (state_ != LinkState::Handback) return rxDuty;
+
+    unsigned long el = now - handbackMs_;
+    if (el >= HANDBACK_MS || !enabled_) {
+        state_ = LinkState::Rx;
+        return rxDuty;
+    }
+    long d = out_ + ((long)rxDuty - out_) * (long)el / HANDBACK_MS;
+    return (uint8_t)d;
+}
@@ -0,0 +1,48 @@
+#ifndef FALLBACK_CTRL_H
+#define FALLBACK_CTRL_H
+
+#include <Arduino.h>
+
+// GR-SAKURA からの ctrl フレームが途絶えた時に ESP32 側で使う代替制御
+//   FALLBACK_USE_PID 1: 上限付き PI 制御 (目標値は最後に受信した sp)
+//   FALLBACK_USE_PID 0: 最後のデューティを上限でクリップして保持
+#ifndef FALLBACK_USE_PID
+#define FALLBACK_USE_PID   1
+#endif
+#define FALLBACK_KP        7.5f    // duty / ℃
+#define FALLBACK_KI        0.5f    // duty / (℃·s)
+#define FALLBACK_MAX_DUTY  128     // 50% 上限
+#define HANDBACK_MS        5000    // RX 復帰時にデューティを移し替える時間
+
+enum class LinkState : uint8_t {
+    Rx,         // GR-SAKURA の PID 出力をそのまま使用
+    Fallback,   // ESP32 の代替制御
+    Handback    // 代替制御 → GR-SAKURA 出力へ直線補間中
+};
+
+class FallbackCtrl {
+public:
+    void setTarget(float sp) { target_ = sp; }
+    void setEnabled(bool en) { enabled_ = en; }
+    LinkState state() const { return state_; }
+
+    // 途絶検出: 現在のデューティから無衝撃で引き継ぐ
+    uint8_t engage(float temp, uint8_t duty, unsigned long now);
+    // Fallback 中に sensor 周期で呼ぶ
+    uint8_t update(float temp, unsigned long now);
+    // ctrl フレーム再受信
+    void release(unsigned long now);
+    // RX のデューティに補間をかけて返す (Rx 状態ではそのまま)
+    uint8_t apply(uint8_t rxDuty, unsigned long now);
+
+private:
+    LinkState state_ = LinkState::Rx;
+    bool enabled_ = true;
+    float target_ = 28.0f;
+    float integral_ = 0.0f;
+    uint8_t out_ = 0;
+    unsigned long lastMs_ = 0;
+    unsigned long handbackMs_ = 0;
+};
+
+#endif
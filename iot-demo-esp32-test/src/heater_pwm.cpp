@@ -1,17 +1,292 @@
 #include "heater_pwm.h"
+#include <ArduinoJson.h>
+#if POWER_MODE == POWER_MODE_SLEEP
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+#endif
+
+bool HeaterPwm::add(uint8_t pin, uint8_t ledcCh, uint16_t fullMa) {
+    if (n_ >= HEATER_MAX_CH || ledcCh >= LEDC_CHANNEL_MAX) return false;
+    for (uint8_t i = 0; i < n_; i++) {
+        if (ch_[i].ledc == ledcCh || ch_[i].pin == pin) return false;
+    }
+    HeaterChannel &c = ch_[n_++];
+    c = HeaterChannel{};
+    c.pin = pin;
+    c.ledc = ledcCh;
+    c.fullMa = fullMa;
+    return true;
+}
+
+void HeaterPwm::setBudget(uint32_t ma) {
+    budgetMa_ = ma;
+    if (n_) apply();
+}
 
 void HeaterPwm::begin() {
-    ledcSetup(HEATER_PWM_CH, HEATER_PWM_FREQ, HEATER_PWM_RES);
-    ledcAttachPin(HEATER_PIN, HEATER_PWM_CH);
-    ledcWrite(HEATER_PWM_CH, 0);
-    duty_ = 0;
+    if (n_ == 0) add(HEATER_PIN, HEATER_PWM_CH, HEATER_FULL_MA);
+#if POWER_MODE == POWER_MODE_SLEEP
+    // ライトスリープ中も RC_FAST を止めず、端子も LEDC の出力のまま
+    // (PM ロックで眠りを止めなくても PWM が続く)
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_ON);
+#endif
+
+    ledc_timer_config_t timer = {};
+    timer.speed_mode      = HEATER_LEDC_MODE;
+    timer.duty_resolution = (ledc_timer_bit_t)HEATER_PWM_RES;
+    timer.timer_num       = HEATER_LEDC_TIMER;
+    timer.freq_hz         = HEATER_PWM_FREQ;
+    timer.clk_cfg         = HEATER_LEDC_CLK;
+    ledc_timer_config(&timer);
+
+    for (uint8_t i = 0; i < n_; i++) {
+        ledc_channel_config_t cfg = {};
+        cfg.gpio_num   = ch_[i].pin;
+        cfg.speed_mode = HEATER_LEDC_MODE;
+        cfg.channel    = (ledc_channel_t)ch_[i].ledc;
+        cfg.intr_type  = LEDC_INTR_DISABLE;
+        cfg.timer_sel  = HEATER_LEDC_TIMER;
+        cfg.duty       = 0;
+        cfg.hpoint     = 0;
+        ledc_channel_config(&cfg);
+#if POWER_MODE == POWER_MODE_SLEEP
+        gpio_sleep_sel_dis((gpio_num_t)ch_[i].pin);
+#endif
+        ch_[i].written = 0;
+        ch_[i].writtenHp = 0;
+        ch_[i].duty = 0;
+    }
+    apply();
 }
 
 void HeaterPwm::set(uint8_t duty) {
-    duty_ = duty;
-    ledcWrite(HEATER_PWM_CH, duty);
+    setDuty(0, (uint16_t)((duty * (uint32_t)HEATER_DUTY_FULL + 127) / 255));
+}
+
+void HeaterPwm::setDuty(uint8_t ch, uint16_t duty) {
+    if (ch >= n_) return;
+    if (duty > HEATER_DUTY_FULL) duty = HEATER_DUTY_FULL;
+    ch_[ch].duty = duty;
+    apply();
 }
 
 void HeaterPwm::off() {
-    set(0);
+    for (uint8_t i = 0; i < n_; i++) ch_[i].duty = 0;
+    apply();
+}
+
+bool HeaterPwm::dithering() const {
+    for (uint8_t i = 0; i < n_; i++) {
+        if (ch_[i].frac) return true;
+    }
+    return false;
+}
+
+void HeaterPwm::tick() {
+    if (!dithering()) return;
+    unsigned long now = micros();
+    if (now - lastTickUs_ < HEATER_DITHER_US) return;
+    lastTickUs_ = now;
+
+    // 1 次シグマデルタ: 平均で base + frac/HEATER_DUTY_FULL になる
+    // (区間は base + 1 で置いてあるので、ずらした位置はそのまま)
+    for (uint8_t i = 0; i < n_; i++) {
+        HeaterChannel &c = ch_[i];
+        if (c.frac == 0) continue;
+        c.acc += c.frac;
+        if (c.acc >= HEATER_DUTY_FULL) {
+            c.acc -= HEATER_DUTY_FULL;
+            write(c, c.base + 1);
+        } else {
+            write(c, c.base);
+        }
+    }
+}
+
+// duty → LEDC カウント (整数部と端数)
+static void toCounts(uint16_t duty, uint32_t *base, uint16_t *frac) {
+    uint32_t scaled = (uint32_t)duty * HEATER_PWM_MAX;
+#if HEATER_PWM_DITHER
+    *base = scaled / HEATER_DUTY_FULL;
+    *frac = scaled % HEATER_DUTY_FULL;
+#else
+    // ディザなし: 最も近いカウントに丸める
+    *base = (scaled + HEATER_DUTY_FULL / 2) / HEATER_DUTY_FULL;
+    *frac = 0;
+#endif
+}
+
+// 倍率 scale で絞ったときの区間 (ディザで伸びる分込み) と hpoint。戻り値はピーク
+uint32_t HeaterPwm::plan(uint16_t scale, uint32_t *len, uint32_t *hp) const {
+    uint16_t ma[HEATER_MAX_CH];
+    for (uint8_t i = 0; i < n_; i++) {
+        uint32_t base;
+        uint16_t frac;
+        toCounts((uint16_t)((uint32_t)ch_[i].duty * scale / HEATER_DUTY_FULL), &base, &frac);
+        len[i] = base + (frac ? 1 : 0);
+        ma[i] = ch_[i].fullMa;
+    }
+    return schedule(n_, len, ma, hp);
+}
+
+void HeaterPwm::apply() {
+    uint32_t len[HEATER_MAX_CH], hp[HEATER_MAX_CH];
+    uint16_t scale = HEATER_DUTY_FULL;
+
+    // 平均が予算を越えるなら、ずらしても収まらないので先にその分絞る
+    if (budgetMa_) {
+        uint32_t avg = 0;
+        for (uint8_t i = 0; i < n_; i++) {
+            avg += (uint32_t)ch_[i].fullMa * ch_[i].duty / HEATER_DUTY_FULL;
+        }
+        if (avg > budgetMa_) scale = (uint16_t)((uint64_t)budgetMa_ * HEATER_DUTY_FULL / avg);
+    }
+    uint32_t peak = plan(scale, len, hp);
+    if (budgetMa_ && peak > budgetMa_) {
+        // ピークが収まる最大の倍率を二分探索 (0 = 全消灯は必ず収まる)
+        uint16_t lo = 0, hi = scale;
+        while (hi - lo > 1) {
+            uint16_t mid = (uint16_t)((lo + hi) / 2);
+            if (plan(mid, len, hp) <= budgetMa_) lo = mid;
+            else hi = mid;
+        }
+        scale = lo;
+        peak = plan(scale, len, hp);
+    }
+
+    load_.peakMa = peak;
+    load_.avgMa = 0;
+    load_.alignedMa = 0;
+    load_.scale = scale;
+    for (uint8_t i = 0; i < n_; i++) {
+        HeaterChannel &c = ch_[i];
+        c.applied = (uint16_t)((uint32_t)c.duty * scale / HEATER_DUTY_FULL);
+        toCounts(c.applied, &c.base, &c.frac);
+        c.hpoint = hp[i];
+        load_.avgMa += (uint32_t)c.fullMa * c.applied / HEATER_DUTY_FULL;
+        if (c.applied) load_.alignedMa += c.fullMa;
+        write(c, c.base);
+    }
+}
+
+void HeaterPwm::write(HeaterChannel &c, uint32_t counts) {
+    if (counts == c.written && (counts == 0 || c.hpoint == c.writtenHp)) return;
+    ledc_set_duty_with_hpoint(HEATER_LEDC_MODE, (ledc_channel_t)c.ledc, counts, c.hpoint);
+    ledc_update_duty(HEATER_LEDC_MODE, (ledc_channel_t)c.ledc);
+    c.written = counts;
+    c.writtenHp = c.hpoint;
+}
+
+// ---------------------------------------------------------------- 位相の割り当て
+
+// 置き済みの区間による時刻 t (カウント) の電流
+static uint32_t loadAt(uint32_t t, uint8_t n, const bool *placed, const uint32_t *len,
+                       const uint16_t *ma, const uint32_t *hp) {
+    uint32_t sum = 0;
+    for (uint8_t j = 0; j < n; j++) {
+        if (placed[j] && len[j] && hp[j] <= t && t < hp[j] + len[j]) sum += ma[j];
+    }
+    return sum;
+}
+
+uint32_t HeaterPwm::schedule(uint8_t n, const uint32_t *len, const uint16_t *ma,
+                             uint32_t *hp) {
+    uint8_t order[HEATER_MAX_CH];
+    bool placed[HEATER_MAX_CH] = {};
+
+    // 電荷 (区間 × 電流) の大きい順。大きいものから置くほど隙間に詰めやすい
+    for (uint8_t i = 0; i < n; i++) {
+        uint8_t k = i;
+        while (k > 0 && (uint64_t)len[order[k - 1]] * ma[order[k - 1]] < (uint64_t)len[i] * ma[i]) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = i;
+    }
+
+    for (uint8_t k = 0; k < n; k++) {
+        uint8_t i = order[k];
+        hp[i] = 0;
+        if (len[i] == 0) {
+            placed[i] = true;
+            continue;
+        }
+        uint32_t last = HEATER_PWM_PERIOD - len[i];
+
+        // 重なりは区間の端が他の区間の端に来る位置で変わるので、候補はそこだけ:
+        // 周期の両端、他の区間の始まり / 終わりに自分の始まり / 終わりを合わせた位置
+        uint32_t cand[2 + 4 * HEATER_MAX_CH];
+        uint8_t nc = 0;
+        cand[nc++] = 0;
+        cand[nc++] = last;
+        for (uint8_t j = 0; j < n; j++) {
+            if (j == i || !placed[j] || len[j] == 0) continue;
+            uint32_t e = hp[j] + len[j];
+            cand[nc++] = hp[j];
+            cand[nc++] = e;
+            cand[nc++] = hp[j] >= len[i] ? hp[j] - len[i] : 0;
+            cand[nc++] = e >= len[i] ? e - len[i] : 0;
+        }
+
+        uint32_t bestPeak = UINT32_MAX, bestH = 0;
+        uint64_t bestOverlap = UINT64_MAX;
+        for (uint8_t c = 0; c < nc; c++) {
+            uint32_t h = cand[c];
+            if (h > last) continue;
+            uint32_t end = h + len[i];
+            uint32_t peak = loadAt(h, n, placed, len, ma, hp);
+            uint64_t overlap = 0;
+            for (uint8_t j = 0; j < n; j++) {
+                if (j == i || !placed[j] || len[j] == 0) continue;
+                if (hp[j] > h && hp[j] < end) {
+                    uint32_t l = loadAt(hp[j], n, placed, len, ma, hp);
+                    if (l > peak) peak = l;
+                }
+                uint32_t a = hp[j] > h ? hp[j] : h;
+                uint32_t b = hp[j] + len[j] < end ? hp[j] + len[j] : end;
+                if (b > a) overlap += (uint64_t)(b - a) * ma[j];
+            }
+            // ピーク → 重なり (電荷) → 前詰めの順に小さい方
+            if (peak < bestPeak || (peak == bestPeak && overlap < bestOverlap) ||
+                (peak == bestPeak && overlap == bestOverlap && h < bestH)) {
+                bestPeak = peak;
+                bestOverlap = overlap;
+                bestH = h;
+            }
+        }
+        hp[i] = bestH;
+        placed[i] = true;
+    }
+
+    // 置き終わった全体のピークは、どれかの区間の始まりで出る
+    uint32_t peak = 0;
+    for (uint8_t j = 0; j < n; j++) {
+        if (len[j] == 0) continue;
+        uint32_t l = loadAt(hp[j], n, placed, len, ma, hp);
+        if (l > peak) peak = l;
+    }
+    return peak;
+}
+
+size_t HeaterPwm::report(char *buf, size_t bufSize) {
+    JsonDocument doc;
+    doc["type"]       = "heater";
+    doc["budget_ma"]  = budgetMa_;
+    doc["peak_ma"]    = load_.peakMa;
+    doc["avg_ma"]     = load_.avgMa;
+    doc["aligned_ma"] = load_.alignedMa;
+    doc["par"]        = round(peakToAvg() * 100.0f) / 100.0f;
+    doc["scale"]      = load_.scale;
+
+    JsonArray arr = doc["ch"].to<JsonArray>();
+    for (uint8_t i = 0; i < n_; i++) {
+        JsonObject o = arr.add<JsonObject>();
+        o["pin"]     = ch_[i].pin;
+        o["duty"]    = ch_[i].duty;
+        o["applied"] = ch_[i].applied;
+        o["hpoint"]  = ch_[i].hpoint;
+    }
+
+    if (measureJson(doc) >= bufSize) return 0;
+    return serializeJson(doc, buf, bufSize);
 }
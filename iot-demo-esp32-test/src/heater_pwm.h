@@ -2,20 +2,127 @@
 #define HEATER_PWM_H
 
 #include <Arduino.h>
+#include <driver/ledc.h>
+#include "power_mgr.h"
 
 #define HEATER_PIN      26
 #define HEATER_PWM_CH   0
-#define HEATER_PWM_FREQ 25000
+#define HEATER_PWM_FREQ 19000
+#if POWER_MODE == POWER_MODE_FULL
+// LEDC の上限周波数 = 80MHz (APB) / 2^分解能 (12bit → 19.5kHz)
+#define HEATER_PWM_RES  12
+#else
+// 省電力モード: APB は DFS で 40MHz に落ち、ライトスリープでは止まるので使わない。
+// 低速モードのタイマーを RC_FAST (約 8MHz) で回す。19kHz では 8bit まで
 #define HEATER_PWM_RES  8
+#endif
+#define HEATER_PWM_MAX  ((1UL << HEATER_PWM_RES) - 1)
+// 1 周期のカウント数 (hpoint の位置決め用)
+#define HEATER_PWM_PERIOD (HEATER_PWM_MAX + 1)
+
+// 全チャンネルを同じタイマーに載せる (位相 = hpoint がそろう)。
+// 高速モードのチャンネル 0-7 = Arduino の ledcWrite(0-7) と同じ番号
+// (省電力モードは低速モード = ledcWrite(8-15)。RC_FAST を使えるのは低速モードだけ)
+#if POWER_MODE == POWER_MODE_FULL
+#define HEATER_LEDC_MODE  LEDC_HIGH_SPEED_MODE
+#define HEATER_LEDC_CLK   LEDC_AUTO_CLK
+#else
+#define HEATER_LEDC_MODE  LEDC_LOW_SPEED_MODE
+#define HEATER_LEDC_CLK   LEDC_USE_RTC8M_CLK
+#endif
+#define HEATER_LEDC_TIMER LEDC_TIMER_0
+
+// ctrl フレームの "duty" (PID 出力 0-10000) の満量
+#define HEATER_DUTY_FULL 10000
+
+// 1 = LEDC で表せない端数をシグマデルタで時間方向に分散
+// (省電力モードの既定は 0: 1ms ごとの tick() で眠れなくなるので 8bit に丸める)
+#ifndef HEATER_PWM_DITHER
+#define HEATER_PWM_DITHER (POWER_MODE == POWER_MODE_FULL)
+#endif
+// ディザ更新周期 (PWM 周期より十分長く)
+#define HEATER_DITHER_US 1000
+
+// 1 つの電源につなぐヒーターの最大数
+#define HEATER_MAX_CH 4
+// add() を呼ばずに begin() したときの 1 チャンネル (HEATER_PIN) の電流 [mA]
+#ifndef HEATER_FULL_MA
+#define HEATER_FULL_MA 2500
+#endif
+
+// 1 チャンネル分
+struct HeaterChannel {
+    uint8_t  pin;
+    uint8_t  ledc;          // LEDC チャンネル (HEATER_LEDC_MODE 内)
+    uint16_t fullMa;        // 100% 点灯時の電流
+    uint16_t duty;          // 要求 (0-HEATER_DUTY_FULL)
+    uint16_t applied;       // 電流予算で絞った後
+    uint32_t base;          // LEDC カウント (整数部)
+    uint16_t frac;          // 端数 (/HEATER_DUTY_FULL)
+    uint16_t acc;
+    uint32_t hpoint;        // 立ち上がり位置 (カウント)
+    uint32_t written;
+    uint32_t writtenHp;
+};
 
+// スケジュールの結果 (report() / bench)
+struct HeaterLoad {
+    uint32_t peakMa;        // 1 周期内の瞬時電流の最大
+    uint32_t avgMa;         // 平均
+    uint32_t alignedMa;     // hpoint をずらさなかった場合のピーク (点灯中の合計)
+    uint16_t scale;         // 予算で掛けた倍率 (/HEATER_DUTY_FULL)
+};
+
+// 複数チャンネルのヒーター PWM。
+// 同じ電源のチャンネルが同時に立ち上がらないよう、hpoint で点灯区間をずらして
+// 重なりを最小にする (大きい順に、既存の区間との重なりが最小の位置へ置く)。
+// ESP32 の LEDC は hpoint + duty が周期を越えても折り返さないので、
+// 区間は 1 周期の中に収める。
+// 電流予算 (setBudget) を越えるときは全チャンネルの duty を同じ割合で絞り、
+// ずらした後のピークが予算に収まる最大の倍率を探す。
+// チャンネル 0 だけのとき (既定) は hpoint = 0 で従来と同じ出力になる。
 class HeaterPwm {
 public:
+    // begin() の前に呼ぶ。1 回も呼ばなければ HEATER_PIN / HEATER_PWM_CH の 1 チャンネル
+    bool add(uint8_t pin, uint8_t ledcCh, uint16_t fullMa);
+    // 全チャンネル合計の瞬時電流の上限 [mA]。0 = 制限なし
+    void setBudget(uint32_t ma);
     void begin();
+    // 0-255 (旧プロトコルの "pwm")。チャンネル 0
     void set(uint8_t duty);
-    uint8_t get() const { return duty_; }
+    uint8_t get() const { return (uint8_t)((ch_[0].duty * 255UL + HEATER_DUTY_FULL / 2) / HEATER_DUTY_FULL); }
+    // 0-HEATER_DUTY_FULL (ctrl フレームの "duty")
+    void setDuty(uint16_t duty) { setDuty(0, duty); }
+    void setDuty(uint8_t ch, uint16_t duty);
+    uint16_t getDuty(uint8_t ch = 0) const { return ch < n_ ? ch_[ch].duty : 0; }
+    uint16_t appliedDuty(uint8_t ch) const { return ch < n_ ? ch_[ch].applied : 0; }
+    uint32_t hpoint(uint8_t ch) const { return ch < n_ ? ch_[ch].hpoint : 0; }
+    uint8_t channels() const { return n_; }
+    // 全チャンネル
     void off();
+    // ディザ更新: HEATER_DITHER_US 毎に呼ぶ
+    void tick();
+    // 端数があり tick() が必要か (なければ呼び出し間隔を空けてよい)
+    bool dithering() const;
+
+    const HeaterLoad &load() const { return load_; }
+    // ピーク / 平均 (消灯中は 0)
+    float peakToAvg() const { return load_.avgMa ? (float)load_.peakMa / load_.avgMa : 0.0f; }
+    // {"type":"heater","budget_ma":..,"peak_ma":..,"avg_ma":..,"aligned_ma":..,"par":..,"ch":[...]}
+    size_t report(char *buf, size_t bufSize);
+
+    // 点灯区間の長さ len[i] (カウント) と電流 ma[i] → hpoint[i]。戻り値はピーク [mA]
+    static uint32_t schedule(uint8_t n, const uint32_t *len, const uint16_t *ma,
+                             uint32_t *hpoint);
 private:
-    uint8_t duty_ = 0;
+    void apply();
+    uint32_t plan(uint16_t scale, uint32_t *len, uint32_t *hp) const;
+    void write(HeaterChannel &c, uint32_t counts);
+    HeaterChannel ch_[HEATER_MAX_CH] = {};
+    uint8_t n_ = 0;
+    uint32_t budgetMa_ = 0;
+    HeaterLoad load_ = {};
+    unsigned long lastTickUs_ = 0;
 };
 
 #endif
@@ -0,0 +1,180 @@
+#include "latency_trace.h"
+
+// 時計がずれすぎた (相手のリセット等) とみなす差
+#define TRACE_RESYNC_US 50000
+
+static const char *const HOP_NAMES[HOP_COUNT] = {
+    "acquire", "uart", "parse", "pid", "return", "apply", "total"
+};
+
+// 巡回差が負なら 0 (推定誤差で前後が逆転した場合)
+static uint32_t positive(uint32_t d) {
+    return (int32_t)d < 0 ? 0 : d;
+}
+
+// ---------------------------------------------------------------- 集計
+
+void LatencyHist::add(uint32_t us) {
+    uint8_t k = us < 2 ? 0 : 31 - __builtin_clz(us);
+    if (k >= TRACE_BUCKETS) k = TRACE_BUCKETS - 1;
+    bucket_[k]++;
+    count_++;
+    sum_ += us;
+    if (us > max_) max_ = us;
+}
+
+void LatencyHist::reset() {
+    count_ = 0;
+    max_ = 0;
+    sum_ = 0;
+    memset(bucket_, 0, sizeof(bucket_));
+}
+
+uint32_t LatencyHist::percentile(uint8_t pct) const {
+    if (count_ == 0) return 0;
+    uint32_t need = (count_ * pct + 99) / 100;
+    uint32_t acc = 0;
+    for (uint8_t k = 0; k < TRACE_BUCKETS; k++) {
+        acc += bucket_[k];
+        if (acc >= need) {
+            uint32_t upper = 2UL << k;
+            return upper < max_ ? upper : max_;
+        }
+    }
+    return max_;
+}
+
+void LatencyHist::toJson(JsonObject o) const {
+    o["n"]    = count_;
+    o["mean"] = count_ ? (uint32_t)(sum_ / count_) : 0;
+    o["p50"]  = percentile(50);
+    o["p99"]  = percentile(99);
+    o["max"]  = max_;
+    JsonArray b = o["b"].to<JsonArray>();
+    for (uint8_t k = 0; k < TRACE_BUCKETS; k++) b.add(bucket_[k]);
+}
+
+// ---------------------------------------------------------------- 時計差
+
+void ClockSync::sample(uint32_t t0, uint32_t t1, uint32_t t2, uint32_t t3) {
+    uint32_t a = t1 - t0;
+    uint32_t b = t2 - t3;
+    Sample s;
+    s.off = a + (uint32_t)((int32_t)(b - a) / 2);
+    s.delay = positive((t3 - t0) - (t2 - t1));
+    s.t = t3;
+
+    // 予測から大きく外れた: 相手がリセットされたとみなして推定し直す
+    if (valid_) {
+        int32_t err = (int32_t)(s.off - (toRemote(t3) - t3));
+        if (err > TRACE_RESYNC_US + (int32_t)s.delay ||
+            err < -TRACE_RESYNC_US - (int32_t)s.delay) {
+            valid_ = false;
+            n_ = 0;
+            pos_ = 0;
+        }
+    }
+
+    win_[pos_] = s;
+    pos_ = (pos_ + 1) % TRACE_FILTER;
+    if (n_ < TRACE_FILTER) n_++;
+
+    // 窓内で往復遅延が最小のもの = 非対称の影響が最も小さい
+    const Sample *best = &win_[0];
+    for (uint8_t i = 1; i < n_; i++) {
+        if (win_[i].delay < best->delay) best = &win_[i];
+    }
+    delay_ = best->delay;
+
+    if (!valid_) {
+        off_ = best->off;
+        ref_ = best->t;
+        drift_ = 0.0f;
+        valid_ = true;
+        return;
+    }
+
+    uint32_t dt = best->t - ref_;
+    if ((int32_t)dt >= (int32_t)TRACE_DRIFT_US) {
+        float slope = (float)(int32_t)(best->off - off_) / (float)dt;
+        drift_ = drift_ * 0.75f + slope * 0.25f;
+        off_ = best->off;
+        ref_ = best->t;
+    }
+}
+
+uint32_t ClockSync::toRemote(uint32_t local) const {
+    int32_t el = (int32_t)(local - ref_);
+    return local + off_ + (int32_t)(drift_ * el);
+}
+
+uint32_t ClockSync::toLocal(uint32_t remote) const {
+    int32_t el = (int32_t)(remote - off_ - ref_);
+    return remote - off_ - (int32_t)(drift_ * el);
+}
+
+// ---------------------------------------------------------------- 区間計測
+
+uint32_t LatencyTrace::begin(uint32_t acq0, uint32_t acq1) {
+    uint32_t id = nextId_++;
+    Pending &p = pending_[id % TRACE_PENDING];
+    if (p.used) lost_++;
+    p.id = id;
+    p.acq0 = acq0;
+    p.acq1 = acq1;
+    p.t0 = acq1;
+    p.used = true;
+    return id;
+}
+
+void LatencyTrace::sent(uint32_t id, uint32_t t0) {
+    Pending &p = pending_[id % TRACE_PENDING];
+    if (p.used && p.id == id) p.t0 = t0;
+}
+
+void LatencyTrace::drop(uint32_t id) {
+    Pending &p = pending_[id % TRACE_PENDING];
+    if (p.used && p.id == id) p.used = false;
+}
+
+void LatencyTrace::onCtrl(JsonDocument &doc, uint32_t t3, uint32_t applied) {
+    if (!doc["id"].is<unsigned long>()) return;
+
+    uint32_t id = doc["id"].as<unsigned long>();
+    Pending &p = pending_[id % TRACE_PENDING];
+    if (!p.used || p.id != id) return;
+    p.used = false;
+
+    uint32_t t1 = doc["t1"] | 0UL;
+    uint32_t t2 = doc["t2"] | 0UL;
+    uint32_t pu = doc["pu"] | 0UL;
+
+    sync_.sample(p.t0, t1, t2, t3);
+
+    hist_[HOP_ACQUIRE].add(p.acq1 - p.acq0);
+    hist_[HOP_PARSE].add(pu);
+    hist_[HOP_PID].add(positive(t2 - t1 - pu));
+    hist_[HOP_UART].add(positive(sync_.toLocal(t1) - p.t0));
+    hist_[HOP_RETURN].add(positive(t3 - sync_.toLocal(t2)));
+    hist_[HOP_APPLY].add(applied - t3);
+    hist_[HOP_TOTAL].add(applied - p.acq0);
+}
+
+size_t LatencyTrace::report(char *buf, size_t bufSize) {
+    JsonDocument doc;
+    doc["type"]      = "latency";
+    doc["off_us"]    = sync_.offset();
+    doc["drift_ppm"] = round(sync_.driftPpm() * 10.0f) / 10.0f;
+    doc["rtt_us"]    = sync_.delay();
+    doc["lost"]      = lost_;
+
+    JsonObject hops = doc["hops"].to<JsonObject>();
+    for (uint8_t h = 0; h < HOP_COUNT; h++) {
+        hist_[h].toJson(hops[HOP_NAMES[h]].to<JsonObject>());
+        hist_[h].reset();
+    }
+    lost_ = 0;
+
+    if (measureJson(doc) >= bufSize) return 0;
+    return serializeJson(doc, buf, bufSize);
+}
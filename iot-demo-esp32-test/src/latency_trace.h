@@ -0,0 +1,92 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// sensor → GR-SAKURA → ctrl → PWM の区間遅延計測
+//
+// sensor フレームに "id" を付けて送り、GR-SAKURA が ctrl に
+// id / t1 (受信完了) / t2 (送信開始) / pu (解析時間) を付けて返す。
+// 送信時刻 t0 と受信時刻 t3 を合わせて NTP 方式で時計差を推定し、
+// 各区間を log2 ヒストグラムに集計する。時刻はすべて micros()。
+
+#define TRACE_PENDING    8          // 応答待ちサンプル数
+#define TRACE_BUCKETS    16         // [2^k, 2^(k+1)) us, 最終は 32ms 以上
+#define TRACE_FILTER     8          // 直近 N 回から最小遅延のものを採用
+#define TRACE_DRIFT_US   10000000UL // ドリフト推定の最短間隔 (10秒)
+#ifndef TRACE_REPORT_MS
+#define TRACE_REPORT_MS  10000      // ヒストグラム配信周期
+#endif
+
+enum TraceHop {
+    HOP_ACQUIRE,    // BME280 読取
+    HOP_UART,       // ESP32 送信 → GR-SAKURA 受信完了
+    HOP_PARSE,      // GR-SAKURA JSON 解析
+    HOP_PID,        // GR-SAKURA PID 演算 + 応答生成
+    HOP_RETURN,     // GR-SAKURA 送信 → ESP32 受信完了
+    HOP_APPLY,      // ctrl 受信 → PWM 反映
+    HOP_TOTAL,      // 読取開始 → PWM 反映
+    HOP_COUNT
+};
+
+class LatencyHist {
+public:
+    void add(uint32_t us);
+    void reset();
+    // 上位 pct% を含むバケットの上端 [us]
+    uint32_t percentile(uint8_t pct) const;
+    void toJson(JsonObject o) const;
+private:
+    uint32_t count_ = 0;
+    uint32_t max_ = 0;
+    uint64_t sum_ = 0;
+    uint32_t bucket_[TRACE_BUCKETS] = {0};
+};
+
+// NTP 方式の時計差推定 (remote = local + offset, 32bit 巡回)
+//   offset = ((t1 - t0) + (t2 - t3)) / 2
+//   delay  = (t3 - t0) - (t2 - t1)
+class ClockSync {
+public:
+    void sample(uint32_t t0, uint32_t t1, uint32_t t2, uint32_t t3);
+    bool valid() const { return valid_; }
+    uint32_t toRemote(uint32_t local) const;
+    uint32_t toLocal(uint32_t remote) const;
+    int32_t offset() const { return (int32_t)off_; }
+    float driftPpm() const { return drift_ * 1e6f; }
+    uint32_t delay() const { return delay_; }
+private:
+    struct Sample { uint32_t off, delay, t; };
+    Sample win_[TRACE_FILTER];
+    uint8_t n_ = 0, pos_ = 0;
+    bool valid_ = false;
+    uint32_t off_ = 0;      // ref_ 時点の時計差
+    uint32_t ref_ = 0;      // local 時刻
+    uint32_t delay_ = 0;
+    float drift_ = 0.0f;    // 時計差の変化率 (remote/local - 1)
+};
+
+class LatencyTrace {
+public:
+    // sensor 送信前に採番、読取/送信時刻を記録
+    uint32_t begin(uint32_t acq0, uint32_t acq1);
+    void sent(uint32_t id, uint32_t t0);
+    // 応答を待たない (まとめ送りでは GR-SAKURA が最後の id だけ返す)
+    void drop(uint32_t id);
+    // ctrl 受信: doc に "id" がなければ何もしない (旧ファームウェア)
+    void onCtrl(JsonDocument &doc, uint32_t t3, uint32_t applied);
+
+    const ClockSync &sync() const { return sync_; }
+    // {"type":"latency",...} を生成して統計をリセット
+    size_t report(char *buf, size_t bufSize);
+private:
+    struct Pending { uint32_t id, acq0, acq1, t0; bool used; };
+    Pending pending_[TRACE_PENDING] = {};
+    uint32_t nextId_ = 1;
+    uint32_t lost_ = 0;     // 応答なしで上書きされたサンプル
+    ClockSync sync_;
+    LatencyHist hist_[HOP_COUNT];
+};
+
+#endif
@@ -6,13 +6,35 @@
  * 配線:
  *   BME280 SCL → GPIO22, SDA → GPIO21
  *   ヒーター MOSFET Gate → GPIO26 (PWM)
+ *   (-DHEATER2_PIN=27 で同じ電源の 2 本目。位相をずらして点灯, heater_pwm.h)
  *   UART: GPIO16(RX) ↔ GR-SAKURA TX, GPIO17(TX) ↔ GR-SAKURA RX
+ *         (ESP-IDF ドライバ直接, '\n' 検出で受信タスクが行リングへ格納)
+ *
+ * loop() は協調ルーチン (coro.h) のスケジューラを回すだけ:
+ *   sensor  1秒毎に BME280 読取 → UART / WS 送信
+ *           (-DSENSOR_BATCH_MS=N で UART は N ms までまとめて送る, sample_batch.h)
+ *   ctrl    受信行イベントで ctrl を処理 → PWM 反映
+ *   link    ctrl が LINK_TIMEOUT_MS 途絶えたら ESP32 代替制御
+ *   command ブラウザのコマンドを GR-SAKURA へ転送
+ *   baud    GR-SAKURA とボーレートを交渉 (baud_link.h)
+ *   stats   遅延 / ルーチン統計の配信
+ *   housekeeping / dither
+ *
+ * POWER_MODE (power_mgr.h) で DFS / 自動ライトスリープ。UART 応答待ち・
+ * WS 送受信中は各モジュールが PM ロックで全速を保つ (PWM は RC_FAST で回すので不要)。
  */
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include "bme_reader.h"
 #include "heater_pwm.h"
+#include "fallback_ctrl.h"
+#include "latency_trace.h"
+#include "metrics.h"
+#include "async_log.h"
+#include "baud_link.h"
+#include "coro.h"
+#include "power_mgr.h"
 #include "uart_comm.h"
 #include "web_server.h"
 
@@ -20,93 +42,423 @@ static BmeReader   bme;
 static HeaterPwm   heater;
 static UartComm    uart;
 static WebDashboard web;
+static FallbackCtrl fallback;
+static LatencyTrace trace;
+static Scheduler   sched;
+static BaudLink    baudLink(uart);
+
+#ifndef SENSOR_INTERVAL_MS
+#define SENSOR_INTERVAL_MS 1000
+#endif
+
+static const unsigned long SENSOR_INTERVAL = SENSOR_INTERVAL_MS;
+static const unsigned long CLEANUP_INTERVAL = 1000;
+static const unsigned long DITHER_IDLE_MS = 100;
+
+static float lastTemp = NAN;            // 代替制御の引き継ぎ用
+static unsigned long failoverMs = 0;    // 代替制御に切り替えた時刻
+static Event ctrlEvent;                 // ctrl フレームを処理した
+
+// 代替制御 / 旧 "pwm" の出力。2 本目 (HEATER2_PIN) も同じ duty にそろえる
+static void setHeater(uint8_t pwm) {
+    heater.set(pwm);
+#ifdef HEATER2_PIN
+    heater.setDuty(1, heater.getDuty());
+#endif
+}
+
+// リンク状態をブラウザへ通知
+static void reportLink(const char *state, const char *key, unsigned long ms) {
+    JsonDocument doc;
+    doc["type"] = "link";
+    doc["state"] = state;
+    doc[key] = ms;
+
+    char buf[96];
+    serializeJson(doc, buf, sizeof(buf));
+    web.broadcast(buf);
+}
+
+// GR-SAKURA へ転送するコマンドから代替制御の目標値/運転状態を追従
+static void trackCommand(const char *json) {
+    JsonDocument doc;
+    if (deserializeJson(doc, json)) return;
+
+    const char *cmd = doc["cmd"] | "";
+    if (strcmp(cmd, "stop") == 0) {
+        fallback.setEnabled(false);
+        if (fallback.state() == LinkState::Fallback) heater.off();
+    } else if (strcmp(cmd, "start") == 0) {
+        fallback.setEnabled(true);
+    } else if (strcmp(cmd, "set_target") == 0) {
+        float sp = doc["sp"] | 0.0f;
+        if (sp > 0.0f) fallback.setTarget(sp);
+        fallback.setEnabled(true);
+    }
+}
+
+#if SENSOR_BATCH_MS > 0
+static SampleBatch batch(SENSOR_INTERVAL_MS, SENSOR_BATCH_MS);
+static BmeData batchLast;
+
+// まとめたサンプルを GR-SAKURA へ (遅延トレースは最後のサンプルだけ)。
+// 1 サンプルだけなら sbatch より sensor フレームの方が短い
+static void flushBatch() {
+    if (batch.empty()) return;
+    uint32_t last = batch.firstId() + batch.count() - 1;
+    if (batch.count() == 1) trace.sent(last, uart.sendSensor(batchLast, last));
+    else trace.sent(last, uart.sendBatch(batch));
+    batch.clear();
+}
+#endif
+
+// BME280読取 → UART送信 + WS配信
+static void acquireAndPublish() {
+    unsigned long now = millis();
+#if SENSOR_BATCH_MS > 0
+    // 読取失敗が続いても先頭を SENSOR_BATCH_MS より待たせない
+    if (batch.overdue(now)) flushBatch();
+#endif
+    uint32_t acq0 = micros();
+    BmeData d = bme.read();
+    uint32_t acq1 = micros();
+    Metrics.sensorReads.add();
+    if (fallback.state() == LinkState::Fallback) {
+        // センサー無効なら安全側で停止
+        setHeater(d.valid ? fallback.update(d.temp, now) : 0);
+    }
+    if (!d.valid) {
+        Metrics.sensorErrors.add();
+        return;
+    }
+    lastTemp = d.temp;
 
-static unsigned long lastSensorMs = 0;
-static const unsigned long SENSOR_INTERVAL = 1000;
+    // UART → GR-SAKURA
+    uint32_t id = trace.begin(acq0, acq1);
+#if SENSOR_BATCH_MS > 0
+    // sensor フレームと同じ分解能 (温湿度 0.1, 気圧 0.01) の ×100
+    int32_t v[SBATCH_CHANNELS] = {
+        (int32_t)lroundf(d.temp * 10.0f) * 10,
+        (int32_t)lroundf(d.humi * 10.0f) * 10,
+        (int32_t)lroundf(d.pres * 100.0f),
+    };
+    if (now - uart.lastCtrlMs() > SENSOR_BATCH_LINK_MS) {
+        // 回線が怪しい間はまとめない
+        flushBatch();
+        trace.sent(id, uart.sendSensor(d, id));
+    } else {
+        if (!batch.add(now, id, v)) {
+            flushBatch();
+            batch.add(now, id, v);
+        }
+        batchLast = d;
+        if (batch.count() > 1) trace.drop(id - 1);
+        if (batch.due(now)) flushBatch();
+    }
+#else
+    trace.sent(id, uart.sendSensor(d, id));
+#endif
+
+    // WebSocket → ブラウザ
+    JsonDocument doc;
+    doc["type"] = "sensor";
+    doc["temp"] = round(d.temp * 10.0f) / 10.0f;
+    doc["humi"] = round(d.humi * 10.0f) / 10.0f;
+    doc["pres"] = round(d.pres * 100.0f) / 100.0f;
+    doc["pwm"]  = heater.get();
+    doc["duty"] = heater.getDuty();
+    doc["id"]   = id;
+    doc["t_us"] = micros();     // サーバー側で WS 配信遅延を計測
+
+    char buf[256];
+    serializeJson(doc, buf, sizeof(buf));
+    web.broadcast(buf);
+
+    LOG_I("[SENSOR] T=%.1f H=%.1f P=%.2f PWM=%d\n",
+          d.temp, d.humi, d.pres, heater.get());
+}
+
+// GR-SAKURAからの制御JSON 1 行 → PWM適用 + WS配信
+static void handleLine(const char *line, uint32_t t3) {
+    LOG_D("[RX←GR] %s\n", line);
+
+    JsonDocument doc;
+    if (deserializeJson(doc, line)) {
+        Metrics.ctrlParseErrors.add();
+        return;
+    }
+    const char *type = doc["type"] | "";
+    if (strcmp(type, "baud") == 0) {
+        baudLink.onMessage(doc);
+        return;
+    }
+    if (strcmp(type, "ack") == 0 || strcmp(type, "status") == 0 ||
+        strcmp(type, "fw") == 0) {
+        // コマンド応答 / 状態通知 / ブートローダーの応答 (tools/fwdelta.py) はそのまま WS へ
+        web.broadcast(line);
+        return;
+    }
+    if (strcmp(type, "ctrl") != 0) return;
+    Metrics.ctrlFrames.add();
+
+    unsigned long now = millis();
+    uart.markCtrl(now);
+    ctrlEvent.signal();
+    if (fallback.state() == LinkState::Fallback) {
+        unsigned long outage = now - failoverMs;
+        fallback.release(now);
+        LOG_W("[LINK] ctrl 復帰 (代替制御 %lums) → %dms で移行\n",
+              outage, HANDBACK_MS);
+        reportLink("rx", "outage_ms", outage);
+    }
+    float sp = doc["sp"] | 0.0f;
+    if (sp > 0.0f) fallback.setTarget(sp);
+
+    // "duty" (0-10000) があれば全分解能で、なければ "pwm" (0-255)
+    int pwm = doc["pwm"] | 0;
+    int duty = doc["duty"] | -1;
+    if (fallback.state() == LinkState::Rx &&
+        duty >= 0 && duty <= HEATER_DUTY_FULL) {
+        heater.setDuty((uint16_t)duty);
+#ifdef HEATER2_PIN
+        int duty2 = doc["duty2"] | duty;
+        if (duty2 >= 0 && duty2 <= HEATER_DUTY_FULL) heater.setDuty(1, (uint16_t)duty2);
+#endif
+    } else if (pwm >= 0 && pwm <= 255) {
+        setHeater(fallback.apply((uint8_t)pwm, now));
+    }
+    trace.onCtrl(doc, t3, micros());
+    // ブラウザに制御データ転送
+    web.broadcast(line);
+}
+
+// ctrl フレーム途絶 → ESP32 代替制御へ切替
+static void engageFallback() {
+    unsigned long now = millis();
+    unsigned long latency = now - uart.lastCtrlMs();
+    setHeater(fallback.engage(lastTemp, heater.get(), now));
+    failoverMs = now;
+    LOG_W("[LINK] ctrl 途絶 %lums → ESP32 代替制御\n", latency);
+    reportLink("fallback", "latency_ms", latency);
+}
+
+// 区間遅延ヒストグラム / ルーチン統計 → ブラウザ / サーバー
+static void reportStats() {
+    static char buf[1536];
+    if (trace.report(buf, sizeof(buf))) {
+        web.broadcast(buf);
+    }
+    LOG_I("[TRACE] offset=%ldus drift=%.1fppm rtt=%luus uart_drop=%lu log_drop=%lu\n",
+          (long)trace.sync().offset(), trace.sync().driftPpm(),
+          (unsigned long)trace.sync().delay(), (unsigned long)uart.dropped(),
+          (unsigned long)Log.dropped());
+
+    if (Power.report(buf, sizeof(buf))) {
+        web.broadcast(buf);
+    }
+    if (baudLink.report(buf, sizeof(buf))) {
+        web.broadcast(buf);
+    }
+    if (heater.channels() > 1 && heater.report(buf, sizeof(buf))) {
+        web.broadcast(buf);
+    }
+
+    JsonDocument doc;
+    doc["type"] = "sched";
+    sched.toJson(doc["routines"].to<JsonArray>());
+    if (measureJson(doc) < sizeof(buf)) {
+        serializeJson(doc, buf, sizeof(buf));
+        web.broadcast(buf);
+    }
+    for (Routine *r = sched.first(); r; r = sched.next(r)) {
+        LOG_D("[SCHED] %-12s wakes=%lu run=%luus max=%luus\n", r->name(),
+              (unsigned long)r->wakes(), (unsigned long)r->runUs(),
+              (unsigned long)r->maxUs());
+    }
+}
+
+// ---------------------------------------------------------------- ルーチン
+// 待ちをまたぐ状態はメンバに置く (coro.h 参照)
+
+class SensorRoutine : public Routine {
+public:
+    SensorRoutine() : Routine("sensor") {}
+protected:
+    void run() override {
+        CO_BEGIN();
+        nextMs_ = millis();
+        for (;;) {
+            acquireAndPublish();
+            nextMs_ += SENSOR_INTERVAL;
+            CO_SLEEP_UNTIL(nextMs_);
+        }
+        CO_END();
+    }
+private:
+    uint32_t nextMs_ = 0;
+};
+
+class CtrlRoutine : public Routine {
+public:
+    CtrlRoutine() : Routine("ctrl") {}
+protected:
+    void run() override {
+        CO_BEGIN();
+        for (;;) {
+            // 応答待ち中は期限付き: 返ってこなければ PM ロックを放して眠れるように
+            if (uart.awaitingReply()) {
+                CO_WAIT_FOR(uart.lineEvent(), POWER_REPLY_MS);
+            } else {
+                CO_WAIT(uart.lineEvent());
+            }
+            // 受信タスクが溜めた行はこの 1 回でまとめて処理する
+            while (uart.receive(rxBuf_, sizeof(rxBuf_), &t3_)) {
+                handleLine(rxBuf_, t3_);
+            }
+            uart.replyDone();
+        }
+        CO_END();
+    }
+private:
+    char rxBuf_[UART_BUF_SIZE];
+    uint32_t t3_ = 0;
+};
+
+class LinkRoutine : public Routine {
+public:
+    LinkRoutine() : Routine("link") {}
+protected:
+    void run() override {
+        CO_BEGIN();
+        for (;;) {
+            CO_WAIT_FOR(ctrlEvent, LINK_TIMEOUT_MS);
+            if (timedOut() && fallback.state() != LinkState::Fallback) {
+                engageFallback();
+            }
+        }
+        CO_END();
+    }
+};
+
+class CommandRoutine : public Routine {
+public:
+    CommandRoutine() : Routine("command") {}
+protected:
+    void run() override {
+        CO_BEGIN();
+        for (;;) {
+            CO_WAIT(web.commandEvent());
+            // ブラウザからのコマンド → UART経由でGR-SAKURAへ転送
+            while (web.hasCommand(cmdBuf_, sizeof(cmdBuf_))) {
+                LOG_I("[WS→GR] %s\n", cmdBuf_);
+                uart.sendRaw(cmdBuf_);
+                trackCommand(cmdBuf_);
+            }
+        }
+        CO_END();
+    }
+private:
+    char cmdBuf_[256];
+};
+
+class StatsRoutine : public Routine {
+public:
+    StatsRoutine() : Routine("stats") {}
+protected:
+    void run() override {
+        CO_BEGIN();
+        for (;;) {
+            CO_SLEEP(TRACE_REPORT_MS);
+            reportStats();
+        }
+        CO_END();
+    }
+};
+
+class HousekeepingRoutine : public Routine {
+public:
+    HousekeepingRoutine() : Routine("housekeeping") {}
+protected:
+    void run() override {
+        CO_BEGIN();
+        for (;;) {
+            CO_SLEEP(CLEANUP_INTERVAL);
+            web.cleanup();
+            Metrics.tick(millis());
+        }
+        CO_END();
+    }
+};
+
+// ヒーターのシグマデルタ更新 (HEATER_DITHER_US 周期)
+// 端数がない間は間隔を空け、1ms 毎の起床で DFS / スリープを妨げない
+class DitherRoutine : public Routine {
+public:
+    DitherRoutine() : Routine("dither") {}
+protected:
+    void run() override {
+        CO_BEGIN();
+        for (;;) {
+            heater.tick();
+            CO_SLEEP(heater.dithering() ? HEATER_DITHER_US / 1000 : DITHER_IDLE_MS);
+        }
+        CO_END();
+    }
+};
+
+static SensorRoutine       sensorRoutine;
+static CtrlRoutine         ctrlRoutine;
+static LinkRoutine         linkRoutine;
+static CommandRoutine      commandRoutine;
+static StatsRoutine        statsRoutine;
+static HousekeepingRoutine housekeepingRoutine;
+static DitherRoutine       ditherRoutine;
 
 void setup() {
     Serial.begin(115200);
     delay(500);
+    Log.begin();
     Serial.println("\n=== SAMDEMO ESP32: Sensor + Heater + Web ===");
 
+    Power.begin();              // PM ロックを作る各 begin() より前
+
     if (bme.begin()) {
         Serial.println("[BME280] OK");
     } else {
         Serial.println("[BME280] NOT FOUND - check wiring");
     }
 
+#ifdef HEATER2_PIN
+    heater.add(HEATER_PIN, HEATER_PWM_CH, HEATER_FULL_MA);
+    heater.add(HEATER2_PIN, HEATER_PWM_CH + 1, HEATER_FULL_MA);
+#endif
+#ifdef HEATER_BUDGET_MA
+    heater.setBudget(HEATER_BUDGET_MA);
+#endif
     heater.begin();
     Serial.println("[HEATER] PWM on GPIO26 ready");
 
     uart.begin();
-    Serial.println("[UART] Serial1 ready (GPIO16=RX, GPIO17=TX)");
+    baudLink.begin([](const char *json) { web.broadcast(json); });
+    Serial.println("[UART] UART1 ready (GPIO16=RX, GPIO17=TX, '\\n' pattern)");
 
     web.begin();
 
+    sched.begin();
+    sched.add(ctrlRoutine);     // 受信処理を先に回す
+    sched.add(linkRoutine);
+    sched.add(sensorRoutine);
+    sched.add(commandRoutine);
+    sched.add(baudLink);
+    sched.add(ditherRoutine);
+    sched.add(statsRoutine);
+    sched.add(housekeepingRoutine);
+
     Serial.println("[READY] System started");
     Serial.println();
 }
 
 void loop() {
-    unsigned long now = millis();
-
-    // 1秒毎: BME280読取 → UART送信 + WS配信
-    if (now - lastSensorMs >= SENSOR_INTERVAL) {
-        lastSensorMs = now;
-
-        BmeData d = bme.read();
-        if (d.valid) {
-            // UART → GR-SAKURA
-            uart.sendSensor(d);
-
-            // WebSocket → ブラウザ
-            JsonDocument doc;
-            doc["type"] = "sensor";
-            doc["temp"] = round(d.temp * 10.0f) / 10.0f;
-            doc["humi"] = round(d.humi * 10.0f) / 10.0f;
-            doc["pres"] = round(d.pres * 100.0f) / 100.0f;
-            doc["pwm"]  = heater.get();
-
-            char buf[256];
-            serializeJson(doc, buf, sizeof(buf));
-            web.broadcast(buf);
-
-            Serial.printf("[SENSOR] T=%.1f H=%.1f P=%.2f PWM=%d\n",
-                          d.temp, d.humi, d.pres, heater.get());
-        }
-    }
-
-    // GR-SAKURAからの制御JSON受信 → PWM適用 + WS配信
-    char rxBuf[256];
-    if (uart.receive(rxBuf, sizeof(rxBuf))) {
-        Serial.printf("[RX←GR] %s\n", rxBuf);
-
-        JsonDocument doc;
-        DeserializationError err = deserializeJson(doc, rxBuf);
-        if (!err) {
-            const char *type = doc["type"] | "";
-            if (strcmp(type, "ctrl") == 0) {
-                int pwm = doc["pwm"] | 0;
-                if (pwm >= 0 && pwm <= 255) {
-                    heater.set((uint8_t)pwm);
-                }
-                // ブラウザに制御データ転送
-                web.broadcast(rxBuf);
-            }
-        }
-    }
-
-    // ブラウザからのコマンド → UART経由でGR-SAKURAへ転送
-    char cmdBuf[256];
-    if (web.hasCommand(cmdBuf, sizeof(cmdBuf))) {
-        Serial.printf("[WS→GR] %s\n", cmdBuf);
-        uart.sendRaw(cmdBuf);
-    }
-
-    // WebSocketクリーンアップ
-    static unsigned long lastCleanup = 0;
-    if (now - lastCleanup > 1000) {
-        lastCleanup = now;
-        // AsyncWebSocketの内部クリーンアップはライブラリが自動実行
-    }
+    Metrics.loopIters.add();
+    sched.runOnce();
 }
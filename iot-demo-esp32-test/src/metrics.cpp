@@ -0,0 +1,65 @@
+#include "metrics.h"
+
+RuntimeMetrics Metrics;
+
+void RuntimeMetrics::tick(uint32_t nowMs) {
+    uint32_t iters = loopIters.get();
+    uint32_t dt = nowMs - lastMs_;
+    if (lastMs_ != 0 && dt > 0) {
+        loopHz_ = (uint32_t)((uint64_t)(iters - lastIters_) * 1000 / dt);
+    }
+    lastIters_ = iters;
+    lastMs_ = nowMs;
+}
+
+static void counter(Print &out, const char *name, const char *help, uint32_t v) {
+    out.printf("# HELP esp32_%s %s\n# TYPE esp32_%s counter\nesp32_%s %lu\n",
+               name, help, name, name, (unsigned long)v);
+}
+
+void RuntimeMetrics::print(Print &out) const {
+    counter(out, "loop_iterations_total", "loop() iterations", loopIters.get());
+    out.printf("# TYPE esp32_loop_rate_hz gauge\nesp32_loop_rate_hz %lu\n",
+               (unsigned long)loopHz_);
+
+    counter(out, "uart_rx_bytes_total", "UART bytes received from GR-SAKURA", uartRxBytes.get());
+    counter(out, "uart_tx_bytes_total", "UART bytes sent to GR-SAKURA", uartTxBytes.get());
+    counter(out, "uart_rx_lines_total", "UART lines received", uartRxLines.get());
+    counter(out, "uart_dropped_lines_total", "UART lines dropped (ring full / too long)",
+            uartDropped.get());
+    out.printf("# HELP esp32_uart_errors_total UART driver errors\n"
+               "# TYPE esp32_uart_errors_total counter\n"
+               "esp32_uart_errors_total{kind=\"fifo_ovf\"} %lu\n"
+               "esp32_uart_errors_total{kind=\"buffer_full\"} %lu\n"
+               "esp32_uart_errors_total{kind=\"frame\"} %lu\n",
+               (unsigned long)uartFifoOvf.get(), (unsigned long)uartBufferFull.get(),
+               (unsigned long)uartFrameErr.get());
+    out.printf("# TYPE esp32_uart_baud gauge\nesp32_uart_baud %lu\n", (unsigned long)uartBaud_);
+    out.printf("# HELP esp32_uart_baud_changes_total baud-rate negotiation outcomes\n"
+               "# TYPE esp32_uart_baud_changes_total counter\n"
+               "esp32_uart_baud_changes_total{result=\"up\"} %lu\n"
+               "esp32_uart_baud_changes_total{result=\"fail\"} %lu\n"
+               "esp32_uart_baud_changes_total{result=\"fallback\"} %lu\n",
+               (unsigned long)uartBaudUp.get(), (unsigned long)uartBaudFail.get(),
+               (unsigned long)uartBaudFallback.get());
+
+    counter(out, "sensor_reads_total", "BME280 reads", sensorReads.get());
+    counter(out, "sensor_errors_total", "BME280 reads without a sensor", sensorErrors.get());
+    counter(out, "ctrl_frames_total", "ctrl frames applied", ctrlFrames.get());
+    counter(out, "ctrl_parse_errors_total", "UART lines that were not valid JSON",
+            ctrlParseErrors.get());
+
+    counter(out, "ws_connects_total", "WebSocket connections accepted", wsConnects.get());
+    out.printf("# HELP esp32_ws_rejected_total WebSocket connections refused\n"
+               "# TYPE esp32_ws_rejected_total counter\n"
+               "esp32_ws_rejected_total{reason=\"full\"} %lu\n"
+               "esp32_ws_rejected_total{reason=\"heap\"} %lu\n",
+               (unsigned long)wsRejectedFull.get(), (unsigned long)wsRejectedHeap.get());
+    counter(out, "ws_disconnects_total", "WebSocket disconnects", wsDisconnects.get());
+    counter(out, "ws_rx_messages_total", "WebSocket messages received", wsRxMsgs.get());
+    counter(out, "ws_tx_messages_total", "WebSocket messages queued (per client)", wsTxMsgs.get());
+    counter(out, "ws_tx_bytes_total", "WebSocket bytes queued (per client)", wsTxBytes.get());
+    counter(out, "ws_tx_dropped_total", "broadcasts skipped for low heap", wsTxDropped.get());
+    counter(out, "ws_cmd_dropped_total", "commands dropped while one was pending",
+            wsCmdDropped.get());
+}
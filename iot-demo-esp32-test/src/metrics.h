@@ -0,0 +1,68 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// 実行時カウンタ。ホットパスでは relaxed な加算だけを行い、
+// 整形は /metrics の要求時 (web_server) にまとめて行う。
+// 複数タスク (loop, uart_rx, AsyncTCP) から加算してよい。
+
+class Counter {
+public:
+    void add(uint32_t n = 1) { v_.fetch_add(n, std::memory_order_relaxed); }
+    uint32_t get() const { return v_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<uint32_t> v_{0};
+};
+
+class RuntimeMetrics {
+public:
+    // loop() 反復
+    Counter loopIters;
+
+    // UART (GR-SAKURA)
+    Counter uartRxBytes;
+    Counter uartTxBytes;
+    Counter uartRxLines;
+    Counter uartDropped;        // 行リングあふれ / 長すぎる行
+    Counter uartFifoOvf;
+    Counter uartBufferFull;
+    Counter uartFrameErr;       // フレーミング / パリティ
+    Counter uartBaudUp;         // ボーレート交渉: 確定
+    Counter uartBaudFail;       //   不成立 (nak / 応答なし / 試験フレーム不一致)
+    Counter uartBaudFallback;   //   確定後のエラー / 途絶で UART_BAUD へ戻した
+
+    // アプリ
+    Counter sensorReads;
+    Counter sensorErrors;
+    Counter ctrlFrames;
+    Counter ctrlParseErrors;
+
+    // WebSocket
+    Counter wsConnects;
+    Counter wsRejectedFull;     // WS_MAX_CLIENTS 超過
+    Counter wsRejectedHeap;     // 空きヒープ不足
+    Counter wsDisconnects;
+    Counter wsRxMsgs;
+    Counter wsTxMsgs;           // broadcast 回数 × 接続数
+    Counter wsTxBytes;
+    Counter wsTxDropped;        // ヒープ不足で配信を見送った回数
+    Counter wsCmdDropped;       // 前のコマンドが未処理で捨てた
+
+    // 1 秒ごとに呼び、直近 1 秒の loop() 反復数を求める
+    void tick(uint32_t nowMs);
+    uint32_t loopHz() const { return loopHz_; }
+    void setUartBaud(uint32_t baud) { uartBaud_ = baud; }
+    // Prometheus テキスト形式でカウンタを書き出す (esp32_ 接頭辞)
+    void print(Print &out) const;
+private:
+    uint32_t lastIters_ = 0;
+    uint32_t lastMs_ = 0;
+    uint32_t loopHz_ = 0;
+    uint32_t uartBaud_ = 0;
+};
+
+extern RuntimeMetrics Metrics;
+
+#endif
@@ -0,0 +1,104 @@
+#include "power_mgr.h"
+
+PowerMgr Power;
+PmLock *PmLock::head_ = nullptr;
+
+// ---------------------------------------------------------------- PM ロック
+
+void PmLock::begin() {
+    // 統計は POWER_MODE_FULL でも取る (どれだけ起きている必要があるかの目安)
+    link_ = head_;
+    head_ = this;
+#if POWER_MODE != POWER_MODE_FULL
+    if (esp_pm_lock_create(type_, 0, name_, &handle_) != ESP_OK) {
+        handle_ = nullptr;
+    }
+#endif
+}
+
+void PmLock::acquire() {
+    if (handle_) esp_pm_lock_acquire(handle_);
+    if (depth_.fetch_add(1) == 0) {
+        since_ = micros();
+        count_++;
+    }
+}
+
+void PmLock::release() {
+    if (depth_.fetch_sub(1) == 1) {
+        heldUs_ += micros() - since_;
+    }
+    if (handle_) esp_pm_lock_release(handle_);
+}
+
+void PmLock::takeStats(uint32_t *count, uint32_t *heldUs) {
+    uint32_t total = heldUs_;
+    // 保持中ならここまでの分を足して区切り直す
+    if (held()) {
+        uint32_t now = micros();
+        total += now - since_;
+        since_ = now;
+    }
+    *count = count_;
+    *heldUs = total;
+    count_ = 0;
+    heldUs_ = 0;
+}
+
+// ---------------------------------------------------------------- 全体設定
+
+bool PowerMgr::begin() {
+    lastMs_ = millis();
+#if POWER_MODE == POWER_MODE_FULL
+    return false;
+#else
+    esp_pm_config_esp32_t cfg = {};
+    cfg.max_freq_mhz = POWER_MAX_MHZ;
+    cfg.min_freq_mhz = POWER_MIN_MHZ;
+    cfg.light_sleep_enable = POWER_MODE == POWER_MODE_SLEEP;
+
+    esp_err_t err = esp_pm_configure(&cfg);
+    if (err != ESP_OK && cfg.light_sleep_enable) {
+        // tickless idle なしのビルド: DFS だけ使う
+        Serial.println("[POWER] light sleep unavailable, DFS only");
+        cfg.light_sleep_enable = false;
+        err = esp_pm_configure(&cfg);
+    }
+    if (err != ESP_OK) {
+        Serial.printf("[POWER] esp_pm_configure failed (%s), full speed\n",
+                      esp_err_to_name(err));
+        return false;
+    }
+    Serial.printf("[POWER] DFS %d-%dMHz%s\n", POWER_MIN_MHZ, POWER_MAX_MHZ,
+                  cfg.light_sleep_enable ? " + light sleep" : "");
+    active_ = true;
+    return true;
+#endif
+}
+
+size_t PowerMgr::report(char *buf, size_t bufSize) {
+    uint32_t now = millis();
+    uint32_t elapsedMs = now - lastMs_;
+    lastMs_ = now;
+    if (elapsedMs == 0) elapsedMs = 1;
+
+    JsonDocument doc;
+    doc["type"]    = "power";
+    doc["mode"]    = POWER_MODE;
+    doc["active"]  = active_;
+    doc["cpu_mhz"] = getCpuFrequencyMhz();
+
+    // held_pct: 区間内でロックを保持していた割合 (= 眠れなかった割合の目安)
+    JsonArray locks = doc["locks"].to<JsonArray>();
+    for (PmLock *l = PmLock::first(); l; l = l->next()) {
+        uint32_t n, heldUs;
+        l->takeStats(&n, &heldUs);
+        JsonObject o = locks.add<JsonObject>();
+        o["name"]     = l->name();
+        o["n"]        = n;
+        o["held_pct"] = round(heldUs / (elapsedMs * 10.0f) * 10.0f) / 10.0f;
+    }
+
+    if (measureJson(doc) >= bufSize) return 0;
+    return serializeJson(doc, buf, bufSize);
+}
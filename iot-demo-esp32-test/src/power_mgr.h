@@ -0,0 +1,84 @@
+#ifndef POWER_MGR_H
+#define POWER_MGR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <esp_pm.h>
+
+// 省電力モード (コンパイル時)
+//   build_flags = -DPOWER_MODE=POWER_MODE_SLEEP
+// DFS / ライトスリープには sdkconfig の CONFIG_PM_ENABLE
+// (ライトスリープは CONFIG_FREERTOS_USE_TICKLESS_IDLE も) が必要。
+// 無効なビルドでは begin() が失敗を報告し、全速のまま動く。
+#define POWER_MODE_FULL  0      // 常に 240MHz (従来動作)
+#define POWER_MODE_DFS   1      // アイドル時に POWER_MIN_MHZ まで下げる
+#define POWER_MODE_SLEEP 2      // DFS + 自動ライトスリープ
+
+#ifndef POWER_MODE
+#define POWER_MODE POWER_MODE_FULL
+#endif
+
+#define POWER_MAX_MHZ 240
+#define POWER_MIN_MHZ 40        // XTAL。APB も 40MHz に落ちる
+
+// sensor 送信から ctrl 受信までロックを保持する上限
+// (GR-SAKURA の応答は通常数 ms。途絶時はここで諦めて眠れるようにする)
+#define POWER_REPLY_MS 100
+
+// ESP-IDF の PM ロック。保持中はその種類に応じて周波数を上げ / 眠らない。
+// POWER_MODE_FULL や PM 無効ビルドでは何もしない。
+// 複数タスクから acquire / release してよい (入れ子も可)。
+class PmLock {
+public:
+    PmLock(esp_pm_lock_type_t type, const char *name) : type_(type), name_(name) {}
+    // esp_pm_lock_create。各モジュールの begin() から呼ぶ
+    void begin();
+    void acquire();
+    void release();
+    bool held() const { return depth_.load() > 0; }
+
+    const char *name() const { return name_; }
+    // 前回 take 以降の取得回数 / 保持時間 [us] を返してクリア
+    void takeStats(uint32_t *count, uint32_t *heldUs);
+
+    static PmLock *first() { return head_; }
+    PmLock *next() const { return link_; }
+private:
+    esp_pm_lock_type_t type_;
+    const char *name_;
+    esp_pm_lock_handle_t handle_ = nullptr;
+    std::atomic<int> depth_{0};
+    uint32_t count_ = 0;
+    uint32_t since_ = 0;        // 0 → 1 になった時刻 [us]
+    uint32_t heldUs_ = 0;
+    PmLock *link_ = nullptr;
+    static PmLock *head_;
+};
+
+// スコープ中だけ保持
+class PmGuard {
+public:
+    explicit PmGuard(PmLock &lock) : lock_(lock) { lock_.acquire(); }
+    ~PmGuard() { lock_.release(); }
+    PmGuard(const PmGuard &) = delete;
+    PmGuard &operator=(const PmGuard &) = delete;
+private:
+    PmLock &lock_;
+};
+
+class PowerMgr {
+public:
+    // 他モジュールの begin() より前に呼ぶ。false = PM 無効 (全速で動作)
+    bool begin();
+    bool active() const { return active_; }
+    // {"type":"power","mode":..,"active":..,"cpu_mhz":..,"locks":[...]}
+    size_t report(char *buf, size_t bufSize);
+private:
+    bool active_ = false;
+    uint32_t lastMs_ = 0;
+};
+
+extern PowerMgr Power;
+
+#endif
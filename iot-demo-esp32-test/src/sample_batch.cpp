@@ -0,0 +1,114 @@
+#include "sample_batch.h"
+
+static const char B64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+bool SampleBatch::fits(uint32_t tMs) const {
+    if (n_ == 0) return true;
+    int32_t err = (int32_t)(tMs - (t0_ + n_ * periodMs_));
+    if (err < 0) err = -err;
+    return (uint32_t)err * 2 < periodMs_ && n_ < 255 && len_ + SBATCH_SAMPLE_MAX <= SBATCH_DATA_MAX;
+}
+
+bool SampleBatch::add(uint32_t tMs, uint32_t id, const int32_t v[SBATCH_CHANNELS]) {
+    if (!fits(tMs)) return false;
+    if (n_ == 0) {
+        t0_ = tMs;
+        id_ = id;
+        for (int c = 0; c < SBATCH_CHANNELS; c++) last_[c] = 0;
+    }
+    for (int c = 0; c < SBATCH_CHANNELS; c++) {
+        // zigzag: 0, -1, 1, -2, .. → 0, 1, 2, 3, ..
+        int32_t d = (int32_t)((uint32_t)v[c] - (uint32_t)last_[c]);
+        uint32_t z = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+        while (z >= 0x80) {
+            data_[len_++] = (uint8_t)(z | 0x80);
+            z >>= 7;
+        }
+        data_[len_++] = (uint8_t)z;
+        last_[c] = v[c];
+    }
+    n_++;
+    return true;
+}
+
+bool SampleBatch::due(uint32_t nowMs) const {
+    if (n_ == 0) return false;
+    if (n_ == 255 || len_ + SBATCH_SAMPLE_MAX > SBATCH_DATA_MAX) return true;
+    return nowMs + periodMs_ - t0_ > capMs_;
+}
+
+size_t SampleBatch::encode(char *buf, size_t bufSize) const {
+    if (n_ == 0) return 0;
+    int len = snprintf(buf, bufSize, "{\"type\":\"sbatch\",\"t0\":%lu,\"dt\":%lu,\"n\":%u,\"id\":%lu,\"d\":\"",
+                       (unsigned long)t0_, (unsigned long)periodMs_, n_, (unsigned long)id_);
+    if (len < 0 || (size_t)len + (len_ + 2) / 3 * 4 + 3 > bufSize) return 0;
+
+    size_t o = (size_t)len;
+    for (uint8_t i = 0; i < len_; i += 3) {
+        uint32_t w = (uint32_t)data_[i] << 16;
+        if (i + 1 < len_) w |= (uint32_t)data_[i + 1] << 8;
+        if (i + 2 < len_) w |= data_[i + 2];
+        buf[o++] = B64[(w >> 18) & 63];
+        buf[o++] = B64[(w >> 12) & 63];
+        if (i + 1 < len_) buf[o++] = B64[(w >> 6) & 63];
+        if (i + 2 < len_) buf[o++] = B64[w & 63];
+    }
+    buf[o++] = '"';
+    buf[o++] = '}';
+    buf[o] = '\0';
+    return o;
+}
+
+// ---------------------------------------------------------------- 復号
+
+static int b64value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+void SampleBatchReader::begin(const char *d, uint32_t n) {
+    p_ = d;
+    left_ = n;
+    bits_ = 0;
+    nbits_ = 0;
+    err_ = false;
+    for (int c = 0; c < SBATCH_CHANNELS; c++) v_[c] = 0;
+}
+
+// 次の 1 バイト (-1 = 終わり)
+int SampleBatchReader::byte() {
+    while (nbits_ < 8) {
+        int x = b64value(*p_);
+        if (x < 0) return -1;
+        p_++;
+        bits_ = (bits_ << 6) | (uint32_t)x;
+        nbits_ += 6;
+    }
+    nbits_ -= 8;
+    return (int)((bits_ >> nbits_) & 0xFF);
+}
+
+bool SampleBatchReader::next(int32_t v[SBATCH_CHANNELS]) {
+    if (left_ == 0 || err_) return false;
+    for (int c = 0; c < SBATCH_CHANNELS; c++) {
+        uint32_t z = 0;
+        for (int shift = 0;; shift += 7) {
+            int b = byte();
+            if (b < 0 || shift > 28) {
+                err_ = true;
+                return false;
+            }
+            z |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+        v_[c] = (int32_t)((uint32_t)v_[c] + ((z >> 1) ^ (0U - (z & 1))));
+        v[c] = v_[c];
+    }
+    left_--;
+    return true;
+}
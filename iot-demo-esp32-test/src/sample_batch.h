@@ -0,0 +1,85 @@
+#ifndef SAMPLE_BATCH_H
+#define SAMPLE_BATCH_H
+
+#include <Arduino.h>
+
+// センサーサンプルのまとめ送り (SENSOR_BATCH_MS > 0)
+//
+// 1 サンプル 1 フレーム ({"type":"sensor","temp":..}) はヘッダとキー名が大半なので、
+// 連続する N サンプルを 1 行にまとめる:
+//   {"type":"sbatch","t0":先頭の millis(),"dt":周期[ms],"n":N,"id":先頭の id,"d":"..."}
+// d はサンプル順に temp, humi, pres (×100 の整数) の直前のサンプルとの差
+// (先頭は 0 との差) を zigzag + LEB128 varint にし、base64 (パディングなし) にしたもの。
+// サンプル i の時刻は t0 + i*dt、id は id + i。
+// 受け手: iot-demo-rx-test の json_parser.c, dashboard/server.py, SampleBatchReader
+//
+// 周期から半周期以上ずれたサンプル (読取失敗で抜けた等) は次のフレームに回す。
+// 先頭のサンプルが capMs より長く待たないよう、次を待つと越えるなら出す。
+
+// 0 = 1 サンプル 1 フレーム (従来)。> 0 でまとめ送り、値は先頭サンプルの待ち上限 [ms]
+#ifndef SENSOR_BATCH_MS
+#define SENSOR_BATCH_MS 0
+#endif
+// GR-SAKURA は sensor が SENSOR_TIMEOUT_MS (5000) 途絶えると非常停止するので、その半分まで
+#if SENSOR_BATCH_MS > 2500
+#error "SENSOR_BATCH_MS は GR-SAKURA の SENSOR_TIMEOUT_MS の半分 (2500) 以下にする"
+#endif
+// ctrl (GR-SAKURA から 500ms 毎) がこれより途絶えている間はまとめずに 1 サンプルずつ送る。
+// 回線の復旧 (ボーレート戻し等) 直後に届くサンプルを待たせて
+// SENSOR_TIMEOUT_MS の余裕を食わないように
+#ifndef SENSOR_BATCH_LINK_MS
+#define SENSOR_BATCH_LINK_MS 1000
+#endif
+
+#define SBATCH_CHANNELS   3       // temp, humi, pres
+// GR-SAKURA の行バッファ (JSON_BUF_SIZE 192) に収める:
+// ヘッダは最大 80 文字、d は 66 バイト → base64 88 文字
+#define SBATCH_DATA_MAX   66
+#define SBATCH_SAMPLE_MAX (SBATCH_CHANNELS * 5)     // varint 最大 5 バイト × 3
+#define SBATCH_LINE_MAX   176
+
+class SampleBatch {
+public:
+    SampleBatch(uint32_t periodMs, uint32_t capMs) : periodMs_(periodMs), capMs_(capMs) {}
+    bool empty() const { return n_ == 0; }
+    uint8_t count() const { return n_; }
+    uint32_t firstId() const { return id_; }
+    // tMs のサンプルを今のフレームに続けられるか (空なら常に true)
+    bool fits(uint32_t tMs) const;
+    // 追加。続けられない / 入りきらないときは false (先に encode して clear)
+    bool add(uint32_t tMs, uint32_t id, const int32_t v[SBATCH_CHANNELS]);
+    // 今出すべきか: 入りきらない、または次のサンプルを待つと先頭が capMs を越える
+    bool due(uint32_t nowMs) const;
+    // 先頭が既に capMs を越えて待っている (読取失敗でサンプルが来ないとき)
+    bool overdue(uint32_t nowMs) const { return n_ && nowMs - t0_ > capMs_; }
+    // フレーム (改行なし) を buf へ。戻り値は長さ (0 = 空 / buf が足りない)
+    size_t encode(char *buf, size_t bufSize) const;
+    void clear() { n_ = 0; len_ = 0; }
+private:
+    uint32_t periodMs_, capMs_;
+    uint32_t t0_ = 0, id_ = 0;
+    uint8_t n_ = 0;
+    uint8_t len_ = 0;
+    int32_t last_[SBATCH_CHANNELS] = {};
+    uint8_t data_[SBATCH_DATA_MAX];
+};
+
+// "d" の復号
+class SampleBatchReader {
+public:
+    // d: base64 の先頭 (終わりは '"' か NUL), n: サンプル数
+    void begin(const char *d, uint32_t n);
+    // 1 サンプル取り出す。false = 終わり / 壊れている (error())
+    bool next(int32_t v[SBATCH_CHANNELS]);
+    bool error() const { return err_; }
+private:
+    int byte();
+    const char *p_ = nullptr;
+    uint32_t left_ = 0;
+    uint32_t bits_ = 0;
+    uint8_t nbits_ = 0;
+    bool err_ = false;
+    int32_t v_[SBATCH_CHANNELS] = {};
+};
+
+#endif
@@ -1,44 +1,196 @@
 #include "uart_comm.h"
 
+// 8N1。省電力モードでは UART_BAUD 以下なら DFS で APB が 40MHz に落ちても
+// ボーレートが変わらない 1MHz REF_TICK、それより速ければ APB (80MHz を保持)
+void UartComm::configure(uint32_t baud) {
+    uart_config_t cfg = {};
+    cfg.baud_rate  = baud;
+    cfg.data_bits  = UART_DATA_8_BITS;
+    cfg.parity     = UART_PARITY_DISABLE;
+    cfg.stop_bits  = UART_STOP_BITS_1;
+    cfg.flow_ctrl  = UART_HW_FLOWCTRL_DISABLE;
+#if POWER_MODE == POWER_MODE_FULL
+    cfg.source_clk = UART_SCLK_APB;
+#else
+    bool fast = baud > UART_BAUD;
+    if (fast && !apbLock_.held()) apbLock_.acquire();
+    cfg.source_clk = fast ? UART_SCLK_APB : UART_SCLK_REF_TICK;
+#endif
+    uart_param_config(UART_PORT, &cfg);
+#if POWER_MODE != POWER_MODE_FULL
+    if (!fast && apbLock_.held()) apbLock_.release();
+#endif
+    baud_ = baud;
+    Metrics.setUartBaud(baud);
+}
+
 void UartComm::begin() {
-    Serial1.begin(UART_BAUD, SERIAL_8N1, UART_RX_PIN, UART_TX_PIN);
+    uart_driver_install(UART_PORT, UART_DRV_RX_BUF, UART_DRV_TX_BUF,
+                        UART_EVT_QUEUE, &evtQueue_, 0);
+    apbLock_.begin();
+    configure(UART_BAUD);
+    uart_set_pin(UART_PORT, UART_TX_PIN, UART_RX_PIN,
+                 UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+
+    // '\n' 1 文字で UART_PATTERN_DET (前後のアイドル条件なし)
+    uart_enable_pattern_det_baud_intr(UART_PORT, '\n', 1, 9, 0, 0);
+    uart_pattern_queue_reset(UART_PORT, UART_PATTERN_QUEUE);
+
+    replyLock_.begin();
+    lastCtrlMs_ = millis();  // 起動直後は LINK_TIMEOUT_MS だけ応答を待つ
+
+    // loop() と同じコアで動かし、WiFi スタック (コア0) と競合させない
+    xTaskCreatePinnedToCore(rxTask, "uart_rx", UART_TASK_STACK, this,
+                            UART_TASK_PRIO, nullptr, 1);
 }
 
-void UartComm::sendSensor(const BmeData &d) {
+uint32_t UartComm::sendSensor(const BmeData &d, uint32_t id) {
     JsonDocument doc;
     doc["type"] = "sensor";
     doc["temp"] = round(d.temp * 10.0f) / 10.0f;
     doc["humi"] = round(d.humi * 10.0f) / 10.0f;
     doc["pres"] = round(d.pres * 100.0f) / 100.0f;
+    doc["id"]   = id;
 
     char buf[UART_BUF_SIZE];
     size_t len = serializeJson(doc, buf, sizeof(buf) - 1);
-    buf[len] = '\n';
-    buf[len + 1] = '\0';
-    Serial1.print(buf);
+    buf[len++] = '\n';
+    holdReply();
+    uint32_t t0 = micros();
+    uart_write_bytes(UART_PORT, buf, len);
+    Metrics.uartTxBytes.add(len);
+    return t0;
+}
+
+uint32_t UartComm::sendBatch(const SampleBatch &b) {
+    char buf[SBATCH_LINE_MAX + 1];
+    size_t len = b.encode(buf, sizeof(buf) - 1);
+    if (len == 0) return micros();
+    buf[len++] = '\n';
+    holdReply();
+    uint32_t t0 = micros();
+    uart_write_bytes(UART_PORT, buf, len);
+    Metrics.uartTxBytes.add(len);
+    return t0;
 }
 
 void UartComm::sendRaw(const char *json) {
-    Serial1.print(json);
-    Serial1.print('\n');
-}
-
-bool UartComm::receive(char *buf, size_t bufSize) {
-    while (Serial1.available()) {
-        char c = Serial1.read();
-        if (c == '\n' || c == '\r') {
-            if (rxPos_ > 0) {
-                size_t copyLen = rxPos_ < bufSize - 1 ? rxPos_ : bufSize - 1;
-                memcpy(buf, rxBuf_, copyLen);
-                buf[copyLen] = '\0';
-                rxPos_ = 0;
-                return true;
+    holdReply();
+    uart_write_bytes(UART_PORT, json, strlen(json));
+    uart_write_bytes(UART_PORT, "\n", 1);
+    Metrics.uartTxBytes.add(strlen(json) + 1);
+}
+
+void UartComm::setBaud(uint32_t baud) {
+    uart_wait_tx_done(UART_PORT, pdMS_TO_TICKS(100));
+    configure(baud);
+    uart_flush_input(UART_PORT);
+    uart_pattern_queue_reset(UART_PORT, UART_PATTERN_QUEUE);
+}
+
+// 応答が返るまで眠らない (ライトスリープ中の UART は受信できない)
+// 送信ごとに取り直さず、応答待ちの間は 1 つだけ保持する
+void UartComm::holdReply() {
+    if (!replyLock_.held()) replyLock_.acquire();
+}
+
+void UartComm::replyDone() {
+    if (replyLock_.held()) replyLock_.release();
+}
+
+bool UartComm::receive(char *buf, size_t bufSize, uint32_t *rxUs) {
+    uint8_t t = tail_;
+    if (t == head_) return false;
+    __sync_synchronize();   // head_ を見てから中身を読む
+
+    const Line &l = ring_[t];
+    size_t copyLen = l.len < bufSize - 1 ? l.len : bufSize - 1;
+    memcpy(buf, l.buf, copyLen);
+    buf[copyLen] = '\0';
+    if (rxUs) *rxUs = l.rxUs;
+
+    __sync_synchronize();
+    tail_ = (t + 1) % UART_LINE_SLOTS;
+    return true;
+}
+
+void UartComm::pushLine(const char *data, size_t len, uint32_t rxUs) {
+    // 行末の "\r\n" を落とす。空行は無視
+    while (len > 0 && (data[len - 1] == '\n' || data[len - 1] == '\r')) len--;
+    if (len == 0) return;
+
+    uint8_t h = head_;
+    uint8_t next = (h + 1) % UART_LINE_SLOTS;
+    if (next == tail_) {
+        Metrics.uartDropped.add();
+        return;
+    }
+    Line &l = ring_[h];
+    l.len = len;
+    l.rxUs = rxUs;
+    memcpy(l.buf, data, len);
+
+    __sync_synchronize();   // 中身を書いてから head_ を進める
+    head_ = next;
+    Metrics.uartRxLines.add();
+    lineEvent_.signal();
+}
+
+// 溜まっている '\n' をすべて行として取り出す
+void UartComm::onPattern() {
+    uint32_t rxUs = micros();
+    char line[UART_BUF_SIZE];
+    int pos;
+
+    while ((pos = uart_pattern_pop_pos(UART_PORT)) != -1) {
+        size_t len = (size_t)pos + 1;
+        if (len > sizeof(line)) {
+            // 長すぎる行は読み捨てる
+            while (len > 0) {
+                size_t n = len < sizeof(line) ? len : sizeof(line);
+                uart_read_bytes(UART_PORT, line, n, pdMS_TO_TICKS(20));
+                len -= n;
             }
-        } else if (rxPos_ < sizeof(rxBuf_) - 1) {
-            rxBuf_[rxPos_++] = c;
-        } else {
-            rxPos_ = 0;
+            Metrics.uartRxBytes.add((size_t)pos + 1);
+            Metrics.uartDropped.add();
+            continue;
+        }
+        int n = uart_read_bytes(UART_PORT, line, len, pdMS_TO_TICKS(20));
+        if (n <= 0) continue;
+        Metrics.uartRxBytes.add(n);
+        pushLine(line, (size_t)n, rxUs);
+    }
+}
+
+void UartComm::rxTask(void *arg) {
+    UartComm *self = static_cast<UartComm *>(arg);
+    uart_event_t ev;
+
+    for (;;) {
+        if (xQueueReceive(self->evtQueue_, &ev, portMAX_DELAY) != pdTRUE) continue;
+
+        switch (ev.type) {
+        case UART_PATTERN_DET:
+            self->onPattern();
+            break;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // 途中の行は壊れているので捨てて行頭から同期し直す
+            uart_flush_input(UART_PORT);
+            xQueueReset(self->evtQueue_);
+            uart_pattern_queue_reset(UART_PORT, UART_PATTERN_QUEUE);
+            if (ev.type == UART_FIFO_OVF) Metrics.uartFifoOvf.add();
+            else Metrics.uartBufferFull.add();
+            Metrics.uartDropped.add();
+            break;
+        case UART_FRAME_ERR:
+        case UART_PARITY_ERR:
+            // 壊れた行は JSON パースで落ちる。ここでは数えるだけ
+            Metrics.uartFrameErr.add();
+            break;
+        default:
+            // UART_DATA 等: '\n' が来るまでドライバのバッファに置いておく
+            break;
         }
     }
-    return false;
 }
@@ -3,22 +3,87 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <driver/uart.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 #include "bme_reader.h"
+#include "coro.h"
+#include "metrics.h"
+#include "power_mgr.h"
+#include "sample_batch.h"
 
+#define UART_PORT   UART_NUM_1
 #define UART_RX_PIN 16
 #define UART_TX_PIN 17
-#define UART_BAUD   115200
+#define UART_BAUD   115200          // 起動時の速度 (baud_link.h で交渉して上げる)
 #define UART_BUF_SIZE 256
 
+// ESP-IDF ドライバ: '\n' のパターン検出で受信タスクを起こす
+#define UART_DRV_RX_BUF   1024    // ドライバ受信バッファ
+#define UART_DRV_TX_BUF   512     // ドライバ送信バッファ (0 = 送信完了まで待つ)
+#define UART_EVT_QUEUE    16
+#define UART_PATTERN_QUEUE 16     // 未処理の '\n' 位置
+#define UART_LINE_SLOTS   8       // 行リング (タスク → loop)
+#define UART_TASK_PRIO    5
+#define UART_TASK_STACK   3072
+
+// ctrl フレームがこの時間届かなければリンク途絶とみなす
+#ifndef LINK_TIMEOUT_MS
+#define LINK_TIMEOUT_MS 3000
+#endif
+
 class UartComm {
 public:
     void begin();
-    void sendSensor(const BmeData &d);
+    // id: 遅延トレース用サンプル番号 (ctrl で返る), 戻り値は送信時刻 [us]
+    uint32_t sendSensor(const BmeData &d, uint32_t id);
+    // まとめ送り (sample_batch.h)。戻り値は送信時刻 [us]
+    uint32_t sendBatch(const SampleBatch &b);
     void sendRaw(const char *json);
-    bool receive(char *buf, size_t bufSize);
+    // 送信を出し切ってから速度を切り替え、旧速度の受信途中の行を捨てる
+    void setBaud(uint32_t baud);
+    uint32_t baud() const { return baud_; }
+    // 受信済みの行を 1 行取り出す。rxUs には '\n' 検出時刻 [us]
+    // 1 回の loop() で false が返るまで呼べば溜まった行をまとめて処理できる
+    bool receive(char *buf, size_t bufSize, uint32_t *rxUs = nullptr);
+    // 行リングあふれ / ドライバ FIFO あふれで捨てた行数
+    uint32_t dropped() const { return Metrics.uartDropped.get(); }
+    // 行リングに行が入ると立つ
+    Event &lineEvent() { return lineEvent_; }
+
+    // 省電力: 送信から応答受信まで (最長 POWER_REPLY_MS) 全速・スリープ禁止
+    bool awaitingReply() const { return replyLock_.held(); }
+    void replyDone();
+
+    // リンク監視 (ctrl フレーム受信時刻)
+    void markCtrl(unsigned long now) { lastCtrlMs_ = now; }
+    bool linkAlive(unsigned long now) const { return now - lastCtrlMs_ < LINK_TIMEOUT_MS; }
+    unsigned long lastCtrlMs() const { return lastCtrlMs_; }
 private:
-    char rxBuf_[UART_BUF_SIZE];
-    size_t rxPos_ = 0;
+    struct Line {
+        uint16_t len;
+        uint32_t rxUs;
+        char buf[UART_BUF_SIZE];
+    };
+
+    static void rxTask(void *arg);
+    void onPattern();
+    void pushLine(const char *data, size_t len, uint32_t rxUs);
+
+    QueueHandle_t evtQueue_ = nullptr;
+    // 単一生産者 (rxTask) / 単一消費者 (loop) なのでロック不要
+    Line ring_[UART_LINE_SLOTS];
+    volatile uint8_t head_ = 0;     // rxTask が書く
+    volatile uint8_t tail_ = 0;     // loop が書く
+    Event lineEvent_;
+    PmLock replyLock_{ESP_PM_CPU_FREQ_MAX, "uart"};
+    // REF_TICK (1MHz) で作れない速度の間は APB クロックで動かし、DFS で APB を下げさせない
+    PmLock apbLock_{ESP_PM_APB_FREQ_MAX, "uart_baud"};
+    void holdReply();
+    void configure(uint32_t baud);
+    unsigned long lastCtrlMs_ = 0;
+    uint32_t baud_ = UART_BAUD;
 };
 
 #endif
@@ -1,9 +1,17 @@
 #include "web_server.h"
+#include <ArduinoJson.h>
+#include <esp_wifi.h>
+#include "async_log.h"
+#include "metrics.h"
 
 char WebDashboard::cmdBuf_[256] = {0};
 volatile bool WebDashboard::cmdReady_ = false;
+Event WebDashboard::cmdEvent_;
+PmLock WebDashboard::lock_{ESP_PM_CPU_FREQ_MAX, "ws"};
+WebDashboard::ClientSlot WebDashboard::slots_[WS_MAX_CLIENTS] = {};
 
 void WebDashboard::begin() {
+    lock_.begin();
     WiFi.softAP(WIFI_AP_SSID, WIFI_AP_PASS);
     Serial.print("[WiFi] AP started: ");
     Serial.println(WiFi.softAPIP());
@@ -18,6 +26,10 @@ void WebDashboard::begin() {
     server_.on("/", HTTP_GET, [](AsyncWebServerRequest *req) {
         req->send(SPIFFS, "/index.html", "text/html");
     });
+    // Prometheus テキスト形式。集計済みカウンタを読むだけなので軽い
+    server_.on("/metrics", HTTP_GET, [this](AsyncWebServerRequest *req) {
+        handleMetrics(req);
+    });
     server_.serveStatic("/", SPIFFS, "/");
 
     server_.begin();
@@ -25,7 +37,17 @@ void WebDashboard::begin() {
 }
 
 void WebDashboard::broadcast(const char *json) {
+    size_t n = ws_.count();
+    if (n == 0) return;
+    // 送信キューの確保でヒープを使い切らないよう、逼迫時は配信を見送る
+    if (ESP.getFreeHeap() < WS_MIN_FREE_HEAP / 2) {
+        Metrics.wsTxDropped.add();
+        return;
+    }
+    PmGuard guard(lock_);
     ws_.textAll(json);
+    Metrics.wsTxMsgs.add(n);
+    Metrics.wsTxBytes.add(n * strlen(json));
 }
 
 bool WebDashboard::hasCommand(char *buf, size_t bufSize) {
@@ -38,19 +60,142 @@ bool WebDashboard::hasCommand(char *buf, size_t bufSize) {
     return true;
 }
 
+// 時刻合わせ要求 {"type":"sync","t0":..} に t1 (受信) / t2 (送信) を付けて即返信
+// loop() を経由しないので ESP32 側の処理遅延が往復時間に乗らない
+bool WebDashboard::replySync(AsyncWebSocketClient *client, const uint8_t *data, size_t len) {
+    uint32_t t1 = micros();
+    if (len < 8 || len > 128 || data[0] != '{') return false;
+
+    JsonDocument doc;
+    if (deserializeJson(doc, data, len)) return false;
+    if (strcmp(doc["type"] | "", "sync") != 0) return false;
+
+    char buf[128];
+    doc["t1"] = t1;
+    doc["t2"] = micros();
+    size_t n = serializeJson(doc, buf, sizeof(buf));
+    client->text(buf);
+    Metrics.wsTxMsgs.add();
+    Metrics.wsTxBytes.add(n);
+    return true;
+}
+
+WebDashboard::ClientSlot *WebDashboard::findSlot(uint32_t id) {
+    for (ClientSlot &s : slots_) {
+        if (s.id == id) return &s;
+    }
+    return nullptr;
+}
+
+// 空き枠とヒープがあれば枠を割り当てる
+bool WebDashboard::admit(AsyncWebSocketClient *client) {
+    if (ESP.getFreeHeap() < WS_MIN_FREE_HEAP) {
+        Metrics.wsRejectedHeap.add();
+        LOG_W("[WS] Client #%u rejected: heap %u\n", client->id(), ESP.getFreeHeap());
+        return false;
+    }
+    ClientSlot *s = findSlot(0);
+    if (!s) {
+        Metrics.wsRejectedFull.add();
+        LOG_W("[WS] Client #%u rejected: %d clients\n", client->id(), WS_MAX_CLIENTS);
+        return false;
+    }
+    s->id = client->id();
+    s->sinceMs = millis();
+    s->rxMsgs = 0;
+    Metrics.wsConnects.add();
+    return true;
+}
+
+// AsyncTCP タスクで実行される (onWsEvent と同じタスクなので slots_ はロック不要)
+void WebDashboard::handleMetrics(AsyncWebServerRequest *req) {
+    AsyncResponseStream *out = req->beginResponseStream("text/plain; version=0.0.4");
+    uint32_t now = millis();
+
+    out->printf("# TYPE esp32_uptime_seconds gauge\nesp32_uptime_seconds %lu\n",
+                (unsigned long)(now / 1000));
+    out->printf("# TYPE esp32_heap_free_bytes gauge\nesp32_heap_free_bytes %lu\n",
+                (unsigned long)ESP.getFreeHeap());
+    out->printf("# TYPE esp32_heap_min_free_bytes gauge\nesp32_heap_min_free_bytes %lu\n",
+                (unsigned long)ESP.getMinFreeHeap());
+    // 最大連続ブロックは断片化の指標 (ヒープを走査するので要求時だけ)
+    out->printf("# TYPE esp32_heap_largest_block_bytes gauge\nesp32_heap_largest_block_bytes %lu\n",
+                (unsigned long)ESP.getMaxAllocHeap());
+    out->printf("# TYPE esp32_log_dropped_total counter\nesp32_log_dropped_total %lu\n",
+                (unsigned long)Log.dropped());
+    Metrics.print(*out);
+
+    out->printf("# TYPE esp32_ws_clients gauge\nesp32_ws_clients %u\n", (unsigned)ws_.count());
+    out->printf("# TYPE esp32_ws_clients_max gauge\nesp32_ws_clients_max %d\n", WS_MAX_CLIENTS);
+
+    // 接続ごと: 送信キュー満杯 (以降の送信は捨てられる) と TCP 送信バッファ空き
+    out->print("# TYPE esp32_ws_client_queue_full gauge\n");
+    for (const ClientSlot &s : slots_) {
+        AsyncWebSocketClient *c = s.id ? ws_.client(s.id) : nullptr;
+        if (c) out->printf("esp32_ws_client_queue_full{id=\"%lu\"} %d\n",
+                           (unsigned long)s.id, c->queueIsFull() ? 1 : 0);
+    }
+    out->print("# TYPE esp32_ws_client_tcp_space_bytes gauge\n");
+    for (const ClientSlot &s : slots_) {
+        AsyncWebSocketClient *c = s.id ? ws_.client(s.id) : nullptr;
+        if (c && c->client()) out->printf("esp32_ws_client_tcp_space_bytes{id=\"%lu\"} %u\n",
+                                          (unsigned long)s.id, (unsigned)c->client()->space());
+    }
+    out->print("# TYPE esp32_ws_client_rx_messages_total counter\n");
+    for (const ClientSlot &s : slots_) {
+        if (s.id) out->printf("esp32_ws_client_rx_messages_total{id=\"%lu\"} %lu\n",
+                              (unsigned long)s.id, (unsigned long)s.rxMsgs);
+    }
+    out->print("# TYPE esp32_ws_client_connected_seconds gauge\n");
+    for (const ClientSlot &s : slots_) {
+        if (s.id) out->printf("esp32_ws_client_connected_seconds{id=\"%lu\"} %lu\n",
+                              (unsigned long)s.id, (unsigned long)((now - s.sinceMs) / 1000));
+    }
+
+    // SoftAP に接続中の端末と RSSI
+    wifi_sta_list_t sta = {};
+    if (esp_wifi_ap_get_sta_list(&sta) == ESP_OK) {
+        out->printf("# TYPE esp32_wifi_stations gauge\nesp32_wifi_stations %d\n", sta.num);
+        out->print("# TYPE esp32_wifi_station_rssi_dbm gauge\n");
+        for (int i = 0; i < sta.num; i++) {
+            const uint8_t *m = sta.sta[i].mac;
+            out->printf("esp32_wifi_station_rssi_dbm{mac=\"%02x:%02x:%02x:%02x:%02x:%02x\"} %d\n",
+                        m[0], m[1], m[2], m[3], m[4], m[5], sta.sta[i].rssi);
+        }
+    }
+    req->send(out);
+}
+
 void WebDashboard::onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
                               AwsEventType type, void *arg, uint8_t *data, size_t len) {
+    PmGuard guard(lock_);
     if (type == WS_EVT_CONNECT) {
-        Serial.printf("[WS] Client #%u connected\n", client->id());
+        if (!admit(client)) {
+            client->close(1013, "busy");
+            return;
+        }
+        LOG_I("[WS] Client #%u connected (%u/%d)\n",
+              client->id(), (unsigned)server->count(), WS_MAX_CLIENTS);
     } else if (type == WS_EVT_DISCONNECT) {
-        Serial.printf("[WS] Client #%u disconnected\n", client->id());
+        // 断った接続にも DISCONNECT は来る。枠を持っていたものだけ数える
+        ClientSlot *s = findSlot(client->id());
+        if (!s) return;
+        s->id = 0;
+        Metrics.wsDisconnects.add();
+        LOG_I("[WS] Client #%u disconnected\n", client->id());
     } else if (type == WS_EVT_DATA) {
         AwsFrameInfo *info = (AwsFrameInfo *)arg;
         if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
+            Metrics.wsRxMsgs.add();
+            if (ClientSlot *s = findSlot(client->id())) s->rxMsgs++;
+            if (replySync(client, data, len)) return;
             if (len < sizeof(cmdBuf_) - 1 && !cmdReady_) {
                 memcpy(cmdBuf_, data, len);
                 cmdBuf_[len] = '\0';
                 cmdReady_ = true;
+                cmdEvent_.signal();
+            } else {
+                Metrics.wsCmdDropped.add();
             }
         }
     }
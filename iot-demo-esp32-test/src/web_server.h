@@ -4,22 +4,53 @@
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
 #include <SPIFFS.h>
+#include "coro.h"
+#include "power_mgr.h"
 
 #define WIFI_AP_SSID "SAMDEMO-ESP32"
 #define WIFI_AP_PASS ""
 
+// WebSocket 同時接続の上限。超えた接続は 1013 (Try Again Later) で閉じる
+// 接続ごとに送信キュー (最大 WS_MAX_QUEUED_MESSAGES 件) を持つのでヒープを直接食う
+#ifndef WS_MAX_CLIENTS
+#define WS_MAX_CLIENTS 4
+#endif
+// 空きヒープがこれを下回ると新規接続を断り、半分を下回ると配信も見送る [byte]
+#ifndef WS_MIN_FREE_HEAP
+#define WS_MIN_FREE_HEAP 32768
+#endif
+
 class WebDashboard {
 public:
     void begin();
     void broadcast(const char *json);
     bool hasCommand(char *buf, size_t bufSize);
+    // ブラウザからコマンドが届くと立つ
+    Event &commandEvent() { return cmdEvent_; }
+    // 切断済みクライアントの解放 (上限超過分は古い接続から閉じる)
+    void cleanup() { ws_.cleanupClients(WS_MAX_CLIENTS); }
 private:
+    // 受け付けた接続 (id == 0 は空き)。AsyncTCP タスクだけが触る
+    struct ClientSlot {
+        uint32_t id;
+        uint32_t sinceMs;
+        uint32_t rxMsgs;
+    };
+
     AsyncWebServer server_{80};
     AsyncWebSocket ws_{"/ws"};
+    void handleMetrics(AsyncWebServerRequest *req);
+    static bool admit(AsyncWebSocketClient *client);
+    static ClientSlot *findSlot(uint32_t id);
     static void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
                           AwsEventType type, void *arg, uint8_t *data, size_t len);
+    static bool replySync(AsyncWebSocketClient *client, const uint8_t *data, size_t len);
     static char cmdBuf_[256];
     static volatile bool cmdReady_;
+    static Event cmdEvent_;
+    static ClientSlot slots_[WS_MAX_CLIENTS];
+    // WS 送受信の間は全速 (AsyncTCP タスクからも取る)
+    static PmLock lock_;
 };
 
 #endif
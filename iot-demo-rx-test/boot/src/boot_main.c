@@ -0,0 +1,504 @@
+/*
+ * boot_main.c - 差分更新ブートローダー (0xFFFF8000-, 領域と手順は src/fw_update.h)
+ *
+ * 起動時:
+ *   1. 入れ替え記録があれば 仮置き → アプリ領域 へコピー (電源断からの再開も同じ)
+ *   2. アプリからの更新要求 (RAM) があれば更新モード
+ *   3. アプリのヘッダが正しければアプリへ
+ *   4. どれでもなければ更新モード (アプリが壊れていても書き直せる)
+ *
+ * 更新モード (SCI2 115200bps, 1 行 1 JSON, tools/fwdelta.py と対):
+ *   RX   → {"type":"fw","op":"ready","base_len":..,"base_crc":"8桁"}   1 秒ごと
+ *   host → {"type":"fw","op":"begin","base_crc":..,"new_len":..,"new_crc":..,"delta_len":..}
+ *   host → {"type":"fw","op":"data","seq":n,"c":"行の CRC","d":"base64"}   ok を待って次
+ *   host → {"type":"fw","op":"end"}
+ *   RX   → {"type":"fw","op":"ok","to":"begin"|"data","seq":n}
+ *          {"type":"fw","op":"err","to":..,"seq":..,"msg":..}
+ *          {"type":"fw","op":"done","crc":..}   の後、入れ替えてアプリへ
+ *   同じ seq の再送 (ok が失われた) には、当て直さずに ok だけ返す。
+ *
+ * 新イメージは 128 バイトずつ仮置き領域へ書き、ブロックは最初に書くときに消去する。
+ * 差分の NEW (書き終えた出力の参照) は、書き込み前の 1 ページは RAM から、
+ * それより前は仮置き領域から読む。OLD はアプリ領域 (いま動いているイメージ) から読む。
+ */
+
+#include "iodefine.h"
+#include "fw_update.h"
+#include "flash_rom.h"
+#include "boot_uart.h"
+#include "fw_delta.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define LINE_SIZE           320
+#define CHUNK_MAX           192         /* 1 行の差分 (fwdelta.py は 128) */
+#define READY_MS            1000
+#define SWAP_RETRY          3
+
+#define APP_HDR             ((const fw_app_header_t *)FW_APP_BASE)
+#define SWAP_REC            ((const fw_swap_rec_t *)FW_SWAP_REC)
+#define FW_REQ              (*(volatile unsigned long *)FW_REQ_ADDR)
+
+static char line[LINE_SIZE];
+static char reply[128];
+static unsigned char chunk[CHUNK_MAX];
+
+/* 仮置きへの書き出し */
+static unsigned char page[FLASH_WRITE_SIZE];
+static unsigned long page_base;         /* page[] が入る仮置き内の位置 */
+static unsigned long page_fill;
+static unsigned long erased_end;        /* ここまでの仮置きブロックは今回消去済み */
+static unsigned long stage_limit;       /* begin の new_len */
+
+/* ------------------------------------------------------------ 応答 */
+
+/* 終端の NUL も書く (続けて書けば上書きされる) */
+static char *put_str(char *p, const char *s)
+{
+    while (*s) *p++ = *s++;
+    *p = '\0';
+    return p;
+}
+
+static char *put_dec(char *p, unsigned long v)
+{
+    char tmp[10];
+    int n = 0;
+
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+static char *put_hex8(char *p, unsigned long v)
+{
+    int i;
+
+    for (i = 28; i >= 0; i -= 4) {
+        *p++ = "0123456789abcdef"[(v >> i) & 0x0F];
+    }
+    return p;
+}
+
+/* {"type":"fw","op":<op>[,"to":<to>][,"seq":n] ... (呼び出し側で続けて閉じる) */
+static char *reply_head(const char *op, const char *to, long seq)
+{
+    char *p = put_str(reply, "{\"type\":\"fw\",\"op\":\"");
+
+    p = put_str(p, op);
+    p = put_str(p, "\"");
+    if (to) {
+        p = put_str(p, ",\"to\":\"");
+        p = put_str(p, to);
+        p = put_str(p, "\"");
+    }
+    if (seq >= 0) {
+        p = put_str(p, ",\"seq\":");
+        p = put_dec(p, (unsigned long)seq);
+    }
+    return p;
+}
+
+static void send_ok(const char *to, long seq)
+{
+    char *p = reply_head("ok", to, seq);
+
+    put_str(p, "}");
+    boot_uart_puts(reply);
+}
+
+static void send_err(const char *to, long seq, const char *msg)
+{
+    char *p = reply_head("err", to, seq);
+
+    p = put_str(p, ",\"msg\":\"");
+    p = put_str(p, msg);
+    put_str(p, "\"}");
+    boot_uart_puts(reply);
+}
+
+/* ------------------------------------------------------------ 行の解析 */
+
+/* "key": の値の先頭 (空白は飛ばす)。なければ NULL */
+static const char *json_value(const char *s, const char *key)
+{
+    size_t klen = strlen(key);
+
+    while ((s = strchr(s, '"')) != NULL) {
+        s++;
+        if (strncmp(s, key, klen) == 0 && s[klen] == '"') {
+            s += klen + 1;
+            while (*s == ' ') s++;
+            if (*s != ':') continue;
+            s++;
+            while (*s == ' ') s++;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+/* 文字列値の中身と長さ */
+static const char *json_str(const char *s, const char *key, int *len)
+{
+    const char *v = json_value(s, key);
+    const char *e;
+
+    if (v == NULL || *v != '"') return NULL;
+    v++;
+    e = strchr(v, '"');
+    if (e == NULL) return NULL;
+    *len = (int)(e - v);
+    return v;
+}
+
+static int json_is(const char *s, const char *key, const char *want)
+{
+    int len;
+    const char *v = json_str(s, key, &len);
+
+    return v != NULL && (size_t)len == strlen(want) && strncmp(v, want, len) == 0;
+}
+
+static int json_ulong(const char *s, const char *key, unsigned long *out)
+{
+    const char *v = json_value(s, key);
+    char *e;
+
+    if (v == NULL || *v < '0' || *v > '9') return 0;
+    *out = strtoul(v, &e, 10);
+    return 1;
+}
+
+/* "8 桁の 16 進" */
+static int json_hex(const char *s, const char *key, unsigned long *out)
+{
+    int len;
+    const char *v = json_str(s, key, &len);
+    char *e;
+
+    if (v == NULL || len != 8) return 0;
+    *out = strtoul(v, &e, 16);
+    return e == v + 8;
+}
+
+/* ------------------------------------------------------------ 仮置き領域 */
+
+static unsigned char stage_at(unsigned long pos)
+{
+    if (pos >= page_base) return page[pos - page_base];
+    return *(const unsigned char *)(FW_STAGE_BASE + pos);
+}
+
+static int write_verified(unsigned long addr, const unsigned char *buf)
+{
+    if (flash_rom_write(addr, buf) != 0) return -1;
+    return memcmp((const void *)addr, buf, FLASH_WRITE_SIZE) == 0 ? 0 : -1;
+}
+
+static int stage_flush(void)
+{
+    unsigned long addr = FW_STAGE_BASE + page_base;
+
+    while (addr >= FW_STAGE_BASE + erased_end) {
+        unsigned long blk = FW_STAGE_BASE + erased_end;
+
+        if (flash_rom_erase(blk) != 0) return -1;
+        erased_end += flash_rom_block_size(blk);
+    }
+    if (write_verified(addr, page) != 0) return -1;
+    page_base += FLASH_WRITE_SIZE;
+    page_fill = 0;
+    memset(page, 0xFF, sizeof(page));
+    return 0;
+}
+
+static int stage_put(unsigned char c)
+{
+    if (page_base + page_fill >= stage_limit) return -1;
+    page[page_fill++] = c;
+    if (page_fill == FLASH_WRITE_SIZE) return stage_flush();
+    return 0;
+}
+
+static void stage_reset(unsigned long limit)
+{
+    page_base = 0;
+    page_fill = 0;
+    erased_end = 0;
+    stage_limit = limit;
+    memset(page, 0xFF, sizeof(page));
+}
+
+/* 仮置きのイメージを検証済みとして記録する */
+static int swap_record(unsigned long len, unsigned long crc)
+{
+    fw_swap_rec_t *rec = (fw_swap_rec_t *)page;
+
+    if (flash_rom_erase(flash_rom_block_start(FW_SWAP_REC)) != 0) return -1;
+    memset(page, 0xFF, sizeof(page));
+    rec->magic = FW_SWAP_MAGIC;
+    rec->length = len;
+    rec->crc = crc;
+    rec->crc_inv = ~crc;
+    return write_verified(FW_SWAP_REC, page);
+}
+
+/* ------------------------------------------------------------ 入れ替え / 起動 */
+
+static int swap_pending(void)
+{
+    const fw_swap_rec_t *r = SWAP_REC;
+
+    if (r->magic != FW_SWAP_MAGIC || r->crc_inv != ~r->crc) return 0;
+    if (r->length < sizeof(fw_app_header_t) || r->length > FW_IMAGE_MAX) return 0;
+    return fw_crc32(0, (const unsigned char *)FW_STAGE_BASE, r->length) == r->crc;
+}
+
+/* 仮置き → アプリ領域。途中で電源が落ちても記録が残るので次の起動でやり直す */
+static int swap(void)
+{
+    unsigned long len = SWAP_REC->length;
+    unsigned long crc = SWAP_REC->crc;
+    unsigned long addr, off;
+    int i;
+
+    for (i = 0; i < SWAP_RETRY; i++) {
+        for (addr = FW_APP_BASE; addr < FW_APP_BASE + len; addr += flash_rom_block_size(addr)) {
+            if (flash_rom_erase(addr) != 0) break;
+        }
+        for (off = 0; off < len; off += FLASH_WRITE_SIZE) {
+            const unsigned char *src = (const unsigned char *)(FW_STAGE_BASE + off);
+            unsigned long k;
+
+            for (k = 0; k < FLASH_WRITE_SIZE && src[k] == 0xFF; k++)
+                ;
+            if (k == FLASH_WRITE_SIZE) continue;    /* 消去したままでよい */
+            if (write_verified(FW_APP_BASE + off, src) != 0) break;
+        }
+        if (fw_crc32(0, (const unsigned char *)FW_APP_BASE, len) == crc) {
+            flash_rom_erase(flash_rom_block_start(FW_SWAP_REC));
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int app_valid(void)
+{
+    const fw_app_header_t *h = APP_HDR;
+
+    return h->magic == FW_APP_MAGIC &&
+           h->length >= sizeof(fw_app_header_t) && h->length <= FW_IMAGE_MAX &&
+           h->entry >= FW_APP_BASE + sizeof(fw_app_header_t) &&
+           h->entry < FW_APP_BASE + h->length;
+}
+
+static void jump_app(void)
+{
+    ((void (*)(void))APP_HDR->entry)();
+}
+
+/* ------------------------------------------------------------ 更新モード */
+
+enum { UPD_IDLE, UPD_RECV, UPD_FAIL };
+
+static int            upd_state = UPD_IDLE;
+static unsigned long  base_len, base_crc;
+static unsigned long  new_len, new_crc;
+static unsigned long  expect_seq;
+static int            delta_result;
+static fw_delta_t     delta;
+
+static void on_begin(void)
+{
+    unsigned long crc;
+
+    if (!json_hex(line, "base_crc", &crc) ||
+        !json_ulong(line, "new_len", &new_len) ||
+        !json_hex(line, "new_crc", &new_crc)) {
+        send_err("begin", -1, "format");
+        return;
+    }
+    if (crc != base_crc) {
+        send_err("begin", -1, "base");
+        return;
+    }
+    if (new_len < sizeof(fw_app_header_t) || new_len > FW_IMAGE_MAX) {
+        send_err("begin", -1, "size");
+        return;
+    }
+
+    /* begin の再送もここで最初からやり直す */
+    stage_reset(new_len);
+    delta.put = stage_put;
+    delta.at = stage_at;
+    delta.old = (const unsigned char *)FW_APP_BASE;
+    delta.old_len = base_len;
+    fw_delta_init(&delta);
+    delta_result = FW_DELTA_MORE;
+    expect_seq = 0;
+    upd_state = UPD_RECV;
+    send_ok("begin", -1);
+}
+
+static void on_data(void)
+{
+    unsigned long seq, c;
+    const char *d;
+    int dlen, n;
+
+    if (!json_ulong(line, "seq", &seq)) {
+        send_err("data", -1, "format");
+        return;
+    }
+    if (upd_state != UPD_RECV) {
+        send_err("data", (long)seq, "state");
+        return;
+    }
+    if (seq + 1 == expect_seq) {
+        send_ok("data", (long)seq);     /* ok が届かなかった再送 */
+        return;
+    }
+    if (seq != expect_seq) {
+        send_err("data", (long)seq, "seq");
+        return;
+    }
+
+    d = json_str(line, "d", &dlen);
+    if (d == NULL || !json_hex(line, "c", &c) ||
+        (n = fw_base64_decode(d, dlen, chunk, sizeof(chunk))) <= 0) {
+        send_err("data", (long)seq, "format");
+        return;
+    }
+    if (fw_crc32(0, chunk, (unsigned long)n) != c) {
+        send_err("data", (long)seq, "crc");
+        return;
+    }
+
+    if (delta_result == FW_DELTA_MORE) {
+        delta_result = fw_delta_feed(&delta, chunk, (unsigned long)n);
+    } else {
+        delta_result = FW_DELTA_ERR;    /* END の後ろにまだある */
+    }
+    if (delta_result == FW_DELTA_ERR) {
+        upd_state = UPD_FAIL;
+        send_err("data", (long)seq, "delta");
+        return;
+    }
+    expect_seq++;
+    send_ok("data", (long)seq);
+}
+
+static void on_end(void)
+{
+    unsigned long crc;
+    char *p;
+
+    if (upd_state != UPD_RECV) {
+        send_err("end", -1, "state");
+        return;
+    }
+    upd_state = UPD_FAIL;
+    if (delta_result != FW_DELTA_END || delta.out_len != new_len) {
+        send_err("end", -1, "length");
+        return;
+    }
+    if (page_fill > 0 && stage_flush() != 0) {
+        send_err("end", -1, "write");
+        return;
+    }
+    crc = fw_crc32(0, (const unsigned char *)FW_STAGE_BASE, new_len);
+    if (crc != new_crc) {
+        send_err("end", -1, "verify");
+        return;
+    }
+    if (swap_record(new_len, crc) != 0) {
+        send_err("end", -1, "write");
+        return;
+    }
+
+    p = reply_head("done", NULL, -1);
+    p = put_str(p, ",\"crc\":\"");
+    p = put_hex8(p, crc);
+    put_str(p, "\"}");
+    boot_uart_puts(reply);
+    boot_uart_deinit();                 /* 送り終えるまで待つ */
+
+    if (swap() == 0 && app_valid()) {
+        jump_app();
+    }
+    boot_uart_init();
+    upd_state = UPD_IDLE;               /* 記録は残っているので次のリセットでもやり直す */
+}
+
+static void send_ready(void)
+{
+    char *p = reply_head("ready", NULL, -1);
+
+    p = put_str(p, ",\"base_len\":");
+    p = put_dec(p, base_len);
+    p = put_str(p, ",\"base_crc\":\"");
+    p = put_hex8(p, base_crc);
+    put_str(p, "\"}");
+    boot_uart_puts(reply);
+}
+
+static void update_mode(void)
+{
+    unsigned long last_ready;
+
+    base_len = app_valid() ? APP_HDR->length : 0;
+    base_crc = fw_crc32(0, (const unsigned char *)FW_APP_BASE, base_len);
+
+    boot_uart_init();
+    send_ready();
+    last_ready = boot_ms();
+
+    for (;;) {
+        if (boot_uart_getline(line, sizeof(line))) {
+            if (!json_is(line, "type", "fw")) continue;    /* sensor / baud などは無視 */
+
+            if (json_is(line, "op", "data")) {
+                on_data();
+            } else if (json_is(line, "op", "begin")) {
+                on_begin();
+            } else if (json_is(line, "op", "end")) {
+                on_end();
+            } else if (json_is(line, "op", "boot") && app_valid()) {
+                boot_uart_deinit();
+                jump_app();
+            }
+        }
+        /* 受信中でなければ ready を流し続ける (ホストの接続待ち) */
+        if (upd_state != UPD_RECV && boot_ms() - last_ready >= READY_MS) {
+            send_ready();
+            last_ready = boot_ms();
+        }
+    }
+}
+
+int main(void)
+{
+    flash_rom_init();
+
+    if (SWAP_REC->magic == FW_SWAP_MAGIC) {
+        if (!swap_pending() || swap() != 0) {
+            /* 仮置きが壊れている / コピーできない: 記録を消して書き直しを待つ */
+            flash_rom_erase(flash_rom_block_start(FW_SWAP_REC));
+        }
+    }
+
+    if (FW_REQ == FW_REQ_MAGIC) {
+        FW_REQ = 0;
+        update_mode();
+    }
+    if (app_valid()) {
+        jump_app();
+    }
+    update_mode();
+    return 0;
+}
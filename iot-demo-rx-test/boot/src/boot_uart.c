@@ -0,0 +1,111 @@
+/*
+ * boot_uart.c - ブートローダーの SCI2 (ポーリング) と ms カウンタ
+ */
+
+#include "iodefine.h"
+#include "boot_uart.h"
+
+#define IR_SCI2_RXI2        220
+#define IR_CMT0_CMI0        28
+#define CMT0_1MS            (50000000 / 8 / 1000 - 1)   /* PCLKB 50MHz / 8 */
+
+static unsigned long ms_count = 0;
+static int line_len = 0;
+
+void boot_uart_init(void)
+{
+    volatile int i;
+
+    SYSTEM.PRCR.WORD = 0xA502;
+    SYSTEM.MSTPCRB.BIT.MSTPB29 = 0;     /* SCI2 */
+    SYSTEM.MSTPCRA.BIT.MSTPA15 = 0;     /* CMT0 / CMT1 */
+    SYSTEM.PRCR.WORD = 0xA500;
+
+    /* 115200: CKS = 0, ABCS = 1, BRR = 26 (src/sci2_uart.c と同じ) */
+    SCI2.SCR.BYTE = 0x00;
+    SCI2.SMR.BYTE = 0x00;
+    SCI2.SEMR.BIT.ABCS = 1;
+    SCI2.BRR = 26;
+    for (i = 0; i < 1000; i++)
+        ;                               /* 1 ビット期間以上待つ */
+
+    MPC.PWPR.BIT.B0WI = 0;
+    MPC.PWPR.BIT.PFSWE = 1;
+    MPC.P50PFS.BIT.PSEL = 0x0A;
+    MPC.P52PFS.BIT.PSEL = 0x0A;
+    MPC.PWPR.BIT.PFSWE = 0;
+    MPC.PWPR.BIT.B0WI = 1;
+    PORT5.PMR.BIT.B0 = 1;
+    PORT5.PMR.BIT.B2 = 1;
+
+    /* 受信は IR フラグだけ見る (IER は立てない) */
+    ICU.IR[IR_SCI2_RXI2].BIT.IR = 0;
+    SCI2.SCR.BYTE = 0x70;               /* RIE | TE | RE */
+
+    CMT0.CMCR.WORD = 0x0040;            /* CMIE = 1, PCLK/8 */
+    CMT0.CMCOR = CMT0_1MS;
+    CMT0.CMCNT = 0;
+    ICU.IR[IR_CMT0_CMI0].BIT.IR = 0;
+    CMT.CMSTR0.BIT.STR0 = 1;
+}
+
+void boot_uart_deinit(void)
+{
+    while (SCI2.SSR.BIT.TEND == 0)
+        ;
+    SCI2.SCR.BYTE = 0x00;
+    ICU.IR[IR_SCI2_RXI2].BIT.IR = 0;
+
+    CMT.CMSTR0.BIT.STR0 = 0;
+    CMT0.CMCR.WORD = 0x0000;
+    ICU.IR[IR_CMT0_CMI0].BIT.IR = 0;
+}
+
+unsigned long boot_ms(void)
+{
+    if (ICU.IR[IR_CMT0_CMI0].BIT.IR) {
+        ICU.IR[IR_CMT0_CMI0].BIT.IR = 0;
+        ms_count++;
+    }
+    return ms_count;
+}
+
+static void putc_raw(char c)
+{
+    while (SCI2.SSR.BIT.TDRE == 0)
+        ;
+    SCI2.TDR = (unsigned char)c;
+}
+
+void boot_uart_puts(const char *s)
+{
+    while (*s) {
+        putc_raw(*s++);
+    }
+    putc_raw('\n');
+}
+
+int boot_uart_getline(char *buf, int size)
+{
+    char c;
+
+    boot_ms();
+
+    if (SCI2.SSR.BYTE & 0x38) {         /* ORER / FER / PER: 途中の行は捨てる */
+        SCI2.SSR.BYTE = (SCI2.SSR.BYTE & ~0x38) | 0xC0;
+        line_len = 0;
+    }
+    if (ICU.IR[IR_SCI2_RXI2].BIT.IR == 0) return 0;
+    ICU.IR[IR_SCI2_RXI2].BIT.IR = 0;
+    c = (char)SCI2.RDR;
+
+    if (c == '\n') {
+        buf[line_len] = '\0';
+        line_len = 0;
+        return buf[0] != '\0';
+    }
+    if (c != '\r' && line_len < size - 1) {
+        buf[line_len++] = c;            /* 長すぎる行は切り詰めて解析に失敗させる */
+    }
+    return 0;
+}
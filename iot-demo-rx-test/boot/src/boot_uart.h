@@ -0,0 +1,23 @@
+/*
+ * boot_uart.h - ブートローダーの SCI2 (ポーリング) と ms カウンタ
+ *
+ * SCI2 はアプリと同じ P50 / P52, 115200bps 固定 (SCI2_BAUD_BASE)。
+ * ESP32 は交渉済みの速度が途絶えると 115200 へ戻るので、そこで揃う。
+ * ms カウンタは CMT0 の比較一致フラグを boot_ms() の呼び出しで数える
+ * (フラッシュ消去の間は進まない)。
+ */
+
+#ifndef BOOT_UART_H
+#define BOOT_UART_H
+
+void boot_uart_init(void);
+/* アプリへ移る前に SCI2 / CMT0 を初期状態へ */
+void boot_uart_deinit(void);
+
+void boot_uart_puts(const char *s);
+/* 1 行 (改行は含めない) を受け取ったら 1。buf は NUL 終端 */
+int  boot_uart_getline(char *buf, int size);
+
+unsigned long boot_ms(void);
+
+#endif /* BOOT_UART_H */
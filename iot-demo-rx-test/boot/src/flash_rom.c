@@ -0,0 +1,173 @@
+/*
+ * flash_rom.c - コードフラッシュの消去 / 書き込み (手順は flash_rom.h)
+ *
+ * FCU の手順 (RX63N ハードウェアマニュアル「ROM (コード格納用フラッシュメモリ)」):
+ *   FENTRYR で P/E モードへ → 周辺クロック通知 → 消去 / 書き込み → リードモードへ
+ * コマンドは対象アドレスの P/E アドレス (下位 24 ビット) へ書く。
+ * .ramfunc の関数は ROM の定数も ROM の関数も参照しない (ライブラリ呼び出しも不可)。
+ */
+
+#include "iodefine.h"
+#include "flash_rom.h"
+
+#define RAMFUNC             __attribute__((section(".ramfunc"), noinline))
+
+#define FCU_FIRM_SRC        0xFEFFE000UL
+#define FCU_RAM_DST         0x007F8000UL
+#define FCU_FIRM_SIZE       0x2000UL
+
+#define FCLK_MHZ            25          /* hwinit.c: FCLK = 25MHz */
+#define FRDY_TIMEOUT        50000000UL  /* 32KB ブロックの消去 (最大 ~1s) より長く */
+
+#define FSTATR0_ERRORS      0x70        /* ILGLERR | ERSERR | PRGERR */
+
+/* 1 行ずつ RAM の中だけで済むよう、書き込みデータもここへ写してから渡す */
+static unsigned char wbuf[FLASH_WRITE_SIZE];
+
+/* ------------------------------------------------------------ RAM 実行部 */
+
+RAMFUNC static int fcu_wait(void)
+{
+    unsigned long n = FRDY_TIMEOUT;
+
+    while (FLASH.FSTATR0.BIT.FRDY == 0) {
+        if (--n == 0) {
+            FLASH.FRESETR.WORD = 0xCC01;    /* FCU を初期化して抜ける */
+            FLASH.FRESETR.WORD = 0xCC00;
+            return -1;
+        }
+    }
+    return (FLASH.FSTATR0.BYTE & FSTATR0_ERRORS) ? -1 : 0;
+}
+
+/* P/E モードへ入り、領域の先頭へ周辺クロックを通知する */
+RAMFUNC static int fcu_enter(unsigned long pe, unsigned short entry)
+{
+    volatile unsigned char *cmd;
+    volatile unsigned short *cmd16;
+
+    FLASH.FENTRYR.WORD = 0xAA00 | entry;
+    while (FLASH.FENTRYR.WORD != entry)
+        ;
+    FLASH.FWEPROR.BYTE = 0x01;
+
+    /* FENTRY0: 0x00F80000-, FENTRY1: 0x00F00000- */
+    cmd = (volatile unsigned char *)(pe & (entry == 0x0001 ? 0x00F80000UL : 0x00F00000UL));
+    cmd16 = (volatile unsigned short *)cmd;
+
+    *cmd = 0x50;                        /* ステータスクリア */
+    FLASH.PCKAR.WORD = FCLK_MHZ;
+    *cmd = 0xE9;
+    *cmd = 0x03;
+    *cmd16 = 0x0F0F;
+    *cmd16 = 0x0F0F;
+    *cmd16 = 0x0F0F;
+    *cmd = 0xD0;
+    return fcu_wait();
+}
+
+RAMFUNC static void fcu_exit(unsigned long pe)
+{
+    if (FLASH.FSTATR0.BYTE & FSTATR0_ERRORS) {
+        if (FLASH.FSTATR0.BIT.ILGLERR) {
+            FLASH.FASTAT.BYTE = 0x10;   /* CMDLK 以外のアクセス違反フラグを落とす */
+        }
+        *(volatile unsigned char *)pe = 0x50;
+    }
+    FLASH.FENTRYR.WORD = 0xAA00;
+    while (FLASH.FENTRYR.WORD != 0x0000)
+        ;
+    FLASH.FWEPROR.BYTE = 0x02;
+}
+
+RAMFUNC static int fcu_erase(unsigned long pe, unsigned short entry)
+{
+    volatile unsigned char *cmd = (volatile unsigned char *)pe;
+    int r;
+
+    r = fcu_enter(pe, entry);
+    if (r == 0) {
+        FLASH.FPROTR.WORD = 0x5501;     /* ロックビットを無視 */
+        *cmd = 0x20;
+        *cmd = 0xD0;
+        r = fcu_wait();
+    }
+    fcu_exit(pe);
+    return r;
+}
+
+RAMFUNC static int fcu_write(unsigned long pe, unsigned short entry, const unsigned char *src)
+{
+    volatile unsigned char *cmd = (volatile unsigned char *)pe;
+    volatile unsigned short *cmd16 = (volatile unsigned short *)pe;
+    int r, i;
+
+    r = fcu_enter(pe, entry);
+    if (r == 0) {
+        FLASH.FPROTR.WORD = 0x5501;
+        *cmd = 0xE8;
+        *cmd = FLASH_WRITE_SIZE / 2;
+        for (i = 0; i < FLASH_WRITE_SIZE; i += 2) {
+            *cmd16 = (unsigned short)(src[i] | (src[i + 1] << 8));
+        }
+        *cmd = 0xD0;
+        r = fcu_wait();
+    }
+    fcu_exit(pe);
+    return r;
+}
+
+/* ROM から RAM へは bsr が届かないので関数ポインタで呼ぶ */
+static int (* volatile erase_fn)(unsigned long, unsigned short) = fcu_erase;
+static int (* volatile write_fn)(unsigned long, unsigned short, const unsigned char *) = fcu_write;
+
+/* ------------------------------------------------------------ 公開 API */
+
+static unsigned short entry_bit(unsigned long addr)
+{
+    return (addr >= 0xFFF80000UL) ? 0x0001 : 0x0002;
+}
+
+void flash_rom_init(void)
+{
+    const unsigned long *src = (const unsigned long *)FCU_FIRM_SRC;
+    volatile unsigned long *dst = (volatile unsigned long *)FCU_RAM_DST;
+    unsigned long i;
+
+    if (FLASH.FENTRYR.WORD != 0x0000) {
+        FLASH.FENTRYR.WORD = 0xAA00;
+        while (FLASH.FENTRYR.WORD != 0x0000)
+            ;
+    }
+    FLASH.FCURAME.WORD = 0xC401;
+    for (i = 0; i < FCU_FIRM_SIZE / 4; i++) {
+        dst[i] = src[i];
+    }
+}
+
+unsigned long flash_rom_block_size(unsigned long addr)
+{
+    if (addr >= 0xFFFF8000UL) return 0x1000;
+    if (addr >= 0xFFF80000UL) return 0x4000;
+    return 0x8000;
+}
+
+unsigned long flash_rom_block_start(unsigned long addr)
+{
+    return addr & ~(flash_rom_block_size(addr) - 1);
+}
+
+int flash_rom_erase(unsigned long block)
+{
+    return erase_fn(block & 0x00FFFFFFUL, entry_bit(block));
+}
+
+int flash_rom_write(unsigned long addr, const unsigned char *buf)
+{
+    int i;
+
+    for (i = 0; i < FLASH_WRITE_SIZE; i++) {
+        wbuf[i] = buf[i];
+    }
+    return write_fn(addr & 0x00FFFFFFUL, entry_bit(addr), wbuf);
+}
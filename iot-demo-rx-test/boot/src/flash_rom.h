@@ -0,0 +1,26 @@
+/*
+ * flash_rom.h - コードフラッシュの消去 / 書き込み (FCU コマンド)
+ *
+ * ブロック: 0xFFFF8000- 4KB / 0xFFF80000- 16KB / 0xFFF00000- 32KB
+ * 書き込み単位は 128 バイト (アドレスも 128 境界)。
+ * 消去 / 書き込み中は ROM を読めないので、その部分は RAM (.ramfunc) で実行する。
+ * ブートローダーは割り込みを使わない (PSW.I = 0 のまま) 前提。
+ */
+
+#ifndef FLASH_ROM_H
+#define FLASH_ROM_H
+
+#define FLASH_WRITE_SIZE    128
+
+/* FCU ファームウェアを FCU RAM へ転送 (起動時に 1 回) */
+void flash_rom_init(void);
+
+/* addr を含むブロックの先頭 / 大きさ */
+unsigned long flash_rom_block_start(unsigned long addr);
+unsigned long flash_rom_block_size(unsigned long addr);
+
+/* 0: 成功, -1: FCU エラー / タイムアウト */
+int flash_rom_erase(unsigned long block);
+int flash_rom_write(unsigned long addr, const unsigned char *buf);
+
+#endif /* FLASH_ROM_H */
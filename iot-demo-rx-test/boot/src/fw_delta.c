@@ -0,0 +1,224 @@
+/*
+ * fw_delta.c - 差分の逐次展開 (形式は fw_delta.h)
+ */
+
+#include "fw_delta.h"
+
+enum {
+    ST_OP,
+    ST_LIT,
+    ST_LEN,         /* OLD / NEW の長さの続き */
+    ST_ARG,         /* OLD の位置増分 / NEW の距離 */
+    ST_FILL_LEN,
+    ST_FILL_BYTE,
+    ST_END
+};
+
+#define OP_OLD      0x80
+#define OP_NEW      0xA0
+#define OP_FILL     0xC0
+#define OP_END      0xC1
+#define MIN_MATCH   4
+
+void fw_delta_init(fw_delta_t *d)
+{
+    d->out_len = 0;
+    d->old_pos = 0;
+    d->len = 0;
+    d->var = 0;
+    d->shift = 0;
+    d->op = 0;
+    d->state = ST_OP;
+}
+
+static int put(fw_delta_t *d, unsigned char c)
+{
+    if (d->put(c) != 0) return -1;
+    d->out_len++;
+    return 0;
+}
+
+/* 1: 値がそろった, 0: 続きがある, -1: 32 ビットを超える
+ * 5 バイト目は下位 4 ビットだけ (上を黙って捨てると長さ / 位置が別の値になる) */
+static int varint_step(fw_delta_t *d, unsigned char c)
+{
+    if (d->shift > 28 || (d->shift == 28 && (c & 0xF0) != 0)) return -1;
+    d->var |= (unsigned long)(c & 0x7F) << d->shift;
+    d->shift += 7;
+    return (c & 0x80) ? 0 : 1;
+}
+
+static void varint_reset(fw_delta_t *d)
+{
+    d->var = 0;
+    d->shift = 0;
+}
+
+static int copy(fw_delta_t *d)
+{
+    unsigned long i;
+
+    if (d->op < OP_NEW) {
+        /* zigzag: 0, -1, 1, -2, ... */
+        if (d->var & 1) {
+            d->old_pos -= (d->var + 1) >> 1;
+        } else {
+            d->old_pos += d->var >> 1;
+        }
+        if (d->old_pos > d->old_len || d->len > d->old_len - d->old_pos) return -1;
+        for (i = 0; i < d->len; i++) {
+            if (put(d, d->old[d->old_pos + i]) != 0) return -1;
+        }
+        d->old_pos += d->len;
+    } else {
+        unsigned long src;
+
+        if (d->var == 0 || d->var > d->out_len) return -1;
+        src = d->out_len - d->var;
+        /* 距離が長さより短ければ今書いた分を読む (繰り返し) */
+        for (i = 0; i < d->len; i++) {
+            if (put(d, d->at(src + i)) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+int fw_delta_feed(fw_delta_t *d, const unsigned char *p, unsigned long n)
+{
+    unsigned long k;
+    int r;
+
+    for (k = 0; k < n; k++) {
+        unsigned char c = p[k];
+
+        switch (d->state) {
+        case ST_OP:
+            if (c < OP_OLD) {
+                d->len = (unsigned long)c + 1;
+                d->state = ST_LIT;
+            } else if (c < OP_FILL) {
+                d->op = c;
+                d->len = c & 0x1F;
+                varint_reset(d);
+                if (d->len == 31) {
+                    d->state = ST_LEN;
+                } else {
+                    d->len += MIN_MATCH;
+                    d->state = ST_ARG;
+                }
+            } else if (c == OP_FILL) {
+                varint_reset(d);
+                d->state = ST_FILL_LEN;
+            } else if (c == OP_END) {
+                d->state = ST_END;
+            } else {
+                return FW_DELTA_ERR;
+            }
+            break;
+
+        case ST_LIT:
+            if (put(d, c) != 0) return FW_DELTA_ERR;
+            if (--d->len == 0) d->state = ST_OP;
+            break;
+
+        case ST_LEN:
+            r = varint_step(d, c);
+            if (r < 0) return FW_DELTA_ERR;
+            if (r > 0) {
+                if (d->var > 0xFFFFFFFFUL - 31 - MIN_MATCH) return FW_DELTA_ERR;
+                d->len = 31 + d->var + MIN_MATCH;
+                varint_reset(d);
+                d->state = ST_ARG;
+            }
+            break;
+
+        case ST_ARG:
+            r = varint_step(d, c);
+            if (r < 0) return FW_DELTA_ERR;
+            if (r > 0) {
+                if (copy(d) != 0) return FW_DELTA_ERR;
+                d->state = ST_OP;
+            }
+            break;
+
+        case ST_FILL_LEN:
+            r = varint_step(d, c);
+            if (r < 0) return FW_DELTA_ERR;
+            if (r > 0) {
+                d->len = d->var;
+                d->state = ST_FILL_BYTE;
+            }
+            break;
+
+        case ST_FILL_BYTE:
+            while (d->len > 0) {
+                if (put(d, c) != 0) return FW_DELTA_ERR;
+                d->len--;
+            }
+            d->state = ST_OP;
+            break;
+
+        default:                        /* END の後ろにまだある */
+            return FW_DELTA_ERR;
+        }
+    }
+    return (d->state == ST_END) ? FW_DELTA_END : FW_DELTA_MORE;
+}
+
+/* ------------------------------------------------------------ CRC-32 / base64 */
+
+/* 4 ビットずつの表 (多項式 0xEDB88320, 64 バイト) */
+static const unsigned long crc_tab[16] = {
+    0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL,
+    0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+    0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL,
+    0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL
+};
+
+unsigned long fw_crc32(unsigned long crc, const unsigned char *p, unsigned long n)
+{
+    crc = ~crc & 0xFFFFFFFFUL;
+    while (n--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ crc_tab[crc & 0x0F];
+        crc = (crc >> 4) ^ crc_tab[crc & 0x0F];
+    }
+    return ~crc & 0xFFFFFFFFUL;
+}
+
+static int b64_val(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+int fw_base64_decode(const char *src, int src_len, unsigned char *dst, int max)
+{
+    int i, n = 0;
+
+    if (src_len % 4 != 0) return -1;
+
+    for (i = 0; i < src_len; i += 4) {
+        int v[4], k, pad = 0;
+        unsigned long w;
+
+        for (k = 0; k < 4; k++) {
+            if (src[i + k] == '=' && i + 4 == src_len && k >= 2) {
+                v[k] = 0;
+                pad++;
+            } else if (pad > 0 || (v[k] = b64_val(src[i + k])) < 0) {
+                return -1;
+            }
+        }
+        w = ((unsigned long)v[0] << 18) | ((unsigned long)v[1] << 12) | (v[2] << 6) | v[3];
+        if (n + 3 - pad > max) return -1;
+        dst[n++] = (unsigned char)(w >> 16);
+        if (pad < 2) dst[n++] = (unsigned char)(w >> 8);
+        if (pad < 1) dst[n++] = (unsigned char)w;
+    }
+    return n;
+}
@@ -0,0 +1,51 @@
+/*
+ * fw_delta.h - 差分の逐次展開 (tools/fwdelta.py の encode と対)
+ *
+ * 形式:
+ *   0x00-0x7F  LIT   op+1 バイトをそのまま
+ *   0x80-0x9F  OLD   旧イメージからコピー。長さの後に旧位置の増分 (zigzag varint)
+ *                    コピー後、旧位置は長さ分進む
+ *   0xA0-0xBF  NEW   書き終えた出力からコピー。長さの後に距離 (varint, 1 以上)
+ *   0xC0       FILL  長さ (varint) + 1 バイト
+ *   0xC1       END
+ *   OLD / NEW の長さ: 下位 5 ビット + 4 (31 なら varint を足す)
+ *
+ * 受信した行の区切りとは無関係に、バイト列を何回に分けて渡してもよい。
+ * 出力は put() で 1 バイトずつ、書き終えた出力は at() で読み返す。
+ */
+
+#ifndef FW_DELTA_H
+#define FW_DELTA_H
+
+#define FW_DELTA_MORE       0
+#define FW_DELTA_END        1
+#define FW_DELTA_ERR        (-1)
+
+typedef struct {
+    /* 呼び出し側が設定 */
+    int           (*put)(unsigned char c);      /* 0: 成功, -1: 書き込み失敗 / 長すぎる */
+    unsigned char (*at)(unsigned long pos);
+    const unsigned char *old;
+    unsigned long old_len;
+
+    /* 展開の状態 */
+    unsigned long out_len;
+    unsigned long old_pos;
+    unsigned long len;
+    unsigned long var;
+    int           shift;
+    unsigned char op;
+    unsigned char state;
+} fw_delta_t;
+
+/* put / at / old / old_len を設定してから呼ぶ */
+void fw_delta_init(fw_delta_t *d);
+/* FW_DELTA_MORE: 続きを待つ, FW_DELTA_END: END まで展開した, FW_DELTA_ERR: 形式違反 */
+int  fw_delta_feed(fw_delta_t *d, const unsigned char *p, unsigned long n);
+
+/* zlib と同じ CRC-32 (初期値 0, 続けて呼べる) */
+unsigned long fw_crc32(unsigned long crc, const unsigned char *p, unsigned long n);
+/* base64 → バイト列。長さ, 形式違反や max 超過なら -1 */
+int  fw_base64_decode(const char *src, int src_len, unsigned char *dst, int max);
+
+#endif /* FW_DELTA_H */
@@ -12,6 +12,13 @@
 /************************************************************************/
 
 #include "interrupt_handlers.h"
+#include "iodefine.h"
+#include "sci2_uart.h"
+#include "sd_spi.h"
+
+/* 弱参照: ドライバをリンクしない構成 (LED 点滅テスト) ではアドレス 0 になり呼ばない */
+#pragma weak sci2_eri_isr
+#pragma weak sd_spi_dma_isr
 
 
 /* INT_Exception(Supervisor Instruction)*/
@@ -234,7 +241,11 @@ void INT_Excep_ICU_GROUP5(void){ }
 void INT_Excep_ICU_GROUP6(void){ }
 
 /* ICU GROUP12*/
-void INT_Excep_ICU_GROUP12(void){ }
+void INT_Excep_ICU_GROUP12(void)
+{
+    /* レベル検出: SSR のエラーフラグを落とすまで要求が続くので、必ず sci2_eri_isr() で解除 */
+    if (IS(SCI2, ERI2) && sci2_eri_isr) sci2_eri_isr();
+}
 
 /* SCI12 SCIX0*/
 void INT_Excep_SCI12_SCIX0(void){ }
@@ -501,7 +512,11 @@ void INT_Excep_RIIC3_TXI3(void){ }
 void INT_Excep_RIIC3_TEI3(void){ }
 
 /* DMAC DMAC0I*/
-void INT_Excep_DMAC_DMAC0I(void){ }
+void INT_Excep_DMAC_DMAC0I(void)
+{
+    /* microSD のブロック送信完了 (sd_spi.c) */
+    if (sd_spi_dma_isr) sd_spi_dma_isr();
+}
 
 /* DMAC DMAC1I*/
 void INT_Excep_DMAC_DMAC1I(void){ }
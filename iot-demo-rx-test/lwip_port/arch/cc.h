@@ -0,0 +1,22 @@
+/*
+ * arch/cc.h - lwIP のコンパイラ / CPU 依存 (GCC for RX, リトルエンディアン)
+ */
+
+#ifndef LWIP_ARCH_CC_H
+#define LWIP_ARCH_CC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* newlib / glibc の <stdlib.h> が定義済みならそれを使う */
+#ifndef BYTE_ORDER
+#define BYTE_ORDER  LITTLE_ENDIAN
+#endif
+
+#define LWIP_RAND()                 ((u32_t)rand())
+
+/* 診断出力の先が無いので捨てる。アサートは FreeRTOS と同じく止める */
+#define LWIP_PLATFORM_DIAG(x)       do { } while (0)
+#define LWIP_PLATFORM_ASSERT(x)     do { for (;;) { } } while (0)
+
+#endif /* LWIP_ARCH_CC_H */
@@ -0,0 +1,26 @@
+/*
+ * arch/sys_arch.h - lwIP の OS 層の型 (FreeRTOS)
+ */
+
+#ifndef LWIP_ARCH_SYS_ARCH_H
+#define LWIP_ARCH_SYS_ARCH_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+typedef SemaphoreHandle_t sys_sem_t;
+typedef SemaphoreHandle_t sys_mutex_t;
+typedef QueueHandle_t     sys_mbox_t;
+typedef TaskHandle_t      sys_thread_t;
+typedef int               sys_prot_t;
+
+#define sys_sem_valid(s)            (*(s) != NULL)
+#define sys_sem_set_invalid(s)      (*(s) = NULL)
+#define sys_mutex_valid(m)          (*(m) != NULL)
+#define sys_mutex_set_invalid(m)    (*(m) = NULL)
+#define sys_mbox_valid(m)           (*(m) != NULL)
+#define sys_mbox_set_invalid(m)     (*(m) = NULL)
+
+#endif /* LWIP_ARCH_SYS_ARCH_H */
@@ -0,0 +1,72 @@
+/*
+ * lwipopts.h - lwIP 設定 (GR-SAKURA, RAM 128KB)
+ *
+ * 使うのは netconn API だけ (UDP 配信 1 本 + TCP コマンド 1 接続)。
+ * 受信はドライバのバッファをそのまま pbuf にする (LWIP_SUPPORT_CUSTOM_PBUF)。
+ */
+
+#ifndef LWIPOPTS_H
+#define LWIPOPTS_H
+
+#include "app_config.h"
+
+#define NO_SYS                      0
+#define SYS_LIGHTWEIGHT_PROT        1
+#define LWIP_TCPIP_CORE_LOCKING     1
+
+#define LWIP_NETCONN                1
+#define LWIP_SOCKET                 0
+#define LWIP_NETIF_API              0
+#define LWIP_SO_RCVTIMEO            1
+
+/* メモリ */
+#define MEM_ALIGNMENT               4
+#define MEM_SIZE                    (12 * 1024)
+#define MEMP_NUM_PBUF               8
+#define MEMP_NUM_UDP_PCB            2
+#define MEMP_NUM_TCP_PCB            2
+#define MEMP_NUM_TCP_PCB_LISTEN     1
+#define MEMP_NUM_TCP_SEG            16
+#define MEMP_NUM_NETBUF             4
+#define MEMP_NUM_NETCONN            4
+#define PBUF_POOL_SIZE              4       /* 受信はドライバのバッファなのでほぼ使わない */
+#define LWIP_SUPPORT_CUSTOM_PBUF    1
+
+/* プロトコル */
+#define LWIP_ARP                    1
+#define LWIP_ETHERNET               1
+#define LWIP_ICMP                   1
+#define LWIP_UDP                    1
+#define LWIP_TCP                    1
+#define LWIP_DHCP                   0
+#define LWIP_IGMP                   0
+#define LWIP_DNS                    0
+#define ETH_PAD_SIZE                0
+#define ARP_TABLE_SIZE              4
+
+#define TCP_MSS                     1460
+#define TCP_WND                     (2 * TCP_MSS)
+#define TCP_SND_BUF                 (2 * TCP_MSS)
+#define TCP_SND_QUEUELEN            (4 * TCP_SND_BUF / TCP_MSS)
+
+/* チェックサムはソフトウェア (ETHERC にオフロードは無い) */
+#define CHECKSUM_GEN_IP             1
+#define CHECKSUM_GEN_UDP            1
+#define CHECKSUM_GEN_TCP            1
+#define CHECKSUM_CHECK_IP           1
+#define CHECKSUM_CHECK_UDP          1
+#define CHECKSUM_CHECK_TCP          1
+
+/* スレッド / メールボックス */
+#define TCPIP_THREAD_NAME           "tcpip"
+#define TCPIP_THREAD_STACKSIZE      STACK_TCPIP
+#define TCPIP_THREAD_PRIO           PRIORITY_TCPIP
+#define TCPIP_MBOX_SIZE             8
+#define DEFAULT_UDP_RECVMBOX_SIZE   2
+#define DEFAULT_TCP_RECVMBOX_SIZE   4
+#define DEFAULT_ACCEPTMBOX_SIZE     1
+
+#define LWIP_NETIF_LINK_CALLBACK    1
+#define LWIP_STATS                  0
+
+#endif /* LWIPOPTS_H */
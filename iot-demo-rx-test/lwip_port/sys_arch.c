@@ -0,0 +1,159 @@
+/*
+ * sys_arch.c - lwIP の OS 層 (FreeRTOS のセマフォ / キュー / タスク)
+ *
+ * タイムアウトは ms (lwIP) と tick (FreeRTOS, 1ms) で同じ値。
+ * 0 は lwIP では「無期限」なので portMAX_DELAY に読み替える。
+ */
+
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "lwip/err.h"
+
+static TickType_t to_ticks(u32_t timeout)
+{
+    return timeout == 0 ? portMAX_DELAY : pdMS_TO_TICKS(timeout);
+}
+
+/* 待ち時間 [ms] を返す (SYS_ARCH_TIMEOUT でなければ) */
+static u32_t elapsed_ms(TickType_t start)
+{
+    return (u32_t)((xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+}
+
+void sys_init(void)
+{
+}
+
+u32_t sys_now(void)
+{
+    return (u32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
+/* ------------------------------------------------------------ 排他 */
+
+sys_prot_t sys_arch_protect(void)
+{
+    taskENTER_CRITICAL();
+    return 0;
+}
+
+void sys_arch_unprotect(sys_prot_t pval)
+{
+    (void)pval;
+    taskEXIT_CRITICAL();
+}
+
+/* ------------------------------------------------------------ セマフォ */
+
+err_t sys_sem_new(sys_sem_t *sem, u8_t count)
+{
+    *sem = xSemaphoreCreateCounting(0xFF, count);
+    return *sem != NULL ? ERR_OK : ERR_MEM;
+}
+
+void sys_sem_signal(sys_sem_t *sem)
+{
+    xSemaphoreGive(*sem);
+}
+
+u32_t sys_arch_sem_wait(sys_sem_t *sem, u32_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    if (xSemaphoreTake(*sem, to_ticks(timeout)) != pdTRUE) return SYS_ARCH_TIMEOUT;
+    return elapsed_ms(start);
+}
+
+void sys_sem_free(sys_sem_t *sem)
+{
+    vSemaphoreDelete(*sem);
+    *sem = NULL;
+}
+
+err_t sys_mutex_new(sys_mutex_t *mutex)
+{
+    *mutex = xSemaphoreCreateMutex();
+    return *mutex != NULL ? ERR_OK : ERR_MEM;
+}
+
+void sys_mutex_lock(sys_mutex_t *mutex)
+{
+    xSemaphoreTake(*mutex, portMAX_DELAY);
+}
+
+void sys_mutex_unlock(sys_mutex_t *mutex)
+{
+    xSemaphoreGive(*mutex);
+}
+
+void sys_mutex_free(sys_mutex_t *mutex)
+{
+    vSemaphoreDelete(*mutex);
+    *mutex = NULL;
+}
+
+/* ------------------------------------------------------------ メールボックス */
+
+err_t sys_mbox_new(sys_mbox_t *mbox, int size)
+{
+    *mbox = xQueueCreate((UBaseType_t)size, sizeof(void *));
+    return *mbox != NULL ? ERR_OK : ERR_MEM;
+}
+
+void sys_mbox_post(sys_mbox_t *mbox, void *msg)
+{
+    xQueueSend(*mbox, &msg, portMAX_DELAY);
+}
+
+err_t sys_mbox_trypost(sys_mbox_t *mbox, void *msg)
+{
+    return xQueueSend(*mbox, &msg, 0) == pdTRUE ? ERR_OK : ERR_MEM;
+}
+
+err_t sys_mbox_trypost_fromisr(sys_mbox_t *mbox, void *msg)
+{
+    BaseType_t woken = pdFALSE;
+
+    if (xQueueSendFromISR(*mbox, &msg, &woken) != pdTRUE) return ERR_MEM;
+    portYIELD_FROM_ISR(woken);
+    return ERR_OK;
+}
+
+u32_t sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+    void *dummy;
+
+    if (msg == NULL) msg = &dummy;
+    if (xQueueReceive(*mbox, msg, to_ticks(timeout)) != pdTRUE) {
+        *msg = NULL;
+        return SYS_ARCH_TIMEOUT;
+    }
+    return elapsed_ms(start);
+}
+
+u32_t sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg)
+{
+    void *dummy;
+
+    if (msg == NULL) msg = &dummy;
+    if (xQueueReceive(*mbox, msg, 0) != pdTRUE) return SYS_MBOX_EMPTY;
+    return 0;
+}
+
+void sys_mbox_free(sys_mbox_t *mbox)
+{
+    vQueueDelete(*mbox);
+    *mbox = NULL;
+}
+
+/* ------------------------------------------------------------ スレッド */
+
+sys_thread_t sys_thread_new(const char *name, lwip_thread_fn thread, void *arg,
+                            int stacksize, int prio)
+{
+    TaskHandle_t handle = NULL;
+
+    xTaskCreate(thread, name, (uint16_t)stacksize, arg, (UBaseType_t)prio, &handle);
+    return handle;
+}
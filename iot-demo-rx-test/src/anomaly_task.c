@@ -10,6 +10,8 @@
 #include "anomaly_task.h"
 #include "json_builder.h"
 #include "sci2_uart.h"
+#include "net_task.h"
+#include "sd_log.h"
 
 #define TEMP_RATE_LIMIT     500     /* 5.00℃/s */
 #define LID_OPEN_THRESHOLD  -300    /* -3.00℃/s */
@@ -47,6 +49,8 @@ void anomaly_task(void *pvParameters)
                 g_emergency_stop = 1;
                 json_build_status(&jb, "UART_TIMEOUT:ESTOP");
                 sci2_puts(jb.buf);
+                net_publish(&jb);
+                sdlog_status("UART_TIMEOUT:ESTOP");
             }
         }
 
@@ -57,11 +61,15 @@ void anomaly_task(void *pvParameters)
             if (rate > TEMP_RATE_LIMIT) {
                 json_build_status(&jb, "TEMP_RISE_FAST");
                 sci2_puts(jb.buf);
+                net_publish(&jb);
+                sdlog_status("TEMP_RISE_FAST");
             }
 
             if (rate < LID_OPEN_THRESHOLD) {
                 json_build_status(&jb, "LID_OPEN_DETECT");
                 sci2_puts(jb.buf);
+                net_publish(&jb);
+                sdlog_status("LID_OPEN_DETECT");
             }
         }
 
@@ -10,12 +10,26 @@
 #include "queue.h"
 #include "semphr.h"
 
+/* Ethernet (net_task.h)。1 にするには lwIP が要る */
+#ifndef USE_ETHERNET
+#define USE_ETHERNET        0
+#endif
+
+/* microSD へのブロックログ (sd_log.h) */
+#ifndef USE_SDLOG
+#define USE_SDLOG           0
+#endif
+
 /* タスク優先度 */
 #define PRIORITY_WDT        4
 #define PRIORITY_UART       3
 #define PRIORITY_PID        2
 #define PRIORITY_ANOMALY    2
 #define PRIORITY_STATUS     1
+#define PRIORITY_ETH_RX     3       /* ethernetif: 受信 → lwIP */
+#define PRIORITY_TCPIP      3       /* lwIP の tcpip スレッド */
+#define PRIORITY_NET        2       /* UDP 配信 / TCP コマンド */
+#define PRIORITY_SDLOG      1       /* microSD への書き出し (一番低い) */
 
 /* タスクスタックサイズ (ワード単位) */
 #define STACK_UART          512
@@ -23,6 +37,10 @@
 #define STACK_ANOMALY       256
 #define STACK_WDT           128
 #define STACK_STATUS        256
+#define STACK_ETH_RX        256
+#define STACK_TCPIP         512
+#define STACK_NET           384
+#define STACK_SDLOG         256
 
 /* PID デフォルト値 (×100 固定小数点) */
 #define DEFAULT_KP          300
@@ -0,0 +1,105 @@
+/*
+ * baud_neg.c - ESP32 とのボーレート交渉 (手順は baud_neg.h)
+ *
+ * uart_task からだけ呼ばれるので状態はロック不要。
+ */
+
+#include "app_config.h"
+#include "baud_neg.h"
+#include "sci2_uart.h"
+#include "json_builder.h"
+#include <string.h>
+
+static unsigned long prev_baud = 0;     /* 仮採用中: 戻り先 (0 = 確定済み) */
+static TickType_t    probe_start;
+static int           test_ok;
+static unsigned long test_err_base;
+
+static TickType_t    last_ok;           /* 最後に正しい行を受け取った時刻 */
+static TickType_t    err_window_start;
+static unsigned long err_base;
+
+static void reset_error_window(void)
+{
+    err_window_start = xTaskGetTickCount();
+    err_base = sci2_rx_errors();
+}
+
+static void revert(unsigned long baud)
+{
+    sci2_set_baud(baud);
+    prev_baud = 0;
+    last_ok = xTaskGetTickCount();
+    reset_error_window();
+}
+
+void baud_neg_handle(const json_parsed_t *msg)
+{
+    json_buf_t jb;
+
+    if (strcmp(msg->op, "req") == 0) {
+        unsigned long cur = sci2_get_baud();
+        unsigned long actual = sci2_baud_actual(msg->baud, BAUD_TOL_PPM);
+
+        if (actual == 0) {
+            json_build_baud(&jb, "nak", cur);
+            sci2_puts(jb.buf);
+            return;
+        }
+        /* ack は今の速度で送り、送り終えてから切り替える */
+        json_build_baud(&jb, "ack", actual);
+        sci2_puts(jb.buf);
+        sci2_set_baud(actual);
+
+        if (prev_baud == 0) prev_baud = cur;   /* 仮採用中の再要求でも戻り先は最初の値 */
+        probe_start = xTaskGetTickCount();
+        test_ok = 0;
+        test_err_base = sci2_rx_errors();
+    } else if (strcmp(msg->op, "test") == 0) {
+        if (prev_baud == 0) return;
+        if (strcmp(msg->pat, BAUD_TEST_PATTERN) == 0) test_ok++;
+        if (msg->seq == BAUD_TEST_FRAMES - 1) {
+            json_build_baud_result(&jb, sci2_get_baud(), test_ok,
+                                   (long)(sci2_rx_errors() - test_err_base));
+            sci2_puts(jb.buf);
+        }
+    } else if (strcmp(msg->op, "commit") == 0) {
+        if (prev_baud == 0) return;
+        prev_baud = 0;
+        reset_error_window();
+    }
+}
+
+void baud_neg_rx_ok(void)
+{
+    last_ok = xTaskGetTickCount();
+}
+
+unsigned long baud_neg_timeout_ms(void)
+{
+    TickType_t elapsed;
+
+    if (prev_baud == 0) return SENSOR_TIMEOUT_MS;
+    elapsed = xTaskGetTickCount() - probe_start;
+    if (elapsed >= pdMS_TO_TICKS(BAUD_PROBE_MS)) return 1;
+    return (unsigned long)(pdMS_TO_TICKS(BAUD_PROBE_MS) - elapsed) * portTICK_PERIOD_MS;
+}
+
+void baud_neg_poll(void)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    if (prev_baud != 0) {
+        if (now - probe_start >= pdMS_TO_TICKS(BAUD_PROBE_MS)) revert(prev_baud);
+        return;
+    }
+    if (sci2_get_baud() == sci2_baud_actual(SCI2_BAUD_BASE, BAUD_TOL_PPM)) return;
+
+    /* 確定後: エラー過多 / 途絶なら起動時の速度へ */
+    if (sci2_rx_errors() - err_base > BAUD_ERR_MAX ||
+        now - last_ok >= pdMS_TO_TICKS(SENSOR_TIMEOUT_MS)) {
+        revert(SCI2_BAUD_BASE);
+        return;
+    }
+    if (now - err_window_start >= pdMS_TO_TICKS(BAUD_ERR_WINDOW_MS)) reset_error_window();
+}
@@ -0,0 +1,42 @@
+/*
+ * baud_neg.h - ESP32 とのボーレート交渉 (uart_task から呼ぶ)
+ *
+ * ESP32 が主導し、1 候補ずつ試す:
+ *   ESP32 → {"type":"baud","op":"req","baud":1000000}
+ *   RX    → {"type":"baud","op":"ack","baud":1041667}  PCLKB で作れる実際の値
+ *           誤差が BAUD_TOL_PPM を超える要求には {"type":"baud","op":"nak","baud":<現在>}
+ *   ack の送信後、両者とも新しい速度へ (RX は仮採用)
+ *   ESP32 → {"type":"baud","op":"test","seq":0,"pat":"<BAUD_TEST_PATTERN>"} × BAUD_TEST_FRAMES
+ *   RX    → {"type":"baud","op":"result","baud":..,"ok":8,"err":0}
+ *   ESP32 → {"type":"baud","op":"commit"}                全数一致かつエラー 0 のとき
+ *   BAUD_PROBE_MS 以内に commit が来なければ RX は元の速度へ戻る
+ *
+ * 確定後も、受信エラーが BAUD_ERR_WINDOW_MS に BAUD_ERR_MAX 回を超えるか
+ * 正しい行が SENSOR_TIMEOUT_MS 届かなければ SCI2_BAUD_BASE へ戻る
+ * (ESP32 側もリンク途絶で同じ速度へ戻るので、そこで再び揃う)。
+ */
+
+#ifndef BAUD_NEG_H
+#define BAUD_NEG_H
+
+#include "json_parser.h"
+
+#define BAUD_TOL_PPM        50000       /* 要求との差 5% まで */
+#define BAUD_TEST_FRAMES    8
+#define BAUD_PROBE_MS       1000
+#define BAUD_ERR_MAX        4
+#define BAUD_ERR_WINDOW_MS  10000
+
+/* ESP32 (baud_link.h) と同じ文字列。0x55 の交互ビット, 0x40 / 0x7E / 0x21, 英数字 */
+#define BAUD_TEST_PATTERN   "UUUUUUUU@@@@~~~~!!!!0123456789ABCDEFGHIJKLMNOPQRSTUV"
+
+/* "baud" 行を処理 (応答は sci2 へ送る) */
+void baud_neg_handle(const json_parsed_t *msg);
+/* 正しく解析できた行を受け取ったとき */
+void baud_neg_rx_ok(void);
+/* 受信待ちの上限 [ms] (仮採用中は期限まで) */
+unsigned long baud_neg_timeout_ms(void);
+/* 受信待ちのたびに呼ぶ: 仮採用の期限切れ / エラー過多 / 途絶で元へ戻す */
+void baud_neg_poll(void);
+
+#endif /* BAUD_NEG_H */
@@ -0,0 +1,36 @@
+/*
+ * cmd_exec.c - コマンド適用 (UART / Ethernet の TCP 共通)
+ */
+
+#include "app_config.h"
+#include "cmd_exec.h"
+#include "fw_update.h"
+#include <string.h>
+
+int cmd_exec(const json_parsed_t *msg)
+{
+    if (strcmp(msg->cmd, "set_pid") == 0) {
+        if (xSemaphoreTake(g_data_mutex, pdMS_TO_TICKS(50)) == pdTRUE) {
+            if (msg->kp > 0) g_kp = msg->kp;
+            if (msg->ki > 0) g_ki = msg->ki;
+            if (msg->kd > 0) g_kd = msg->kd;
+            xSemaphoreGive(g_data_mutex);
+        }
+    } else if (strcmp(msg->cmd, "set_target") == 0) {
+        if (xSemaphoreTake(g_data_mutex, pdMS_TO_TICKS(50)) == pdTRUE) {
+            if (msg->sp_x100 > 0) g_setpoint = msg->sp_x100;
+            xSemaphoreGive(g_data_mutex);
+        }
+    } else if (strcmp(msg->cmd, "stop") == 0) {
+        g_emergency_stop = 1;
+    } else if (strcmp(msg->cmd, "start") == 0) {
+        g_emergency_stop = 0;
+#if FW_UPDATE
+    } else if (strcmp(msg->cmd, "fw_update") == 0) {
+        fw_update_request();    /* ack の後、wdt_task がリセットしてブートローダーへ */
+#endif
+    } else {
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,14 @@
+/*
+ * cmd_exec.h - コマンド適用 (UART / Ethernet の TCP 共通)
+ */
+
+#ifndef CMD_EXEC_H
+#define CMD_EXEC_H
+
+#include "json_parser.h"
+
+/* {"type":"cmd",...} を共有データへ反映する
+ * 戻り値: 1 = 適用, 0 = 未知のコマンド (ack の "ok") */
+int cmd_exec(const json_parsed_t *msg);
+
+#endif /* CMD_EXEC_H */
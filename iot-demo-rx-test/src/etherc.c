@@ -0,0 +1,472 @@
+/*
+ * etherc.c - ETHERC / EDMAC ドライバ (RMII, ゼロコピー, 手順は etherc.h)
+ *
+ * GR-SAKURA の配線 (RMII):
+ *   P71 = ET_MDIO, P72 = ET_MDC
+ *   P74 = RMII0_RXD1, P75 = RMII0_RXD0, P76 = REF50CK0, P77 = RMII0_RX_ER
+ *   P80 = RMII0_TXD_EN, P81 = RMII0_TXD0, P82 = RMII0_TXD1, P83 = RMII0_CRS_DV
+ * 記述子はリトルエンディアン (EDMR.DE=1), 16 バイト (EDMR.DL=0)。
+ * RX63N にデータキャッシュは無いので、DMA との間でキャッシュ操作は要らない。
+ */
+
+#include "iodefine.h"
+#include "etherc.h"
+#include "task.h"
+#include "semphr.h"
+#include <string.h>
+
+/* 記述子 (RD0-RD3 / TD0-TD3)。4 語目は EDMAC が見ないのでパディング */
+typedef struct {
+    volatile unsigned long  status;
+    volatile unsigned short size;       /* RD1 下位: 受信フレーム長 (RFL) */
+    volatile unsigned short bufsize;    /* RD1 / TD1 上位: バッファ長 (RBL / TBL) */
+    unsigned char          *buf;
+    unsigned long           pad;
+} eth_desc_t;
+
+#define DESC_ACT    0x80000000UL    /* EDMAC が使う */
+#define DESC_DLE    0x40000000UL    /* リングの最後 */
+#define DESC_FP1    0x20000000UL    /* フレームの先頭 */
+#define DESC_FP0    0x10000000UL    /* フレームの最後 */
+#define DESC_FE     0x08000000UL    /* 受信エラー (RFS のどれか) */
+
+/* EESR / EESIPR */
+#define EESR_RDE    (1UL << 17)
+#define EESR_FR     (1UL << 18)
+#define EESR_TC     (1UL << 21)
+#define EESR_ALL    0x47FF0F9FUL
+
+/* ECMR */
+#define ECMR_DM     (1UL << 1)
+#define ECMR_RTM    (1UL << 2)
+#define ECMR_TE     (1UL << 5)
+#define ECMR_RE     (1UL << 6)
+
+/* PHY (IEEE 802.3 22 条の標準レジスタだけを使う) */
+#define PHY_BMCR        0
+#define PHY_BMSR        1
+#define PHY_ANAR        4
+#define PHY_ANLPAR      5
+#define BMCR_RESET      0x8000
+#define BMCR_ANEN       0x1000
+#define BMCR_ANRESTART  0x0200
+#define BMSR_LINK       0x0004
+#define BMSR_ANDONE     0x0020
+#define ANAR_100FD      0x0100
+#define ANAR_100HD      0x0080
+#define ANAR_10FD       0x0040
+#define ANAR_ALL        0x01E1      /* 100/10 全二重・半二重 + IEEE 802.3 */
+
+/* PIR */
+#define PIR_MDC     0x01
+#define PIR_MMD     0x02            /* 1 = MDIO を出力 */
+#define PIR_MDO     0x04
+#define PIR_MDI     0x08
+
+static eth_desc_t rx_desc[ETH_RX_DESC] __attribute__((aligned(16)));
+static eth_desc_t tx_desc[ETH_TX_DESC] __attribute__((aligned(16)));
+
+static unsigned char rx_pool[ETH_RX_BUFS][ETH_BUF_SIZE] __attribute__((aligned(32)));
+static unsigned char rx_free[ETH_RX_BUFS];      /* 空きバッファ番号のスタック */
+static int           rx_free_n;
+static unsigned int  rx_next;       /* 次に受信完了を見る記述子 */
+static unsigned int  rx_fill;       /* 次にバッファを付ける記述子 */
+static unsigned int  rx_empty;      /* バッファの無い記述子 ([rx_fill, rx_next) に並ぶ) */
+
+static void         *tx_token[ETH_TX_DESC];
+static unsigned int  tx_head;       /* 次に使う記述子 */
+static unsigned int  tx_tail;       /* 送信完了を待っている最古の記述子 */
+static unsigned int  tx_used;
+
+static const unsigned char zero_pad[ETH_FRAME_MIN];
+
+static SemaphoreHandle_t irq_sem = NULL;
+static int               phy_addr = -1;
+static etherc_stats_t    stats;
+
+/* ------------------------------------------------------------ PHY (MII 管理) */
+
+/* MDC は 2.5MHz 以下 (PCLK 50MHz で 1 区間 200ns 以上) */
+static void mii_wait(void)
+{
+    volatile int i;
+    for (i = 0; i < 10; i++) {
+        __asm("nop");
+    }
+}
+
+static void mii_write_bit(int b)
+{
+    unsigned long v = PIR_MMD | (b ? PIR_MDO : 0);
+
+    ETHERC.PIR.LONG = v;
+    mii_wait();
+    ETHERC.PIR.LONG = v | PIR_MDC;
+    mii_wait();
+    ETHERC.PIR.LONG = v;
+    mii_wait();
+}
+
+static int mii_read_bit(void)
+{
+    int b;
+
+    ETHERC.PIR.LONG = 0;
+    mii_wait();
+    ETHERC.PIR.LONG = PIR_MDC;
+    mii_wait();
+    b = (ETHERC.PIR.LONG & PIR_MDI) != 0;
+    ETHERC.PIR.LONG = 0;
+    mii_wait();
+    return b;
+}
+
+static void mii_write_bits(unsigned long v, int n)
+{
+    while (n-- > 0) mii_write_bit((v >> n) & 1);
+}
+
+/* プリアンブル 32 / ST 01 / OP / PHYAD / REGAD */
+static void mii_header(int op, int addr, int reg)
+{
+    mii_write_bits(0xFFFFFFFFUL, 32);
+    mii_write_bits(0x1, 2);
+    mii_write_bits((unsigned long)op, 2);
+    mii_write_bits((unsigned long)addr, 5);
+    mii_write_bits((unsigned long)reg, 5);
+}
+
+static unsigned short phy_read_at(int addr, int reg)
+{
+    unsigned short v = 0;
+    int i;
+
+    mii_header(0x2, addr, reg);
+    mii_read_bit();                 /* TA: Z */
+    mii_read_bit();                 /* TA: 0 (PHY が駆動) */
+    for (i = 0; i < 16; i++) {
+        v = (unsigned short)((v << 1) | mii_read_bit());
+    }
+    mii_read_bit();                 /* アイドル */
+    return v;
+}
+
+static void phy_write(int reg, unsigned short v)
+{
+    mii_header(0x1, phy_addr, reg);
+    mii_write_bits(0x2, 2);         /* TA: 10 */
+    mii_write_bits(v, 16);
+    mii_read_bit();                 /* 解放 */
+}
+
+static unsigned short phy_read(int reg)
+{
+    return phy_read_at(phy_addr, reg);
+}
+
+/* PHYAD ピンの設定に依らないよう、BMSR が読めた最初のアドレスを使う */
+static int phy_probe(void)
+{
+    int a;
+
+    for (a = 0; a < 32; a++) {
+        unsigned short v = phy_read_at(a, PHY_BMSR);
+        if (v != 0x0000 && v != 0xFFFF) return a;
+    }
+    return -1;
+}
+
+/* ------------------------------------------------------------ 記述子 */
+
+/* バッファの無い記述子に空きバッファを付けて EDMAC に渡す (クリティカルセクション内で) */
+static void rx_refill(void)
+{
+    int armed = 0;
+
+    while (rx_empty > 0 && rx_free_n > 0) {
+        eth_desc_t *d = &rx_desc[rx_fill];
+
+        d->buf = rx_pool[rx_free[--rx_free_n]];
+        d->bufsize = ETH_BUF_SIZE;
+        d->size = 0;
+        d->status = DESC_ACT | (rx_fill == ETH_RX_DESC - 1 ? DESC_DLE : 0);
+        rx_fill = (rx_fill + 1) % ETH_RX_DESC;
+        rx_empty--;
+        armed = 1;
+    }
+    /* RDE で止まっていたら再開 */
+    if (armed && EDMAC.EDRRR.LONG == 0) EDMAC.EDRRR.LONG = 1;
+}
+
+static void desc_init(void)
+{
+    int i;
+
+    memset(rx_desc, 0, sizeof(rx_desc));
+    memset(tx_desc, 0, sizeof(tx_desc));
+
+    rx_free_n = 0;
+    for (i = ETH_RX_BUFS - 1; i >= 0; i--) rx_free[rx_free_n++] = (unsigned char)i;
+    rx_next = rx_fill = 0;
+    rx_empty = ETH_RX_DESC;
+    rx_refill();
+
+    tx_desc[ETH_TX_DESC - 1].status = DESC_DLE;
+    tx_head = tx_tail = tx_used = 0;
+}
+
+/* ------------------------------------------------------------ 初期化 */
+
+static void pins_init(void)
+{
+    MPC.PWPR.BIT.B0WI = 0;
+    MPC.PWPR.BIT.PFSWE = 1;
+    MPC.PFENET.BIT.PHYMODE = 0;     /* RMII */
+    MPC.P71PFS.BIT.PSEL = 0x11;     /* ET_MDIO */
+    MPC.P72PFS.BIT.PSEL = 0x11;     /* ET_MDC */
+    MPC.P74PFS.BIT.PSEL = 0x12;
+    MPC.P75PFS.BIT.PSEL = 0x12;
+    MPC.P76PFS.BIT.PSEL = 0x12;
+    MPC.P77PFS.BIT.PSEL = 0x12;
+    MPC.P80PFS.BIT.PSEL = 0x12;
+    MPC.P81PFS.BIT.PSEL = 0x12;
+    MPC.P82PFS.BIT.PSEL = 0x12;
+    MPC.P83PFS.BIT.PSEL = 0x12;
+    MPC.PWPR.BIT.PFSWE = 0;
+    MPC.PWPR.BIT.B0WI = 1;
+
+    PORT7.PMR.BYTE |= 0xF6;         /* P71, P72, P74-P77 */
+    PORT8.PMR.BYTE |= 0x0F;         /* P80-P83 */
+}
+
+int etherc_init(const unsigned char mac[6])
+{
+    volatile int i;
+
+    irq_sem = xSemaphoreCreateBinary();
+
+    /* モジュールストップ解除 (EDMAC と ETHERC は MSTPB15 で共通) */
+    SYSTEM.PRCR.WORD = 0xA502;
+    SYSTEM.MSTPCRB.BIT.MSTPB15 = 0;
+    SYSTEM.PRCR.WORD = 0xA500;
+
+    pins_init();
+
+    /* ソフトウェアリセット (ETHERC / EDMAC とも) */
+    EDMAC.EDMR.BIT.SWR = 1;
+    for (i = 0; i < 1000; i++) {
+        __asm("nop");
+    }
+
+    phy_addr = phy_probe();
+    if (phy_addr < 0) return -1;
+    phy_write(PHY_BMCR, BMCR_RESET);
+    for (i = 0; i < 1000 && (phy_read(PHY_BMCR) & BMCR_RESET); i++) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    phy_write(PHY_ANAR, ANAR_ALL);
+    phy_write(PHY_BMCR, BMCR_ANEN | BMCR_ANRESTART);
+
+    /* ETHERC: 最大 1518 バイト, IPG 96 ビット時間 */
+    ETHERC.ECSR.LONG = 0x00000037;  /* 状態をクリア */
+    ETHERC.ECSIPR.LONG = 0;
+    ETHERC.RFLR.LONG = 1518;
+    ETHERC.IPGR.LONG = 0x00000014;
+    ETHERC.MAHR = ((unsigned long)mac[0] << 24) | ((unsigned long)mac[1] << 16) |
+                  ((unsigned long)mac[2] << 8) | mac[3];
+    ETHERC.MALR.LONG = ((unsigned long)mac[4] << 8) | mac[5];
+
+    /* EDMAC: リトルエンディアン記述子, 16 バイト */
+    desc_init();
+    EDMAC.EESR.LONG = EESR_ALL;
+    EDMAC.EDMR.LONG = 0x00000040;   /* DE=1, DL=00 */
+    EDMAC.TRSCER.LONG = 0;          /* 受信エラーも EESR に出さず記述子で見る */
+    EDMAC.TFTR.LONG = 0;            /* ストア & フォワード */
+    EDMAC.FDR.LONG = 0x00000707;    /* 送受信 FIFO 2048 バイト */
+    EDMAC.RMCR.LONG = 0x00000001;   /* 1 フレームごとに止めず受信し続ける */
+    EDMAC.RDLAR = rx_desc;
+    EDMAC.TDLAR = tx_desc;
+    EDMAC.EESIPR.LONG = EESR_FR | EESR_TC | EESR_RDE;
+
+    /* EINT (ベクタ32) */
+    ICU.IPR[32].BIT.IPR = 2;        /* 優先度2 (configMAX_SYSCALL_INTERRUPT_PRIORITY以下) */
+    ICU.IR[32].BIT.IR = 0;
+    ICU.IER[0x04].BIT.IEN0 = 1;     /* IER[32/8].IEN[32%8] */
+
+    return 0;
+}
+
+int etherc_link_poll(void)
+{
+    unsigned short bmsr, lpa;
+    unsigned long ecmr;
+
+    /* リンク断はラッチされるので 2 回読む */
+    (void)phy_read(PHY_BMSR);
+    bmsr = phy_read(PHY_BMSR);
+
+    if (!(bmsr & BMSR_LINK) || !(bmsr & BMSR_ANDONE)) {
+        if (stats.link) {
+            ETHERC.ECMR.LONG = 0;
+            stats.link = 0;
+        }
+        return 0;
+    }
+    if (stats.link) return 1;
+
+    /* 両者が広告した中で最上位の組み合わせ */
+    lpa = phy_read(PHY_ANAR) & phy_read(PHY_ANLPAR);
+    ecmr = ECMR_RE | ECMR_TE;
+    if (lpa & (ANAR_100FD | ANAR_100HD)) {
+        ecmr |= ECMR_RTM;
+        stats.link = 100;
+        stats.full_duplex = (lpa & ANAR_100FD) != 0;
+    } else {
+        stats.link = 10;
+        stats.full_duplex = (lpa & ANAR_10FD) != 0;
+    }
+    if (stats.full_duplex) ecmr |= ECMR_DM;
+    ETHERC.ECMR.LONG = ecmr;
+    EDMAC.EDRRR.LONG = 1;
+    return 1;
+}
+
+int etherc_wait(TickType_t ticks)
+{
+    return xSemaphoreTake(irq_sem, ticks) == pdTRUE;
+}
+
+/* ------------------------------------------------------------ 受信 */
+
+int etherc_rx_take(unsigned int *len)
+{
+    int idx = -1;
+
+    taskENTER_CRITICAL();
+    while (rx_empty < ETH_RX_DESC) {
+        eth_desc_t *d = &rx_desc[rx_next];
+        unsigned long st = d->status;
+
+        int b;
+
+        if (st & DESC_ACT) break;
+
+        /* 記述子からバッファを外す。付け直しはリングの順に rx_refill() で */
+        b = (int)((d->buf - rx_pool[0]) / ETH_BUF_SIZE);
+        d->buf = NULL;
+        rx_next = (rx_next + 1) % ETH_RX_DESC;
+        rx_empty++;
+
+        /* バッファは 1 フレームより大きいので、分割されたものは異常として捨てる */
+        if ((st & DESC_FE) || (st & (DESC_FP1 | DESC_FP0)) != (DESC_FP1 | DESC_FP0)) {
+            stats.rx_errors++;
+            rx_free[rx_free_n++] = (unsigned char)b;
+            rx_refill();
+            continue;
+        }
+
+        /* バッファごと上位へ */
+        idx = b;
+        *len = d->size;
+        stats.rx_frames++;
+        rx_refill();
+        break;
+    }
+    taskEXIT_CRITICAL();
+    return idx;
+}
+
+unsigned char *etherc_rx_buf(int idx)
+{
+    return rx_pool[idx];
+}
+
+void etherc_rx_release(int idx)
+{
+    taskENTER_CRITICAL();
+    rx_free[rx_free_n++] = (unsigned char)idx;
+    rx_refill();
+    taskEXIT_CRITICAL();
+}
+
+/* ------------------------------------------------------------ 送信 */
+
+int etherc_tx(const etherc_seg_t *seg, int n, void *token)
+{
+    unsigned int total = 0, need, i, k;
+    int j;
+
+    for (j = 0; j < n; j++) total += seg[j].len;
+    need = (unsigned int)n + (total < ETH_FRAME_MIN ? 1 : 0);
+
+    taskENTER_CRITICAL();
+    if (need == 0 || tx_used + need > ETH_TX_DESC) {
+        stats.tx_full++;
+        taskEXIT_CRITICAL();
+        return -1;
+    }
+
+    /* 先頭の TACT を最後に立てて、途中までのフレームを EDMAC に見せない */
+    for (k = need; k-- > 0; ) {
+        eth_desc_t *d = &tx_desc[(tx_head + k) % ETH_TX_DESC];
+        unsigned long st = d->status & DESC_DLE;
+
+        if (k < (unsigned int)n) {
+            d->buf = (unsigned char *)seg[k].data;
+            d->bufsize = (unsigned short)seg[k].len;
+        } else {
+            d->buf = (unsigned char *)zero_pad;
+            d->bufsize = (unsigned short)(ETH_FRAME_MIN - total);
+        }
+        if (k == 0) st |= DESC_FP1;
+        if (k == need - 1) st |= DESC_FP0;
+        d->status = st | DESC_ACT;
+    }
+    for (i = 0; i < need; i++) {
+        tx_token[(tx_head + i) % ETH_TX_DESC] = (i == need - 1) ? token : NULL;
+    }
+    tx_head = (tx_head + need) % ETH_TX_DESC;
+    tx_used += need;
+    stats.tx_frames++;
+    if (EDMAC.EDTRR.LONG == 0) EDMAC.EDTRR.LONG = 1;
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+void *etherc_tx_done(void)
+{
+    void *token = NULL;
+
+    taskENTER_CRITICAL();
+    while (tx_used > 0 && !(tx_desc[tx_tail].status & DESC_ACT)) {
+        token = tx_token[tx_tail];
+        tx_token[tx_tail] = NULL;
+        tx_tail = (tx_tail + 1) % ETH_TX_DESC;
+        tx_used--;
+        if (token != NULL) break;
+    }
+    taskEXIT_CRITICAL();
+    return token;
+}
+
+void etherc_get_stats(etherc_stats_t *out)
+{
+    taskENTER_CRITICAL();
+    *out = stats;
+    taskEXIT_CRITICAL();
+}
+
+/* ------------------------------------------------------------ 割り込み */
+
+void etherc_eint_isr(void)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    unsigned long eesr = EDMAC.EESR.LONG;
+
+    EDMAC.EESR.LONG = eesr;         /* 1 書き込みでクリア */
+    if (eesr & EESR_RDE) stats.rx_nobuf++;
+    if ((eesr & (EESR_FR | EESR_TC | EESR_RDE)) && irq_sem != NULL) {
+        xSemaphoreGiveFromISR(irq_sem, &xHigherPriorityTaskWoken);
+    }
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
@@ -0,0 +1,71 @@
+/*
+ * etherc.h - ETHERC / EDMAC ドライバ (RMII, ゼロコピー)
+ *
+ * 受信: 記述子にはプールのバッファを付けておき、届いたフレームはバッファごと
+ *       上位へ渡す (コピーなし)。上位が etherc_rx_release() で返すまで
+ *       そのバッファは使わず、記述子には別のプールのバッファを付け直す。
+ *       プールが空なら記述子は空のままで、EDMAC は受信を止めて待つ (RDE)。
+ * 送信: 上位のバッファを記述子に直接指す。EDMAC が送り終えた (TACT=0) ものから
+ *       etherc_tx_done() で token を返すので、上位はそこでバッファを解放する。
+ *
+ * ISR とタスクで共有する状態はクリティカルセクションで守る。
+ * lwIP には依存しない (ethernetif.c がつなぐ)。
+ */
+
+#ifndef ETHERC_H
+#define ETHERC_H
+
+#include "FreeRTOS.h"
+
+#define ETH_BUF_SIZE    1536    /* 受信バッファ (32 の倍数, 1518 + 余裕) */
+#define ETH_RX_DESC     4
+#define ETH_RX_BUFS     10      /* 記述子 + 上位が持っている分 */
+#define ETH_TX_DESC     8
+#define ETH_FRAME_MIN   60      /* ETHERC はパディングしないので足りなければ 0 を足す */
+
+/* 送信するフレームの断片 (lwIP の pbuf 1 つ分) */
+typedef struct {
+    const void  *data;
+    unsigned int len;
+} etherc_seg_t;
+
+typedef struct {
+    unsigned long rx_frames;
+    unsigned long rx_errors;    /* CRC / 長さ / 分割フレーム */
+    unsigned long rx_nobuf;     /* 記述子が空で受信できなかった回数 (RDE) */
+    unsigned long tx_frames;
+    unsigned long tx_full;      /* 記述子不足で断った回数 */
+    int           link;         /* 0 = 切断, 10 / 100 = Mbps */
+    int           full_duplex;
+} etherc_stats_t;
+
+/* MAC アドレスを設定し、PHY に自動ネゴシエーションを始めさせる
+ * 戻り値: 0 = OK, -1 = PHY が応答しない */
+int  etherc_init(const unsigned char mac[6]);
+
+/* PHY のリンクを見て ETHERC の速度 / 二重を合わせる (1 秒程度ごとに呼ぶ)
+ * 戻り値: 1 = リンク中 */
+int  etherc_link_poll(void);
+
+/* 受信完了 / 送信完了の割り込みを待つ。戻り値: 1 = 割り込みあり, 0 = タイムアウト */
+int  etherc_wait(TickType_t ticks);
+
+/* 受信済みフレームを 1 つ取り出す。戻り値はバッファ番号 (-1 = なし)
+ * *len はフレーム長。中身は etherc_rx_buf(idx) */
+int  etherc_rx_take(unsigned int *len);
+unsigned char *etherc_rx_buf(int idx);
+void etherc_rx_release(int idx);
+
+/* seg[0..n-1] をつないで 1 フレームとして送る。token は送信完了で返る
+ * 戻り値: 0 = OK, -1 = 記述子が足りない (何もしていない) */
+int  etherc_tx(const etherc_seg_t *seg, int n, void *token);
+
+/* 送信が終わったフレームの token を 1 つ返す (なければ NULL) */
+void *etherc_tx_done(void);
+
+void etherc_get_stats(etherc_stats_t *out);
+
+/* 割り込みハンドラ (inthandler.c の INT_Excep_ETHER_EINT から呼ばれる) */
+void etherc_eint_isr(void);
+
+#endif /* ETHERC_H */
@@ -0,0 +1,172 @@
+/*
+ * ethernetif.c - lwIP の netif と ETHERC ドライバをつなぐ (コピーしない)
+ *
+ * 受信: ドライバのバッファを pbuf_custom で包んで tcpip スレッドへ渡す。
+ *       lwIP が pbuf を解放したとき (custom_free_function) にドライバへ返す。
+ * 送信: pbuf のチェインをそのまま記述子に並べ、参照を 1 つ持っておく。
+ *       EDMAC が送り終えたら受信タスクが pbuf_free する。
+ *       呼び出し側が使い回すバッファ (PBUF_REF) と、記述子に
+ *       収まらないほど細切れのチェインだけは 1 枚の PBUF_RAM に複製する。
+ */
+
+#include "app_config.h"
+#include "ethernetif.h"
+#include "etherc.h"
+#include "net_task.h"
+#include "lwip/opt.h"
+#include "lwip/init.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "lwip/etharp.h"
+#include "netif/ethernet.h"
+#include <string.h>
+
+/* pbuf_custom / PBUF_REF の扱いは lwIP 2.1 (sim/Makefile の LWIP_TAG) で確かめている */
+#if LWIP_VERSION_MAJOR != 2 || LWIP_VERSION_MINOR != 1
+#error "lwIP 2.1 が要る (make -C ../sim lwip)"
+#endif
+
+#define TX_SEGS_MAX     (ETH_TX_DESC / 2)   /* 1 フレームが使う記述子の上限 */
+#define TX_WAIT_MS      20                  /* 記述子が空くのを待つ上限 */
+
+static struct pbuf_custom rx_pbuf[ETH_RX_BUFS];
+static struct netif *eth_netif;
+
+/* ------------------------------------------------------------ 受信 */
+
+static void rx_pbuf_free(struct pbuf *p)
+{
+    etherc_rx_release((int)((struct pbuf_custom *)p - rx_pbuf));
+}
+
+static void rx_input(void)
+{
+    unsigned int len;
+    int idx;
+
+    while ((idx = etherc_rx_take(&len)) >= 0) {
+        struct pbuf_custom *pc = &rx_pbuf[idx];
+        struct pbuf *p;
+
+        pc->custom_free_function = rx_pbuf_free;
+        p = pbuf_alloced_custom(PBUF_RAW, (u16_t)len, PBUF_REF, pc,
+                                etherc_rx_buf(idx), ETH_BUF_SIZE);
+        /* input が ERR_OK 以外を返したら pbuf はまだこちらの持ち物 (lwIP の約束)。
+         * ここで pbuf_free し、rx_pbuf_free でバッファをドライバへ戻す。
+         * pbuf を作れなかったときはバッファを直接戻す */
+        if (p == NULL || eth_netif->input(p, eth_netif) != ERR_OK) {
+            if (p != NULL) pbuf_free(p);
+            else etherc_rx_release(idx);
+        }
+    }
+}
+
+/* ------------------------------------------------------------ 送信 */
+
+static void tx_reclaim(void)
+{
+    void *token;
+
+    while ((token = etherc_tx_done()) != NULL) {
+        pbuf_free((struct pbuf *)token);
+    }
+}
+
+static int tx_needs_copy(struct pbuf *p)
+{
+    struct pbuf *q;
+
+    if (pbuf_clen(p) > TX_SEGS_MAX) return 1;
+    for (q = p; q != NULL; q = q->next) {
+        if (PBUF_NEEDS_COPY(q)) return 1;
+    }
+    return 0;
+}
+
+/* tcpip スレッドから呼ばれる */
+static err_t low_level_output(struct netif *netif, struct pbuf *p)
+{
+    etherc_seg_t seg[TX_SEGS_MAX];
+    struct pbuf *q;
+    TickType_t start;
+    int n = 0;
+
+    (void)netif;
+    if (tx_needs_copy(p)) {
+        p = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+        if (p == NULL) return ERR_MEM;
+    } else {
+        pbuf_ref(p);
+    }
+    for (q = p; q != NULL; q = q->next) {
+        if (q->len == 0) continue;
+        seg[n].data = q->payload;
+        seg[n].len = q->len;
+        n++;
+    }
+
+    /* 記述子が空くまで少し待つ (TCP の再送より十分短く) */
+    start = xTaskGetTickCount();
+    for (;;) {
+        tx_reclaim();
+        if (etherc_tx(seg, n, p) == 0) return ERR_OK;
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(TX_WAIT_MS)) break;
+        vTaskDelay(1);
+    }
+    pbuf_free(p);
+    return ERR_IF;
+}
+
+/* ------------------------------------------------------------ 受信タスク */
+
+static void set_link(void *arg)
+{
+    if (arg) netif_set_link_up(eth_netif);
+    else     netif_set_link_down(eth_netif);
+}
+
+static void ethernetif_task(void *pvParameters)
+{
+    TickType_t last_poll;
+    int link = 0;
+
+    (void)pvParameters;
+
+    last_poll = xTaskGetTickCount() - pdMS_TO_TICKS(NET_LINK_POLL_MS);
+    for (;;) {
+        etherc_wait(pdMS_TO_TICKS(NET_LINK_POLL_MS));
+        rx_input();
+        tx_reclaim();
+
+        if (xTaskGetTickCount() - last_poll >= pdMS_TO_TICKS(NET_LINK_POLL_MS)) {
+            int up = etherc_link_poll();
+
+            last_poll = xTaskGetTickCount();
+            if (up != link) {
+                link = up;
+                tcpip_callback(set_link, up ? (void *)1 : NULL);
+            }
+        }
+    }
+}
+
+/* ------------------------------------------------------------ 初期化 */
+
+err_t ethernetif_init(struct netif *netif)
+{
+    const unsigned char *mac = (const unsigned char *)netif->state;
+
+    eth_netif = netif;
+    netif->name[0] = 'e';
+    netif->name[1] = '0';
+    netif->output = etharp_output;
+    netif->linkoutput = low_level_output;
+    netif->mtu = 1500;
+    netif->hwaddr_len = ETH_HWADDR_LEN;
+    memcpy(netif->hwaddr, mac, ETH_HWADDR_LEN);
+    netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET;
+
+    if (etherc_init(mac) != 0) return ERR_IF;
+    xTaskCreate(ethernetif_task, "eth_rx", STACK_ETH_RX, NULL, PRIORITY_ETH_RX, NULL);
+    return ERR_OK;
+}
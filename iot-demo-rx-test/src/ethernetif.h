@@ -0,0 +1,13 @@
+/*
+ * ethernetif.h - lwIP の netif と ETHERC ドライバ (etherc.h) をつなぐ
+ */
+
+#ifndef ETHERNETIF_H
+#define ETHERNETIF_H
+
+#include "lwip/netif.h"
+
+/* netif_add() に渡す初期化関数 (state に MAC アドレス 6 バイトを渡す) */
+err_t ethernetif_init(struct netif *netif);
+
+#endif /* ETHERNETIF_H */
@@ -0,0 +1,30 @@
+/*
+ * fw_update.c - アプリ側の更新要求 (手順は fw_update.h)
+ */
+
+#include "app_config.h"
+#include "fw_update.h"
+#include "iodefine.h"
+
+static volatile int pending = 0;
+
+void fw_update_request(void)
+{
+    g_emergency_stop = 1;
+    *(volatile unsigned long *)FW_REQ_ADDR = FW_REQ_MAGIC;
+    pending = 1;
+}
+
+int fw_update_pending(void)
+{
+    return pending;
+}
+
+void fw_update_reboot(void)
+{
+    taskENTER_CRITICAL();
+    SYSTEM.PRCR.WORD = 0xA502;
+    SYSTEM.SWRR = 0xA501;
+    for (;;) {
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * fw_update.h - 差分ファームウェア更新 (ブートローダー boot/ と共通の定義)
+ *
+ * ROM 1MB の割り当て:
+ *   0xFFF00000 - 0xFFF7FFFF  アプリ     (32KB ブロック × 16, 先頭に fw_app_header_t)
+ *   0xFFF80000 - 0xFFFF7FFF  仮置き     (16KB ブロック × 30, 最後の 1 ブロックは入れ替え記録)
+ *   0xFFFF8000 - 0xFFFFFFFF  ブートローダー (4KB ブロック × 8, 固定ベクタを含む)
+ *
+ * 手順: アプリが {"cmd":"fw_update"} を受けると RAM に要求を残してリセット →
+ * ブートローダーが SCI2 で差分を受け、旧イメージ + 差分 → 仮置きに新イメージ →
+ * CRC を確かめて入れ替え記録を書き、アプリ領域へコピーして起動する。
+ * コピー中に電源が落ちても、次の起動で記録を見てコピーをやり直す。
+ *
+ * アプリ側は FW_UPDATE 1 (make FW_UPDATE=1, リンカスクリプト rx63n_app.ld) のときだけ。
+ */
+
+#ifndef FW_UPDATE_H
+#define FW_UPDATE_H
+
+#ifndef FW_UPDATE
+#define FW_UPDATE           0
+#endif
+
+#define FW_APP_BASE         0xFFF00000UL
+#define FW_APP_SIZE         0x00080000UL
+#define FW_STAGE_BASE       0xFFF80000UL
+#define FW_STAGE_SIZE       0x00078000UL
+#define FW_IMAGE_MAX        (FW_STAGE_SIZE - 0x4000UL)
+#define FW_SWAP_REC         (FW_STAGE_BASE + FW_STAGE_SIZE - 128)
+#define FW_BOOT_BASE        0xFFFF8000UL
+
+#define FW_APP_MAGIC        0x414D4153UL    /* "SAMA" */
+#define FW_SWAP_MAGIC       0x50415753UL    /* "SWAP" */
+
+/* 更新要求: どちらの .data / .bss / スタックにも入らない RAM の末尾
+ * (ソフトウェアリセットでは RAM は消えない) */
+#define FW_REQ_ADDR         0x0001FFF8UL
+#define FW_REQ_MAGIC        0x50555746UL    /* "FWUP" */
+
+/* アプリ領域の先頭 (rx63n_app.ld が埋める) */
+typedef struct {
+    unsigned long magic;
+    unsigned long entry;        /* PowerON_Reset */
+    unsigned long length;       /* ヘッダを含むイメージ長 [byte] */
+    unsigned long reserved;
+} fw_app_header_t;
+
+/* 仮置き領域の最後の 128 バイト。仮置きのイメージを検証済みでコピー待ち */
+typedef struct {
+    unsigned long magic;
+    unsigned long length;
+    unsigned long crc;
+    unsigned long crc_inv;      /* ~crc (書きかけの記録と区別する) */
+} fw_swap_rec_t;
+
+#if FW_UPDATE
+/* ヒーターを止めて要求を残す。リセットは wdt_task の次の周期 (ack を送り終えてから) */
+void fw_update_request(void);
+int  fw_update_pending(void);
+void fw_update_reboot(void);
+#endif
+
+#endif /* FW_UPDATE_H */
@@ -86,7 +86,7 @@ static void jb_key_fixed2(json_buf_t *jb, const char *key, long val_x100)
     jb_append_fixed2(jb, val_x100);
 }
 
-void json_build_ctrl(json_buf_t *jb, long vtemp_x100, long pwm,
+void json_build_ctrl(json_buf_t *jb, long vtemp_x100, long pwm, long duty,
                      long sp_x100, long kp_x100, long ki_x100, long kd_x100)
 {
     jb->len = 0;
@@ -101,6 +101,9 @@ void json_build_ctrl(json_buf_t *jb, long vtemp_x100, long pwm,
     jb_key_int(jb, "pwm", pwm);
     jb_append_char(jb, ',');
 
+    jb_key_int(jb, "duty", duty);
+    jb_append_char(jb, ',');
+
     jb_key_fixed2(jb, "sp", sp_x100);
     jb_append_char(jb, ',');
 
@@ -117,6 +120,35 @@ void json_build_ctrl(json_buf_t *jb, long vtemp_x100, long pwm,
     jb->buf[jb->len] = '\0';
 }
 
+void json_build_sensor(json_buf_t *jb, long temp_x100, long humi_x100, long pres_x100)
+{
+    jb->len = 0;
+    jb_append_char(jb, '{');
+
+    jb_key_str(jb, "type", "sensor");
+    jb_append_char(jb, ',');
+
+    jb_key_fixed2(jb, "temp", temp_x100);
+    jb_append_char(jb, ',');
+
+    jb_key_fixed2(jb, "humi", humi_x100);
+    jb_append_char(jb, ',');
+
+    jb_key_fixed2(jb, "pres", pres_x100);
+
+    jb_append_char(jb, '}');
+    jb_append_char(jb, '\n');
+    jb->buf[jb->len] = '\0';
+}
+
+void json_build_line(json_buf_t *jb, const char *line)
+{
+    jb->len = 0;
+    jb_append_str(jb, line);
+    jb_append_char(jb, '\n');
+    jb->buf[jb->len] = '\0';
+}
+
 void json_build_status(json_buf_t *jb, const char *msg)
 {
     jb->len = 0;
@@ -131,3 +163,59 @@ void json_build_status(json_buf_t *jb, const char *msg)
     jb_append_char(jb, '\n');
     jb->buf[jb->len] = '\0';
 }
+
+void json_build_ack(json_buf_t *jb, long cid, int ok)
+{
+    jb->len = 0;
+    jb_append_char(jb, '{');
+
+    jb_key_str(jb, "type", "ack");
+    jb_append_char(jb, ',');
+
+    jb_key_int(jb, "cid", cid);
+    jb_append_char(jb, ',');
+
+    jb_key_int(jb, "ok", ok ? 1 : 0);
+
+    jb_append_char(jb, '}');
+    jb_append_char(jb, '\n');
+    jb->buf[jb->len] = '\0';
+}
+
+static void jb_baud_head(json_buf_t *jb, const char *op, unsigned long baud)
+{
+    jb->len = 0;
+    jb_append_char(jb, '{');
+
+    jb_key_str(jb, "type", "baud");
+    jb_append_char(jb, ',');
+
+    jb_key_str(jb, "op", op);
+    jb_append_char(jb, ',');
+
+    jb_key_int(jb, "baud", (long)baud);
+}
+
+void json_build_baud(json_buf_t *jb, const char *op, unsigned long baud)
+{
+    jb_baud_head(jb, op, baud);
+
+    jb_append_char(jb, '}');
+    jb_append_char(jb, '\n');
+    jb->buf[jb->len] = '\0';
+}
+
+void json_build_baud_result(json_buf_t *jb, unsigned long baud, int ok, long err)
+{
+    jb_baud_head(jb, "result", baud);
+    jb_append_char(jb, ',');
+
+    jb_key_int(jb, "ok", ok);
+    jb_append_char(jb, ',');
+
+    jb_key_int(jb, "err", err);
+
+    jb_append_char(jb, '}');
+    jb_append_char(jb, '\n');
+    jb->buf[jb->len] = '\0';
+}
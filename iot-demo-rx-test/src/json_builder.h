@@ -13,12 +13,33 @@ typedef struct {
 } json_buf_t;
 
 /* 制御JSON生成
- * {"type":"ctrl","vtemp":26.10,"pwm":128,"sp":28.00,"kp":3.00,"ki":0.80,"kd":0.20}
+ * {"type":"ctrl","vtemp":26.10,"pwm":128,"duty":5020,"sp":28.00,"kp":3.00,"ki":0.80,"kd":0.20}
+ * pwm: 0-255 (旧 ESP32 互換), duty: PID 出力 0-10000 (全分解能)
  */
-void json_build_ctrl(json_buf_t *jb, long vtemp_x100, long pwm,
+void json_build_ctrl(json_buf_t *jb, long vtemp_x100, long pwm, long duty,
                      long sp_x100, long kp_x100, long ki_x100, long kd_x100);
 
+/* センサーJSON生成 (ESP32 から受け取った値を Ethernet で配信するとき)
+ * {"type":"sensor","temp":25.30,"humi":48.20,"pres":1013.25}
+ */
+void json_build_sensor(json_buf_t *jb, long temp_x100, long humi_x100, long pres_x100);
+
+/* 受け取った 1 行をそのまま (改行を付けて) 配信するとき (ESP32 の sbatch) */
+void json_build_line(json_buf_t *jb, const char *line);
+
 /* ステータスJSON生成 */
 void json_build_status(json_buf_t *jb, const char *msg);
 
+/* コマンド応答JSON生成
+ * {"type":"ack","cid":17,"ok":1}  ok: 0 = 未知のコマンド
+ */
+void json_build_ack(json_buf_t *jb, long cid, int ok);
+
+/* ボーレート交渉 (baud_neg.h)
+ * {"type":"baud","op":"ack","baud":1041667}
+ * {"type":"baud","op":"result","baud":1041667,"ok":8,"err":0}
+ */
+void json_build_baud(json_buf_t *jb, const char *op, unsigned long baud);
+void json_build_baud_result(json_buf_t *jb, unsigned long baud, int ok, long err);
+
 #endif /* JSON_BUILDER_H */
@@ -4,6 +4,8 @@
  * {"type":"sensor","temp":25.3,"humi":48.2,"pres":1013.25}
  * {"type":"cmd","cmd":"set_pid","kp":300,"ki":80,"kd":20}
  * {"type":"cmd","cmd":"set_target","sp":28.0}
+ * {"type":"baud","op":"test","seq":0,"pat":"UUUU..."}
+ * {"type":"sbatch","t0":120000,"dt":10,"n":17,"id":501,"d":"kDyoDtTXDAIA..."}
  */
 
 #include "json_parser.h"
@@ -72,6 +74,17 @@ static long parse_long(const char *p)
     return sign * val;
 }
 
+static unsigned long parse_ulong(const char *p)
+{
+    unsigned long val = 0;
+
+    while (*p >= '0' && *p <= '9') {
+        val = val * 10 + (unsigned long)(*p - '0');
+        p++;
+    }
+    return val;
+}
+
 static void parse_string(const char *p, char *out, int maxlen)
 {
     int i = 0;
@@ -88,6 +101,7 @@ int json_parse(const char *buf, json_parsed_t *out)
 
     memset(out, 0, sizeof(*out));
     out->type = JP_TYPE_UNKNOWN;
+    out->cid = -1;
 
     v = find_key(buf, "type");
     if (!v) return -1;
@@ -126,8 +140,113 @@ int json_parse(const char *buf, json_parsed_t *out)
         v = find_key(buf, "sp");
         if (v) out->sp_x100 = parse_fixed100(v);
 
+        v = find_key(buf, "cid");
+        if (v) out->cid = parse_long(v);
+
+        return 0;
+    }
+
+    if (strcmp(type_str, "baud") == 0) {
+        out->type = JP_TYPE_BAUD;
+
+        v = find_key(buf, "op");
+        if (v) parse_string(v, out->op, sizeof(out->op));
+
+        v = find_key(buf, "baud");
+        if (v) out->baud = parse_long(v);
+
+        v = find_key(buf, "seq");
+        if (v) out->seq = parse_long(v);
+
+        v = find_key(buf, "pat");
+        if (v) parse_string(v, out->pat, sizeof(out->pat));
+
+        return 0;
+    }
+
+    if (strcmp(type_str, "sbatch") == 0) {
+        out->type = JP_TYPE_SBATCH;
+
+        v = find_key(buf, "t0");
+        if (v) out->t0_ms = parse_ulong(v);
+
+        v = find_key(buf, "dt");
+        if (v) out->dt_ms = parse_long(v);
+
+        v = find_key(buf, "n");
+        if (v) out->count = parse_long(v);
+
+        v = find_key(buf, "id");
+        if (v) out->id = parse_ulong(v);
+
+        v = find_key(buf, "d");
+        if (!v || *v != '"' || out->count <= 0) return -1;
+        out->data = v + 1;
+
         return 0;
     }
 
     return -1;
 }
+
+/* ------------------------------------------------------------ sbatch */
+
+static int b64_value(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+/* base64 から 1 バイト (-1 = 終わり) */
+static int sbatch_byte(json_sbatch_t *it)
+{
+    while (it->nbits < 8) {
+        int x = b64_value(*it->p);
+        if (x < 0) return -1;
+        it->p++;
+        it->bits = (it->bits << 6) | (unsigned long)x;
+        it->nbits += 6;
+    }
+    it->nbits -= 8;
+    return (int)((it->bits >> it->nbits) & 0xFF);
+}
+
+void json_sbatch_begin(json_sbatch_t *it, const json_parsed_t *jp)
+{
+    memset(it, 0, sizeof(*it));
+    it->p = jp->data;
+    it->left = jp->type == JP_TYPE_SBATCH ? jp->count : 0;
+}
+
+int json_sbatch_next(json_sbatch_t *it, long *temp_x100, long *humi_x100, long *pres_x100)
+{
+    int c, b, shift;
+    unsigned long z;
+
+    if (it->left <= 0) return 0;
+
+    for (c = 0; c < SBATCH_CHANNELS; c++) {
+        z = 0;
+        for (shift = 0; ; shift += 7) {
+            b = sbatch_byte(it);
+            if (b < 0 || shift > 28) {
+                it->left = 0;
+                return -1;
+            }
+            z |= (unsigned long)(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+        /* zigzag: 0, 1, 2, 3, .. → 0, -1, 1, -2, .. */
+        it->val[c] = (long)((unsigned long)it->val[c] + ((z >> 1) ^ (0UL - (z & 1))));
+    }
+    it->left--;
+
+    *temp_x100 = it->val[0];
+    *humi_x100 = it->val[1];
+    *pres_x100 = it->val[2];
+    return 1;
+}
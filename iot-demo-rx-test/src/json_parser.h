@@ -11,6 +11,11 @@
 #define JP_TYPE_UNKNOWN  0
 #define JP_TYPE_SENSOR   1
 #define JP_TYPE_CMD      2
+#define JP_TYPE_BAUD     3
+#define JP_TYPE_SBATCH   4
+
+/* sbatch のチャンネル (temp, humi, pres の順) */
+#define SBATCH_CHANNELS  3
 
 typedef struct {
     int type;
@@ -22,8 +27,35 @@ typedef struct {
     char cmd[16];
     long kp, ki, kd;
     long sp_x100;
+    long cid;           /* "cid" があれば処理後に ack で返す (なければ -1) */
+    /* baud (baud_neg.h) */
+    char op[8];
+    long baud;
+    long seq;
+    char pat[64];
+    /* sbatch: 値は json_sbatch_next() で取り出す */
+    unsigned long t0_ms;    /* 先頭サンプルの時刻 (ESP32 の millis) */
+    long dt_ms;             /* サンプル周期 */
+    long count;             /* サンプル数 */
+    unsigned long id;       /* 先頭サンプルの id (サンプル i は id + i) */
+    const char *data;       /* "d" の base64 (json_parse に渡した buf の中を指す) */
 } json_parsed_t;
 
 int json_parse(const char *buf, json_parsed_t *out);
 
+/* sbatch の復号 (ESP32 sample_batch.h と同じ形式)
+ * d = サンプルごとに 3 チャンネルの直前との差を zigzag + varint にして base64 (パディングなし)
+ * 行バッファ (buf) を書き換えたり再利用したりする前に読み終えること */
+typedef struct {
+    const char   *p;
+    unsigned long bits;
+    int           nbits;
+    long          left;
+    long          val[SBATCH_CHANNELS];
+} json_sbatch_t;
+
+void json_sbatch_begin(json_sbatch_t *it, const json_parsed_t *jp);
+/* 1 = 1 サンプル取り出した, 0 = 終わり, -1 = 壊れている */
+int  json_sbatch_next(json_sbatch_t *it, long *temp_x100, long *humi_x100, long *pres_x100);
+
 #endif /* JSON_PARSER_H */
@@ -0,0 +1,185 @@
+/*
+ * net_task.c - Ethernet 配信 / コマンド受付 (優先度2, 手順は net_task.h)
+ *
+ * net_telem: キューの行を 1 行 1 データグラムで UDP 送信
+ * net_cmd:   TCP で 1 接続ずつ受け付け、行ごとに cmd_exec() して ack を返す
+ * どちらも netconn API。netif の登録は tcpip スレッドの中で行う。
+ */
+
+#include "app_config.h"
+#include "net_task.h"
+#include "ethernetif.h"
+#include "json_parser.h"
+#include "cmd_exec.h"
+#include "lwip/tcpip.h"
+#include "lwip/api.h"
+#include "lwip/netif.h"
+#include <string.h>
+
+static const unsigned char mac_addr[6] = NET_MAC;
+
+static struct netif  eth_netif;
+static QueueHandle_t telem_q = NULL;
+static volatile int  link_up = 0;
+static net_stats_t   stats;
+
+/* ------------------------------------------------------------ netif */
+
+static void link_changed(struct netif *netif)
+{
+    link_up = netif_is_link_up(netif);
+}
+
+/* tcpip スレッドで呼ばれる */
+static void netif_setup(void *arg)
+{
+    ip4_addr_t ip, mask, gw;
+
+    (void)arg;
+    ip4addr_aton(NET_IP, &ip);
+    ip4addr_aton(NET_NETMASK, &mask);
+    ip4addr_aton(NET_GATEWAY, &gw);
+
+    /* PHY が応答しなければ netif は登録されず、net_enabled() は 0 のまま */
+    if (netif_add(&eth_netif, &ip, &mask, &gw, (void *)mac_addr,
+                  ethernetif_init, tcpip_input) == NULL) {
+        return;
+    }
+    netif_set_link_callback(&eth_netif, link_changed);
+    netif_set_default(&eth_netif);
+    netif_set_up(&eth_netif);
+}
+
+/* ------------------------------------------------------------ UDP 配信 */
+
+static void telem_task(void *pvParameters)
+{
+    char line[JSON_BUF_SIZE];
+    struct netconn *conn;
+    ip_addr_t dst;
+
+    (void)pvParameters;
+
+    ipaddr_aton(NET_SERVER_IP, &dst);
+    conn = netconn_new(NETCONN_UDP);
+
+    for (;;) {
+        struct netbuf *nb;
+        void *data;
+        size_t len;
+
+        xQueueReceive(telem_q, line, portMAX_DELAY);
+        len = strlen(line);
+
+        /* netbuf_alloc は UDP / IP / Ethernet ヘッダの分を前に空けた 1 枚の pbuf
+         * なので、ドライバはこれをそのまま記述子に指す */
+        nb = netbuf_new();
+        data = nb ? netbuf_alloc(nb, (u16_t)len) : NULL;
+        if (data != NULL) {
+            memcpy(data, line, len);
+            if (netconn_sendto(conn, nb, &dst, NET_TELEM_PORT) == ERR_OK) {
+                stats.telem_sent++;
+            } else {
+                stats.telem_dropped++;
+            }
+        } else {
+            stats.telem_dropped++;
+        }
+        if (nb) netbuf_delete(nb);
+    }
+}
+
+/* ------------------------------------------------------------ TCP コマンド */
+
+static void cmd_line(struct netconn *conn, const char *line)
+{
+    json_parsed_t parsed;
+    json_buf_t jb;
+    int ok;
+
+    if (json_parse(line, &parsed) != 0 || parsed.type != JP_TYPE_CMD) return;
+    stats.cmd_lines++;
+
+    ok = cmd_exec(&parsed);
+    if (parsed.cid >= 0) {
+        json_build_ack(&jb, parsed.cid, ok);
+        netconn_write(conn, jb.buf, (size_t)jb.len, NETCONN_COPY);
+    }
+}
+
+/* 切断か NET_CMD_IDLE_MS の無通信まで行を読む */
+static void cmd_session(struct netconn *conn)
+{
+    char line[JSON_BUF_SIZE];
+    struct netbuf *nb;
+    int n = 0;
+
+    while (netconn_recv(conn, &nb) == ERR_OK) {
+        do {
+            void *data;
+            u16_t len, i;
+
+            netbuf_data(nb, &data, &len);
+            for (i = 0; i < len; i++) {
+                char c = ((const char *)data)[i];
+
+                if (c == '\n') {
+                    line[n] = '\0';
+                    if (n > 0) cmd_line(conn, line);
+                    n = 0;
+                } else if (c != '\r' && n < JSON_BUF_SIZE - 1) {
+                    line[n++] = c;      /* 長すぎる行は切り詰めて解析に失敗させる */
+                }
+            }
+        } while (netbuf_next(nb) >= 0);
+        netbuf_delete(nb);
+    }
+}
+
+static void cmd_task(void *pvParameters)
+{
+    struct netconn *listener, *conn;
+
+    (void)pvParameters;
+
+    listener = netconn_new(NETCONN_TCP);
+    netconn_bind(listener, IP_ADDR_ANY, NET_CMD_PORT);
+    netconn_listen(listener);
+
+    for (;;) {
+        if (netconn_accept(listener, &conn) != ERR_OK) continue;
+        stats.cmd_conns++;
+        netconn_set_recvtimeout(conn, NET_CMD_IDLE_MS);
+        cmd_session(conn);
+        netconn_close(conn);
+        netconn_delete(conn);
+    }
+}
+
+/* ------------------------------------------------------------ 公開 API */
+
+void net_init(void)
+{
+    telem_q = xQueueCreate(NET_TELEM_QUEUE, JSON_BUF_SIZE);
+    tcpip_init(netif_setup, NULL);
+
+    xTaskCreate(telem_task, "net_telem", STACK_NET, NULL, PRIORITY_NET, NULL);
+    xTaskCreate(cmd_task,   "net_cmd",   STACK_NET, NULL, PRIORITY_NET, NULL);
+}
+
+int net_enabled(void)
+{
+    return link_up;
+}
+
+void net_publish(const json_buf_t *jb)
+{
+    if (!link_up || xQueueSend(telem_q, jb->buf, 0) != pdTRUE) {
+        stats.telem_dropped++;
+    }
+}
+
+void net_get_stats(net_stats_t *out)
+{
+    *out = stats;
+}
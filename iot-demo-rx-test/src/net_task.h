@@ -0,0 +1,75 @@
+/*
+ * net_task.h - Ethernet (ETHERC + lwIP) でダッシュボードサーバーへ直接つなぐ
+ *
+ * USE_ETHERNET 1 のときだけ有効 (Makefile の LWIP_DIR と net 用ソースが要る)。
+ * ESP32 との UART はそのまま残し、同じ行を両方へ出す:
+ *   UDP  GR-SAKURA → NET_SERVER_IP:NET_TELEM_PORT
+ *        sensor / ctrl / status の JSON 行 (1 データグラム 1 行)
+ *   TCP  サーバー → GR-SAKURA:NET_CMD_PORT
+ *        {"type":"cmd",...} の行。"cid" 付きなら同じ接続へ {"type":"ack",...} を返す
+ *
+ * USE_ETHERNET 0 では net_publish() などは何もしないマクロになる。
+ */
+
+#ifndef NET_TASK_H
+#define NET_TASK_H
+
+#include "app_config.h"
+#include "json_builder.h"
+
+#if USE_ETHERNET
+
+/* 固定アドレス (DHCP は使わない) */
+#ifndef NET_IP
+#define NET_IP          "192.168.1.50"
+#endif
+#ifndef NET_NETMASK
+#define NET_NETMASK     "255.255.255.0"
+#endif
+#ifndef NET_GATEWAY
+#define NET_GATEWAY     "192.168.1.1"
+#endif
+/* 既定はサブネットへのブロードキャスト (サーバーのアドレスを知らなくてよい) */
+#ifndef NET_SERVER_IP
+#define NET_SERVER_IP   "192.168.1.255"
+#endif
+#ifndef NET_TELEM_PORT
+#define NET_TELEM_PORT  50500
+#endif
+#ifndef NET_CMD_PORT
+#define NET_CMD_PORT    50501
+#endif
+/* ローカル管理アドレス (U/L ビット = 1) */
+#ifndef NET_MAC
+#define NET_MAC         { 0x02, 0x00, 0x00, 0x63, 0x00, 0x01 }
+#endif
+
+#define NET_TELEM_QUEUE 8           /* 送信待ちの行 (あふれたら捨てる) */
+#define NET_CMD_IDLE_MS 60000       /* コマンド接続を黙って切るまで */
+#define NET_LINK_POLL_MS 1000
+
+/* lwIP と ETHERC を初期化し、送受信タスクを作る (スケジューラ開始前に呼ぶ) */
+void net_init(void);
+/* リンクが上がっていれば 1 */
+int  net_enabled(void);
+/* json_builder の行 (改行付き) を UDP で送る。キューへコピーするだけで待たない */
+void net_publish(const json_buf_t *jb);
+
+typedef struct {
+    unsigned long telem_sent;
+    unsigned long telem_dropped;    /* キューあふれ / リンク断 */
+    unsigned long cmd_conns;
+    unsigned long cmd_lines;
+} net_stats_t;
+
+void net_get_stats(net_stats_t *out);
+
+#else
+
+#define net_init()          ((void)0)
+#define net_enabled()       0
+#define net_publish(jb)     ((void)(jb))
+
+#endif /* USE_ETHERNET */
+
+#endif /* NET_TASK_H */
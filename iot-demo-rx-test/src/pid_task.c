@@ -9,6 +9,8 @@
 #include "pid_ctrl.h"
 #include "json_builder.h"
 #include "sci2_uart.h"
+#include "net_task.h"
+#include "sd_log.h"
 
 void pid_task(void *pvParameters)
 {
@@ -50,16 +52,18 @@ void pid_task(void *pvParameters)
 
         /* 緊急停止チェック */
         long pwm;
+        long duty;
         if (g_emergency_stop) {
             pwm = 0;
+            duty = 0;
             pid_reset(&pid);
         } else {
             /* PID演算 */
-            long output = pid_compute(&pid, local_temp);
-            /* output: 0-10000 → PWM: 0-255 */
-            pwm = (output * 255) / 10000;
-            if (pwm < 0) pwm = 0;
-            if (pwm > 255) pwm = 255;
+            duty = pid_compute(&pid, local_temp);
+            if (duty < 0) duty = 0;
+            if (duty > 10000) duty = 10000;
+            /* output: 0-10000 → PWM: 0-255 (旧 ESP32 互換) */
+            pwm = (duty * 255) / 10000;
         }
 
         /* グローバルPWM値を更新 */
@@ -68,8 +72,10 @@ void pid_task(void *pvParameters)
             xSemaphoreGive(g_data_mutex);
         }
 
-        /* 制御JSON → ESP32 */
-        json_build_ctrl(&jb, local_temp, pwm, local_sp, local_kp, local_ki, local_kd);
+        /* 制御JSON → ESP32 (+ Ethernet) */
+        json_build_ctrl(&jb, local_temp, pwm, duty, local_sp, local_kp, local_ki, local_kd);
         sci2_puts(jb.buf);
+        net_publish(&jb);
+        sdlog_ctrl(local_temp, local_sp, duty);
     }
 }
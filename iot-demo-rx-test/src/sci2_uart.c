@@ -2,9 +2,9 @@
  * sci2_uart.c - SCI2 UART 割り込み駆動リングバッファ
  *
  * P50 = TXD2, P52 = RXD2
- * 115200bps 8N1, PCLKB = 50MHz
- * 受信: 割り込み + 256バイトリングバッファ
- * 送信: ポーリング
+ * 8N1, PCLKB = 50MHz。起動時 115200bps、sci2_set_baud() で変更
+ * 受信: 割り込み + 256バイトリングバッファ。エラーは ERI2 で数えて解除
+ * 送信: ポーリング。sci2_puts() は 1 行を他タスクと混ぜずに送る
  */
 
 #include "iodefine.h"
@@ -20,6 +20,71 @@ static volatile unsigned int  rx_head = 0;
 static volatile unsigned int  rx_tail = 0;
 
 static SemaphoreHandle_t rx_sem = NULL;
+static SemaphoreHandle_t tx_mutex = NULL;
+
+static unsigned long cur_baud = 0;
+static volatile unsigned long rx_errors = 0;
+
+/* ボーレート設定: B = PCLK / (64 * 2^(2n-1) * (N+1)), ABCS=1 なら 64 → 32
+ * (SCI2 には MDDR が無いので、この式で作れる値から選ぶ) */
+typedef struct {
+    unsigned char cks;      /* n */
+    unsigned char abcs;
+    unsigned char brr;      /* N */
+    unsigned long actual;
+} sci2_brr_t;
+
+static unsigned long abs_diff(unsigned long a, unsigned long b)
+{
+    return a > b ? a - b : b - a;
+}
+
+static int brr_calc(unsigned long baud, sci2_brr_t *out)
+{
+    unsigned long best_err = 0xFFFFFFFFUL;
+    int n, abcs;
+
+    if (baud == 0) return 0;
+    for (n = 0; n < 4; n++) {
+        /* 同じ誤差なら ABCS=0 (1 ビット 16 サンプル) を優先 */
+        for (abcs = 0; abcs <= 1; abcs++) {
+            unsigned long div = (abcs ? 16UL : 32UL) << (2 * n);
+            unsigned long nplus1 = (SCI2_PCLK_HZ + div * baud / 2) / (div * baud);
+            unsigned long actual, err;
+
+            if (nplus1 < 1 || nplus1 > 256) continue;
+            actual = SCI2_PCLK_HZ / (div * nplus1);
+            err = abs_diff(actual, baud);
+            if (err < best_err) {
+                best_err = err;
+                out->cks = (unsigned char)n;
+                out->abcs = (unsigned char)abcs;
+                out->brr = (unsigned char)(nplus1 - 1);
+                out->actual = actual;
+            }
+        }
+    }
+    return best_err != 0xFFFFFFFFUL;
+}
+
+/* BRR 書き込み後 1 ビット期間以上待つ */
+static void bit_wait(void)
+{
+    volatile int i;
+    for (i = 0; i < 1000; i++) {
+        __asm("nop");
+    }
+}
+
+/* TE = RE = 0 で呼ぶ */
+static void brr_apply(const sci2_brr_t *b)
+{
+    SCI2.SMR.BYTE = b->cks;     /* 非同期 8N1, CKS = n */
+    SCI2.SEMR.BIT.ABCS = b->abcs;
+    SCI2.BRR = b->brr;
+    bit_wait();
+    cur_baud = b->actual;
+}
 
 void sci2_rxi_isr(void)
 {
@@ -38,9 +103,25 @@ void sci2_rxi_isr(void)
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
+/* ORER / FER / PER が立つと受信が止まるので、数えてから解除する */
+void sci2_eri_isr(void)
+{
+    volatile unsigned char dummy = SCI2.RDR;
+    (void)dummy;
+
+    rx_errors++;
+    SCI2.SSR.BYTE = (SCI2.SSR.BYTE & ~0x38) | 0xC0;
+    /* 読み返して書き込みを終わらせてから戻る (GROUP12 の要求が残って再突入しないように) */
+    dummy = SCI2.SSR.BYTE;
+}
+
 void sci2_init(void)
 {
+    sci2_brr_t b;
+
     rx_sem = xSemaphoreCreateBinary();
+    tx_mutex = xSemaphoreCreateMutex();
+    brr_calc(SCI2_BAUD_BASE, &b);
 
     /* モジュールストップ解除 */
     SYSTEM.PRCR.WORD = 0xA502;
@@ -48,16 +129,7 @@ void sci2_init(void)
     SYSTEM.PRCR.WORD = 0xA500;
 
     SCI2.SCR.BYTE = 0x00;
-    SCI2.SMR.BYTE = 0x00;
-    SCI2.SEMR.BIT.ABCS = 1;
-    SCI2.BRR = 26;
-
-    {
-        volatile int i;
-        for (i = 0; i < 1000; i++) {
-            __asm("nop");
-        }
-    }
+    brr_apply(&b);              /* 115200: ABCS=1, BRR=26 (+0.47%) */
 
     /* MPC */
     MPC.PWPR.BIT.B0WI = 0;
@@ -75,12 +147,57 @@ void sci2_init(void)
     ICU.IR[220].BIT.IR = 0;
     ICU.IER[0x1B].BIT.IEN4 = 1; /* IER[220/8].IEN[220%8] = IER[27].IEN4 */
 
+    /* ERI2 はグループ 12 (ベクタ114) の IS2 → INT_Excep_ICU_GROUP12 (inthandler.c) */
+    EN(SCI2, ERI2) = 1;
+    IPR(ICU, GROUP12) = 3;
+    IR(ICU, GROUP12) = 0;
+    IEN(ICU, GROUP12) = 1;
+
     /* 送受信有効化 + RXI割り込み有効 */
     SCI2.SCR.BIT.RIE = 1;
     SCI2.SCR.BIT.TE = 1;
     SCI2.SCR.BIT.RE = 1;
 }
 
+unsigned long sci2_baud_actual(unsigned long baud, unsigned long max_err_ppm)
+{
+    sci2_brr_t b;
+
+    if (!brr_calc(baud, &b)) return 0;
+    /* 誤差 [ppm] = |actual - baud| / baud * 1e6 (1Mbps でも桁あふれしない順で) */
+    if (abs_diff(b.actual, baud) > baud / 1000 * max_err_ppm / 1000) return 0;
+    return b.actual;
+}
+
+unsigned long sci2_set_baud(unsigned long baud)
+{
+    sci2_brr_t b;
+
+    if (!brr_calc(baud, &b)) return 0;
+
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    while (SCI2.SSR.BIT.TEND == 0)
+        ;                       /* 最後のバイトのストップビットまで */
+
+    SCI2.SCR.BYTE = 0x00;       /* SMR / BRR は TE = RE = 0 でのみ書ける */
+    brr_apply(&b);
+    rx_tail = rx_head;          /* 旧速度の途中の行は捨てる (消費側なので tail だけ) */
+    SCI2.SCR.BYTE = 0x70;       /* RIE | TE | RE */
+    xSemaphoreGive(tx_mutex);
+
+    return b.actual;
+}
+
+unsigned long sci2_get_baud(void)
+{
+    return cur_baud;
+}
+
+unsigned long sci2_rx_errors(void)
+{
+    return rx_errors;
+}
+
 void sci2_putc(char c)
 {
     while (SCI2.SSR.BIT.TDRE == 0)
@@ -90,8 +207,10 @@ void sci2_putc(char c)
 
 void sci2_puts(const char *s)
 {
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
     while (*s)
         sci2_putc(*s++);
+    xSemaphoreGive(tx_mutex);
 }
 
 int sci2_getc_timeout(unsigned long timeout_ms)
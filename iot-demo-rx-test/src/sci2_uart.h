@@ -1,19 +1,34 @@
 /*
  * sci2_uart.h - SCI2 UART 割り込み駆動リングバッファ
  *
- * P50 = TXD2, P52 = RXD2 (115200bps 8N1)
+ * P50 = TXD2, P52 = RXD2 (起動時 115200bps 8N1, baud_neg.c で切替)
  */
 
 #ifndef SCI2_UART_H
 #define SCI2_UART_H
 
+#define SCI2_PCLK_HZ    50000000UL  /* PCLKB (hwinit.c) */
+#define SCI2_BAUD_BASE  115200UL
+
 void sci2_init(void);
 void sci2_putc(char c);
 void sci2_puts(const char *s);
 int  sci2_getc_timeout(unsigned long timeout_ms);
 int  sci2_readline(char *buf, int maxlen, unsigned long timeout_ms);
 
+/* ボーレート: PCLKB から CKS / ABCS / BRR を選ぶ
+ * sci2_baud_actual: 要求に最も近い実際の値 (誤差が max_err_ppm を超えれば 0)
+ * sci2_set_baud:    送信中の行を出し切ってから切替え、受信リングを捨てる
+ *                   戻り値は実際の値 (0 = 設定できない, 変更なし) */
+unsigned long sci2_baud_actual(unsigned long baud, unsigned long max_err_ppm);
+unsigned long sci2_set_baud(unsigned long baud);
+unsigned long sci2_get_baud(void);
+
+/* 受信エラー (フレーミング / オーバーラン / パリティ) の累計 */
+unsigned long sci2_rx_errors(void);
+
 /* 割り込みハンドラ (inthandler.c から呼ばれる) */
 void sci2_rxi_isr(void);
+void sci2_eri_isr(void);    /* GROUP12 (IS2 = ERI2) */
 
 #endif /* SCI2_UART_H */
@@ -0,0 +1,258 @@
+/*
+ * sd_card.c - microSD (SPI モード) の 512 バイトブロック読み書き (sd_card.h)
+ *
+ * 初期化: 80 クロック → CMD0 → CMD8 (v2 か) → ACMD41 → CMD58 (CCS)
+ * CCS = 1 (SDHC / SDXC) はブロックアドレス、それ以外はバイトアドレス + CMD16。
+ * 最後に CMD9 で CSD を読み、容量 (ブロック数) を覚える。
+ * 書き込み後のビジー (数百 us、まれに 250ms まで) は 1ms ずつ待って CPU を譲る。
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sd_card.h"
+
+#define CMD0    0               /* GO_IDLE_STATE */
+#define CMD8    8               /* SEND_IF_COND */
+#define CMD9    9               /* SEND_CSD */
+#define CMD12   12              /* STOP_TRANSMISSION */
+#define CMD16   16              /* SET_BLOCKLEN */
+#define CMD17   17              /* READ_SINGLE_BLOCK */
+#define CMD25   25              /* WRITE_MULTIPLE_BLOCK */
+#define CMD55   55              /* APP_CMD */
+#define CMD58   58              /* READ_OCR */
+#define ACMD41  (0x80 | 41)     /* SD_SEND_OP_COND */
+
+#define TOKEN_READ      0xFE
+#define TOKEN_MULTI     0xFC
+#define TOKEN_STOP      0xFD
+
+#define INIT_TIMEOUT_MS     1000
+#define READ_TIMEOUT_MS     100
+#define BUSY_TIMEOUT_MS     500
+#define BUSY_SPIN           64      /* これだけ 0xFF を待ってもビジーなら 1ms ずつ待つ */
+
+static int           card_hc = 0;      /* 1: ブロックアドレス */
+static int           in_write = 0;     /* CMD25 を開いている */
+static unsigned long next_lba = 0;
+static unsigned long card_blocks = 0;  /* CSD の容量 (0 = 読めていない) */
+
+static int wait_ready(unsigned long timeout_ms)
+{
+    TickType_t start = xTaskGetTickCount();
+    int n = 0;
+
+    while (sd_spi_xfer(0xFF) != 0xFF) {
+        if (++n < BUSY_SPIN) continue;
+        if ((xTaskGetTickCount() - start) > pdMS_TO_TICKS(timeout_ms)) return -1;
+        vTaskDelay(1);
+    }
+    return 0;
+}
+
+static void deselect(void)
+{
+    sd_spi_select(0);
+    sd_spi_xfer(0xFF);                  /* DO を離させる */
+}
+
+/* R1 を返す (0xFF = 応答なし)。CS は選択したまま */
+static unsigned char send_cmd(unsigned char cmd, unsigned long arg)
+{
+    unsigned char r, crc = 0x01;
+    int n;
+
+    if (cmd & 0x80) {
+        r = send_cmd(CMD55, 0);
+        if (r > 1) return r;
+        cmd &= 0x7F;
+    }
+
+    deselect();
+    sd_spi_select(1);
+    if (cmd != CMD0 && wait_ready(BUSY_TIMEOUT_MS) != 0) return 0xFF;
+
+    if (cmd == CMD0) crc = 0x95;        /* CRC が要るのは SPI モードに入るまで */
+    if (cmd == CMD8) crc = 0x87;
+
+    sd_spi_xfer((unsigned char)(0x40 | cmd));
+    sd_spi_xfer((unsigned char)(arg >> 24));
+    sd_spi_xfer((unsigned char)(arg >> 16));
+    sd_spi_xfer((unsigned char)(arg >> 8));
+    sd_spi_xfer((unsigned char)arg);
+    sd_spi_xfer(crc);
+
+    if (cmd == CMD12) sd_spi_xfer(0xFF);
+
+    for (n = 0; n < 10; n++) {
+        r = sd_spi_xfer(0xFF);
+        if (!(r & 0x80)) break;
+    }
+    return r;
+}
+
+/* 待つコマンドを期限まで繰り返す (ACMD41) */
+static int send_cmd_until_ready(unsigned char cmd, unsigned long arg)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    while (send_cmd(cmd, arg) != 0) {
+        if ((xTaskGetTickCount() - start) > pdMS_TO_TICKS(INIT_TIMEOUT_MS)) return -1;
+        vTaskDelay(10);
+    }
+    return 0;
+}
+
+/* データトークンを待って n バイト受け取る (CRC は見ない)。CS は選択したまま */
+static int read_data(unsigned char *buf, unsigned int n)
+{
+    TickType_t start = xTaskGetTickCount();
+    unsigned char t;
+
+    while ((t = sd_spi_xfer(0xFF)) == 0xFF &&
+           (xTaskGetTickCount() - start) <= pdMS_TO_TICKS(READ_TIMEOUT_MS))
+        ;
+    if (t != TOKEN_READ) return -1;
+    sd_spi_recv(buf, n);
+    sd_spi_xfer(0xFF);                  /* CRC (見ない) */
+    sd_spi_xfer(0xFF);
+    return 0;
+}
+
+/* CSD → 容量 [ブロック] (0 = 知らない形式) */
+static unsigned long csd_blocks(const unsigned char *csd)
+{
+    unsigned long c_size, mult, bl_len;
+
+    if ((csd[0] >> 6) == 1) {
+        /* v2 (SDHC / SDXC): (C_SIZE + 1) × 512KB */
+        c_size = ((unsigned long)(csd[7] & 0x3F) << 16) | ((unsigned long)csd[8] << 8) | csd[9];
+        if (c_size >= 0x3FFFFFUL) return 0xFFFFFFFFUL;
+        return (c_size + 1) * 1024UL;
+    }
+    if ((csd[0] >> 6) == 0) {
+        /* v1 (SDSC): (C_SIZE + 1) × 2^(C_SIZE_MULT + 2) × 2^READ_BL_LEN バイト */
+        c_size = ((unsigned long)(csd[6] & 0x03) << 10) | ((unsigned long)csd[7] << 2) | (csd[8] >> 6);
+        mult = ((csd[9] & 0x03) << 1) | (csd[10] >> 7);
+        bl_len = csd[5] & 0x0F;             /* 9-11 */
+        if (bl_len < 9) return 0;
+        return (c_size + 1) << (mult + 2 + bl_len - 9);
+    }
+    return 0;
+}
+
+static int stop_write(void)
+{
+    int ok;
+
+    if (!in_write) return 0;
+    in_write = 0;
+    sd_spi_xfer(TOKEN_STOP);
+    sd_spi_xfer(0xFF);
+    ok = wait_ready(BUSY_TIMEOUT_MS);
+    deselect();
+    return ok;
+}
+
+int sd_card_init(void)
+{
+    unsigned char ocr[4];
+    int i, ok = -1;
+
+    in_write = 0;
+    card_blocks = 0;
+    sd_spi_init();
+    sd_spi_set_fast(0);
+
+    /* CS = High で 74 クロック以上 */
+    sd_spi_select(0);
+    for (i = 0; i < 10; i++) sd_spi_xfer(0xFF);
+
+    if (send_cmd(CMD0, 0) == 1) {
+        if (send_cmd(CMD8, 0x1AA) == 1) {
+            /* v2: 電圧範囲とチェックパターンが返る */
+            sd_spi_recv(ocr, 4);
+            if (ocr[2] == 0x01 && ocr[3] == 0xAA &&
+                send_cmd_until_ready(ACMD41, 1UL << 30) == 0 &&
+                send_cmd(CMD58, 0) == 0) {
+                sd_spi_recv(ocr, 4);
+                card_hc = (ocr[0] & 0x40) ? 1 : 0;
+                ok = 0;
+            }
+        } else if (send_cmd_until_ready(ACMD41, 0) == 0) {
+            card_hc = 0;
+            ok = 0;
+        }
+        if (ok == 0 && !card_hc && send_cmd(CMD16, SD_BLOCK_SIZE) != 0) ok = -1;
+        if (ok == 0) {
+            unsigned char csd[16];
+
+            if (send_cmd(CMD9, 0) == 0 && read_data(csd, sizeof(csd)) == 0) {
+                card_blocks = csd_blocks(csd);
+            }
+            if (card_blocks == 0) ok = -1;
+        }
+    }
+    deselect();
+
+    if (ok == 0) sd_spi_set_fast(1);
+    return ok;
+}
+
+unsigned long sd_card_blocks(void)
+{
+    return card_blocks;
+}
+
+int sd_card_read(unsigned long lba, unsigned char *buf)
+{
+    int ok = -1;
+
+    if (stop_write() != 0) return -1;
+
+    if (send_cmd(CMD17, card_hc ? lba : lba * SD_BLOCK_SIZE) == 0) {
+        ok = read_data(buf, SD_BLOCK_SIZE);
+    }
+    deselect();
+    return ok;
+}
+
+int sd_card_write(unsigned long lba, const unsigned char *buf)
+{
+    unsigned char resp;
+
+    if (in_write && lba != next_lba) {
+        if (stop_write() != 0) return -1;
+    }
+    if (!in_write) {
+        if (send_cmd(CMD25, card_hc ? lba : lba * SD_BLOCK_SIZE) != 0) {
+            deselect();
+            return -1;
+        }
+        in_write = 1;
+        sd_spi_xfer(0xFF);
+    }
+
+    sd_spi_xfer(TOKEN_MULTI);
+    if (sd_spi_send_block(buf) != 0) {
+        in_write = 0;
+        deselect();
+        return -1;
+    }
+    sd_spi_xfer(0xFF);                  /* CRC (SPI モードでは見られない) */
+    sd_spi_xfer(0xFF);
+
+    /* データ応答 xxx0_0101 = 受理。その後のビジーを待つ */
+    resp = sd_spi_xfer(0xFF);
+    if ((resp & 0x1F) != 0x05 || wait_ready(BUSY_TIMEOUT_MS) != 0) {
+        in_write = 0;
+        deselect();
+        return -1;
+    }
+    next_lba = lba + 1;
+    return 0;
+}
+
+int sd_card_sync(void)
+{
+    return stop_write();
+}
@@ -0,0 +1,27 @@
+/*
+ * sd_card.h - microSD (SPI モード) の 512 バイトブロック読み書き
+ *
+ * SDSC / SDHC / SDXC。FAT は持たず、LBA を直接読み書きする (sd_log.c が使う)。
+ * 連続した LBA への書き込みは CMD25 (マルチブロック) を開いたまま続け、
+ * 別の LBA / 読み出し / sd_card_sync() で閉じる。
+ *
+ * 実機は sd_card.c (sd_spi.c の上)。ホストの sim/ は rx/sim_sd_card.c
+ * (ファイルをカードに見立て、書き込みの遅れを仮想時刻で再現する)。
+ * どれも呼んだタスクを待たせる。書き込み側のタスクからだけ呼ぶ。
+ */
+
+#ifndef SD_CARD_H
+#define SD_CARD_H
+
+#include "sd_spi.h"
+
+/* 0 = OK, -1 = カードなし / 応答なし / 容量 (CSD) が読めない */
+int  sd_card_init(void);
+/* 容量 [ブロック] (sd_card_init() が CSD から読んだ値) */
+unsigned long sd_card_blocks(void);
+int  sd_card_read(unsigned long lba, unsigned char *buf);
+int  sd_card_write(unsigned long lba, const unsigned char *buf);
+/* 開いているマルチブロック書き込みを閉じ、カードの書き込み完了まで待つ */
+int  sd_card_sync(void);
+
+#endif /* SD_CARD_H */
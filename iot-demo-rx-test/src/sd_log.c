@@ -0,0 +1,403 @@
+/*
+ * sd_log.c - 制御ログを microSD へブロック単位で書く (形式は sd_log.h)
+ *
+ * バッファの面は FREE → FILL (cur, 各タスクが詰める) → FULL (書き出し待ち) → FREE。
+ * 面の状態と cur はクリティカルセクションで守る。中でするのは 1 レコードの
+ * コピー (最大 55 バイト) と、途中書き出し用の used バイトのコピーだけ。
+ * seq は書き込みタスクだけが振る (満杯か途中書き出しで初めてカードへ出すとき)。
+ */
+
+#include "app_config.h"
+#include "sd_log.h"
+#include "sd_card.h"
+#include <string.h>
+
+#if USE_SDLOG
+
+enum { BUF_FREE, BUF_FILL, BUF_FULL };
+
+typedef struct {
+    unsigned char  data[SD_BLOCK_SIZE];
+    unsigned long  order;           /* 詰め始めた順 */
+    unsigned long  seq;
+    unsigned long  t0;              /* 先頭レコードの時刻 [ms] */
+    unsigned long  t_last;
+    unsigned long  dirty_since;     /* 途中書き出し後の最初のレコード */
+    unsigned short used;
+    unsigned char  state;
+    unsigned char  has_seq;
+    unsigned char  dirty;
+} sdlog_buf_t;
+
+static sdlog_buf_t       bufs[2];
+static sdlog_buf_t      *cur = NULL;
+static unsigned long     fill_order = 0;
+static unsigned char     scratch[SD_BLOCK_SIZE];   /* 途中書き出し / 起動時の探索 */
+static SemaphoreHandle_t wake = NULL;
+static unsigned long     next_seq = 0;
+static int               seq_known = 0;     /* 探索は最初の初期化だけ */
+static unsigned long     ring = 0;          /* リングのブロック数 (カードの容量で決める) */
+static sdlog_stats_t     stats;
+
+static unsigned long now_ms(void)
+{
+    return (unsigned long)xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static void put16(unsigned char *p, unsigned long v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put32(unsigned char *p, unsigned long v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+static unsigned long get32(const unsigned char *p)
+{
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8) |
+           ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+static unsigned long clamp16(long v)
+{
+    if (v > 32767) v = 32767;
+    if (v < -32768) v = -32768;
+    return (unsigned long)v & 0xFFFF;
+}
+
+/* CRC-16/CCITT (多項式 0x1021, 初期値 0xFFFF) */
+static unsigned short crc16(unsigned short crc, const unsigned char *p, unsigned int n)
+{
+    int i;
+
+    while (n--) {
+        crc ^= (unsigned short)(*p++ << 8);
+        for (i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (unsigned short)((crc << 1) ^ 0x1021) : (unsigned short)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static unsigned short block_crc(const unsigned char *blk, unsigned int used)
+{
+    unsigned short crc = crc16(0xFFFF, blk, 14);
+
+    return crc16(crc, blk + SDLOG_HDR_SIZE, used - SDLOG_HDR_SIZE);
+}
+
+static unsigned long block_lba(unsigned long seq)
+{
+    return SDLOG_LBA_BASE + seq % ring;
+}
+
+/* ------------------------------------------------------------ 詰める側 */
+
+/* FREE の面を FILL にする。なければ NULL (クリティカルセクション内) */
+static sdlog_buf_t *start_buf(unsigned long now)
+{
+    sdlog_buf_t *b;
+
+    if (bufs[0].state == BUF_FREE) {
+        b = &bufs[0];
+    } else if (bufs[1].state == BUF_FREE) {
+        b = &bufs[1];
+    } else {
+        return NULL;
+    }
+    b->order = ++fill_order;
+    b->t0 = now;
+    b->t_last = now;
+    b->used = SDLOG_HDR_SIZE;
+    b->has_seq = 0;
+    b->dirty = 0;
+    b->state = BUF_FILL;
+    return b;
+}
+
+static void append(unsigned char type, const unsigned char *p, unsigned int n)
+{
+    unsigned long now = now_ms();
+    sdlog_buf_t *b;
+    int kick = 0;
+
+    taskENTER_CRITICAL();
+    b = cur;
+    /* 入らない / dt が 16 ビットを超える: この面は閉じて書き出しへ */
+    if (b != NULL && (b->used + 3 + n > SD_BLOCK_SIZE || now - b->t_last > 0xFFFF)) {
+        b->state = BUF_FULL;
+        b = NULL;
+        kick = 1;
+    }
+    if (b == NULL) {
+        b = start_buf(now);
+        cur = b;
+    }
+    if (b != NULL) {
+        unsigned char *q = b->data + b->used;
+
+        q[0] = type;
+        put16(q + 1, now - b->t_last);
+        if (n > 0) memcpy(q + 3, p, n);
+        b->used = (unsigned short)(b->used + 3 + n);
+        b->t_last = now;
+        if (!b->dirty) {
+            b->dirty = 1;
+            b->dirty_since = now;
+        }
+        stats.records++;
+    } else {
+        stats.dropped++;
+    }
+    taskEXIT_CRITICAL();
+
+    if (kick) xSemaphoreGive(wake);
+}
+
+void sdlog_ctrl(long temp_x100, long sp_x100, long duty)
+{
+    unsigned char p[6];
+
+    put16(p, clamp16(temp_x100));
+    put16(p + 2, clamp16(sp_x100));
+    put16(p + 4, (unsigned long)duty);
+    append(SDLOG_T_CTRL, p, sizeof(p));
+}
+
+void sdlog_sensor(long temp_x100, long humi_x100, long pres_x100)
+{
+    unsigned char p[8];
+
+    put16(p, clamp16(temp_x100));
+    put16(p + 2, (unsigned long)humi_x100);
+    put32(p + 4, (unsigned long)pres_x100);
+    append(SDLOG_T_SENSOR, p, sizeof(p));
+}
+
+void sdlog_status(const char *msg)
+{
+    unsigned char p[1 + SDLOG_STATUS_MAX];
+    size_t len = strlen(msg);
+
+    if (len > SDLOG_STATUS_MAX) len = SDLOG_STATUS_MAX;
+    p[0] = (unsigned char)len;
+    memcpy(p + 1, msg, len);
+    append(SDLOG_T_STATUS, p, (unsigned int)(1 + len));
+}
+
+/* ------------------------------------------------------------ 書き込みタスク */
+
+/* 1 = 正しいブロック, 0 = 違う, -1 = 読めない */
+static int read_seq(unsigned long index, unsigned long *seq)
+{
+    unsigned int used;
+
+    if (sd_card_read(SDLOG_LBA_BASE + index, scratch) != 0) return -1;
+    if (get32(scratch) != SDLOG_MAGIC) return 0;
+    used = scratch[12] | (scratch[13] << 8);
+    if (used < SDLOG_HDR_SIZE || used > SD_BLOCK_SIZE) return 0;
+    if (block_crc(scratch, used) != (scratch[14] | (scratch[15] << 8))) return 0;
+    *seq = get32(scratch + 4);
+    return 1;
+}
+
+/* カードに収まるリングの大きさ (SDLOG_LBA_COUNT まで)。0 = 小さすぎる */
+static unsigned long ring_blocks(void)
+{
+    unsigned long cap = sd_card_blocks();
+
+    if (cap <= SDLOG_LBA_BASE + 1) return 0;
+    cap -= SDLOG_LBA_BASE;
+    return cap < SDLOG_LBA_COUNT ? cap : SDLOG_LBA_COUNT;
+}
+
+/* リングの先頭 (index 0) から seq が 1 ずつ続く最後を二分探索で探す */
+static int find_next_seq(void)
+{
+    unsigned long seq0, s, lo, hi, mid;
+    int r;
+
+    r = read_seq(0, &seq0);
+    if (r < 0) return -1;
+    if (r == 0 || seq0 % ring != 0) {
+        next_seq = 0;
+        return 0;
+    }
+    lo = 0;
+    hi = ring;
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo) / 2;
+        r = read_seq(mid, &s);
+        if (r < 0) return -1;
+        if (r > 0 && s == seq0 + mid) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    next_seq = seq0 + lo + 1;
+    return 0;
+}
+
+static void finish_header(unsigned char *blk, unsigned long seq, unsigned long t0,
+                          unsigned int used)
+{
+    put32(blk, SDLOG_MAGIC);
+    put32(blk + 4, seq);
+    put32(blk + 8, t0);
+    put16(blk + 12, used);
+    put16(blk + 14, block_crc(blk, used));
+}
+
+static int write_block(const unsigned char *blk)
+{
+    unsigned long seq = get32(blk + 4);
+    TickType_t t = xTaskGetTickCount();
+    unsigned long ms;
+
+    if (sd_card_write(block_lba(seq), blk) != 0) {
+        stats.errors++;
+        stats.card_ok = 0;
+        return -1;
+    }
+    ms = (unsigned long)(xTaskGetTickCount() - t) * portTICK_PERIOD_MS;
+    if (ms > stats.write_max_ms) stats.write_max_ms = ms;
+    return 0;
+}
+
+static sdlog_buf_t *oldest_full(void)
+{
+    sdlog_buf_t *a = &bufs[0], *b = &bufs[1];
+
+    if (a->state == BUF_FULL && (b->state != BUF_FULL || (long)(a->order - b->order) < 0)) {
+        return a;
+    }
+    return (b->state == BUF_FULL) ? b : NULL;
+}
+
+/* 満杯の面を書く。失敗したら FULL のまま残し、カードを初期化し直してから書く */
+static int write_full(sdlog_buf_t *b)
+{
+    if (!b->has_seq) {
+        b->seq = next_seq++;
+        b->has_seq = 1;
+    }
+    finish_header(b->data, b->seq, b->t0, b->used);
+    if (write_block(b->data) != 0) return -1;
+    stats.blocks++;
+
+    memset(b->data, 0, SD_BLOCK_SIZE);
+    taskENTER_CRITICAL();
+    b->state = BUF_FREE;
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+/* 詰めている途中の面を scratch へ写して書く (後で満杯になれば同じ LBA を上書き) */
+static void flush_partial(void)
+{
+    sdlog_buf_t *b;
+    unsigned int used = 0;
+    unsigned long t0 = 0;
+
+    taskENTER_CRITICAL();
+    b = cur;
+    /* 先に満杯の面を書く (seq の順を守る) */
+    if (b != NULL && b->dirty && oldest_full() == NULL) {
+        if (!b->has_seq) {
+            b->seq = next_seq++;
+            b->has_seq = 1;
+        }
+        used = b->used;
+        t0 = b->t0;
+        memcpy(scratch, b->data, used);
+        put32(scratch + 4, b->seq);
+        b->dirty = 0;
+    } else {
+        b = NULL;
+    }
+    taskEXIT_CRITICAL();
+
+    if (b == NULL) return;
+    memset(scratch + used, 0, SD_BLOCK_SIZE - used);
+    finish_header(scratch, get32(scratch + 4), t0, used);
+    if (write_block(scratch) == 0 && sd_card_sync() == 0) {
+        stats.flushes++;
+    }
+}
+
+/* 途中書き出しまでの残り [ms] */
+static unsigned long flush_wait_ms(void)
+{
+    unsigned long wait = SDLOG_FLUSH_MS;
+
+    taskENTER_CRITICAL();
+    if (cur != NULL && cur->dirty) {
+        unsigned long age = now_ms() - cur->dirty_since;
+
+        wait = (age >= SDLOG_FLUSH_MS) ? 0 : SDLOG_FLUSH_MS - age;
+    }
+    taskEXIT_CRITICAL();
+    return wait;
+}
+
+static void sdlog_task(void *pvParameters)
+{
+    sdlog_buf_t *b;
+
+    (void)pvParameters;
+
+    for (;;) {
+        if (!stats.card_ok) {
+            unsigned long n = 0;
+
+            /* 書き込み失敗からの復帰では seq を振り直さない (書き出し待ちの面が持っている)。
+             * 容量の違うカードに差し替えられたときだけ探し直す */
+            if (sd_card_init() == 0 && (n = ring_blocks()) != ring) {
+                ring = n;
+                seq_known = 0;
+            }
+            if (n == 0 || (!seq_known && find_next_seq() != 0)) {
+                stats.errors++;
+                vTaskDelay(pdMS_TO_TICKS(SDLOG_RETRY_MS));
+                continue;
+            }
+            seq_known = 1;
+            stats.card_ok = 1;
+        }
+
+        while (stats.card_ok && (b = oldest_full()) != NULL) {
+            write_full(b);
+        }
+        if (stats.card_ok && flush_wait_ms() == 0) {
+            flush_partial();
+        }
+        if (stats.card_ok) {
+            unsigned long wait = flush_wait_ms();
+
+            xSemaphoreTake(wake, pdMS_TO_TICKS(wait > 0 ? wait : 1));
+        }
+    }
+}
+
+void sdlog_init(void)
+{
+    wake = xSemaphoreCreateBinary();
+    xTaskCreate(sdlog_task, "SDLOG", STACK_SDLOG, NULL, PRIORITY_SDLOG, NULL);
+    append(SDLOG_T_BOOT, NULL, 0);
+}
+
+void sdlog_get_stats(sdlog_stats_t *out)
+{
+    taskENTER_CRITICAL();
+    *out = stats;
+    out->next_seq = next_seq;
+    out->ring_blocks = ring;
+    taskEXIT_CRITICAL();
+}
+
+#endif /* USE_SDLOG */
@@ -0,0 +1,91 @@
+/*
+ * sd_log.h - 制御ログを microSD へブロック単位で書く
+ *
+ * USE_SDLOG 1 のときだけ有効 (sd_card.c / sd_spi.c が要る)。
+ * 各タスクは sdlog_*() でレコードを 512 バイトのバッファへ詰めるだけで待たない。
+ * バッファは 2 面。満杯になった面を一番低い優先度の書き込みタスクが
+ * DMA でカードへ書き、その間はもう一方の面へ詰める。両方とも書き出し待ちなら
+ * レコードは捨てて数える (制御側を止めない)。
+ * 満杯にならなくても SDLOG_FLUSH_MS ごとに途中まで書く (同じ LBA を後で上書き)。
+ *
+ * カードはログ専用にする。FAT もパーティションも見ずに SDLOG_LBA_BASE から上書きするので、
+ * 普通にフォーマットしたカードはファイルシステムが壊れる。
+ *
+ * カード上の形式 (FAT なし、tools/sdlog_dump.py で読む。数値はリトルエンディアン):
+ *   LBA = SDLOG_LBA_BASE + seq % N のリング。
+ *   N = SDLOG_LBA_COUNT と (カードの容量 - SDLOG_LBA_BASE) の小さい方 (CSD から)
+ *   ヘッダ 16 バイト
+ *     u32 magic "SDLG"   u32 seq   u32 t_ms (先頭レコードの時刻)
+ *     u16 used (ヘッダ込み)   u16 CRC-16/CCITT (ヘッダの先頭 14 バイト + レコード部)
+ *   レコード: u8 type, u16 dt_ms (直前のレコードから。ブロックの先頭は t_ms から)
+ *     CTRL    i16 temp_x100, i16 sp_x100, u16 duty (0-10000)
+ *     SENSOR  i16 temp_x100, u16 humi_x100, u32 pres_x100
+ *     STATUS  u8 len, 文字列 (NUL なし)
+ *     BOOT    なし (起動ごとに 1 個)
+ *   type 0 以降はブロックの残り (0 埋め)
+ * 起動時はリングを二分探索して続きの seq から書く。
+ *
+ * USE_SDLOG 0 では sdlog_*() は何もしないマクロになる。
+ */
+
+#ifndef SD_LOG_H
+#define SD_LOG_H
+
+#include "app_config.h"
+
+#if USE_SDLOG
+
+/* 先頭 1MB は空け、その後ろ最大 512MB をリングにする (カードが小さければカードの終わりまで) */
+#ifndef SDLOG_LBA_BASE
+#define SDLOG_LBA_BASE      2048UL
+#endif
+#ifndef SDLOG_LBA_COUNT
+#define SDLOG_LBA_COUNT     (1024UL * 1024UL)
+#endif
+#ifndef SDLOG_FLUSH_MS
+#define SDLOG_FLUSH_MS      5000
+#endif
+#define SDLOG_RETRY_MS      10000   /* カードがなければこの間隔で初期化し直す */
+#define SDLOG_STATUS_MAX    48
+
+#define SDLOG_MAGIC         0x474C4453UL    /* "SDLG" */
+#define SDLOG_HDR_SIZE      16
+
+enum {
+    SDLOG_T_PAD = 0,
+    SDLOG_T_BOOT,
+    SDLOG_T_CTRL,
+    SDLOG_T_SENSOR,
+    SDLOG_T_STATUS
+};
+
+/* 書き込みタスクを作る (スケジューラ開始前に呼ぶ)。カードの初期化はタスクの中 */
+void sdlog_init(void);
+void sdlog_ctrl(long temp_x100, long sp_x100, long duty);
+void sdlog_sensor(long temp_x100, long humi_x100, long pres_x100);
+void sdlog_status(const char *msg);
+
+typedef struct {
+    unsigned long records;          /* バッファへ入れた */
+    unsigned long dropped;          /* 両方の面が書き出し待ちで捨てた */
+    unsigned long blocks;           /* 満杯で書いたブロック */
+    unsigned long flushes;          /* 途中まで書いた回数 */
+    unsigned long errors;           /* 初期化 / 書き込みの失敗 */
+    unsigned long next_seq;
+    unsigned long ring_blocks;      /* リングのブロック数 (0 = カードなし / 小さすぎる) */
+    unsigned long write_max_ms;     /* 1 ブロックの書き込みの最大 */
+    int           card_ok;
+} sdlog_stats_t;
+
+void sdlog_get_stats(sdlog_stats_t *out);
+
+#else
+
+#define sdlog_init()                ((void)0)
+#define sdlog_ctrl(t, sp, duty)     ((void)0)
+#define sdlog_sensor(t, h, p)       ((void)0)
+#define sdlog_status(msg)           ((void)0)
+
+#endif /* USE_SDLOG */
+
+#endif /* SD_LOG_H */
@@ -0,0 +1,170 @@
+/*
+ * sd_spi.c - microSD スロットの SPI (RSPI0 + DMAC0, 手順は sd_spi.h)
+ *
+ * GR-SAKURA の配線: PC5 = RSPCKA, PC6 = MOSIA, PC7 = MISOA (Arduino の D13 / D11 / D12 と共用)
+ * SPI モード 0 (CPOL = 0, CPHA = 0), MSB 先頭。SSL は使わず CS をポートで動かす。
+ */
+
+#include "iodefine.h"
+#include "sd_spi.h"
+#include "task.h"
+#include "semphr.h"
+
+#define CS_PODR             SD_CS_PORT.PODR.BIT.SD_CS_BIT
+#define CS_PDR              SD_CS_PORT.PDR.BIT.SD_CS_BIT
+
+/* SPCMD0: CPHA = 0, CPOL = 0, BRDV = 0, SSLKP = 1 */
+#define SPCMD_8BIT          0x0780      /* SPB = 0111 */
+#define SPCMD_32BIT         0x0280      /* SPB = 0010 */
+
+static SemaphoreHandle_t dma_sem = NULL;
+static unsigned long dma_buf[SD_BLOCK_SIZE / 4];
+
+void sd_spi_init(void)
+{
+    /* sd_card_init() はカードが無い間も繰り返し呼ばれるので、セマフォは最初の 1 回だけ */
+    if (dma_sem == NULL) {
+        dma_sem = xSemaphoreCreateBinary();
+    }
+
+    /* モジュールストップ解除: RSPI0, DMAC */
+    SYSTEM.PRCR.WORD = 0xA502;
+    SYSTEM.MSTPCRB.BIT.MSTPB17 = 0;
+    SYSTEM.MSTPCRA.BIT.MSTPA28 = 0;
+    SYSTEM.PRCR.WORD = 0xA500;
+
+    /* CS: 出力 High (非選択) */
+    CS_PODR = 1;
+    CS_PDR = 1;
+
+    /* MPC: PC5 / PC6 / PC7 → RSPI0 (PSEL = 0x0D) */
+    MPC.PWPR.BIT.B0WI = 0;
+    MPC.PWPR.BIT.PFSWE = 1;
+    MPC.PC5PFS.BIT.PSEL = 0x0D;
+    MPC.PC6PFS.BIT.PSEL = 0x0D;
+    MPC.PC7PFS.BIT.PSEL = 0x0D;
+    MPC.PWPR.BIT.PFSWE = 0;
+    MPC.PWPR.BIT.B0WI = 1;
+    PORTC.PMR.BYTE |= 0xE0;
+
+    RSPI0.SPCR.BYTE = 0x00;
+    RSPI0.SPPCR.BYTE = 0x30;            /* MOSI のアイドルは High (MOIFV = 1, MOIFE = 1) */
+    RSPI0.SPBR = SD_SPBR_INIT;
+    RSPI0.SPDCR.BYTE = 0x00;            /* フレーム 1 つ, SPDR はワードアクセス */
+    RSPI0.SPSCR.BYTE = 0x00;            /* SPCMD0 だけ */
+    RSPI0.SPCKD.BYTE = 0x00;
+    RSPI0.SSLND.BYTE = 0x00;
+    RSPI0.SPND.BYTE = 0x00;
+    RSPI0.SPCR2.BYTE = 0x00;
+    RSPI0.SPCMD0.WORD = SPCMD_8BIT;
+
+    /* 受信は IR フラグだけ見る (IER は立てない) */
+    IR(RSPI0, SPRI0) = 0;
+    RSPI0.SPCR.BYTE = 0x88;             /* SPRIE | MSTR */
+    RSPI0.SPCR.BIT.SPE = 1;
+
+    /* DMAC0: SPTI0 起動, 32 ビット, 転送元だけ進める */
+    DMAC.DMAST.BIT.DMST = 0;
+    DMAC0.DMCNT.BIT.DTE = 0;
+    ICU.DMRSR0 = VECT(RSPI0, SPTI0);
+    DMAC0.DMAMD.WORD = 0x8000;          /* SM = 10 (加算), DM = 00 (固定) */
+    DMAC0.DMTMD.WORD = 0x2201;          /* ノーマル, SZ = 32 ビット, DCTG = 周辺 */
+    DMAC0.DMINT.BYTE = 0x10;            /* DTIE */
+    DMAC.DMAST.BIT.DMST = 1;
+
+    IPR(DMAC, DMAC0I) = 3;              /* 優先度3 (configMAX_SYSCALL_INTERRUPT_PRIORITY以下) */
+    IR(DMAC, DMAC0I) = 0;
+    IEN(DMAC, DMAC0I) = 1;
+}
+
+void sd_spi_set_fast(int fast)
+{
+    RSPI0.SPCR.BIT.SPE = 0;
+    RSPI0.SPBR = fast ? SD_SPBR_FAST : SD_SPBR_INIT;
+    RSPI0.SPCR.BIT.SPE = 1;
+}
+
+void sd_spi_select(int on)
+{
+    CS_PODR = on ? 0 : 1;
+}
+
+unsigned char sd_spi_xfer(unsigned char out)
+{
+    RSPI0.SPDR.WORD.H = out;
+    while (IR(RSPI0, SPRI0) == 0)
+        ;
+    IR(RSPI0, SPRI0) = 0;
+    return (unsigned char)RSPI0.SPDR.WORD.H;
+}
+
+void sd_spi_recv(unsigned char *buf, unsigned int n)
+{
+    while (n--) {
+        *buf++ = sd_spi_xfer(0xFF);
+    }
+}
+
+int sd_spi_send_block(const unsigned char *buf)
+{
+    unsigned int i;
+    int ok;
+
+    /* MSB 先頭の 32 ビットフレームでバイト順どおりに出るよう並べ替える */
+    for (i = 0; i < SD_BLOCK_SIZE / 4; i++) {
+        const unsigned char *p = buf + i * 4;
+        dma_buf[i] = ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) |
+                     ((unsigned long)p[2] << 8) | p[3];
+    }
+
+    RSPI0.SPCR.BIT.SPE = 0;
+    RSPI0.SPCMD0.WORD = SPCMD_32BIT;
+    RSPI0.SPDCR.BIT.SPLW = 1;
+
+    DMAC0.DMSAR = (void *)dma_buf;
+    DMAC0.DMDAR = (void *)&RSPI0.SPDR.LONG;
+    DMAC0.DMCRA = SD_BLOCK_SIZE / 4;
+    DMAC0.DMSTS.BYTE = 0x00;
+    DMAC0.DMCNT.BIT.DTE = 1;
+
+    /* SPTI0 は CPU ではなく DMAC へ (DMRSR0)。IER は起動元として要る */
+    IR(RSPI0, SPTI0) = 0;
+    IEN(RSPI0, SPTI0) = 1;
+    RSPI0.SPCR.BYTE = 0x6A;             /* SPTIE | SPE | MSTR | TXMD */
+
+    ok = xSemaphoreTake(dma_sem, pdMS_TO_TICKS(SD_DMA_TIMEOUT_MS)) == pdTRUE;
+
+    /* 最後のフレームがシフトアウトされるまで */
+    while (ok && RSPI0.SPSR.BIT.IDLNF)
+        ;
+
+    RSPI0.SPCR.BYTE = 0x00;
+    IEN(RSPI0, SPTI0) = 0;
+    IR(RSPI0, SPTI0) = 0;
+    DMAC0.DMCNT.BIT.DTE = 0;
+    if (!ok) {
+        /* タイムアウト後に遅れて来た完了を捨てる (残ると次のブロックが DMA の終わりを待たない) */
+        IR(DMAC, DMAC0I) = 0;
+        DMAC0.DMSTS.BIT.DTIF = 0;
+        xSemaphoreTake(dma_sem, 0);
+    }
+
+    RSPI0.SPDCR.BIT.SPLW = 0;
+    RSPI0.SPCMD0.WORD = SPCMD_8BIT;
+    IR(RSPI0, SPRI0) = 0;
+    RSPI0.SPCR.BYTE = 0x88;
+    RSPI0.SPCR.BIT.SPE = 1;
+
+    return ok ? 0 : -1;
+}
+
+void sd_spi_dma_isr(void)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    DMAC0.DMSTS.BIT.DTIF = 0;
+    if (dma_sem != NULL) {
+        xSemaphoreGiveFromISR(dma_sem, &xHigherPriorityTaskWoken);
+    }
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
@@ -0,0 +1,45 @@
+/*
+ * sd_spi.h - microSD スロットの SPI (RSPI0 + DMAC0)
+ *
+ * 1 バイトずつの転送はポーリング (コマンド / 応答 / 読み出し)。
+ * 512 バイトのブロック送信だけ DMAC0 で送り、終わるまでタスクは待つ。
+ * RX63N の RSPI はバイト単位で SPDR を読み書きできないので、ブロック送信は
+ * 32 ビットフレーム (MSB 先頭) に切り替え、4 バイトずつ並べ替えて渡す。
+ * 送信専用モード (TXMD) なので受信側のオーバーランは起きない。
+ *
+ * sd_card.c だけが使う。ホスト (sim/) では sd_card.h ごと差し替える。
+ */
+
+#ifndef SD_SPI_H
+#define SD_SPI_H
+
+#include "FreeRTOS.h"
+
+#define SD_BLOCK_SIZE       512
+
+/* RSPI0, CS はポート出力 (GR-SAKURA の回路図でスロットの CS を確認して合わせる) */
+#ifndef SD_CS_PORT
+#define SD_CS_PORT          PORTC
+#define SD_CS_BIT           B0
+#endif
+
+/* PCLKB 50MHz / (2 × (SPBR + 1)) */
+#define SD_SPBR_INIT        62          /* 397kHz (初期化は 400kHz 以下) */
+#define SD_SPBR_FAST        1           /* 12.5MHz */
+
+#define SD_DMA_TIMEOUT_MS   20          /* 512 バイト @ 397kHz でも 11ms */
+
+/* ピン / RSPI0 / DMAC0 を初期化し、低速にする。何度呼んでもよい (ISR 用のセマフォは最初の 1 回だけ作る) */
+void sd_spi_init(void);
+void sd_spi_set_fast(int fast);
+void sd_spi_select(int on);
+unsigned char sd_spi_xfer(unsigned char out);
+/* 0xFF を送りながら n バイト受け取る */
+void sd_spi_recv(unsigned char *buf, unsigned int n);
+/* 512 バイトを DMA で送る。0 = OK, -1 = タイムアウト */
+int  sd_spi_send_block(const unsigned char *buf);
+
+/* 割り込みハンドラ (inthandler.c の INT_Excep_DMAC_DMAC0I から呼ばれる) */
+void sd_spi_dma_isr(void);
+
+#endif /* SD_SPI_H */
@@ -8,6 +8,7 @@
 #include "status_task.h"
 #include "json_builder.h"
 #include "sci2_uart.h"
+#include "net_task.h"
 #include "iodefine.h"
 
 static int led_state = 0;
@@ -40,5 +41,6 @@ void status_task(void *pvParameters)
             json_build_status(&jb, "OK");
         }
         sci2_puts(jb.buf);
+        net_publish(&jb);
     }
 }
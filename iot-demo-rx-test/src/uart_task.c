@@ -1,26 +1,46 @@
 /*
  * uart_task.c - UART 受信/送信タスク (優先度3)
  *
- * ESP32からのJSONを受信し、センサーデータまたはコマンドを処理
+ * ESP32からのJSONを受信し、センサーデータ・コマンド・ボーレート交渉を処理
+ * (Ethernet 有効時は受け取ったセンサー値も net_publish で配信)
+ * sbatch (まとめ送り) は 1 サンプルずつ SD ログへ、最後のサンプルを g_sensor へ。
+ * Ethernet へは sbatch の行のまま流す (dashboard/server.py が展開する)
  */
 
 #include "app_config.h"
 #include "uart_task.h"
 #include "sci2_uart.h"
 #include "json_parser.h"
-#include <string.h>
+#include "json_builder.h"
+#include "baud_neg.h"
+#include "cmd_exec.h"
+#include "net_task.h"
+#include "sd_log.h"
+
+static void store_sensor(long temp_x100, long humi_x100, long pres_x100)
+{
+    if (xSemaphoreTake(g_data_mutex, pdMS_TO_TICKS(50)) == pdTRUE) {
+        g_sensor.temp_x100 = temp_x100;
+        g_sensor.humi_x100 = humi_x100;
+        g_sensor.pres_x100 = pres_x100;
+        g_sensor.timestamp = xTaskGetTickCount();
+        xSemaphoreGive(g_data_mutex);
+    }
+}
 
 void uart_task(void *pvParameters)
 {
     char line[JSON_BUF_SIZE];
     json_parsed_t parsed;
+    json_buf_t jb;
 
     (void)pvParameters;
 
     for (;;) {
         g_task_alive_bits |= ALIVE_UART;
 
-        int len = sci2_readline(line, sizeof(line), SENSOR_TIMEOUT_MS);
+        int len = sci2_readline(line, sizeof(line), baud_neg_timeout_ms());
+        baud_neg_poll();
         if (len <= 0) {
             /* タイムアウト: センサーデータ受信なし */
             continue;
@@ -28,32 +48,39 @@ void uart_task(void *pvParameters)
 
         if (json_parse(line, &parsed) != 0)
             continue;
+        baud_neg_rx_ok();
 
-        if (parsed.type == JP_TYPE_SENSOR) {
-            if (xSemaphoreTake(g_data_mutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-                g_sensor.temp_x100 = parsed.temp_x100;
-                g_sensor.humi_x100 = parsed.humi_x100;
-                g_sensor.pres_x100 = parsed.pres_x100;
-                g_sensor.timestamp = xTaskGetTickCount();
-                xSemaphoreGive(g_data_mutex);
+        if (parsed.type == JP_TYPE_BAUD) {
+            baud_neg_handle(&parsed);
+        } else if (parsed.type == JP_TYPE_SENSOR) {
+            store_sensor(parsed.temp_x100, parsed.humi_x100, parsed.pres_x100);
+            sdlog_sensor(parsed.temp_x100, parsed.humi_x100, parsed.pres_x100);
+            if (net_enabled()) {
+                json_build_sensor(&jb, parsed.temp_x100, parsed.humi_x100, parsed.pres_x100);
+                net_publish(&jb);
+            }
+        } else if (parsed.type == JP_TYPE_SBATCH) {
+            json_sbatch_t it;
+            long t, h, p;
+            int got = 0;
+
+            json_sbatch_begin(&it, &parsed);
+            while (json_sbatch_next(&it, &t, &h, &p) > 0) {
+                sdlog_sensor(t, h, p);
+                got = 1;
+            }
+            if (got) store_sensor(t, h, p);
+            if (net_enabled()) {
+                json_build_line(&jb, line);
+                net_publish(&jb);
             }
         } else if (parsed.type == JP_TYPE_CMD) {
-            if (strcmp(parsed.cmd, "set_pid") == 0) {
-                if (xSemaphoreTake(g_data_mutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-                    if (parsed.kp > 0) g_kp = parsed.kp;
-                    if (parsed.ki > 0) g_ki = parsed.ki;
-                    if (parsed.kd > 0) g_kd = parsed.kd;
-                    xSemaphoreGive(g_data_mutex);
-                }
-            } else if (strcmp(parsed.cmd, "set_target") == 0) {
-                if (xSemaphoreTake(g_data_mutex, pdMS_TO_TICKS(50)) == pdTRUE) {
-                    if (parsed.sp_x100 > 0) g_setpoint = parsed.sp_x100;
-                    xSemaphoreGive(g_data_mutex);
-                }
-            } else if (strcmp(parsed.cmd, "stop") == 0) {
-                g_emergency_stop = 1;
-            } else if (strcmp(parsed.cmd, "start") == 0) {
-                g_emergency_stop = 0;
+            int ok = cmd_exec(&parsed);
+
+            /* "cid" 付きコマンドは処理後に ack (サーバーの往復時間計測用) */
+            if (parsed.cid >= 0) {
+                json_build_ack(&jb, parsed.cid, ok);
+                sci2_puts(jb.buf);
             }
         }
     }
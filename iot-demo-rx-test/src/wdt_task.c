@@ -9,6 +9,9 @@
 #include "wdt_task.h"
 #include "json_builder.h"
 #include "sci2_uart.h"
+#include "net_task.h"
+#include "sd_log.h"
+#include "fw_update.h"
 
 void wdt_task(void *pvParameters)
 {
@@ -25,6 +28,13 @@ void wdt_task(void *pvParameters)
     for (;;) {
         vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(5000));
 
+#if FW_UPDATE
+        /* 更新要求から 1 周期以上経っている: ack は送り終えている */
+        if (fw_update_pending()) {
+            fw_update_reboot();
+        }
+#endif
+
         unsigned long bits = g_task_alive_bits;
 
         if ((bits & ALIVE_ALL) != ALIVE_ALL) {
@@ -33,6 +43,8 @@ void wdt_task(void *pvParameters)
                 g_emergency_stop = 1;
                 json_build_status(&jb, "WDT_TASK_DEAD");
                 sci2_puts(jb.buf);
+                net_publish(&jb);
+                sdlog_status("WDT_TASK_DEAD");
             }
         }
 
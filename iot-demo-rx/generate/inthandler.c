@@ -13,6 +13,10 @@
 
 #include "interrupt_handlers.h"
 #include "../src/cmt_timer.h"
+#include "../src/sci0_uart.h"
+#ifdef USE_ADC_FAST
+#include "../src/adc_fast.h"
+#endif
 
 /* INT_Exception(Supervisor Instruction)*/
 void INT_Excep_SuperVisorInst(void){/* brk(); */}
@@ -210,7 +214,11 @@ void INT_Excep_RTC_PRD(void){ }
 void INT_Excep_AD_ADI0(void){ }
 
 /* S12AD S12ADI0*/
+#ifdef USE_ADC_FAST
+void INT_Excep_S12AD_S12ADI0(void){ adc_fast_isr(); }
+#else
 void INT_Excep_S12AD_S12ADI0(void){ }
+#endif
 
 /* ICU GROUP0*/
 void INT_Excep_ICU_GROUP0(void){ }
@@ -555,7 +563,7 @@ void INT_Excep_SCI1_TEI1(void){ }
 void INT_Excep_SCI2_RXI2(void){ }
 
 /* SCI2 TXI2*/
-void INT_Excep_SCI2_TXI2(void){ }
+void INT_Excep_SCI2_TXI2(void){ sci0_txi_isr(); }
 
 /* SCI2 TEI2*/
 void INT_Excep_SCI2_TEI2(void){ }
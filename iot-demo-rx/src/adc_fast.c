@@ -0,0 +1,195 @@
+/*
+ * adc_fast.c - S12AD 高速サンプリング (サーミスタ + ヒーター電流シャント)
+ *
+ * TMR0: PCLKB/64 = 781.25kHz, TCORA = 249 → 3125Hz, TCSR.ADTE で A/D 起動
+ * S12AD: シングルスキャン AN000-AN001, TMR0 同期トリガ, スキャン終了で S12ADI0
+ * DTC: ブロック転送 (2 ワード/ブロック, 転送元 ADDR0-ADDR1 をブロック領域)
+ *      ADC_FAST_BLOCK ブロックで CRB=0 → S12ADI0 が CPU に通知され面を切替
+ */
+
+#include "iodefine.h"
+#include "dtc.h"
+#include "adc_fast.h"
+
+#define S12ADI0_VECT    VECT(S12AD, S12ADI0)
+
+/* ADSTRGR.ADSTRS: TMR0 コンペアマッチ A (TMTRG0AN_0) */
+#define ADSTRS_TMR0     0x09
+
+#define RAW_OPEN        4000    /* これ以上: サーミスタ断線 */
+#define RAW_SHORT       50      /* これ以下: サーミスタ短絡 */
+
+static unsigned short adc_buf[2][ADC_FAST_BLOCK * ADC_FAST_CHANNELS];
+static volatile int   adc_active = 0;       /* DTC が書き込み中の面 */
+static volatile int   adc_ready[2];         /* 1 = 間引き待ち */
+static volatile int   adc_faults = 0;
+static unsigned long  adc_seq = 0;
+
+static dtc_info_t dtc_adc_info __attribute__((aligned(4)));
+
+/* 10kΩ NTC (B=3435) + 10kΩ プルアップ: -20℃ から 10℃ 刻みの ADC 値 */
+static const unsigned short ntc_table[] = {
+    3628, 3368, 3038, 2654, 2249, 1854, 1497, 1191,
+     941,  741,  584,  462,  368,  295,  238
+};
+#define NTC_POINTS  (int)(sizeof(ntc_table) / sizeof(ntc_table[0]))
+#define NTC_T0_X100 (-2000L)
+#define NTC_STEP    1000L
+
+static long ntc_to_x100(long raw)
+{
+    int i;
+
+    if (raw >= ntc_table[0])
+        return NTC_T0_X100;
+
+    for (i = 0; i < NTC_POINTS - 1; i++) {
+        if (raw >= ntc_table[i + 1]) {
+            long span = ntc_table[i] - ntc_table[i + 1];
+            return NTC_T0_X100 + NTC_STEP * i +
+                   (ntc_table[i] - raw) * NTC_STEP / span;
+        }
+    }
+    return NTC_T0_X100 + NTC_STEP * (NTC_POINTS - 1);
+}
+
+/* 指定面を DTC の書き込み先にする */
+static void dtc_arm(int side)
+{
+    dtc_adc_info.mode  = DTC_MODE(DTC_MRA_MD_BLOCK | DTC_MRA_SZ_WORD |
+                                  DTC_MRA_SM_INC,
+                                  DTC_MRB_DTS | DTC_MRB_DM_INC);
+    dtc_adc_info.sar   = (unsigned long)&S12AD.ADDR0;
+    dtc_adc_info.dar   = (unsigned long)adc_buf[side];
+    /* CRA: ブロックサイズ (上位=リロード値, 下位=カウンタ), CRB: ブロック数 */
+    dtc_adc_info.count = DTC_COUNT((ADC_FAST_CHANNELS << 8) | ADC_FAST_CHANNELS,
+                                   ADC_FAST_BLOCK);
+    adc_active = side;
+    DTCE(S12AD, S12ADI0) = 1;
+}
+
+void adc_fast_isr(void)
+{
+    int done = adc_active;
+    int next = done ^ 1;
+
+    /* 前回のブロックがまだ間引かれていない: 上書きする */
+    if (adc_ready[next]) {
+        adc_ready[next] = 0;
+        adc_faults |= ADC_FAULT_OVERRUN;
+    }
+    dtc_arm(next);
+    adc_ready[done] = 1;
+}
+
+void adc_fast_init(void)
+{
+    /* ---- モジュールストップ解除 ---- */
+    SYSTEM.PRCR.WORD = 0xA502;
+    SYSTEM.MSTPCRA.BIT.MSTPA17 = 0;  /* S12AD */
+    SYSTEM.MSTPCRA.BIT.MSTPA5 = 0;   /* TMR0/TMR1 */
+    SYSTEM.PRCR.WORD = 0xA500;
+
+    /* ---- ピン機能設定: P40/P41 をアナログ入力 ---- */
+    PORT4.PDR.BIT.B0 = 0;
+    PORT4.PDR.BIT.B1 = 0;
+    PORT4.PMR.BIT.B0 = 0;
+    PORT4.PMR.BIT.B1 = 0;
+    MPC.PWPR.BIT.B0WI = 0;
+    MPC.PWPR.BIT.PFSWE = 1;
+    MPC.P40PFS.BIT.ASEL = 1;
+    MPC.P41PFS.BIT.ASEL = 1;
+    MPC.PWPR.BIT.PFSWE = 0;
+    MPC.PWPR.BIT.B0WI = 1;
+
+    /* ---- S12AD: AN000-AN001 シングルスキャン, TMR0 同期トリガ ---- */
+    S12AD.ADCSR.BYTE = 0x00;
+    S12AD.ADANS0.WORD = 0x0003;
+    S12AD.ADADS0.WORD = 0x0000;      /* 加算なし */
+    S12AD.ADCER.WORD = 0x0000;       /* 右詰め, 自動クリアなし */
+    S12AD.ADSTRGR.BIT.ADSTRS = ADSTRS_TMR0;
+    S12AD.ADCSR.BIT.CKS = 3;         /* PCLK */
+    S12AD.ADCSR.BIT.ADIE = 1;        /* スキャン終了で S12ADI0 */
+    S12AD.ADCSR.BIT.EXTRG = 0;       /* 同期トリガ */
+    S12AD.ADCSR.BIT.TRGE = 1;
+
+    /* ---- DTC: S12ADI0 起動, 面 0 から ---- */
+    adc_ready[0] = 0;
+    adc_ready[1] = 0;
+    dtc_init();
+    dtc_set_vector(S12ADI0_VECT, &dtc_adc_info);
+    dtc_arm(0);
+
+    IPR(S12AD, S12ADI0) = 6;
+    IR(S12AD, S12ADI0) = 0;
+    IEN(S12AD, S12ADI0) = 1;
+
+    /* ---- TMR0: 3125Hz, コンペアマッチ A でクリア + A/D 起動 ---- */
+    TMR0.TCR.BYTE = 0x00;
+    TMR0.TCR.BIT.CCLR = 1;           /* コンペアマッチ A でクリア */
+    TMR0.TCORA = 249;                /* 781250 / 250 = 3125Hz */
+    TMR0.TCNT = 0;
+    TMR0.TCSR.BIT.ADTE = 1;
+    TMR0.TCCR.BIT.CKS = 4;           /* PCLK/64 */
+    TMR0.TCCR.BIT.CSS = 1;           /* 内部クロック: カウント開始 */
+}
+
+void adc_fast_process_block(const unsigned short *blk, int nsamples,
+                            adc_fast_data_t *out)
+{
+    unsigned long sum_t = 0, sum_i = 0;
+    unsigned short peak = 0;
+    long raw_t;
+    int i;
+
+    if (nsamples <= 0)
+        return;
+
+    for (i = 0; i < nsamples; i++) {
+        unsigned short t = blk[2 * i] & 0x0FFF;
+        unsigned short c = blk[2 * i + 1] & 0x0FFF;
+
+        sum_t += t;
+        sum_i += c;
+        if (c > peak)
+            peak = c;
+    }
+
+    raw_t = (long)(sum_t / (unsigned long)nsamples);
+    out->temp_x100  = ntc_to_x100(raw_t);
+    out->current_ma = (long)(sum_i / (unsigned long)nsamples) *
+                      ADC_SHUNT_UA_PER_LSB / 1000;
+    out->peak_ma    = (long)peak * ADC_SHUNT_UA_PER_LSB / 1000;
+    out->seq        = adc_seq++;
+
+    if (raw_t > RAW_OPEN || raw_t < RAW_SHORT)
+        adc_faults |= ADC_FAULT_SENSOR;
+    else if (out->temp_x100 > ADC_FAST_TEMP_LIMIT)
+        adc_faults |= ADC_FAULT_OVERTEMP;
+    if (out->peak_ma > ADC_FAST_CURRENT_LIMIT)
+        adc_faults |= ADC_FAULT_OVERCURRENT;
+}
+
+int adc_fast_poll(adc_fast_data_t *out)
+{
+    int side;
+
+    for (side = 0; side < 2; side++) {
+        if (adc_ready[side] && side != adc_active) {
+            adc_fast_process_block(adc_buf[side], ADC_FAST_BLOCK, out);
+            adc_ready[side] = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int adc_fast_faults(void)
+{
+    return adc_faults;
+}
+
+void adc_fast_clear_faults(void)
+{
+    adc_faults = 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * adc_fast.h - S12AD 高速サンプリング (サーミスタ + ヒーター電流シャント)
+ *
+ * AN000 (P40, GR-SAKURA A0) = サーミスタ分圧 (10kΩ NTC, 10kΩ プルアップ)
+ * AN001 (P41, GR-SAKURA A1) = ヒーター電流シャントアンプ出力
+ *
+ * TMR0 コンペアマッチ A で 3125Hz ごとにスキャン開始
+ * スキャン終了 (S12ADI0) で DTC が ADDR0/ADDR1 をブロックバッファへ転送
+ * 1 ブロック (ADC_FAST_BLOCK サンプル) 完了ごとに面を切り替え、
+ * 埋まった面は adc_fast_poll() でメインループから間引き処理する
+ */
+
+#ifndef ADC_FAST_H
+#define ADC_FAST_H
+
+#define ADC_FAST_RATE_HZ    3125    /* PCLKB/64 / 250 */
+#define ADC_FAST_BLOCK      125     /* 1 ブロック = 40ms → 25Hz に間引き */
+#define ADC_FAST_CHANNELS   2
+
+/* シャント換算: 電流[mA] = raw × ADC_SHUNT_UA_PER_LSB / 1000 */
+/* 0.05Ω + 増幅 20 倍, 3.3V/4096: 3300000/4096/20/0.05 = 805 uA/LSB */
+#define ADC_SHUNT_UA_PER_LSB    805
+
+/* 保護しきい値 (間引き後の値で判定) */
+#define ADC_FAST_TEMP_LIMIT     8000    /* 80.00℃ */
+#define ADC_FAST_CURRENT_LIMIT  3000    /* 3000mA (ピーク) */
+
+/* 間引き後のサンプル (25Hz) */
+typedef struct {
+    long          temp_x100;    /* サーミスタ温度 × 100 (ブロック平均) */
+    long          current_ma;   /* ヒーター電流 (ブロック平均) */
+    long          peak_ma;      /* ヒーター電流 (ブロック最大) */
+    unsigned long seq;          /* ブロック番号 */
+} adc_fast_data_t;
+
+/* 故障フラグ */
+#define ADC_FAULT_OVERTEMP      (1 << 0)
+#define ADC_FAULT_OVERCURRENT   (1 << 1)
+#define ADC_FAULT_SENSOR        (1 << 2)    /* サーミスタ断線 / 短絡 */
+#define ADC_FAULT_OVERRUN       (1 << 3)    /* 間引きが 1 ブロック以上遅れた */
+
+/* ヒーターを止めるべき故障 */
+#define ADC_FAULT_TRIP  (ADC_FAULT_OVERTEMP | ADC_FAULT_OVERCURRENT | \
+                         ADC_FAULT_SENSOR)
+
+void adc_fast_init(void);
+
+/* 埋まったブロックがあれば間引きして 1 を返す (メインループから呼ぶ) */
+int  adc_fast_poll(adc_fast_data_t *out);
+
+/* 1 ブロック分の生データ (AN000, AN001 の交互並び) を間引く
+ * adc_fast_poll() の内部処理。ホスト側のモックから合成データを流し込む
+ * 場合もこの関数を直接呼ぶ */
+void adc_fast_process_block(const unsigned short *blk, int nsamples,
+                            adc_fast_data_t *out);
+
+/* 故障フラグ (ADC_FAULT_*) の取得とクリア */
+int  adc_fast_faults(void);
+void adc_fast_clear_faults(void);
+
+/* 割り込みハンドラから呼ばれる (inthandler.c から使用) */
+void adc_fast_isr(void);
+
+#endif /* ADC_FAST_H */
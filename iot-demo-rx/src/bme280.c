@@ -2,7 +2,16 @@
  * bme280.c - BME280 センサードライバ
  *
  * Bosch BME280 の補正アルゴリズムをデータシートに基づいて実装
- * 32bit 整数演算のみ使用 (FPU 不要)
+ * 32bit 整数演算のみ使用 (FPU 不要, BME280_PRESS_64 のときだけ 64bit)
+ *
+ * bme280_compensate はデータシートの式 (bme280_compensate_ref) と全入力で
+ * ビット単位で同じ結果を返す。変えたのは:
+ *   - 較正値のシフトや定数項 (T1 << 1, P4 << 16, P5 << 1, 16384 - (H4 << 20) など) は
+ *     bme280_coef_init で 1 回だけ計算する。(a * b) << n は a * (b << n) と同じ
+ *     (2 の補数で下位ビットは変わらない)
+ *   - 同じ式の 2 回目 ((var1 >> 2) の 2 乗, (adc_T >> 4) - T1) は 1 回にする
+ *   - t_fine は static 変数ではなく関数内の変数にする
+ *   - 湿度の Q22.10 → % × 100 (h * 100 / 1024) は h * 25 >> 8 にする
  */
 
 #include "soft_i2c.h"
@@ -21,105 +30,236 @@
 
 #define BME280_CHIP_ID          0x60
 
-/* I2C アドレス (bme280_init で設定) */
-static unsigned char g_addr;
-
-/* 補正パラメータ */
-static unsigned short dig_T1;
-static short          dig_T2, dig_T3;
-static unsigned short dig_P1;
-static short          dig_P2, dig_P3, dig_P4, dig_P5;
-static short          dig_P6, dig_P7, dig_P8, dig_P9;
-static unsigned char  dig_H1, dig_H3;
-static short          dig_H2, dig_H4, dig_H5;
-static signed char    dig_H6;
-
-/* t_fine: 温度補正で使用するグローバル変数 */
-static long t_fine;
-
 /* --- レジスタ読み書き --- */
 
-static int reg_read(unsigned char reg, unsigned char *buf, int len)
+static int reg_read(unsigned char addr, unsigned char reg, unsigned char *buf, int len)
 {
-    return i2c_write_read(g_addr, &reg, 1, buf, len);
+    return i2c_write_read(addr, &reg, 1, buf, len);
 }
 
-static int reg_write(unsigned char reg, unsigned char val)
+static int reg_write(unsigned char addr, unsigned char reg, unsigned char val)
 {
     unsigned char buf[2];
     buf[0] = reg;
     buf[1] = val;
-    return i2c_write(g_addr, buf, 2);
+    return i2c_write(addr, buf, 2);
 }
 
 /* --- 補正パラメータ読み出し --- */
 
-static int read_calibration(void)
+static int read_calibration(unsigned char addr, bme280_calib_t *cal)
 {
     unsigned char buf[26];
     unsigned char buf2[7];
 
     /* calib00-25 (0x88-0xA1) */
-    if (reg_read(BME280_REG_CALIB00, buf, 26) != 0)
+    if (reg_read(addr, BME280_REG_CALIB00, buf, 26) != 0)
         return -1;
 
-    dig_T1 = (unsigned short)(buf[1] << 8 | buf[0]);
-    dig_T2 = (short)(buf[3] << 8 | buf[2]);
-    dig_T3 = (short)(buf[5] << 8 | buf[4]);
+    cal->dig_T1 = (unsigned short)(buf[1] << 8 | buf[0]);
+    cal->dig_T2 = (short)(buf[3] << 8 | buf[2]);
+    cal->dig_T3 = (short)(buf[5] << 8 | buf[4]);
 
-    dig_P1 = (unsigned short)(buf[7] << 8 | buf[6]);
-    dig_P2 = (short)(buf[9] << 8 | buf[8]);
-    dig_P3 = (short)(buf[11] << 8 | buf[10]);
-    dig_P4 = (short)(buf[13] << 8 | buf[12]);
-    dig_P5 = (short)(buf[15] << 8 | buf[14]);
-    dig_P6 = (short)(buf[17] << 8 | buf[16]);
-    dig_P7 = (short)(buf[19] << 8 | buf[18]);
-    dig_P8 = (short)(buf[21] << 8 | buf[20]);
-    dig_P9 = (short)(buf[23] << 8 | buf[22]);
+    cal->dig_P1 = (unsigned short)(buf[7] << 8 | buf[6]);
+    cal->dig_P2 = (short)(buf[9] << 8 | buf[8]);
+    cal->dig_P3 = (short)(buf[11] << 8 | buf[10]);
+    cal->dig_P4 = (short)(buf[13] << 8 | buf[12]);
+    cal->dig_P5 = (short)(buf[15] << 8 | buf[14]);
+    cal->dig_P6 = (short)(buf[17] << 8 | buf[16]);
+    cal->dig_P7 = (short)(buf[19] << 8 | buf[18]);
+    cal->dig_P8 = (short)(buf[21] << 8 | buf[20]);
+    cal->dig_P9 = (short)(buf[23] << 8 | buf[22]);
 
-    dig_H1 = buf[25];
+    cal->dig_H1 = buf[25];
 
     /* calib26-32 (0xE1-0xE7) */
-    if (reg_read(BME280_REG_CALIB26, buf2, 7) != 0)
+    if (reg_read(addr, BME280_REG_CALIB26, buf2, 7) != 0)
         return -1;
 
-    dig_H2 = (short)(buf2[1] << 8 | buf2[0]);
-    dig_H3 = buf2[2];
-    dig_H4 = (short)((buf2[3] << 4) | (buf2[4] & 0x0F));
-    dig_H5 = (short)((buf2[5] << 4) | (buf2[4] >> 4));
-    dig_H6 = (signed char)buf2[6];
+    cal->dig_H2 = (short)(buf2[1] << 8 | buf2[0]);
+    cal->dig_H3 = buf2[2];
+    cal->dig_H4 = (short)((buf2[3] << 4) | (buf2[4] & 0x0F));
+    cal->dig_H5 = (short)((buf2[5] << 4) | (buf2[4] >> 4));
+    cal->dig_H6 = (signed char)buf2[6];
 
     return 0;
 }
 
-/* --- 補正演算 (Bosch データシートより) --- */
+/* --- 補正係数 --- */
+
+void bme280_coef_init(bme280_coef_t *c, const bme280_calib_t *cal)
+{
+    c->t1   = (long)cal->dig_T1;
+    c->t1x2 = (long)cal->dig_T1 << 1;
+    c->t2   = cal->dig_T2;
+    c->t3   = cal->dig_T3;
+
+    c->p1    = (long)cal->dig_P1;
+    c->p2    = cal->dig_P2;
+    c->p3    = cal->dig_P3;
+    c->p4s16 = (long)((unsigned long)(long)cal->dig_P4 << 16);
+    c->p5x2  = (long)cal->dig_P5 * 2;
+    c->p6    = cal->dig_P6;
+    c->p7    = cal->dig_P7;
+    c->p8    = cal->dig_P8;
+    c->p9    = cal->dig_P9;
+
+    c->h1  = cal->dig_H1;
+    c->h2  = cal->dig_H2;
+    c->h3  = cal->dig_H3;
+    c->h4c = (long)(16384UL - ((unsigned long)(long)cal->dig_H4 << 20));
+    c->h5  = cal->dig_H5;
+    c->h6  = cal->dig_H6;
+
+#if BME280_PRESS_64
+    c->p4s35 = (long long)cal->dig_P4 * ((long long)1 << 35);
+    c->p5s17 = (long long)cal->dig_P5 * ((long long)1 << 17);
+    c->p2s12 = (long long)cal->dig_P2 * ((long long)1 << 12);
+    c->p7s4  = (long long)cal->dig_P7 * 16;
+#endif
+}
+
+/* --- 補正演算 --- */
 
-static long compensate_temp(long adc_T)
+#if BME280_PRESS_64
+
+/* Q24.8 Pa */
+static unsigned long press_comp(const bme280_coef_t *c, long t_fine, long adc_P)
+{
+    long long v1, v2, sq, p;
+
+    v1 = (long long)t_fine - 128000;
+    sq = v1 * v1;
+    v2 = sq * c->p6 + v1 * c->p5s17 + c->p4s35;
+    v1 = ((sq * c->p3) >> 8) + v1 * c->p2s12;
+    v1 = ((((long long)1 << 47) + v1) * c->p1) >> 33;
+    if (v1 == 0)
+        return 0;
+
+    p = 1048576 - adc_P;
+    p = ((p * ((long long)1 << 31) - v2) * 3125) / v1;
+    v1 = (c->p9 * (p >> 13) * (p >> 13)) >> 25;
+    v2 = (c->p8 * p) >> 19;
+    return (unsigned long)(((p + v1 + v2) >> 8) + c->p7s4);
+}
+
+#else
+
+/* Pa */
+static unsigned long press_comp(const bme280_coef_t *c, long t_fine, long adc_P)
+{
+    long v1, v2, sq;
+    unsigned long p;
+
+    v1 = (t_fine >> 1) - 64000;
+    sq = (v1 >> 2) * (v1 >> 2);
+    v2 = ((sq >> 11) * c->p6) + v1 * c->p5x2;
+    v2 = (v2 >> 2) + c->p4s16;
+    v1 = (((c->p3 * (sq >> 13)) >> 3) + ((c->p2 * v1) >> 1)) >> 18;
+    v1 = ((32768 + v1) * c->p1) >> 15;
+    if (v1 == 0)
+        return 0;
+
+    p = (unsigned long)((1048576 - adc_P) - (v2 >> 12)) * 3125;
+    if (p < 0x80000000UL)
+        p = (p << 1) / (unsigned long)v1;
+    else
+        p = (p / (unsigned long)v1) * 2;
+
+    v1 = (c->p9 * (long)(((p >> 3) * (p >> 3)) >> 13)) >> 12;
+    v2 = ((long)(p >> 2) * c->p8) >> 13;
+    return (unsigned long)((long)p + ((v1 + v2 + c->p7) >> 4));
+}
+
+#endif /* BME280_PRESS_64 */
+
+void bme280_compensate(const bme280_coef_t *c, long adc_T, long adc_P, long adc_H,
+                       bme280_data_t *out)
+{
+    long t_fine, d, v;
+
+    /* 温度 */
+    d = (adc_T >> 4) - c->t1;
+    t_fine = ((((adc_T >> 3) - c->t1x2) * c->t2) >> 11) +
+             ((((d * d) >> 12) * c->t3) >> 14);
+    out->temp_x100 = (t_fine * 5 + 128) >> 8;
+
+    /* 気圧: Pa = hPa × 100 */
+#if BME280_PRESS_64
+    out->press_x100 = (long)((press_comp(c, t_fine, adc_P) + 128) >> 8);
+#else
+    out->press_x100 = (long)press_comp(c, t_fine, adc_P);
+#endif
+
+    /* 湿度 */
+    v = t_fine - 76800;
+    v = (((adc_H << 14) + c->h4c - c->h5 * v) >> 15) *
+        (((((((v * c->h6) >> 10) * (((v * c->h3) >> 11) + 32768)) >> 10) +
+           2097152) * c->h2 + 8192) >> 14);
+    v = v - (((((v >> 15) * (v >> 15)) >> 7) * c->h1) >> 4);
+    if (v < 0)
+        v = 0;
+    if (v > 419430400)
+        v = 419430400;
+    out->hum_x100 = (long)(((unsigned long)(v >> 12) * 25) >> 8);
+}
+
+/* --- 補正演算 (Bosch データシートより, 比較用) --- */
+
+static long compensate_temp(const bme280_calib_t *cal, long adc_T, long *t_fine)
 {
     long var1, var2, T;
 
-    var1 = ((((adc_T >> 3) - ((long)dig_T1 << 1))) * ((long)dig_T2)) >> 11;
-    var2 = (((((adc_T >> 4) - ((long)dig_T1)) *
-              ((adc_T >> 4) - ((long)dig_T1))) >> 12) *
-            ((long)dig_T3)) >> 14;
+    var1 = ((((adc_T >> 3) - ((long)cal->dig_T1 << 1))) * ((long)cal->dig_T2)) >> 11;
+    var2 = (((((adc_T >> 4) - ((long)cal->dig_T1)) *
+              ((adc_T >> 4) - ((long)cal->dig_T1))) >> 12) *
+            ((long)cal->dig_T3)) >> 14;
 
-    t_fine = var1 + var2;
-    T = (t_fine * 5 + 128) >> 8;
+    *t_fine = var1 + var2;
+    T = (*t_fine * 5 + 128) >> 8;
     return T;  /* 温度 × 100 (例: 2530 = 25.30℃) */
 }
 
-static unsigned long compensate_press(long adc_P)
+#if BME280_PRESS_64
+
+static unsigned long compensate_press(const bme280_calib_t *cal, long adc_P, long t_fine)
+{
+    long long var1, var2, p;
+
+    var1 = ((long long)t_fine) - 128000;
+    var2 = var1 * var1 * (long long)cal->dig_P6;
+    var2 = var2 + ((var1 * (long long)cal->dig_P5) << 17);
+    var2 = var2 + (((long long)cal->dig_P4) << 35);
+    var1 = ((var1 * var1 * (long long)cal->dig_P3) >> 8) +
+           ((var1 * (long long)cal->dig_P2) << 12);
+    var1 = (((((long long)1) << 47) + var1)) * ((long long)cal->dig_P1) >> 33;
+
+    if (var1 == 0)
+        return 0;
+
+    p = 1048576 - adc_P;
+    p = (((p << 31) - var2) * 3125) / var1;
+    var1 = (((long long)cal->dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+    var2 = (((long long)cal->dig_P8) * p) >> 19;
+
+    p = ((p + var1 + var2) >> 8) + (((long long)cal->dig_P7) << 4);
+    return (unsigned long)p;  /* Q24.8 Pa */
+}
+
+#else
+
+static unsigned long compensate_press(const bme280_calib_t *cal, long adc_P, long t_fine)
 {
     long var1, var2;
     unsigned long p;
 
     var1 = (t_fine >> 1) - 64000;
-    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((long)dig_P6);
-    var2 = var2 + ((var1 * ((long)dig_P5)) << 1);
-    var2 = (var2 >> 2) + (((long)dig_P4) << 16);
-    var1 = (((dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) +
-            ((((long)dig_P2) * var1) >> 1)) >> 18;
-    var1 = ((32768 + var1) * ((long)dig_P1)) >> 15;
+    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((long)cal->dig_P6);
+    var2 = var2 + ((var1 * ((long)cal->dig_P5)) << 1);
+    var2 = (var2 >> 2) + (((long)cal->dig_P4) << 16);
+    var1 = (((cal->dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) +
+            ((((long)cal->dig_P2) * var1) >> 1)) >> 18;
+    var1 = ((32768 + var1) * ((long)cal->dig_P1)) >> 15;
 
     if (var1 == 0)
         return 0;
@@ -130,26 +270,28 @@ static unsigned long compensate_press(long adc_P)
     else
         p = (p / (unsigned long)var1) * 2;
 
-    var1 = (((long)dig_P9) * ((long)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
-    var2 = (((long)(p >> 2)) * ((long)dig_P8)) >> 13;
+    var1 = (((long)cal->dig_P9) * ((long)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
+    var2 = (((long)(p >> 2)) * ((long)cal->dig_P8)) >> 13;
 
-    p = (unsigned long)((long)p + ((var1 + var2 + (long)dig_P7) >> 4));
+    p = (unsigned long)((long)p + ((var1 + var2 + (long)cal->dig_P7) >> 4));
     return p;  /* Pa 単位 */
 }
 
-static unsigned long compensate_hum(long adc_H)
+#endif /* BME280_PRESS_64 */
+
+static unsigned long compensate_hum(const bme280_calib_t *cal, long adc_H, long t_fine)
 {
     long v_x1_u32r;
 
     v_x1_u32r = t_fine - 76800;
-    v_x1_u32r = (((((adc_H << 14) - (((long)dig_H4) << 20) -
-                    (((long)dig_H5) * v_x1_u32r)) + 16384) >> 15) *
-                 (((((((v_x1_u32r * ((long)dig_H6)) >> 10) *
-                      (((v_x1_u32r * ((long)dig_H3)) >> 11) + 32768)) >> 10) +
-                    2097152) * ((long)dig_H2) + 8192) >> 14));
+    v_x1_u32r = (((((adc_H << 14) - (((long)cal->dig_H4) << 20) -
+                    (((long)cal->dig_H5) * v_x1_u32r)) + 16384) >> 15) *
+                 (((((((v_x1_u32r * ((long)cal->dig_H6)) >> 10) *
+                      (((v_x1_u32r * ((long)cal->dig_H3)) >> 11) + 32768)) >> 10) +
+                    2097152) * ((long)cal->dig_H2) + 8192) >> 14));
     v_x1_u32r = v_x1_u32r - (((((v_x1_u32r >> 15) *
                                  (v_x1_u32r >> 15)) >> 7) *
-                                ((long)dig_H1)) >> 4);
+                                ((long)cal->dig_H1)) >> 4);
     if (v_x1_u32r < 0)
         v_x1_u32r = 0;
     if (v_x1_u32r > 419430400)
@@ -158,70 +300,81 @@ static unsigned long compensate_hum(long adc_H)
     return (unsigned long)(v_x1_u32r >> 12);  /* Q22.10 固定小数点 */
 }
 
+void bme280_compensate_ref(const bme280_calib_t *cal, long adc_T, long adc_P, long adc_H,
+                           bme280_data_t *out)
+{
+    long t_fine;
+
+    /* 温度を先に計算: t_fine が必要 */
+    out->temp_x100 = compensate_temp(cal, adc_T, &t_fine);
+
+    {
+        unsigned long p = compensate_press(cal, adc_P, t_fine);
+#if BME280_PRESS_64
+        /* Q24.8 Pa → Pa (四捨五入) */
+        p = (p + 128) >> 8;
+#endif
+        /* Pa → hPa × 100 は Pa のまま */
+        out->press_x100 = (long)p;
+    }
+
+    {
+        unsigned long h = compensate_hum(cal, adc_H, t_fine);
+        /* Q22.10 → % × 100: h / 1024 * 100 = h * 100 / 1024 */
+        out->hum_x100 = (long)((h * 100) / 1024);
+    }
+}
+
 /* --- 公開 API --- */
 
-int bme280_init(unsigned char addr)
+int bme280_init(bme280_dev_t *dev, unsigned char addr)
 {
+    bme280_calib_t cal;
     unsigned char id;
 
-    g_addr = addr;
+    dev->addr = addr;
 
     i2c_init();
 
     /* チップ ID 確認 */
-    if (reg_read(BME280_REG_ID, &id, 1) != 0)
+    if (reg_read(addr, BME280_REG_ID, &id, 1) != 0)
         return -1;
     if (id != BME280_CHIP_ID)
         return -2;
 
     /* ソフトリセット */
-    reg_write(BME280_REG_RESET, 0xB6);
+    reg_write(addr, BME280_REG_RESET, 0xB6);
     {
         volatile int i;
         for (i = 0; i < 50000; i++) __asm("nop");
     }
 
-    /* 補正パラメータ読み出し */
-    if (read_calibration() != 0)
+    /* 補正パラメータ読み出し → 補正係数 */
+    if (read_calibration(addr, &cal) != 0)
         return -3;
+    bme280_coef_init(&dev->coef, &cal);
 
     /* 設定: オーバーサンプリング ×1, ノーマルモード */
-    reg_write(BME280_REG_CTRL_HUM, 0x01);   /* 湿度 ×1 */
-    reg_write(BME280_REG_CONFIG, 0xA0);      /* スタンバイ 1000ms, フィルタ OFF */
-    reg_write(BME280_REG_CTRL_MEAS, 0x27);   /* 温度×1, 気圧×1, ノーマルモード */
+    reg_write(addr, BME280_REG_CTRL_HUM, 0x01);   /* 湿度 ×1 */
+    reg_write(addr, BME280_REG_CONFIG, 0xA0);      /* スタンバイ 1000ms, フィルタ OFF */
+    reg_write(addr, BME280_REG_CTRL_MEAS, 0x27);   /* 温度×1, 気圧×1, ノーマルモード */
 
     return 0;
 }
 
-int bme280_read(bme280_data_t *data)
+int bme280_read(const bme280_dev_t *dev, bme280_data_t *data)
 {
     unsigned char buf[8];
     long adc_T, adc_P, adc_H;
 
     /* 8 バイト一括読み出し: press[3] + temp[3] + hum[2] */
-    if (reg_read(BME280_REG_PRESS_MSB, buf, 8) != 0)
+    if (reg_read(dev->addr, BME280_REG_PRESS_MSB, buf, 8) != 0)
         return -1;
 
     adc_P = ((long)buf[0] << 12) | ((long)buf[1] << 4) | (buf[2] >> 4);
     adc_T = ((long)buf[3] << 12) | ((long)buf[4] << 4) | (buf[5] >> 4);
     adc_H = ((long)buf[6] << 8) | buf[7];
 
-    /* 補正演算 (温度を先に計算: t_fine が必要) */
-    data->temp_x100 = compensate_temp(adc_T);
-
-    {
-        unsigned long p = compensate_press(adc_P);
-        /* Pa → hPa × 100: p(Pa) / 100 * 100 = p そのまま...
-         * compensate_press は Pa を返す。hPa にするには /100。
-         * hPa × 100 にするには Pa のまま。 */
-        data->press_x100 = (long)p;
-    }
-
-    {
-        unsigned long h = compensate_hum(adc_H);
-        /* Q22.10 → % × 100: h / 1024 * 100 = h * 100 / 1024 */
-        data->hum_x100 = (long)((h * 100) / 1024);
-    }
-
+    bme280_compensate(&dev->coef, adc_T, adc_P, adc_H, data);
     return 0;
 }
@@ -3,11 +3,20 @@
  *
  * I2C アドレス: 0x76 (SDO=GND) または 0x77 (SDO=VDD)
  * 温度・湿度・気圧を読み取り
+ *
+ * 較正値は bme280_init で補正係数 (bme280_coef_t) に畳み込み、毎サンプルの
+ * 補正はそれだけを見る (t_fine も引数の中で完結するので 2 個つないでもよい)。
+ * BME280_PRESS_64 を 1 にすると気圧はデータシートの 64 ビット版 (1/256 Pa) で
+ * 計算して Pa に丸める。RX は 64 ビットの乗除算がライブラリ呼び出しになるので既定は 0。
  */
 
 #ifndef BME280_H
 #define BME280_H
 
+#ifndef BME280_PRESS_64
+#define BME280_PRESS_64     0
+#endif
+
 /* センサーデータ (整数×100 で表現) */
 typedef struct {
     long temp_x100;       /* 温度 × 100  (例: 2530 = 25.30℃) */
@@ -15,7 +24,47 @@ typedef struct {
     long press_x100;      /* 気圧 × 100  (例: 101320 = 1013.20 hPa) */
 } bme280_data_t;
 
-int  bme280_init(unsigned char addr);
-int  bme280_read(bme280_data_t *data);
+/* 較正値 (calib00-25, calib26-32 の並べ替え) */
+typedef struct {
+    unsigned short dig_T1;
+    short          dig_T2, dig_T3;
+    unsigned short dig_P1;
+    short          dig_P2, dig_P3, dig_P4, dig_P5;
+    short          dig_P6, dig_P7, dig_P8, dig_P9;
+    unsigned char  dig_H1, dig_H3;
+    short          dig_H2, dig_H4, dig_H5;
+    signed char    dig_H6;
+} bme280_calib_t;
+
+/* 補正係数: データシートの式で毎回作っていたシフト / 定数項を先に計算したもの */
+typedef struct {
+    long t1, t1x2, t2, t3;              /* T1 << 1 */
+    long p1, p2, p3, p4s16, p5x2;       /* P4 << 16, P5 << 1 */
+    long p6, p7, p8, p9;
+    long h1, h2, h3, h5, h6;
+    long h4c;                           /* 16384 - (H4 << 20) */
+#if BME280_PRESS_64
+    long long p4s35, p5s17, p2s12;      /* P4 << 35, P5 << 17, P2 << 12 */
+    long long p7s4;                     /* P7 << 4 */
+#endif
+} bme280_coef_t;
+
+/* センサー 1 個分 */
+typedef struct {
+    unsigned char addr;
+    bme280_coef_t coef;
+} bme280_dev_t;
+
+int  bme280_init(bme280_dev_t *dev, unsigned char addr);
+int  bme280_read(const bme280_dev_t *dev, bme280_data_t *data);
+
+/* 生の ADC 値 (20 / 20 / 16 ビット) → データ。再入可能 */
+void bme280_coef_init(bme280_coef_t *c, const bme280_calib_t *cal);
+void bme280_compensate(const bme280_coef_t *c, long adc_T, long adc_P, long adc_H,
+                       bme280_data_t *out);
+
+/* データシートの式そのまま (比較 / 計測用, bme280_bench.c) */
+void bme280_compensate_ref(const bme280_calib_t *cal, long adc_T, long adc_P, long adc_H,
+                           bme280_data_t *out);
 
 #endif /* BME280_H */
@@ -0,0 +1,24 @@
+/*
+ * bme280_bench.h - BME280 補正演算のサイクル計測 (実機用)
+ *
+ * データシートの式 (bme280_compensate_ref) と補正係数版 (bme280_compensate) を
+ * 同じ生 ADC 値に通し、1 サンプルの所要サイクルと全出力の一致を比べる。
+ * 計測は dsp_bench と同じく CMT0 カウンタ (1 カウント = 8 サイクル)
+ */
+
+#ifndef BME280_BENCH_H
+#define BME280_BENCH_H
+
+typedef struct {
+    const char   *name;
+    unsigned long ref_cycles;   /* データシートの式 */
+    unsigned long opt_cycles;   /* 補正係数版 */
+    int           match;        /* 1 = 計測入力と掃引の全点で温度 / 気圧 / 湿度が一致 */
+} bme280_bench_t;
+
+#define BME280_BENCH_CALIBS 2   /* データシートの例 / 別の実測値 */
+
+/* cmt0_init() と割り込み有効化の後に呼ぶこと */
+void bme280_bench_run(bme280_bench_t res[BME280_BENCH_CALIBS]);
+
+#endif /* BME280_BENCH_H */
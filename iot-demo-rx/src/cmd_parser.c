@@ -97,6 +97,18 @@ static long parse_int(const char *s)
     return neg ? -val : val;
 }
 
+/* 符号なし整数パース (サンプル ID 用, 32bit 全域) */
+static unsigned long parse_uint(const char *s)
+{
+    unsigned long val = 0;
+    while (*s == ' ') s++;
+    while (*s >= '0' && *s <= '9') {
+        val = val * 10 + (unsigned long)(*s - '0');
+        s++;
+    }
+    return val;
+}
+
 /* 文字列値を比較: "target" → 1 if match */
 static int value_is(const char *p, const char *str)
 {
@@ -139,6 +151,10 @@ msg_result_t cmd_poll(void)
     r.kp_x100 = 0;
     r.ki_x100 = 0;
     r.kd_x100 = 0;
+    r.has_id = 0;
+    r.id = 0;
+    r.has_cid = 0;
+    r.cid = 0;
 
     if (!line_ready)
         return r;
@@ -155,7 +171,11 @@ msg_result_t cmd_poll(void)
         if (v) r.humi_x100 = parse_fixed100(v);
         v = find_value(line_buf, "pres");
         if (v) r.pres_x100 = parse_fixed100(v);
+        v = find_value(line_buf, "id");
+        if (v) { r.has_id = 1; r.id = parse_uint(v); }
     } else if (value_is(v, "cmd")) {
+        v = find_value(line_buf, "cid");
+        if (v) { r.has_cid = 1; r.cid = parse_uint(v); }
         v = find_value(line_buf, "cmd");
         if (!v) { r.type = MSG_CMD_UNKNOWN; goto done; }
 
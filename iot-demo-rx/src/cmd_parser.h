@@ -3,10 +3,12 @@
  *
  * ESP32からのJSON行を解析
  * {"type":"sensor","temp":25.3,"humi":48.2,"pres":1013.25}
+ * {"type":"sensor","temp":25.3,"humi":48.2,"pres":1013.25,"id":42}
  * {"type":"cmd","cmd":"set_target","sp":28.0}
  * {"type":"cmd","cmd":"stop"}
  * {"type":"cmd","cmd":"start"}
  * {"type":"cmd","cmd":"set_pid","kp":300,"ki":80,"kd":20}
+ * {"type":"cmd","cmd":"stop","cid":17}    "cid" 付きは処理後に ack を返す
  */
 
 #ifndef CMD_PARSER_H
@@ -31,6 +33,10 @@ typedef struct {
     long kp_x100;
     long ki_x100;
     long kd_x100;
+    int  has_id;            /* sensor に "id" があれば 1 (ctrl で返す) */
+    unsigned long id;
+    int  has_cid;           /* cmd に "cid" があれば 1 (ack で返す) */
+    unsigned long cid;
 } msg_result_t;
 
 void cmd_feed(char c);
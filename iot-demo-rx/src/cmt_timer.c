@@ -53,6 +53,43 @@ unsigned long millis(void)
     return g_millis;
 }
 
+/* ms と CMCNT を揃えて読む。
+ * CMCNT が一周したのに CMI0 がまだ受け付けられていない (割り込み禁止中 / より高い
+ * 優先度の処理中) と g_millis は古いままなので、IR を見て 1ms 足す */
+static void read_ms_cnt(unsigned long *ms, unsigned long *cnt)
+{
+    unsigned long m, c;
+    int pending;
+
+    do {
+        m = g_millis;
+        c = CMT0.CMCNT;
+        pending = IR(CMT0, CMI0);
+        if (pending)
+            c = CMT0.CMCNT;     /* IR より前に読んだ値は一周前かもしれない */
+    } while (m != g_millis);
+
+    *ms = pending ? m + 1 : m;
+    *cnt = c;
+}
+
+/* CMCNT: 6.25 カウント/us */
+unsigned long micros(void)
+{
+    unsigned long ms, cnt;
+
+    read_ms_cnt(&ms, &cnt);
+    return ms * 1000UL + cnt * 4UL / 25UL;
+}
+
+unsigned long cmt0_counts(void)
+{
+    unsigned long ms, cnt;
+
+    read_ms_cnt(&ms, &cnt);
+    return ms * CMT0_COUNTS_MS + cnt;
+}
+
 void delay_ms(unsigned long ms)
 {
     unsigned long start = g_millis;
@@ -9,8 +9,13 @@
 #ifndef CMT_TIMER_H
 #define CMT_TIMER_H
 
+#define CMT0_COUNTS_MS      6250UL  /* CMCOR + 1 */
+
 void          cmt0_init(void);
 unsigned long millis(void);
+unsigned long micros(void);         /* 0.16us 分解能, 約 71 分で一周 */
+/* CMT0 のカウント (1 カウント = 0.16us = ICLK 8 サイクル, 約 11 分で一周)。差で使う */
+unsigned long cmt0_counts(void);
 void          delay_ms(unsigned long ms);
 
 /* 割り込みハンドラから呼ばれる (inthandler.c から使用) */
@@ -0,0 +1,23 @@
+/*
+ * dsp_bench.h - dsp_filter のサイクル計測 (実機用)
+ *
+ * CMT0 カウンタ (PCLKB/8) で計測し、ICLK サイクル / サンプルに換算
+ * ICLK = PCLKB = 50MHz のため 1 カウント = 8 サイクル
+ */
+
+#ifndef DSP_BENCH_H
+#define DSP_BENCH_H
+
+typedef struct {
+    const char   *name;
+    unsigned long ref_cycles;   /* C 実装 */
+    unsigned long mac_cycles;   /* 積和命令版 */
+    int           match;        /* 1 = 全サンプルで出力一致 */
+} dsp_bench_t;
+
+#define DSP_BENCH_KERNELS 3     /* fir / biquad / median */
+
+/* cmt0_init() と割り込み有効化の後に呼ぶこと */
+void dsp_bench_run(dsp_bench_t res[DSP_BENCH_KERNELS]);
+
+#endif /* DSP_BENCH_H */
@@ -0,0 +1,204 @@
+/*
+ * dsp_filter.c - 固定小数点フィルタ (FIR / 双二次 IIR / 移動メディアン)
+ *
+ * __RX__ 定義時 (rx-elf-gcc) は積和命令版、それ以外は C 実装を使用
+ * ACC を使うため、割り込み側は -msave-acc-in-interrupts でビルドすること
+ */
+
+#include "dsp_filter.h"
+
+static short sat16(long long v)
+{
+    if (v > 32767)
+        return 32767;
+    if (v < -32768)
+        return -32768;
+    return (short)v;
+}
+
+static long pack16(short hi, short lo)
+{
+    return (long)(((unsigned long)(unsigned short)hi << 16) |
+                  (unsigned long)(unsigned short)lo);
+}
+
+static short hi16(long v)
+{
+    return (short)(((unsigned long)v >> 16) & 0xFFFF);
+}
+
+static short lo16(long v)
+{
+    return (short)((unsigned long)v & 0xFFFF);
+}
+
+/* ---------------------------------------------------------------- FIR --- */
+
+void dsp_fir_init(dsp_fir_t *f, const short *coef, int ntaps)
+{
+    int i;
+
+    if (ntaps > DSP_FIR_MAX_TAPS)
+        ntaps = DSP_FIR_MAX_TAPS;
+    if (ntaps < 1)
+        ntaps = 1;              /* 0 以下だと fir_push の pos が -1 になる */
+    f->coef = coef;
+    f->ntaps = ntaps;
+    f->pos = 0;
+    for (i = 0; i < 2 * DSP_FIR_MAX_TAPS; i++)
+        f->hist[i] = 0;
+}
+
+/* 最新サンプルを書き込み、hist[pos..pos+ntaps-1] = x[n], x[n-1], ... */
+static const short *fir_push(dsp_fir_t *f, short x)
+{
+    f->pos = (f->pos == 0) ? f->ntaps - 1 : f->pos - 1;
+    f->hist[f->pos] = x;
+    f->hist[f->pos + f->ntaps] = x;
+    return &f->hist[f->pos];
+}
+
+short dsp_fir_ref(dsp_fir_t *f, short x)
+{
+    const short *w = fir_push(f, x);
+    long long acc = 0;
+    int i;
+
+    for (i = 0; i < f->ntaps; i++)
+        acc += (long)f->coef[i] * w[i];
+
+    return sat16((acc + (1L << 14)) >> 15);
+}
+
+short dsp_fir(dsp_fir_t *f, short x)
+{
+#ifdef __RX__
+    register const short   *r1 __asm__("r1") = f->coef;
+    register const short   *r2 __asm__("r2") = fir_push(f, x);
+    register unsigned long  r3 __asm__("r3") = (unsigned long)f->ntaps;
+    register unsigned long  r4 __asm__("r4") = 0;
+    register long           r5 __asm__("r5") = 0;
+    register long           r6 __asm__("r6") = 0;
+    long long acc;
+
+    __asm__ volatile ("rmpa.w"
+                      : "+r"(r1), "+r"(r2), "+r"(r3),
+                        "+r"(r4), "+r"(r5), "+r"(r6)
+                      :
+                      : "memory");
+
+    /* 32 タップ × Q15 × 16bit は R5:R4 に収まる */
+    acc = ((long long)r5 << 32) | r4;
+    return sat16((acc + (1L << 14)) >> 15);
+#else
+    return dsp_fir_ref(f, x);
+#endif
+}
+
+/* ------------------------------------------------------------- 双二次 --- */
+
+void dsp_biquad_init(dsp_biquad_t *q, short b0, short b1, short b2,
+                     short a1, short a2)
+{
+    q->k0 = pack16(b0, b1);
+    q->k1 = pack16(b2, (short)-a1);
+    q->k2 = pack16((short)-a2, 0);
+    q->x1 = q->x2 = 0;
+    q->y1 = q->y2 = 0;
+}
+
+static short biquad_update(dsp_biquad_t *q, short x, long long sum)
+{
+    short y = sat16((sum + (1L << 13)) >> 14);
+
+    q->x2 = q->x1;
+    q->x1 = x;
+    q->y2 = q->y1;
+    q->y1 = y;
+    return y;
+}
+
+short dsp_biquad_ref(dsp_biquad_t *q, short x)
+{
+    long long sum;
+
+    sum  = (long)hi16(q->k0) * x;
+    sum += (long)lo16(q->k0) * q->x1;
+    sum += (long)hi16(q->k1) * q->x2;
+    sum += (long)lo16(q->k1) * q->y1;
+    sum += (long)hi16(q->k2) * q->y2;
+
+    return biquad_update(q, x, sum);
+}
+
+short dsp_biquad(dsp_biquad_t *q, short x)
+{
+#ifdef __RX__
+    long d0 = pack16(x, q->x1);
+    long d1 = pack16(q->x2, q->y1);
+    long d2 = pack16(q->y2, 0);
+    long hi, mi;
+
+    /* ACC = Σ(係数 × 状態) << 16 */
+    __asm__ volatile ("mulhi   %2, %3\n\t"
+                      "maclo   %2, %3\n\t"
+                      "machi   %4, %5\n\t"
+                      "maclo   %4, %5\n\t"
+                      "machi   %6, %7\n\t"
+                      "mvfachi %0\n\t"
+                      "mvfacmi %1"
+                      : "=&r"(hi), "=&r"(mi)
+                      : "r"(q->k0), "r"(d0), "r"(q->k1), "r"(d1),
+                        "r"(q->k2), "r"(d2));
+
+    /* ACC[63:16] = (ACC[63:32] << 16) | ACC[31:16] */
+    return biquad_update(q, x, ((long long)hi << 16) |
+                               ((unsigned long)mi & 0xFFFF));
+#else
+    return dsp_biquad_ref(q, x);
+#endif
+}
+
+/* ---------------------------------------------------------- メディアン --- */
+
+void dsp_median_init(dsp_median_t *m, int n)
+{
+    if (n > DSP_MEDIAN_MAX)
+        n = DSP_MEDIAN_MAX;
+    if (n < 1)
+        n = 1;
+    if ((n & 1) == 0)
+        n--;
+    m->n = n;
+    m->pos = 0;
+    m->count = 0;
+}
+
+short dsp_median(dsp_median_t *m, short x)
+{
+    int i, len = m->count;
+
+    /* 最古のサンプルを整列済み配列から取り除く */
+    if (len == m->n) {
+        short old = m->ring[m->pos];
+        for (i = 0; m->sorted[i] != old; i++)
+            ;
+        for (; i < len - 1; i++)
+            m->sorted[i] = m->sorted[i + 1];
+        len--;
+    } else {
+        m->count++;
+    }
+
+    m->ring[m->pos] = x;
+    if (++m->pos >= m->n)
+        m->pos = 0;
+
+    /* 挿入ソート 1 ステップ */
+    for (i = len; i > 0 && m->sorted[i - 1] > x; i--)
+        m->sorted[i] = m->sorted[i - 1];
+    m->sorted[i] = x;
+
+    /* 窓が埋まるまでは到着済みサンプルの中央値 */
+    return m->sorted[m->count / 2];
+}
@@ -0,0 +1,56 @@
+/*
+ * dsp_filter.h - 固定小数点フィルタ (FIR / 双二次 IIR / 移動メディアン)
+ *
+ * サンプル: 16bit 整数 (例: 温度 × 100)
+ * FIR 係数: Q15,  IIR 係数: Q14 (|a1| < 2 を表現するため)
+ *
+ * RX 版は積和命令を使用し、*_ref は移植用の C 実装 (結果はビット一致)
+ *   FIR    : RMPA.W  (R1/R2 配列の積和 → R6:R5:R4)
+ *   双二次 : MULHI / MACHI / MACLO (ACC, 16bit × 2 を 1 レジスタに詰める)
+ *   メディアン : 比較のみ (積和なし, 単一実装)
+ */
+
+#ifndef DSP_FILTER_H
+#define DSP_FILTER_H
+
+#define DSP_FIR_MAX_TAPS  32
+#define DSP_MEDIAN_MAX    9
+
+/* FIR: ディレイラインを 2 重化し、常に連続した窓を RMPA に渡す */
+typedef struct {
+    const short *coef;                      /* Q15 係数 [ntaps] */
+    int          ntaps;
+    int          pos;                       /* 最新サンプル位置 */
+    short        hist[2 * DSP_FIR_MAX_TAPS];
+} dsp_fir_t;
+
+/* 双二次 IIR (直接形 I)
+ * y = b0*x0 + b1*x1 + b2*x2 - a1*y1 - a2*y2 */
+typedef struct {
+    long  k0, k1, k2;       /* 詰めた係数: (b0,b1) (b2,-a1) (-a2,0) */
+    short x1, x2, y1, y2;   /* 状態 */
+} dsp_biquad_t;
+
+/* 移動メディアン (窓長は奇数) */
+typedef struct {
+    int   n;
+    int   pos;
+    int   count;
+    short ring[DSP_MEDIAN_MAX];     /* 到着順 */
+    short sorted[DSP_MEDIAN_MAX];   /* 昇順 */
+} dsp_median_t;
+
+/* ntaps は 1..DSP_FIR_MAX_TAPS に丸める (coef は丸めた後の数だけ読む) */
+void  dsp_fir_init(dsp_fir_t *f, const short *coef, int ntaps);
+short dsp_fir(dsp_fir_t *f, short x);
+short dsp_fir_ref(dsp_fir_t *f, short x);
+
+void  dsp_biquad_init(dsp_biquad_t *q, short b0, short b1, short b2,
+                      short a1, short a2);
+short dsp_biquad(dsp_biquad_t *q, short x);
+short dsp_biquad_ref(dsp_biquad_t *q, short x);
+
+void  dsp_median_init(dsp_median_t *m, int n);
+short dsp_median(dsp_median_t *m, short x);
+
+#endif /* DSP_FILTER_H */
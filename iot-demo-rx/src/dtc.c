@@ -0,0 +1,38 @@
+/*
+ * dtc.c - DTC (データトランスファコントローラ) 共通設定 (GR-SAKURA RX63N)
+ *
+ * DTCVBR の下位 12bit は 0 固定のため、ベクタテーブルは 4KB 境界に配置
+ * (256 ベクタ × 4 バイト = 1KB)
+ */
+
+#include "iodefine.h"
+#include "dtc.h"
+
+static unsigned long dtc_vector_table[256] __attribute__((aligned(4096)));
+
+static int g_started = 0;
+
+void dtc_init(void)
+{
+    if (g_started)
+        return;
+
+    /* モジュールストップ解除 (DTC/DMAC 共通) */
+    SYSTEM.PRCR.WORD = 0xA502;
+    SYSTEM.MSTPCRA.BIT.MSTPA28 = 0;
+    SYSTEM.PRCR.WORD = 0xA500;
+
+    DTC.DTCST.BIT.DTCST = 0;
+
+    DTC.DTCVBR = (void *)dtc_vector_table;
+    DTC.DTCADMOD.BIT.SHORT = 0;     /* フルアドレスモード */
+    DTC.DTCCR.BIT.RRS = 0;          /* 転送情報は毎回読み直す */
+
+    DTC.DTCST.BIT.DTCST = 1;
+    g_started = 1;
+}
+
+void dtc_set_vector(int vect, dtc_info_t *info)
+{
+    dtc_vector_table[vect & 0xFF] = (unsigned long)info;
+}
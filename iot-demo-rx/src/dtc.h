@@ -0,0 +1,43 @@
+/*
+ * dtc.h - DTC (データトランスファコントローラ) 共通設定 (GR-SAKURA RX63N)
+ *
+ * フルアドレスモード, リードスキップ無効
+ * 転送情報は割り込みベクタ番号ごとに 1 つ登録する
+ */
+
+#ifndef DTC_H
+#define DTC_H
+
+/* 転送情報 (フルアドレスモード, 16 バイト) */
+typedef struct {
+    unsigned long mode;     /* MRA(31-24) / MRB(23-16) / 予約(15-0) */
+    unsigned long sar;      /* 転送元アドレス */
+    unsigned long dar;      /* 転送先アドレス */
+    unsigned long count;    /* CRA(31-16) / CRB(15-0) */
+} dtc_info_t;
+
+/* MRA: 転送モード / データサイズ / 転送元アドレスモード */
+#define DTC_MRA_MD_NORMAL   0x00    /* ノーマル転送 */
+#define DTC_MRA_MD_REPEAT   0x40    /* リピート転送 */
+#define DTC_MRA_MD_BLOCK    0x80    /* ブロック転送 */
+#define DTC_MRA_SZ_BYTE     0x00
+#define DTC_MRA_SZ_WORD     0x10
+#define DTC_MRA_SZ_LONG     0x20
+#define DTC_MRA_SM_FIXED    0x00    /* SAR 固定 */
+#define DTC_MRA_SM_INC      0x08    /* SAR インクリメント */
+
+/* MRB: チェーン / 割り込み選択 / 転送先アドレスモード */
+#define DTC_MRB_DISEL       0x20    /* 1 転送ごとに CPU 割り込み */
+#define DTC_MRB_DTS         0x10    /* リピート / ブロック領域 = 転送元 (0 なら転送先) */
+#define DTC_MRB_DM_FIXED    0x00    /* DAR 固定 */
+#define DTC_MRB_DM_INC      0x08    /* DAR インクリメント */
+
+#define DTC_MODE(mra, mrb)  (((unsigned long)(mra) << 24) | \
+                             ((unsigned long)(mrb) << 16))
+#define DTC_COUNT(cra, crb) (((unsigned long)(cra) << 16) | \
+                             ((unsigned long)(crb) & 0xFFFF))
+
+void dtc_init(void);
+void dtc_set_vector(int vect, dtc_info_t *info);
+
+#endif /* DTC_H */
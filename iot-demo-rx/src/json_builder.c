@@ -16,18 +16,10 @@ static void jb_append_str(json_buf_t *jb, const char *s)
         jb_append_char(jb, *s++);
 }
 
-static void jb_append_int(json_buf_t *jb, long val)
+static void jb_append_uint(json_buf_t *jb, unsigned long uval)
 {
     char tmp[12];
     int i = 0;
-    unsigned long uval;
-
-    if (val < 0) {
-        jb_append_char(jb, '-');
-        uval = (unsigned long)(-(val + 1)) + 1;
-    } else {
-        uval = (unsigned long)val;
-    }
 
     if (uval == 0) {
         jb_append_char(jb, '0');
@@ -42,6 +34,16 @@ static void jb_append_int(json_buf_t *jb, long val)
         jb_append_char(jb, tmp[--i]);
 }
 
+static void jb_append_int(json_buf_t *jb, long val)
+{
+    if (val < 0) {
+        jb_append_char(jb, '-');
+        jb_append_uint(jb, (unsigned long)(-(val + 1)) + 1);
+    } else {
+        jb_append_uint(jb, (unsigned long)val);
+    }
+}
+
 static void jb_append_fixed2(json_buf_t *jb, long val_x100)
 {
     long integer, frac;
@@ -78,6 +80,14 @@ static void jb_key_int(json_buf_t *jb, const char *key, long val)
     jb_append_int(jb, val);
 }
 
+static void jb_key_uint(json_buf_t *jb, const char *key, unsigned long val)
+{
+    jb_append_char(jb, '"');
+    jb_append_str(jb, key);
+    jb_append_str(jb, "\":");
+    jb_append_uint(jb, val);
+}
+
 static void jb_key_fixed2(json_buf_t *jb, const char *key, long val_x100)
 {
     jb_append_char(jb, '"');
@@ -86,7 +96,8 @@ static void jb_key_fixed2(json_buf_t *jb, const char *key, long val_x100)
     jb_append_fixed2(jb, val_x100);
 }
 
-void json_build_ctrl(json_buf_t *jb, long vtemp_x100, int pwm, long sp_x100)
+void json_build_ctrl(json_buf_t *jb, long vtemp_x100, int pwm, long duty,
+                     long sp_x100, const ctrl_trace_t *tr)
 {
     jb->len = 0;
     jb_append_char(jb, '{');
@@ -100,8 +111,22 @@ void json_build_ctrl(json_buf_t *jb, long vtemp_x100, int pwm, long sp_x100)
     jb_key_int(jb, "pwm", (long)pwm);
     jb_append_char(jb, ',');
 
+    jb_key_int(jb, "duty", duty);
+    jb_append_char(jb, ',');
+
     jb_key_fixed2(jb, "sp", sp_x100);
 
+    if (tr) {
+        jb_append_char(jb, ',');
+        jb_key_uint(jb, "id", tr->id);
+        jb_append_char(jb, ',');
+        jb_key_uint(jb, "t1", tr->t1);
+        jb_append_char(jb, ',');
+        jb_key_uint(jb, "t2", tr->t2);
+        jb_append_char(jb, ',');
+        jb_key_uint(jb, "pu", tr->parse_us);
+    }
+
     jb_append_char(jb, '}');
     jb_append_char(jb, '\n');
     jb->buf[jb->len] = '\0';
@@ -121,3 +146,47 @@ void json_build_status(json_buf_t *jb, const char *msg)
     jb_append_char(jb, '\n');
     jb->buf[jb->len] = '\0';
 }
+
+void json_build_ack(json_buf_t *jb, unsigned long cid, int ok)
+{
+    jb->len = 0;
+    jb_append_char(jb, '{');
+
+    jb_key_str(jb, "type", "ack");
+    jb_append_char(jb, ',');
+
+    jb_key_uint(jb, "cid", cid);
+    jb_append_char(jb, ',');
+
+    jb_key_int(jb, "ok", ok ? 1 : 0);
+
+    jb_append_char(jb, '}');
+    jb_append_char(jb, '\n');
+    jb->buf[jb->len] = '\0';
+}
+
+void json_build_bench(json_buf_t *jb, const char *name,
+                      unsigned long ref_cycles, unsigned long mac_cycles,
+                      int match)
+{
+    jb->len = 0;
+    jb_append_char(jb, '{');
+
+    jb_key_str(jb, "type", "bench");
+    jb_append_char(jb, ',');
+
+    jb_key_str(jb, "name", name);
+    jb_append_char(jb, ',');
+
+    jb_key_int(jb, "ref", (long)ref_cycles);
+    jb_append_char(jb, ',');
+
+    jb_key_int(jb, "mac", (long)mac_cycles);
+    jb_append_char(jb, ',');
+
+    jb_key_int(jb, "match", (long)match);
+
+    jb_append_char(jb, '}');
+    jb_append_char(jb, '\n');
+    jb->buf[jb->len] = '\0';
+}
@@ -5,18 +5,40 @@
 #ifndef JSON_BUILDER_H
 #define JSON_BUILDER_H
 
-#define JSON_BUF_SIZE 128
+#define JSON_BUF_SIZE 192
 
 typedef struct {
     char buf[JSON_BUF_SIZE];
     int  len;
 } json_buf_t;
 
+/* 遅延トレース: sensor の "id" を ctrl で返し、RX 側の時刻を添える
+ * t1: 受信完了 [us], t2: 送信開始 [us], pu: 解析時間 [us] (micros() 基準) */
+typedef struct {
+    unsigned long id;
+    unsigned long t1;
+    unsigned long t2;
+    unsigned long parse_us;
+} ctrl_trace_t;
+
 /* 制御データ JSON を生成 */
-/* {"type":"ctrl","vtemp":25.30,"pwm":128,"sp":28.00} */
-void json_build_ctrl(json_buf_t *jb, long vtemp_x100, int pwm, long sp_x100);
+/* {"type":"ctrl","vtemp":25.30,"pwm":128,"duty":5020,"sp":28.00} */
+/* pwm: 0-255 (旧 ESP32 互換), duty: PID 出力 0-10000 (全分解能) */
+/* tr != NULL なら ,"id":42,"t1":..,"t2":..,"pu":.. を追加 */
+void json_build_ctrl(json_buf_t *jb, long vtemp_x100, int pwm, long duty,
+                     long sp_x100, const ctrl_trace_t *tr);
 
 /* ステータス JSON を生成 */
 void json_build_status(json_buf_t *jb, const char *msg);
 
+/* コマンド応答 JSON を生成 */
+/* {"type":"ack","cid":17,"ok":1}  ok: 0 = 未知のコマンド */
+void json_build_ack(json_buf_t *jb, unsigned long cid, int ok);
+
+/* ベンチマーク結果 JSON を生成 */
+/* {"type":"bench","name":"fir16","ref":412,"mac":96,"match":1} */
+void json_build_bench(json_buf_t *jb, const char *name,
+                      unsigned long ref_cycles, unsigned long mac_cycles,
+                      int match);
+
 #endif
@@ -6,15 +6,28 @@
  *
  * データフロー:
  *   ESP32 → {"type":"sensor","temp":25.3,"humi":48.2,"pres":1013.25}
- *   RX63N → {"type":"ctrl","vtemp":25.30,"pwm":128,"sp":28.00}
+ *   RX63N → {"type":"ctrl","vtemp":25.30,"pwm":128,"duty":5020,"sp":28.00}
+ *
+ * sensor に "id" があれば ctrl に id と受信/送信時刻 (micros) を付けて返す
+ * (ESP32 側で NTP 方式の時刻合わせと区間ごとの遅延計測に使う)
  */
 
+#include <stddef.h>
 #include "iodefine.h"
 #include "sci0_uart.h"
 #include "cmt_timer.h"
 #include "cmd_parser.h"
 #include "json_builder.h"
 #include "pid_ctrl.h"
+#ifdef DSP_BENCH
+#include "dsp_bench.h"
+#endif
+#ifdef BME_BENCH
+#include "bme280_bench.h"
+#endif
+#ifdef USE_ADC_FAST
+#include "adc_fast.h"
+#endif
 
 /* PID コントローラ */
 static pid_t g_pid;
@@ -23,6 +36,10 @@ static pid_t g_pid;
 static int g_running = 1;          /* 0=停止, 1=運転 */
 static long g_last_temp_x100 = 0;  /* 最新温度 */
 
+#ifdef USE_ADC_FAST
+static adc_fast_data_t g_fast;     /* サーミスタ / ヒーター電流 (25Hz) */
+#endif
+
 static void delay_loop(volatile unsigned long n)
 {
     while (n--) __asm("nop");
@@ -54,6 +71,9 @@ int main(void)
     /* 周辺初期化 */
     sci0_init();
     cmt0_init();
+#ifdef USE_ADC_FAST
+    adc_fast_init();
+#endif
 
     /* PID 初期化: Kp=3.00, Ki=0.80, Kd=0.20 (x100) */
     pid_init(&g_pid, 300, 80, 20);
@@ -65,10 +85,57 @@ int main(void)
     json_build_status(&jb, "boot ok");
     sci0_puts(jb.buf);
 
+#ifdef DSP_BENCH
+    /* フィルタカーネルのサイクル計測 (make build DSP_BENCH=1) */
+    {
+        dsp_bench_t res[DSP_BENCH_KERNELS];
+
+        dsp_bench_run(res);
+        for (i = 0; i < DSP_BENCH_KERNELS; i++) {
+            json_build_bench(&jb, res[i].name, res[i].ref_cycles,
+                             res[i].mac_cycles, res[i].match);
+            sci0_puts(jb.buf);
+        }
+    }
+#endif
+
+#ifdef BME_BENCH
+    /* BME280 補正演算のサイクル計測 (make build BME_BENCH=1)
+     * "ref" = データシートの式, "mac" = 補正係数版 */
+    {
+        bme280_bench_t res[BME280_BENCH_CALIBS];
+
+        bme280_bench_run(res);
+        for (i = 0; i < BME280_BENCH_CALIBS; i++) {
+            json_build_bench(&jb, res[i].name, res[i].ref_cycles,
+                             res[i].opt_cycles, res[i].match);
+            sci0_puts(jb.buf);
+        }
+    }
+#endif
+
     while (1) {
+#ifdef USE_ADC_FAST
+        /* 高速計測: 過熱 / 過電流 / センサー異常でヒーター停止 */
+        if (adc_fast_poll(&g_fast) &&
+            (adc_fast_faults() & ADC_FAULT_TRIP) && g_running) {
+            g_running = 0;
+            pid_reset(&g_pid);
+            json_build_ctrl(&jb, g_last_temp_x100, 0, 0,
+                            g_pid.target_x100, NULL);
+            sci0_puts(jb.buf);
+            json_build_status(&jb, "FAST_FAULT:STOP");
+            sci0_puts(jb.buf);
+        }
+#endif
+
         /* UART受信処理 */
         int c = sci0_trygetc();
         if (c >= 0) {
+            ctrl_trace_t tr;
+
+            /* 行末 = 受信完了時刻 */
+            tr.t1 = (c == '\n' || c == '\r') ? micros() : 0;
             cmd_feed((char)c);
             msg_result_t msg = cmd_poll();
 
@@ -76,18 +143,23 @@ int main(void)
             case MSG_SENSOR: {
                 g_last_temp_x100 = msg.temp_x100;
                 int pwm = 0;
+                long duty = 0;
+
+                tr.id = msg.id;
+                tr.parse_us = micros() - tr.t1;
 
                 if (g_running) {
-                    long pid_out = pid_compute(&g_pid, msg.temp_x100);
-                    /* PID出力 0-10000 → PWM 0-255 */
-                    pwm = (int)(pid_out * 255 / 10000);
-                    if (pwm < 0) pwm = 0;
-                    if (pwm > 255) pwm = 255;
+                    duty = pid_compute(&g_pid, msg.temp_x100);
+                    if (duty < 0) duty = 0;
+                    if (duty > 10000) duty = 10000;
+                    /* PID出力 0-10000 → PWM 0-255 (旧 ESP32 互換) */
+                    pwm = (int)(duty * 255 / 10000);
                 }
 
                 /* 制御JSONをESP32に返送 */
-                json_build_ctrl(&jb, msg.temp_x100, pwm,
-                                g_pid.target_x100);
+                tr.t2 = micros();
+                json_build_ctrl(&jb, msg.temp_x100, pwm, duty,
+                                g_pid.target_x100, msg.has_id ? &tr : NULL);
                 sci0_puts(jb.buf);
 
                 /* LED トグル（動作確認） */
@@ -99,8 +171,8 @@ int main(void)
                 pid_reset(&g_pid);
                 g_running = 1;
                 /* 即座にctrl JSONで新SP値をブラウザに反映 */
-                json_build_ctrl(&jb, g_last_temp_x100, 0,
-                                g_pid.target_x100);
+                json_build_ctrl(&jb, g_last_temp_x100, 0, 0,
+                                g_pid.target_x100, NULL);
                 sci0_puts(jb.buf);
                 break;
 
@@ -108,14 +180,17 @@ int main(void)
                 g_running = 0;
                 pid_reset(&g_pid);
                 /* PWM=0 を即座に送信 */
-                json_build_ctrl(&jb, g_last_temp_x100, 0,
-                                g_pid.target_x100);
+                json_build_ctrl(&jb, g_last_temp_x100, 0, 0,
+                                g_pid.target_x100, NULL);
                 sci0_puts(jb.buf);
                 json_build_status(&jb, "stopped");
                 sci0_puts(jb.buf);
                 break;
 
             case MSG_CMD_START:
+#ifdef USE_ADC_FAST
+                adc_fast_clear_faults();
+#endif
                 g_running = 1;
                 pid_reset(&g_pid);
                 json_build_status(&jb, "started");
@@ -132,6 +207,12 @@ int main(void)
             default:
                 break;
             }
+
+            /* "cid" 付きコマンドは処理後に ack (サーバーの往復時間計測用) */
+            if (msg.has_cid) {
+                json_build_ack(&jb, msg.cid, msg.type != MSG_CMD_UNKNOWN);
+                sci0_puts(jb.buf);
+            }
         }
     }
 
@@ -9,11 +9,85 @@
  *   BRR = PCLKB / (16 * baud) - 1
  *       = 50000000 / (16 * 115200) - 1 = 26.1 → BRR = 26
  *   実ボーレート = 50000000 / (16 * 27) = 115741 (誤差 +0.47%)
+ *
+ * 送信: DTC ブロック転送 + ダブルバッファ
+ *   sci0_puts() は書き込み面へコピーして戻る。停止中なら先頭 1 バイトを
+ *   TDR に書き、残りは TXI2 起動の DTC が 1 バイトずつ TDR へ転送する。
+ *   DTC 転送完了 (CRA=0) で TXI2 が CPU に通知され、もう一方の面に
+ *   データがあれば続けて転送する。CPU は 1 フレームにつき 1〜2 回だけ
+ *   割り込みを処理する。
  */
 
 #include "iodefine.h"
+#include "dtc.h"
 #include "sci0_uart.h"
 
+#define TXI2_VECT       VECT(SCI2, TXI2)
+#define TXI2_DISABLE()  (IEN(SCI2, TXI2) = 0)
+#define TXI2_ENABLE()   (IEN(SCI2, TXI2) = 1)
+
+/* 送信状態 */
+#define TX_IDLE   0     /* 停止中 (TDR 空き) */
+#define TX_DTC    1     /* DTC 転送中 */
+#define TX_DRAIN  2     /* 最終バイトが TDR に残っている */
+
+static unsigned char tx_buf[2][SCI0_TX_BUF_SIZE];
+static volatile unsigned int tx_len[2];
+static volatile int tx_fill = 0;            /* 書き込み面 */
+static volatile int tx_state = TX_IDLE;
+
+static dtc_info_t dtc_tx_info __attribute__((aligned(4)));
+
+/* 書き込み面を DTC に渡し、もう一方の面を書き込み面にする */
+static void tx_arm(const unsigned char *src, unsigned int count)
+{
+    tx_fill ^= 1;
+    tx_len[tx_fill] = 0;
+
+    dtc_tx_info.mode  = DTC_MODE(DTC_MRA_MD_NORMAL | DTC_MRA_SZ_BYTE |
+                                 DTC_MRA_SM_INC,
+                                 DTC_MRB_DM_FIXED);
+    dtc_tx_info.sar   = (unsigned long)src;
+    dtc_tx_info.dar   = (unsigned long)&SCI2.TDR;
+    dtc_tx_info.count = DTC_COUNT(count, 0);
+
+    DTCE(SCI2, TXI2) = 1;
+    tx_state = TX_DTC;
+}
+
+/* TDR が空の状態から送信開始 (先頭 1 バイトは CPU が書く) */
+static void tx_start(void)
+{
+    const unsigned char *src = tx_buf[tx_fill];
+    unsigned int len = tx_len[tx_fill];
+
+    if (len > 1) {
+        tx_arm(src + 1, len - 1);
+    } else {
+        tx_fill ^= 1;
+        tx_len[tx_fill] = 0;
+        tx_state = TX_DRAIN;
+    }
+    SCI2.TDR = src[0];
+}
+
+void sci0_txi_isr(void)
+{
+    if (tx_state == TX_DTC) {
+        /* DTC 転送完了: 最終バイトは TDR 内。次の面は次の TXI で DTC 起動 */
+        if (tx_len[tx_fill] > 0)
+            tx_arm(tx_buf[tx_fill], tx_len[tx_fill]);
+        else
+            tx_state = TX_DRAIN;
+    } else {
+        /* TDR 空き */
+        if (tx_len[tx_fill] > 0)
+            tx_start();
+        else
+            tx_state = TX_IDLE;
+    }
+}
+
 void sci0_init(void)
 {
     /* ---- モジュールストップ解除 ---- */
@@ -57,25 +131,68 @@ void sci0_init(void)
     PORT5.PMR.BIT.B0 = 1;      /* P50 = TXD2 (周辺機能) */
     PORT5.PMR.BIT.B2 = 1;      /* P52 = RXD2 (周辺機能) */
 
-    /* ---- 送受信有効化 ---- */
-    SCI2.SCR.BIT.TE = 1;
-    SCI2.SCR.BIT.RE = 1;
+    /* ---- DTC: TXI2 起動の送信転送 ---- */
+    dtc_init();
+    dtc_set_vector(TXI2_VECT, &dtc_tx_info);
+    DTCE(SCI2, TXI2) = 0;
+    tx_len[0] = 0;
+    tx_len[1] = 0;
+    tx_fill = 0;
+    tx_state = TX_IDLE;
+
+    /* ---- 送受信有効化 (TIE と TE は同時に設定) ---- */
+    SCI2.SCR.BYTE |= 0xB0;     /* TIE | TE | RE */
+
+    /* TIE/TE 設定時の TXI2 要求は捨てる (TDR は空) */
+    IPR(SCI2, TXI2) = 4;
+    IR(SCI2, TXI2) = 0;
+    TXI2_ENABLE();
 }
 
 void sci0_putc(char c)
 {
-    while (SCI2.SSR.BIT.TDRE == 0)
-        ;
-    SCI2.TDR = (unsigned char)c;
+    char s[2];
+
+    s[0] = c;
+    s[1] = '\0';
+    sci0_puts(s);
 }
 
 void sci0_puts(const char *s)
 {
     while (*s) {
-        sci0_putc(*s++);
+        unsigned char *dst;
+        unsigned int len;
+
+        TXI2_DISABLE();
+        len = tx_len[tx_fill];
+        dst = tx_buf[tx_fill];
+        while (*s && len < SCI0_TX_BUF_SIZE)
+            dst[len++] = (unsigned char)*s++;
+        tx_len[tx_fill] = len;
+        if (tx_state == TX_IDLE)
+            tx_start();
+        TXI2_ENABLE();
+
+        /* 書き込み面が満杯: DTC が面を切り替えるまで待つ */
+        if (*s) {
+            while (tx_len[tx_fill] >= SCI0_TX_BUF_SIZE)
+                ;
+        }
     }
 }
 
+int sci0_tx_done(void)
+{
+    return tx_state == TX_IDLE;
+}
+
+void sci0_tx_flush(void)
+{
+    while (tx_state != TX_IDLE)
+        ;
+}
+
 int sci0_getc(void)
 {
     unsigned char data;
@@ -4,19 +4,32 @@
  * P20 = TXD0, P21 = RXD0
  * 115200bps, 8N1
  * PCLKB = 50MHz (HOCO)
+ *
+ * 送信は DTC (データトランスファコントローラ) によるブロック転送。
+ * sci0_puts() は送信バッファへコピーして即座に戻る。
  */
 
 #ifndef SCI0_UART_H
 #define SCI0_UART_H
 
+/* 送信バッファ 1 面のサイズ (2 面でダブルバッファ) */
+#define SCI0_TX_BUF_SIZE 256
+
 void sci0_init(void);
 void sci0_putc(char c);
 void sci0_puts(const char *s);
 int  sci0_getc(void);          /* ブロッキング受信 */
 int  sci0_trygetc(void);       /* ノンブロッキング受信 (-1 = データなし) */
 
+/* 送信状態 */
+int  sci0_tx_done(void);       /* 1 = 送信キューが空 (全フレームを TDR へ転送済み) */
+void sci0_tx_flush(void);      /* 送信キューが空になるまで待つ */
+
 /* 簡易数値出力 */
 void sci0_put_int(long val);
 void sci0_put_hex(unsigned long val);
 
+/* 割り込みハンドラから呼ばれる (inthandler.c から使用) */
+void sci0_txi_isr(void);
+
 #endif /* SCI0_UART_H */
@@ -0,0 +1,216 @@
+/*
+ * adc_fast_test - S12AD 高速サンプリング (iot-demo-rx/src/adc_fast.c) のホスト検証
+ *
+ * adc_fast.c / dtc.c はそのまま、レジスタは rx63n/ の模型。
+ * 1 スキャン = ADDR0 (サーミスタ) / ADDR1 (電流) を置いて S12ADI0 を起こす。
+ * 模型の DTC が転送情報どおりにブロック転送し、125 スキャンで adc_fast_isr() に入る。
+ *
+ *   1. 初期化: 転送情報 (ブロック / ワード / 転送元 ADDR0 がブロック領域),
+ *      DTCE, ベクタ表, 割り込み優先度と許可, TMR0 / S12AD の設定
+ *   2. 間引き: 1 秒 (3125 スキャン) で 25 件, ブロック完了のスキャンでだけ出る, 平均とピーク
+ *   3. 2 面の切り替え: 間引き前に次のブロックが進んでも混ざらない。
+ *      2 ブロック間引かないと ADC_FAULT_OVERRUN で、新しい方が残る
+ *   4. 保護: 80℃ 超, 3A 超 (ピーク 1 サンプル), サーミスタ断線 / 短絡。
+ *      しきい値ちょうどでは止めない。一度立つと clear まで残る
+ * 終了コード: どれか合わなければ 1
+ *
+ * 実行: make adc_fast_test && ./adc_fast_test
+ */
+
+#include "iodefine.h"
+#include "dtc.h"
+#include "adc_fast.h"
+#include "sim_regs.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+/* ntc_table の点 (adc_fast.c): 20℃ = 2249, 30℃ = 1854, 80℃ = 584, 90℃ = 462 */
+#define RAW_20C     2249
+#define RAW_25C     2052        /* 20 + (2249 - 2052) * 10 / 395 = 24.98℃ */
+#define RAW_30C     1854
+#define RAW_80C     584
+
+static int failures = 0;
+static int isr_calls = 0;
+
+static void fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    fputs("NG: ", stdout);
+    vprintf(fmt, ap);
+    fputc('\n', stdout);
+    va_end(ap);
+    failures++;
+}
+
+#define CHECK(cond, ...)    do { if (!(cond)) fail(__VA_ARGS__); } while (0)
+
+/* A/D 変換 1 回 (TMR0 のトリガ 1 回) */
+static void scan(unsigned short t, unsigned short c)
+{
+    S12AD.ADDR0 = t;
+    S12AD.ADDR1 = c;
+    if (sim_intc_request(VECT(S12AD, S12ADI0)) && IEN(S12AD, S12ADI0)) {
+        IR(S12AD, S12ADI0) = 0;
+        isr_calls++;
+        adc_fast_isr();
+    }
+}
+
+static void block(unsigned short t, unsigned short c)
+{
+    int i;
+
+    for (i = 0; i < ADC_FAST_BLOCK; i++)
+        scan(t, c);
+}
+
+static void test_init(void)
+{
+    const unsigned long *table = (const unsigned long *)DTC.DTCVBR;
+    const dtc_info_t *d;
+
+    CHECK(DTC.DTCST.BIT.DTCST == 1 && DTC.DTCADMOD.BIT.SHORT == 0, "init: DTC not started in full-address mode");
+    CHECK(table != NULL && table[VECT(S12AD, S12ADI0)] != 0, "init: no vector table entry for S12ADI0");
+    if (table == NULL || table[VECT(S12AD, S12ADI0)] == 0)
+        return;
+    d = (const dtc_info_t *)table[VECT(S12AD, S12ADI0)];
+
+    CHECK(d->mode == DTC_MODE(DTC_MRA_MD_BLOCK | DTC_MRA_SZ_WORD | DTC_MRA_SM_INC,
+                              DTC_MRB_DTS | DTC_MRB_DM_INC),
+          "init: mode %08lx", d->mode);
+    CHECK(d->sar == (unsigned long)&S12AD.ADDR0, "init: SAR is not ADDR0");
+    CHECK(d->count == DTC_COUNT((ADC_FAST_CHANNELS << 8) | ADC_FAST_CHANNELS, ADC_FAST_BLOCK),
+          "init: count %08lx", d->count);
+    CHECK(DTCE(S12AD, S12ADI0) == 1, "init: DTCE not set");
+    CHECK(IEN(S12AD, S12ADI0) == 1 && IPR(S12AD, S12ADI0) == 6, "init: IEN / IPR");
+    CHECK(S12AD.ADANS0.WORD == 0x0003 && S12AD.ADSTRGR.BIT.ADSTRS == 0x09 &&
+          S12AD.ADCSR.BIT.ADIE == 1 && S12AD.ADCSR.BIT.TRGE == 1,
+          "init: S12AD scan / trigger setup");
+    CHECK(TMR0.TCORA == 249 && TMR0.TCSR.BIT.ADTE == 1 && TMR0.TCCR.BIT.CKS == 4,
+          "init: TMR0 3125Hz trigger");
+}
+
+/* 1 秒分を毎スキャン後に間引き: 25Hz, 値 */
+static void test_decimation(void)
+{
+    adc_fast_data_t out;
+    unsigned long units = sim_dtc_units();
+    unsigned long sum = 0;
+    int i, n = 0;
+
+    for (i = 0; i < ADC_FAST_RATE_HZ; i++) {
+        unsigned short c = (i & 1) ? 1200 : 1000;
+
+        scan(RAW_25C, c);
+        sum += c;
+        if (adc_fast_poll(&out)) {
+            CHECK(i % ADC_FAST_BLOCK == ADC_FAST_BLOCK - 1, "decimation: output at scan %d", i);
+            CHECK(out.seq == (unsigned long)n, "decimation: seq %lu (want %d)", out.seq, n);
+            CHECK(out.temp_x100 == 2498, "decimation: temp %ld (want 2498)", out.temp_x100);
+            CHECK(out.current_ma == (long)(sum / ADC_FAST_BLOCK) * ADC_SHUNT_UA_PER_LSB / 1000,
+                  "decimation: current %ld (want mean of %lu)", out.current_ma, sum);
+            sum = 0;
+            CHECK(out.peak_ma == 1200L * ADC_SHUNT_UA_PER_LSB / 1000,
+                  "decimation: peak %ld", out.peak_ma);
+            n++;
+        }
+    }
+    CHECK(n == 25, "decimation: %d outputs per second (want 25)", n);
+    CHECK(isr_calls == 25, "decimation: %d CPU interrupts (want 25)", isr_calls);
+    CHECK(sim_dtc_units() - units == (unsigned long)ADC_FAST_RATE_HZ * ADC_FAST_CHANNELS,
+          "decimation: DTC moved %lu words", sim_dtc_units() - units);
+    CHECK(adc_fast_faults() == 0, "decimation: faults %x", adc_fast_faults());
+}
+
+static void test_double_buffer(void)
+{
+    adc_fast_data_t out;
+    int i;
+
+    /* 次のブロックが半分進んでから間引いても、前のブロックの値だけ */
+    block(RAW_20C, 100);
+    for (i = 0; i < ADC_FAST_BLOCK / 2; i++)
+        scan(RAW_30C, 200);
+    CHECK(adc_fast_poll(&out) == 1 && out.temp_x100 == 2000 &&
+          out.current_ma == 100L * ADC_SHUNT_UA_PER_LSB / 1000,
+          "swap: first block %ld / %ld", out.temp_x100, out.current_ma);
+    CHECK(adc_fast_poll(&out) == 0, "swap: half block was returned");
+    for (; i < ADC_FAST_BLOCK; i++)
+        scan(RAW_30C, 200);
+    CHECK(adc_fast_poll(&out) == 1 && out.temp_x100 == 3000 &&
+          out.current_ma == 200L * ADC_SHUNT_UA_PER_LSB / 1000,
+          "swap: second block %ld / %ld", out.temp_x100, out.current_ma);
+    CHECK(adc_fast_faults() == 0, "swap: faults %x", adc_fast_faults());
+
+    /* 2 ブロック間引かない: 遅れを記録し、古い方を捨てて新しい方を残す */
+    block(RAW_20C, 100);
+    block(RAW_30C, 200);
+    CHECK(adc_fast_faults() == ADC_FAULT_OVERRUN, "overrun: faults %x", adc_fast_faults());
+    CHECK(adc_fast_poll(&out) == 1 && out.temp_x100 == 3000, "overrun: kept %ld", out.temp_x100);
+    CHECK(adc_fast_poll(&out) == 0, "overrun: stale block still ready");
+    CHECK((ADC_FAULT_OVERRUN & ADC_FAULT_TRIP) == 0, "overrun must not trip the heater");
+    adc_fast_clear_faults();
+}
+
+/* 1 ブロック流して間引き、故障フラグを返す */
+static int fault_of(unsigned short t, unsigned short c, unsigned short peak, adc_fast_data_t *out)
+{
+    int i;
+
+    adc_fast_clear_faults();
+    for (i = 0; i < ADC_FAST_BLOCK; i++)
+        scan(t, i == ADC_FAST_BLOCK / 2 ? peak : c);
+    if (!adc_fast_poll(out))
+        fail("fault: no block");
+    return adc_fast_faults();
+}
+
+static void test_faults(void)
+{
+    adc_fast_data_t out;
+    int f;
+
+    f = fault_of(RAW_80C, 500, 500, &out);
+    CHECK(f == 0 && out.temp_x100 == ADC_FAST_TEMP_LIMIT, "80.00C must not trip (%x, %ld)", f, out.temp_x100);
+    f = fault_of(RAW_80C - 24, 500, 500, &out);
+    CHECK(f == ADC_FAULT_OVERTEMP, "overtemp: %x (%ld)", f, out.temp_x100);
+
+    /* 3726 LSB = 2999mA, 3730 LSB = 3002mA (平均は 500 LSB のまま) */
+    f = fault_of(RAW_25C, 500, 3726, &out);
+    CHECK(f == 0 && out.peak_ma == 2999, "2999mA must not trip (%x, %ld)", f, out.peak_ma);
+    f = fault_of(RAW_25C, 500, 3730, &out);
+    CHECK(f == ADC_FAULT_OVERCURRENT && out.peak_ma == 3002, "overcurrent: %x (%ld)", f, out.peak_ma);
+
+    f = fault_of(4095, 500, 500, &out);
+    CHECK(f == ADC_FAULT_SENSOR, "thermistor open: %x", f);
+    f = fault_of(10, 500, 500, &out);
+    CHECK(f == ADC_FAULT_SENSOR, "thermistor short: %x (overtemp must not be reported)", f);
+
+    /* 保持: 正常なブロックが続いても clear まで残る */
+    f = fault_of(RAW_80C - 24, 500, 3730, &out);
+    CHECK(f == (ADC_FAULT_OVERTEMP | ADC_FAULT_OVERCURRENT), "both: %x", f);
+    block(RAW_25C, 500);
+    block(RAW_25C, 500);
+    CHECK((adc_fast_faults() & ADC_FAULT_TRIP) == (ADC_FAULT_OVERTEMP | ADC_FAULT_OVERCURRENT),
+          "latch: faults %x after normal blocks", adc_fast_faults());
+    adc_fast_poll(&out);
+    adc_fast_clear_faults();
+    CHECK(adc_fast_faults() == 0, "clear: faults %x", adc_fast_faults());
+}
+
+int main(void)
+{
+    sim_regs_reset();
+    adc_fast_init();
+
+    test_init();
+    test_decimation();
+    test_double_buffer();
+    test_faults();
+
+    printf("%s\n", failures ? "NG" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * dsp_filter_test - 固定小数点フィルタ (iot-demo-rx/src/dsp_filter.c) のホスト検証
+ *
+ * ホストでは __RX__ が無いので dsp_fir / dsp_biquad も C 実装 (*_ref) になる。
+ * RX の積和命令版とのビット一致は実機の dsp_bench が見る。ここは C 実装の値そのもの。
+ *
+ *   1. FIR: インパルス応答 = 係数, ステップ応答, 16bit 飽和, ntaps の丸め (0 / 負 → 1, 超過 → 32)
+ *   2. 双二次: 素通し, 1 次遅れのインパルス応答 (Q14 の丸め), ステップの収束, 16bit 飽和
+ *   3. メディアン: スパイク除去, ステップの遅れ, 窓長の丸め, 乱数列を素朴な整列と突き合わせ
+ * 終了コード: どれか合わなければ 1
+ *
+ * 実行: make dsp_filter_test && ./dsp_filter_test
+ */
+
+#include "dsp_filter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+static int failures = 0;
+
+static void fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    fputs("NG: ", stdout);
+    vprintf(fmt, ap);
+    fputc('\n', stdout);
+    va_end(ap);
+    failures++;
+}
+
+#define CHECK(cond, ...)    do { if (!(cond)) fail(__VA_ARGS__); } while (0)
+#define COUNT(a)            ((int)(sizeof(a) / sizeof((a)[0])))
+
+/* ---------------------------------------------------------------- FIR --- */
+
+static void fir_expect(const char *what, dsp_fir_t *f, const short *x, const short *want, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        short y = dsp_fir(f, x[i]);
+        CHECK(y == want[i], "%s[%d]: %d (want %d)", what, i, y, want[i]);
+    }
+}
+
+static void test_fir(void)
+{
+    /* 0.25, 0.5, 0.25 (Q15) */
+    static const short tri[] = { 8192, 16384, 8192 };
+    static const short imp[]      = { 1000, 0, 0, 0, 0 };
+    static const short imp_want[] = { 250, 500, 250, 0, 0 };
+    static const short step[]      = { 1000, 1000, 1000, 1000 };
+    static const short step_want[] = { 250, 750, 1000, 1000 };
+    /* 1 - 2^-15 × 4 タップ: 4 倍近くなって飽和 */
+    static const short big[] = { 32767, 32767, 32767, 32767 };
+    static const short pos[]      = { 16384, 16384, 16384 };
+    static const short pos_want[] = { 16384, 32767, 32767 };
+    static const short neg[]      = { -16384, -16384, -16384 };
+    static const short neg_want[] = { -16383, -32767, -32768 };  /* -16383.5 は切り上げ */
+    static short half[DSP_FIR_MAX_TAPS + 8];
+    dsp_fir_t f;
+    int i;
+
+    dsp_fir_init(&f, tri, COUNT(tri));
+    fir_expect("fir impulse", &f, imp, imp_want, COUNT(imp));
+    dsp_fir_init(&f, tri, COUNT(tri));
+    fir_expect("fir step", &f, step, step_want, COUNT(step));
+
+    dsp_fir_init(&f, big, COUNT(big));
+    fir_expect("fir +sat", &f, pos, pos_want, COUNT(pos));
+    dsp_fir_init(&f, big, COUNT(big));
+    fir_expect("fir -sat", &f, neg, neg_want, COUNT(neg));
+
+    /* ntaps 0 / 負: 1 タップ (係数 0.25 だけ) */
+    dsp_fir_init(&f, tri, 0);
+    CHECK(f.ntaps == 1, "fir ntaps 0 -> %d (want 1)", f.ntaps);
+    fir_expect("fir ntaps 0", &f, step, (const short[]){ 250, 250, 250, 250 }, COUNT(step));
+    dsp_fir_init(&f, tri, -5);
+    CHECK(f.ntaps == 1, "fir ntaps -5 -> %d (want 1)", f.ntaps);
+    fir_expect("fir ntaps -5", &f, imp, (const short[]){ 250, 0, 0, 0, 0 }, COUNT(imp));
+
+    /* 超過: 先頭 32 個だけ使う (後ろの係数は読まない) */
+    for (i = 0; i < COUNT(half); i++)
+        half[i] = i < DSP_FIR_MAX_TAPS ? 16384 : 32767;
+    dsp_fir_init(&f, half, COUNT(half));
+    CHECK(f.ntaps == DSP_FIR_MAX_TAPS, "fir ntaps %d -> %d (want %d)", COUNT(half), f.ntaps, DSP_FIR_MAX_TAPS);
+    for (i = 0; i < DSP_FIR_MAX_TAPS + 8; i++) {
+        short y = dsp_fir(&f, i == 0 ? 100 : 0);
+        short want = i < DSP_FIR_MAX_TAPS ? 50 : 0;
+        CHECK(y == want, "fir clamp impulse[%d]: %d (want %d)", i, y, want);
+    }
+}
+
+/* ------------------------------------------------------------- 双二次 --- */
+
+static void test_biquad(void)
+{
+    static const short imp_want[] = { 1000, 500, 250, 125, 63, 32 };
+    dsp_biquad_t q;
+    short y = 0;
+    int i;
+
+    /* 素通し b0 = 1.0 (Q14) */
+    dsp_biquad_init(&q, 16384, 0, 0, 0, 0);
+    for (i = 0; i < 5; i++) {
+        short x = (short)(i * 7919 - 16000);
+        y = dsp_biquad(&q, x);
+        CHECK(y == x, "biquad pass[%d]: %d (want %d)", i, y, x);
+    }
+
+    /* y = x + 0.5 y1: 半分ずつ減る。端数 .5 は切り上げ */
+    dsp_biquad_init(&q, 16384, 0, 0, -8192, 0);
+    for (i = 0; i < COUNT(imp_want); i++) {
+        y = dsp_biquad(&q, i == 0 ? 1000 : 0);
+        CHECK(y == imp_want[i], "biquad impulse[%d]: %d (want %d)", i, y, imp_want[i]);
+    }
+
+    /* FIR 形 0.25 / 0.5 / 0.25 のステップ: 3 サンプル目で直流利得 1 */
+    dsp_biquad_init(&q, 4096, 8192, 4096, 0, 0);
+    for (i = 0; i < 4; i++) {
+        static const short want[] = { 250, 750, 1000, 1000 };
+        y = dsp_biquad(&q, 1000);
+        CHECK(y == want[i], "biquad fir step[%d]: %d (want %d)", i, y, want[i]);
+    }
+
+    /* y = 0.5 x + 0.5 y1 のステップ: 1000 に収束してそこで止まる */
+    dsp_biquad_init(&q, 8192, 0, 0, -8192, 0);
+    for (i = 0; i < 30; i++)
+        y = dsp_biquad(&q, 1000);
+    CHECK(y == 1000, "biquad step settles at %d (want 1000)", y);
+
+    /* b0 = 2.0 近く: 30000 → 飽和 */
+    dsp_biquad_init(&q, 32767, 0, 0, 0, 0);
+    y = dsp_biquad(&q, 30000);
+    CHECK(y == 32767, "biquad +sat: %d", y);
+    y = dsp_biquad(&q, -30000);
+    CHECK(y == -32768, "biquad -sat: %d", y);
+    /* 飽和した値が状態に入り、帰還でもあふれない */
+    dsp_biquad_init(&q, 16384, 0, 0, -16000, 0);
+    for (i = 0; i < 10; i++)
+        y = dsp_biquad(&q, 30000);
+    CHECK(y == 32767, "biquad feedback sat: %d", y);
+}
+
+/* ---------------------------------------------------------- メディアン --- */
+
+static int cmp_short(const void *a, const void *b)
+{
+    return *(const short *)a - *(const short *)b;
+}
+
+static void test_median(void)
+{
+    static const short spike[]      = { 10, 10, 1000, 10, 10, -900, 10, 10 };
+    static const short step_want[]  = { 0, 0, 100, 100, 100 };
+    dsp_median_t m;
+    short win[DSP_MEDIAN_MAX];
+    short y;
+    int i, k;
+
+    dsp_median_init(&m, 5);
+    for (i = 0; i < COUNT(spike); i++) {
+        y = dsp_median(&m, spike[i]);
+        CHECK(y == 10, "median spike[%d]: %d (want 10)", i, y);
+    }
+
+    /* 窓 5 のステップ: 3 サンプル目で切り替わる */
+    dsp_median_init(&m, 5);
+    for (i = 0; i < 5; i++)
+        dsp_median(&m, 0);
+    for (i = 0; i < COUNT(step_want); i++) {
+        y = dsp_median(&m, 100);
+        CHECK(y == step_want[i], "median step[%d]: %d (want %d)", i, y, step_want[i]);
+    }
+
+    dsp_median_init(&m, 4);
+    CHECK(m.n == 3, "median n 4 -> %d (want 3)", m.n);
+    dsp_median_init(&m, 20);
+    CHECK(m.n == DSP_MEDIAN_MAX, "median n 20 -> %d (want %d)", m.n, DSP_MEDIAN_MAX);
+    dsp_median_init(&m, 0);
+    CHECK(m.n == 1, "median n 0 -> %d (want 1)", m.n);
+    CHECK(dsp_median(&m, 7) == 7 && dsp_median(&m, -3) == -3, "median n 1 is not a pass-through");
+
+    /* 乱数列 (重複多め) を直近の窓の整列と比べる。埋まるまでは到着分の sorted[count / 2] */
+    for (k = 3; k <= DSP_MEDIAN_MAX; k += 2) {
+        srand((unsigned)k);
+        dsp_median_init(&m, k);
+        for (i = 0; i < 500; i++) {
+            short x = (short)(rand() % 21 - 10) * 1000;
+            int n = i + 1 < k ? i + 1 : k;
+            int j;
+
+            win[i % k] = x;
+            y = dsp_median(&m, x);
+            {
+                short s[DSP_MEDIAN_MAX];
+                for (j = 0; j < n; j++)
+                    s[j] = win[(i - j + k * 2) % k];
+                qsort(s, (size_t)n, sizeof(s[0]), cmp_short);
+                if (y != s[n / 2]) {
+                    fail("median n=%d sample %d: %d (want %d)", k, i, y, s[n / 2]);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    test_fir();
+    test_biquad();
+    test_median();
+
+    printf("%s\n", failures ? "NG" : "OK");
+    return failures ? 1 : 0;
+}
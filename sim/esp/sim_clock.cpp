@@ -0,0 +1,26 @@
+// 時刻のフェイク (仮想時刻版): native/fakes/fake_clock.cpp と差し替える
+
+#include <Arduino.h>
+#include "sim_kernel.h"
+
+// ESP32 と同じく 32bit で一周する
+unsigned long millis() {
+    return (uint32_t)(sim_now() / 1000);
+}
+
+unsigned long micros() {
+    return (uint32_t)sim_now();
+}
+
+void delay(unsigned long ms) {
+    sim_block(nullptr, sim_now() + (uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    sim_block(nullptr, sim_now() + us);
+}
+
+// 時刻を見ながら yield() で回る待ちが止まらないよう 1us 進める
+void yield() {
+    sim_block(nullptr, sim_now() + 1);
+}
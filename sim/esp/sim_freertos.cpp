@@ -0,0 +1,121 @@
+// FreeRTOS (タスク / 通知 / キュー) のフェイク (仮想時刻版)
+// native/fakes/fake_freertos.cpp と差し替える。待ちは sim_block() で行う
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "sim_kernel.h"
+
+#include <string.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+static uint64_t tickDeadline(TickType_t ticks) {
+    return ticks == portMAX_DELAY ? SIM_FOREVER : sim_now() + (uint64_t)ticks * 1000;
+}
+
+// ---------------------------------------------------------------- タスク
+
+struct FakeTask {
+    std::string name;
+    sim_task_t *task = nullptr;
+    uint32_t notify = 0;
+    sim_waitq_t waiters = {};
+};
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *handle,
+                                   BaseType_t core) {
+    (void)stack;
+    (void)core;
+    FakeTask *task = new FakeTask;
+    task->name = std::string("esp_") + (name ? name : "");
+    task->task = sim_spawn(task->name.c_str(), (int)prio, fn, arg, 0);
+    sim_set_user(task->task, task);
+    if (handle) *handle = task;
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    sim_task_t *t = sim_current();
+    return t ? static_cast<FakeTask *>(sim_user(t)) : nullptr;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    sim_block(nullptr, tickDeadline(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(sim_now() / 1000);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    FakeTask *task = xTaskGetCurrentTaskHandle();
+    uint64_t deadline = tickDeadline(ticks);
+    while (task->notify == 0 && ticks != 0 && sim_now() < deadline) {
+        sim_block(&task->waiters, deadline);
+    }
+
+    uint32_t value = task->notify;
+    if (value > 0) task->notify = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    task->notify++;
+    sim_wake_all(&task->waiters);
+    return pdPASS;
+}
+
+// ---------------------------------------------------------------- キュー
+
+struct FakeQueue {
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+    sim_waitq_t senders = {};
+    sim_waitq_t receivers = {};
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    FakeQueue *q = new FakeQueue;
+    q->length = length;
+    q->itemSize = itemSize;
+    return q;
+}
+
+// イベント (割り込み相当) からは待てないので ticks に関係なく即失敗
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks) {
+    uint64_t deadline = tickDeadline(ticks);
+    while (q->items.size() >= q->length) {
+        if (ticks == 0 || !sim_current() || sim_now() >= deadline) return pdFALSE;
+        sim_block(&q->senders, deadline);
+    }
+    const uint8_t *p = static_cast<const uint8_t *>(item);
+    q->items.emplace_back(p, p + q->itemSize);
+    sim_wake_one(&q->receivers);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+    uint64_t deadline = tickDeadline(ticks);
+    while (q->items.empty()) {
+        if (ticks == 0 || !sim_current() || sim_now() >= deadline) return pdFALSE;
+        sim_block(&q->receivers, deadline);
+    }
+    memcpy(item, q->items.front().data(), q->itemSize);
+    q->items.pop_front();
+    sim_wake_one(&q->senders);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q) {
+    q->items.clear();
+    sim_wake_all(&q->senders);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    return (UBaseType_t)q->items.size();
+}
@@ -0,0 +1,594 @@
+/*
+ * fwdelta_test - 差分更新ブートローダー (iot-demo-rx-test/boot) のホスト検証
+ *
+ * boot_main.c をこのファイルに取り込み (static の on_begin / on_data / on_end を直接呼ぶ)、
+ * fw_delta.c はそのまま、フラッシュ / SCI2 はここの差し替えで動かす。
+ * ROM は 0xFFF00000- に 1MB を mmap するので、boot_main.c のアドレスがそのまま使える。
+ *
+ *   1. 往復: tools/fwdelta.py の encode で作った差分を fw_delta_feed に
+ *      ばらばらの切れ目で入れ、新イメージに戻るか
+ *   2. 手順: 同じ差分を begin / data / end で流す。途中で CRC を壊した行
+ *      (err crc → 同じ seq で再送) と、ok が失われた体の二重送信
+ *      (ok だけ返して当て直さない) を混ぜ、アプリ領域が新イメージになるか
+ *   3. 壊れた差分: OLD が旧イメージの外, NEW の距離が出力より長い / 0,
+ *      32 ビットに収まらない varint (5 バイト目の上位), 長さのあふれ は FW_DELTA_ERR
+ *
+ * 新イメージのヘッダはわざと偽にする (app_valid() が通ると jump_app() で飛んでしまう)。
+ * 終了コード: どれか合わなければ 1
+ *
+ * 実行: make fwdelta_test && ./fwdelta_test
+ *       ./fwdelta_test --cases 200 --seed 7    (乱数のイメージを増やす)
+ */
+
+#define main boot_main
+#include "boot_main.c"
+#undef main
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define ROM_BASE        FW_APP_BASE
+#define ROM_SIZE        0x00100000UL
+
+static uint64_t     rng = 0x9E3779B97F4A7C15ULL;
+static const char  *fwdelta_py = "../tools/fwdelta.py";
+static char         tmpdir[] = "/tmp/fwdelta_test.XXXXXX";
+static int          failures = 0;
+
+/* 最後の応答 */
+static char         last_reply[sizeof(reply)];
+
+static unsigned long urand(unsigned long n)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return n ? (unsigned long)(rng % n) : 0;
+}
+
+static void fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    fputs("NG: ", stdout);
+    vprintf(fmt, ap);
+    fputc('\n', stdout);
+    va_end(ap);
+    failures++;
+}
+
+/* ------------------------------------------------------------ 差し替え (flash_rom / boot_uart) */
+
+void flash_rom_init(void)
+{
+}
+
+unsigned long flash_rom_block_start(unsigned long addr)
+{
+    return addr & ~(flash_rom_block_size(addr) - 1);
+}
+
+unsigned long flash_rom_block_size(unsigned long addr)
+{
+    if (addr >= FW_BOOT_BASE) return 0x1000;
+    if (addr >= FW_STAGE_BASE) return 0x4000;
+    return 0x8000;
+}
+
+int flash_rom_erase(unsigned long block)
+{
+    if (block < ROM_BASE || block != flash_rom_block_start(block)) return -1;
+    memset((void *)block, 0xFF, flash_rom_block_size(block));
+    return 0;
+}
+
+/* 消去していない所へ書くと 1 → 0 にしかならない (実物と同じ) */
+int flash_rom_write(unsigned long addr, const unsigned char *buf)
+{
+    unsigned char *dst = (unsigned char *)addr;
+    int i;
+
+    if (addr < ROM_BASE || (addr & (FLASH_WRITE_SIZE - 1)) != 0) return -1;
+    for (i = 0; i < FLASH_WRITE_SIZE; i++) dst[i] &= buf[i];
+    return 0;
+}
+
+void boot_uart_init(void)
+{
+}
+
+void boot_uart_deinit(void)
+{
+}
+
+void boot_uart_puts(const char *s)
+{
+    snprintf(last_reply, sizeof(last_reply), "%s", s);
+}
+
+int boot_uart_getline(char *buf, int size)
+{
+    (void)buf;
+    (void)size;
+    return 0;
+}
+
+unsigned long boot_ms(void)
+{
+    return 0;
+}
+
+/* ------------------------------------------------------------ ホスト側 (fwdelta.py send と同じ行) */
+
+/* update_mode() の 1 行分。応答を返す */
+static const char *host_line(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    last_reply[0] = '\0';
+    if (json_is(line, "op", "data")) {
+        on_data();
+    } else if (json_is(line, "op", "begin")) {
+        on_begin();
+    } else if (json_is(line, "op", "end")) {
+        on_end();
+    }
+    return last_reply;
+}
+
+static int reply_is(const char *op, const char *msg)
+{
+    char want[64];
+
+    snprintf(want, sizeof(want), "\"op\":\"%s\"", op);
+    if (strstr(last_reply, want) == NULL) return 0;
+    if (msg == NULL) return 1;
+    snprintf(want, sizeof(want), "\"msg\":\"%s\"", msg);
+    return strstr(last_reply, want) != NULL;
+}
+
+static void base64_encode(const unsigned char *p, int n, char *out)
+{
+    static const char tab[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    int i;
+
+    for (i = 0; i < n; i += 3) {
+        unsigned long w = (unsigned long)p[i] << 16;
+
+        if (i + 1 < n) w |= (unsigned long)p[i + 1] << 8;
+        if (i + 2 < n) w |= p[i + 2];
+        *out++ = tab[(w >> 18) & 0x3F];
+        *out++ = tab[(w >> 12) & 0x3F];
+        *out++ = i + 1 < n ? tab[(w >> 6) & 0x3F] : '=';
+        *out++ = i + 2 < n ? tab[w & 0x3F] : '=';
+    }
+    *out = '\0';
+}
+
+static const char *data_line(unsigned long seq, const unsigned char *p, int n, unsigned long crc)
+{
+    char b64[CHUNK_MAX * 4 / 3 + 4];
+
+    base64_encode(p, n, b64);
+    return host_line("{\"type\":\"fw\",\"op\":\"data\",\"seq\":%lu,\"c\":\"%08lx\",\"d\":\"%s\"}",
+                     seq, crc, b64);
+}
+
+/* ------------------------------------------------------------ イメージと差分 */
+
+static int write_file(const char *name, const unsigned char *p, unsigned long n)
+{
+    char path[64];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/%s", tmpdir, name);
+    f = fopen(path, "wb");
+    if (f == NULL) return -1;
+    if (n > 0 && fwrite(p, 1, n, f) != n) {
+        fclose(f);
+        return -1;
+    }
+    return fclose(f);
+}
+
+/* fwdelta.py の encode()。差分の長さ, 失敗なら -1 */
+static long encode_py(const unsigned char *old, unsigned long old_len,
+                      const unsigned char *new_img, unsigned long new_len,
+                      unsigned char *delta, unsigned long max)
+{
+    char cmd[512], path[64];
+    FILE *f;
+    long n;
+
+    if (write_file("old", old, old_len) != 0 || write_file("new", new_img, new_len) != 0) return -1;
+    snprintf(cmd, sizeof(cmd),
+             "python3 -c 'import sys, runpy; m = runpy.run_path(sys.argv[1]); "
+             "d = sys.argv[2]; r = lambda n: open(d + n, \"rb\").read(); "
+             "open(d + \"/delta\", \"wb\").write(m[\"encode\"](r(\"/old\"), r(\"/new\")))' %s %s",
+             fwdelta_py, tmpdir);
+    if (system(cmd) != 0) return -1;
+
+    snprintf(path, sizeof(path), "%s/delta", tmpdir);
+    f = fopen(path, "rb");
+    if (f == NULL) return -1;
+    n = (long)fread(delta, 1, max, f);
+    fclose(f);
+    return n;
+}
+
+/* それらしい旧イメージ: 命令列のような繰り返し + 定数表 + 0xFF の隙間 */
+static void make_old(unsigned char *p, unsigned long n)
+{
+    unsigned long i = 0;
+
+    while (i < n) {
+        unsigned long run = 16 + urand(200), k;
+        int kind = (int)urand(4);
+
+        for (k = 0; k < run && i < n; k++, i++) {
+            if (kind == 0) p[i] = 0xFF;
+            else if (kind == 1) p[i] = (unsigned char)urand(256);
+            else p[i] = (unsigned char)(0x60 + (i % 24) + kind);
+        }
+    }
+}
+
+/* 新イメージ: 旧を写して、書き換え / 挿入 / 削除 / 自分の前の部分の繰り返しを入れる */
+static unsigned long make_new(const unsigned char *old, unsigned long old_len,
+                              unsigned char *p, unsigned long max)
+{
+    unsigned long i = 0, o = 0;
+
+    while (i < max && (o < old_len || urand(4) != 0)) {
+        unsigned long k, run = 1 + urand(300);
+
+        switch (urand(8)) {
+        case 0:                         /* 書き換え */
+            for (k = 0; k < run && i < max; k++) p[i++] = (unsigned char)urand(256);
+            o += run;
+            break;
+        case 1:                         /* 挿入 */
+            for (k = 0; k < run && i < max; k++) p[i++] = (unsigned char)urand(256);
+            break;
+        case 2:                         /* 削除 */
+            o += run;
+            break;
+        case 3:                         /* 新しい方の繰り返し (NEW) */
+            if (i > 0) {
+                unsigned long src = urand(i);
+
+                for (k = 0; k < run && i < max; k++) p[i++] = p[src + k];
+            }
+            break;
+        case 4:                         /* 塗りつぶし (FILL) */
+            memset(p + i, 0xFF, run < max - i ? run : max - i);
+            i += run < max - i ? run : max - i;
+            break;
+        default:                        /* そのまま (OLD) */
+            for (k = 0; k < run * 8 && o < old_len && i < max; k++) p[i++] = old[o++];
+            break;
+        }
+    }
+    if (i < sizeof(fw_app_header_t)) {
+        memset(p + i, 0x5A, sizeof(fw_app_header_t) - i);
+        i = sizeof(fw_app_header_t);
+    }
+    memset(p, 0, 4);                    /* 偽のヘッダ (magic != FW_APP_MAGIC) */
+    return i;
+}
+
+/* ------------------------------------------------------------ 1. 往復 (fw_delta_feed だけ) */
+
+static unsigned char  ram_out[FW_IMAGE_MAX];
+static unsigned long  ram_len;
+static unsigned long  ram_max;
+static unsigned long  feed_err_at;      /* FW_DELTA_ERR になったバイトの位置 (cuts = 1 のとき) */
+
+static int ram_put(unsigned char c)
+{
+    if (ram_len >= ram_max) return -1;
+    ram_out[ram_len++] = c;
+    return 0;
+}
+
+static unsigned char ram_at(unsigned long pos)
+{
+    return ram_out[pos];
+}
+
+/* cuts: 0 = 一度に, 1 = 1 バイトずつ, 2 = ばらばら */
+static int feed_ram(const unsigned char *old, unsigned long old_len,
+                    const unsigned char *p, unsigned long n, int cuts)
+{
+    fw_delta_t d;
+    unsigned long k = 0;
+    int r = FW_DELTA_MORE;
+
+    d.put = ram_put;
+    d.at = ram_at;
+    d.old = old;
+    d.old_len = old_len;
+    fw_delta_init(&d);
+    ram_len = 0;
+    ram_max = sizeof(ram_out);
+    while (k < n && r == FW_DELTA_MORE) {
+        unsigned long step = cuts == 0 ? n - k : cuts == 1 ? 1 : 1 + urand(40);
+
+        if (step > n - k) step = n - k;
+        r = fw_delta_feed(&d, p + k, step);
+        k += step;
+    }
+    if (r == FW_DELTA_ERR) {
+        feed_err_at = k - 1;
+        return r;
+    }
+    feed_err_at = k;
+    if (r == FW_DELTA_MORE) return FW_DELTA_MORE;
+    return k == n ? r : FW_DELTA_ERR;   /* END の後ろにまだある */
+}
+
+/* ------------------------------------------------------------ 2. 手順 (begin / data / end) */
+
+static int run_protocol(int id, const unsigned char *old, unsigned long old_len,
+                        const unsigned char *new_img, unsigned long new_len,
+                        const unsigned char *dbytes, unsigned long delta_len,
+                        int *crc_retries, int *dups)
+{
+    unsigned long seq, chunks = (delta_len + 127) / 128;
+
+    memset((void *)ROM_BASE, 0xFF, ROM_SIZE);
+    memcpy((void *)FW_APP_BASE, old, old_len);
+    base_len = old_len;
+    base_crc = fw_crc32(0, old, old_len);
+    upd_state = UPD_IDLE;
+
+    host_line("{\"type\":\"fw\",\"op\":\"begin\",\"base_crc\":\"%08lx\",\"new_len\":%lu,"
+              "\"new_crc\":\"%08lx\",\"delta_len\":%lu}",
+              base_crc, new_len, fw_crc32(0, new_img, new_len), delta_len);
+    if (!reply_is("ok", NULL)) {
+        fail("case %d: begin -> %s", id, last_reply);
+        return -1;
+    }
+
+    for (seq = 0; seq < chunks; seq++) {
+        const unsigned char *part = dbytes + seq * 128;
+        int n = (int)(delta_len - seq * 128 < 128 ? delta_len - seq * 128 : 128);
+        unsigned long crc = fw_crc32(0, part, (unsigned long)n);
+
+        if (urand(8) == 0) {
+            /* 行が化けた: CRC で弾かれて、同じ seq の再送で通る */
+            data_line(seq, part, n, crc ^ 0x00010000UL);
+            if (!reply_is("err", "crc")) {
+                fail("case %d: seq %lu bad crc -> %s", id, seq, last_reply);
+                return -1;
+            }
+            (*crc_retries)++;
+        }
+        data_line(seq, part, n, crc);
+        if (!reply_is("ok", NULL)) {
+            fail("case %d: seq %lu -> %s", id, seq, last_reply);
+            return -1;
+        }
+        if (urand(8) == 0) {
+            /* ok が失われた: 同じ行の再送は ok だけで、出力は増えない */
+            unsigned long out = delta.out_len;
+
+            data_line(seq, part, n, crc);
+            if (!reply_is("ok", NULL) || delta.out_len != out) {
+                fail("case %d: seq %lu dup -> %s (out %lu -> %lu)",
+                     id, seq, last_reply, out, delta.out_len);
+                return -1;
+            }
+            (*dups)++;
+        }
+    }
+    if (chunks > 1) {
+        /* 先の seq / 戻りすぎた seq は拒否 */
+        data_line(chunks + 1, dbytes, 4, fw_crc32(0, dbytes, 4));
+        if (!reply_is("err", "seq")) fail("case %d: seq skip -> %s", id, last_reply);
+        data_line(0, dbytes, 4, fw_crc32(0, dbytes, 4));
+        if (!reply_is("err", "seq")) fail("case %d: seq rewind -> %s", id, last_reply);
+    }
+
+    host_line("{\"type\":\"fw\",\"op\":\"end\"}");
+    if (!reply_is("done", NULL)) {
+        fail("case %d: end -> %s", id, last_reply);
+        return -1;
+    }
+    if (memcmp((const void *)FW_APP_BASE, new_img, new_len) != 0) {
+        fail("case %d: app area != new image", id);
+        return -1;
+    }
+    if (SWAP_REC->magic == FW_SWAP_MAGIC) {
+        fail("case %d: swap record left after copy", id);
+        return -1;
+    }
+    return 0;
+}
+
+/* 手順の拒否 (差分の中身より前で止まるもの) */
+static void protocol_rejects(void)
+{
+    static const unsigned char delta_end[] = { 0x03, 1, 2, 3, 4, 0xC1 };
+
+    memset((void *)ROM_BASE, 0xFF, ROM_SIZE);
+    base_len = 0;
+    base_crc = fw_crc32(0, NULL, 0);
+    upd_state = UPD_IDLE;
+
+    data_line(0, delta_end, sizeof(delta_end), fw_crc32(0, delta_end, sizeof(delta_end)));
+    if (!reply_is("err", "state")) fail("data before begin -> %s", last_reply);
+
+    host_line("{\"type\":\"fw\",\"op\":\"begin\",\"base_crc\":\"%08lx\",\"new_len\":64,"
+              "\"new_crc\":\"00000000\",\"delta_len\":6}", base_crc ^ 1);
+    if (!reply_is("err", "base")) fail("begin wrong base -> %s", last_reply);
+
+    host_line("{\"type\":\"fw\",\"op\":\"begin\",\"base_crc\":\"%08lx\",\"new_len\":%lu,"
+              "\"new_crc\":\"00000000\",\"delta_len\":6}", base_crc, FW_IMAGE_MAX + 1);
+    if (!reply_is("err", "size")) fail("begin too large -> %s", last_reply);
+
+    /* 4 バイトしか出ないのに new_len は 64: end で長さ違い */
+    host_line("{\"type\":\"fw\",\"op\":\"begin\",\"base_crc\":\"%08lx\",\"new_len\":64,"
+              "\"new_crc\":\"00000000\",\"delta_len\":6}", base_crc);
+    data_line(0, delta_end, sizeof(delta_end), fw_crc32(0, delta_end, sizeof(delta_end)));
+    if (!reply_is("ok", NULL)) fail("short delta data -> %s", last_reply);
+    host_line("{\"type\":\"fw\",\"op\":\"end\"}");
+    if (!reply_is("err", "length")) fail("short delta end -> %s", last_reply);
+
+    /* 壊れた差分は data で止まり、以降は end まで受け付けない */
+    host_line("{\"type\":\"fw\",\"op\":\"begin\",\"base_crc\":\"%08lx\",\"new_len\":64,"
+              "\"new_crc\":\"00000000\",\"delta_len\":2}", base_crc);
+    {
+        static const unsigned char bad[] = { 0xA0, 0x01 };     /* 何も書く前の NEW */
+
+        data_line(0, bad, sizeof(bad), fw_crc32(0, bad, sizeof(bad)));
+        if (!reply_is("err", "delta")) fail("bad delta data -> %s", last_reply);
+        data_line(1, bad, sizeof(bad), fw_crc32(0, bad, sizeof(bad)));
+        if (!reply_is("err", "state")) fail("data after bad delta -> %s", last_reply);
+    }
+}
+
+/* ------------------------------------------------------------ 3. 壊れた差分 */
+
+struct bad_case {
+    const char          *name;
+    unsigned char        bytes[16];
+    int                  n;
+    int                  want;
+    int                  at;            /* FW_DELTA_ERR を返すべきバイトの位置 */
+};
+
+/* 位置まで確かめる: ホストの unsigned long は 64 ビットなので、varint の上位を
+ * 捨てない版でも値が範囲外になって後で ERR になる。RX では捨てた値が通ってしまう */
+static void malformed(void)
+{
+    static const unsigned char old[16] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+    };
+    static const struct bad_case cases[] = {
+        /* OLD 4 バイト: 位置 +12 は 12..15 で収まる, +13 は 1 バイトはみ出す */
+        { "old in range",           { 0x80, 24, 0xC1 },                          3, FW_DELTA_END, -1 },
+        { "old past old_len",       { 0x80, 26, 0xC1 },                          3, FW_DELTA_ERR, 1 },
+        { "old before 0",           { 0x80, 1, 0xC1 },                           3, FW_DELTA_ERR, 1 },
+        { "old second copy past",   { 0x80, 16, 0x80, 2, 0xC1 },                 5, FW_DELTA_ERR, 3 },
+        /* NEW: 出力 2 バイトに距離 2 は可, 3 は出力の前, 0 は形式違反 */
+        { "new in range",           { 0x01, 7, 8, 0xA0, 2, 0xC1 },               6, FW_DELTA_END, -1 },
+        { "new distance > out_len", { 0x01, 7, 8, 0xA0, 3, 0xC1 },               6, FW_DELTA_ERR, 4 },
+        { "new distance 0",         { 0x01, 7, 8, 0xA0, 0, 0xC1 },               6, FW_DELTA_ERR, 4 },
+        /* varint: 5 バイトで 0 (冗長だが 32 ビットに収まる) は可, 5 バイト目の上位 4 ビットは違反 */
+        { "varint 5 bytes, 0",      { 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0xC1 }, 7, FW_DELTA_END, -1 },
+        { "varint bit 32 (FILL)",   { 0xC0, 0x80, 0x80, 0x80, 0x80, 0x10, 0xAA, 0xC1 }, 8, FW_DELTA_ERR, 5 },
+        { "varint bit 34 (OLD)",    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x40, 0xC1 }, 7, FW_DELTA_ERR, 5 },
+        { "varint 6 bytes",         { 0xC0, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0xC1 }, 8, FW_DELTA_ERR, 5 },
+        { "len varint overflow",    { 0x9F, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x00, 0xC1 }, 8, FW_DELTA_ERR, 5 },
+        /* その他 */
+        { "unknown op",             { 0xC2 },                                    1, FW_DELTA_ERR, 0 },
+        { "bytes after END",        { 0xC1, 0x00 },                              2, FW_DELTA_ERR, 1 },
+        { "truncated",              { 0x03, 1, 2 },                              3, FW_DELTA_MORE, -1 },
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const struct bad_case *c = &cases[i];
+        int whole = feed_ram(old, sizeof(old), c->bytes, (unsigned long)c->n, 0);
+        int bytewise = feed_ram(old, sizeof(old), c->bytes, (unsigned long)c->n, 1);
+
+        if (whole != c->want || bytewise != c->want) {
+            fail("malformed '%s': %d / %d (want %d)", c->name, whole, bytewise, c->want);
+        } else if (c->at >= 0 && feed_err_at != (unsigned long)c->at) {
+            fail("malformed '%s': error at byte %lu (want %d)", c->name, feed_err_at, c->at);
+        }
+    }
+    printf("malformed: %d cases\n", (int)i);
+}
+
+/* ------------------------------------------------------------ */
+
+static unsigned char old_img[FW_IMAGE_MAX];
+static unsigned char new_img[FW_IMAGE_MAX];
+static unsigned char delta_buf[FW_IMAGE_MAX * 2];
+
+int main(int argc, char **argv)
+{
+    int cases = 40, i, crc_retries = 0, dups = 0;
+    unsigned long total_new = 0, total_delta = 0;
+    void *rom;
+
+    for (i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(a, "--cases") == 0 && v) {
+            cases = atoi(v);
+            i++;
+        } else if (strcmp(a, "--seed") == 0 && v) {
+            rng = strtoull(v, NULL, 0) | 1;
+            i++;
+        } else if (strcmp(a, "--py") == 0 && v) {
+            fwdelta_py = v;
+            i++;
+        } else {
+            fprintf(stderr, "usage: %s [--cases N] [--seed S] [--py ../tools/fwdelta.py]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    rom = mmap((void *)ROM_BASE, ROM_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (rom != (void *)ROM_BASE) {
+        perror("mmap ROM");
+        return 2;
+    }
+    if (mkdtemp(tmpdir) == NULL) {
+        perror("mkdtemp");
+        return 2;
+    }
+
+    malformed();
+    protocol_rejects();
+
+    for (i = 0; i < cases; i++) {
+        /* 0: 空の旧イメージ (アプリ領域が壊れている → 全体を送る), 後ろほど大きく */
+        unsigned long old_len = i == 0 ? 0 : 64 + urand(i < cases / 2 ? 4096 : 96 * 1024);
+        unsigned long new_len;
+        long delta_len;
+
+        make_old(old_img, old_len);
+        new_len = make_new(old_img, old_len, new_img, old_len + 8192 < FW_IMAGE_MAX ?
+                           old_len + 8192 : FW_IMAGE_MAX);
+        delta_len = encode_py(old_img, old_len, new_img, new_len, delta_buf, sizeof(delta_buf));
+        if (delta_len <= 0) {
+            fail("case %d: fwdelta.py encode failed (%s)", i, fwdelta_py);
+            break;
+        }
+
+        if (feed_ram(old_img, old_len, delta_buf, (unsigned long)delta_len, 2) != FW_DELTA_END ||
+            ram_len != new_len || memcmp(ram_out, new_img, new_len) != 0) {
+            fail("case %d: round trip (old %lu, new %lu, delta %ld) -> %lu bytes",
+                 i, old_len, new_len, delta_len, ram_len);
+            continue;
+        }
+        run_protocol(i, old_img, old_len, new_img, new_len, delta_buf,
+                     (unsigned long)delta_len, &crc_retries, &dups);
+        total_new += new_len;
+        total_delta += (unsigned long)delta_len;
+    }
+
+    printf("round trip: %d cases, new %lu B, delta %lu B (%.1f%%)\n", cases, total_new,
+           total_delta, total_new ? 100.0 * total_delta / total_new : 0.0);
+    printf("protocol: crc retries %d, duplicate seq %d\n", crc_retries, dups);
+
+    snprintf(line, sizeof(line), "rm -rf %s", tmpdir);
+    if (system(line) != 0) fprintf(stderr, "%s failed\n", line);
+
+    printf("%s\n", failures ? "NG" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,29 @@
+/*
+ * FreeRTOS.h - iot-demo-rx-test の FreeRTOS API を仮想時刻カーネルで置き換える
+ *
+ * 1 tick = 1ms。優先度は同時刻に起きたタスクの実行順にだけ効く (プリエンプションなし)
+ */
+
+#ifndef SIM_RX_FREERTOS_H
+#define SIM_RX_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef long          BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t      TickType_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              1
+#define pdFAIL              0
+#define portMAX_DELAY       ((TickType_t)0xFFFFFFFFUL)
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+
+/* 割り込みからの切り替え要求はスケジューラが次に回すだけ */
+#define portYIELD_FROM_ISR(x)   ((void)(x))
+
+#endif /* SIM_RX_FREERTOS_H */
@@ -0,0 +1,30 @@
+/*
+ * iodefine.h - シミュレーション用の RX63N I/O レジスタ (使う分だけ)
+ */
+
+#ifndef SIM_RX_IODEFINE_H
+#define SIM_RX_IODEFINE_H
+
+typedef union {
+    unsigned char BYTE;
+    struct {
+        unsigned char B0:1;
+        unsigned char B1:1;
+        unsigned char B2:1;
+        unsigned char B3:1;
+        unsigned char B4:1;
+        unsigned char B5:1;
+        unsigned char B6:1;
+        unsigned char B7:1;
+    } BIT;
+} sim_port_reg_t;
+
+struct sim_port {
+    sim_port_reg_t PDR;
+    sim_port_reg_t PODR;
+};
+
+/* PORTE.B0 = LED1 (status_task) */
+extern volatile struct sim_port PORTE;
+
+#endif /* SIM_RX_IODEFINE_H */
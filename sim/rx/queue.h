@@ -0,0 +1,20 @@
+/*
+ * queue.h - FreeRTOS キュー API (仮想時刻カーネル版)
+ *
+ * Ethernet (net_task.c / lwIP の sys_arch.c) が使う分だけ
+ */
+
+#ifndef SIM_RX_QUEUE_H
+#define SIM_RX_QUEUE_H
+
+#include "FreeRTOS.h"
+
+typedef struct sim_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void          vQueueDelete(QueueHandle_t q);
+BaseType_t    xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks);
+BaseType_t    xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken);
+BaseType_t    xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks);
+
+#endif /* SIM_RX_QUEUE_H */
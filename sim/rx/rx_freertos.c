@@ -0,0 +1,177 @@
+/*
+ * rx_freertos.c - FreeRTOS API を sim_kernel で実装 (GR-SAKURA 側)
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "queue.h"
+#include "sim_kernel.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct sim_sem {
+    int count;
+    int max;
+    sim_waitq_t waiters;
+};
+
+static uint64_t tick_deadline(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) return SIM_FOREVER;
+    return sim_now() + (uint64_t)ticks * 1000;
+}
+
+/* ------------------------------------------------------------ タスク */
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint16_t usStackDepth,
+                       void *arg, UBaseType_t prio, TaskHandle_t *handle)
+{
+    sim_task_t *t;
+
+    (void)usStackDepth;
+    t = sim_spawn(name, (int)prio, fn, arg, 0);
+    if (handle) *handle = t;
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    sim_block(NULL, tick_deadline(ticks));
+}
+
+void vTaskDelayUntil(TickType_t *prevWake, TickType_t period)
+{
+    *prevWake += period;
+    /* 期限を過ぎていても一度は譲る (FreeRTOS は即戻るが、協調なので他を回す) */
+    sim_block(NULL, (uint64_t)*prevWake * 1000);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(sim_now() / 1000);
+}
+
+/* ------------------------------------------------------------ セマフォ */
+
+static SemaphoreHandle_t sem_create(int count, int max)
+{
+    SemaphoreHandle_t s = calloc(1, sizeof(*s));
+
+    if (s) {
+        s->count = count;
+        s->max = max;
+    }
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return sem_create(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return sem_create(0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    return sem_create((int)initial, (int)max);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    free(sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    uint64_t deadline = tick_deadline(ticks);
+
+    while (sem->count == 0) {
+        if (ticks == 0 || sim_now() >= deadline) return pdFALSE;
+        sim_block(&sem->waiters, deadline);
+    }
+    sem->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (sem->count >= sem->max) return pdFALSE;
+    sem->count++;
+    sim_wake_one(&sem->waiters);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken)
+{
+    if (woken) *woken = sem->waiters.head != NULL;
+    return xSemaphoreGive(sem);
+}
+
+/* ------------------------------------------------------------ キュー */
+
+struct sim_queue {
+    unsigned char *buf;
+    size_t item;
+    UBaseType_t len;
+    UBaseType_t head;
+    UBaseType_t count;
+    sim_waitq_t readers;
+    sim_waitq_t writers;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    QueueHandle_t q = calloc(1, sizeof(*q));
+
+    if (q) {
+        q->buf = calloc(length, itemSize);
+        q->item = itemSize;
+        q->len = length;
+    }
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    free(q->buf);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    uint64_t deadline = tick_deadline(ticks);
+
+    while (q->count == q->len) {
+        if (ticks == 0 || sim_now() >= deadline) return pdFALSE;
+        sim_block(&q->writers, deadline);
+    }
+    memcpy(q->buf + ((q->head + q->count) % q->len) * q->item, item, q->item);
+    q->count++;
+    sim_wake_one(&q->readers);
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken)
+{
+    if (woken) *woken = q->readers.head != NULL;
+    return xQueueSend(q, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    uint64_t deadline = tick_deadline(ticks);
+
+    while (q->count == 0) {
+        if (ticks == 0 || sim_now() >= deadline) return pdFALSE;
+        sim_block(&q->readers, deadline);
+    }
+    memcpy(item, q->buf + q->head * q->item, q->item);
+    q->head = (q->head + 1) % q->len;
+    q->count--;
+    sim_wake_one(&q->writers);
+    return pdTRUE;
+}
@@ -0,0 +1,42 @@
+/*
+ * rx_main.c - GR-SAKURA (iot-demo-rx-test) の FreeRTOS main 相当
+ *
+ * 実機の main.c は LED 点滅テストのため、フル構成 (Makefile のコメント) の
+ * 共有データとタスク生成をここに置く
+ */
+
+#include "app_config.h"
+#include "iodefine.h"
+#include "sci2_uart.h"
+#include "sim_board.h"
+#include "uart_task.h"
+#include "pid_task.h"
+#include "anomaly_task.h"
+#include "wdt_task.h"
+#include "status_task.h"
+#include "net_task.h"
+#include "sd_log.h"
+
+SemaphoreHandle_t g_data_mutex;
+sensor_data_t     g_sensor;
+long              g_pwm;
+long              g_setpoint = DEFAULT_TARGET;
+long              g_kp = DEFAULT_KP, g_ki = DEFAULT_KI, g_kd = DEFAULT_KD;
+volatile int      g_emergency_stop;
+volatile unsigned long g_task_alive_bits;
+
+volatile struct sim_port PORTE;
+
+void rx_start(void)
+{
+    g_data_mutex = xSemaphoreCreateMutex();
+    sci2_init();
+
+    xTaskCreate(wdt_task,     "rx_wdt",     STACK_WDT,     NULL, PRIORITY_WDT,     NULL);
+    xTaskCreate(uart_task,    "rx_uart",    STACK_UART,    NULL, PRIORITY_UART,    NULL);
+    xTaskCreate(pid_task,     "rx_pid",     STACK_PID,     NULL, PRIORITY_PID,     NULL);
+    xTaskCreate(anomaly_task, "rx_anomaly", STACK_ANOMALY, NULL, PRIORITY_ANOMALY, NULL);
+    xTaskCreate(status_task,  "rx_status",  STACK_STATUS,  NULL, PRIORITY_STATUS,  NULL);
+    net_init();
+    sdlog_init();
+}
@@ -0,0 +1,20 @@
+/*
+ * semphr.h - FreeRTOS セマフォ / ミューテックス (仮想時刻カーネル版)
+ */
+
+#ifndef SIM_RX_SEMPHR_H
+#define SIM_RX_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+typedef struct sim_sem *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+void              vSemaphoreDelete(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken);
+
+#endif /* SIM_RX_SEMPHR_H */
@@ -0,0 +1,574 @@
+/*
+ * sim_etherc.c - ETHERC / EDMAC ドライバ (etherc.h) の仮想版 + 相手のホスト
+ *
+ * 100Mbps 全二重の線 1 本の先に「ダッシュボードのホスト」を 1 台置く。
+ * ホストは lwIP を使わない最小の実装で、
+ *   ARP     GR-SAKURA の問い合わせに答え、自分からも問い合わせる
+ *   UDP     NET_TELEM_PORT に届いた行を sim_main へ渡す
+ *   TCP     sim_rx_eth_command() の行を 1 接続 1 行で NET_CMD_PORT へ送り、
+ *           返ってきた ack の行を sim_main へ渡して自分から閉じる
+ * 再送はしない (線で落ちることはない)。
+ *
+ * 受信記述子 / バッファプールの数と「記述子が空なら落とす (RDE)」は実機と同じ。
+ * 送信は送り終えた時刻に断片を読むので、送信完了前に上位がバッファを
+ * 書き換えたり解放したりすればホストが受け取る中身が壊れて分かる。
+ */
+
+#include "FreeRTOS.h"
+#include "etherc.h"
+#include "net_task.h"
+#include "sim_board.h"
+#include "sim_kernel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIRE_BPS        100000000ULL
+#define WIRE_OVERHEAD   24          /* プリアンブル 8 + FCS 4 + IFG 12 [byte] */
+#define LINK_UP_US      1500000     /* 自動ネゴシエーション */
+#define HOST_DELAY_US   50          /* ホストが応答するまで */
+#define CMD_TIMEOUT_US  5000000     /* TCP の 1 行がこれで終わらなければ RST */
+#define CMD_QUEUE       4
+#define CMD_LINE_MAX    256
+#define HOST_PORT_BASE  40000
+
+static const unsigned char host_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x0a };
+static unsigned char rx_mac[6];
+static unsigned char rx_ip[4];
+static unsigned char host_ip[4];
+static int           rx_mac_known = 0;
+
+static sim_rx_eth_line_fn line_cb = NULL;
+
+/* ------------------------------------------------------------ 線 */
+
+static uint64_t wire_free = 0;      /* 各方向の線が空く時刻 */
+static uint64_t wire_free_in = 0;
+
+static uint64_t wire_time(unsigned int len)
+{
+    if (len < ETH_FRAME_MIN) len = ETH_FRAME_MIN;
+    return ((uint64_t)(len + WIRE_OVERHEAD) * 8 * 1000000 + WIRE_BPS - 1) / WIRE_BPS;
+}
+
+/* ------------------------------------------------------------ 受信側 (GR-SAKURA) */
+
+static unsigned char rx_pool[ETH_RX_BUFS][ETH_BUF_SIZE];
+static unsigned int  rx_len[ETH_RX_BUFS];
+static int           rx_free[ETH_RX_BUFS];      /* 空きバッファ (スタック) */
+static int           rx_nfree;
+static int           rx_armed[ETH_RX_DESC];     /* 記述子に付いたバッファ (順番) */
+static int           rx_narmed;
+static int           rx_done[ETH_RX_DESC];      /* 受信済みで取り出し待ち */
+static int           rx_ndone;
+
+static etherc_stats_t stats;
+static uint64_t       link_at = SIM_FOREVER;
+static int            irq_pending = 0;
+static sim_waitq_t    irq_wait;
+
+static void raise_irq(void)
+{
+    irq_pending = 1;
+    sim_wake_all(&irq_wait);
+}
+
+/* 空いた記述子にバッファを付け直す (etherc.c の rx_refill 相当) */
+static void rx_refill(void)
+{
+    while (rx_narmed + rx_ndone < ETH_RX_DESC && rx_nfree > 0) {
+        rx_armed[rx_narmed++] = rx_free[--rx_nfree];
+    }
+}
+
+struct frame {
+    unsigned int  len;
+    unsigned char data[ETH_BUF_SIZE];
+};
+
+/* ホスト → GR-SAKURA: 最後のビットが届いた時刻に呼ばれる */
+static void rx_arrive(void *arg)
+{
+    struct frame *f = arg;
+    int idx;
+
+    if (sim_now() < link_at) {
+        /* リンク前は PHY が捨てる */
+    } else if (rx_narmed == 0) {
+        stats.rx_nobuf++;
+    } else {
+        idx = rx_armed[0];
+        memmove(rx_armed, rx_armed + 1, (size_t)--rx_narmed * sizeof(rx_armed[0]));
+        memcpy(rx_pool[idx], f->data, f->len);
+        rx_len[idx] = f->len;
+        rx_done[rx_ndone++] = idx;
+        stats.rx_frames++;
+        raise_irq();
+    }
+    free(f);
+}
+
+int etherc_init(const unsigned char mac[6])
+{
+    int i;
+
+    memcpy(rx_mac, mac, 6);
+    for (i = 0; i < ETH_RX_BUFS; i++) rx_free[i] = ETH_RX_BUFS - 1 - i;
+    rx_nfree = ETH_RX_BUFS;
+    rx_refill();
+    link_at = sim_now() + LINK_UP_US;
+    return 0;
+}
+
+int etherc_link_poll(void)
+{
+    int up = sim_now() >= link_at;
+
+    stats.link = up ? 100 : 0;
+    stats.full_duplex = up;
+    return up;
+}
+
+int etherc_wait(TickType_t ticks)
+{
+    uint64_t deadline = sim_now() + (uint64_t)ticks * 1000;
+
+    while (!irq_pending) {
+        if (sim_now() >= deadline) return 0;
+        sim_block(&irq_wait, deadline);
+    }
+    irq_pending = 0;
+    return 1;
+}
+
+int etherc_rx_take(unsigned int *len)
+{
+    int idx;
+
+    if (rx_ndone == 0) return -1;
+    idx = rx_done[0];
+    memmove(rx_done, rx_done + 1, (size_t)--rx_ndone * sizeof(rx_done[0]));
+    *len = rx_len[idx];
+    rx_refill();
+    return idx;
+}
+
+unsigned char *etherc_rx_buf(int idx)
+{
+    return rx_pool[idx];
+}
+
+void etherc_rx_release(int idx)
+{
+    rx_free[rx_nfree++] = idx;
+    rx_refill();
+}
+
+/* ------------------------------------------------------------ 送信側 (GR-SAKURA) */
+
+typedef struct {
+    etherc_seg_t seg[ETH_TX_DESC];
+    int          n;
+    int          ndesc;
+    void        *token;
+    int          done;
+} tx_slot_t;
+
+static tx_slot_t tx_ring[ETH_TX_DESC];
+static int       tx_head = 0;       /* 次に完了を返す */
+static int       tx_count = 0;      /* 使っている枠 */
+static int       tx_desc_used = 0;
+
+static void host_receive(const unsigned char *f, unsigned int len);
+
+/* 送り終えた時刻に断片を集めてホストへ */
+static void tx_complete(void *arg)
+{
+    tx_slot_t *s = arg;
+    unsigned char buf[ETH_BUF_SIZE];
+    unsigned int len = 0;
+    int i;
+
+    for (i = 0; i < s->n; i++) {
+        if (len + s->seg[i].len > sizeof(buf)) break;
+        memcpy(buf + len, s->seg[i].data, s->seg[i].len);
+        len += s->seg[i].len;
+    }
+    while (len < ETH_FRAME_MIN) buf[len++] = 0;
+    s->done = 1;
+    stats.tx_frames++;
+    raise_irq();
+    host_receive(buf, len);
+}
+
+int etherc_tx(const etherc_seg_t *seg, int n, void *token)
+{
+    tx_slot_t *s;
+    unsigned int len = 0;
+    int i, ndesc;
+
+    for (i = 0; i < n; i++) len += seg[i].len;
+    ndesc = n + (len < ETH_FRAME_MIN);
+    if (n <= 0 || tx_desc_used + ndesc > ETH_TX_DESC) {
+        stats.tx_full++;
+        return -1;
+    }
+
+    s = &tx_ring[(tx_head + tx_count) % ETH_TX_DESC];
+    memcpy(s->seg, seg, (size_t)n * sizeof(seg[0]));
+    s->n = n;
+    s->ndesc = ndesc;
+    s->token = token;
+    s->done = 0;
+    tx_count++;
+    tx_desc_used += ndesc;
+
+    if (wire_free < sim_now()) wire_free = sim_now();
+    wire_free += wire_time(len);
+    sim_at(wire_free, tx_complete, s);
+    return 0;
+}
+
+void *etherc_tx_done(void)
+{
+    tx_slot_t *s = &tx_ring[tx_head];
+
+    if (tx_count == 0 || !s->done) return NULL;
+    tx_head = (tx_head + 1) % ETH_TX_DESC;
+    tx_count--;
+    tx_desc_used -= s->ndesc;
+    return s->token;
+}
+
+void etherc_get_stats(etherc_stats_t *out)
+{
+    *out = stats;
+}
+
+void etherc_eint_isr(void)
+{
+}
+
+/* ------------------------------------------------------------ ホスト: フレーム */
+
+static unsigned int rd16(const unsigned char *p)
+{
+    return ((unsigned int)p[0] << 8) | p[1];
+}
+
+static unsigned long rd32(const unsigned char *p)
+{
+    return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) |
+           ((unsigned long)p[2] << 8) | p[3];
+}
+
+static void wr16(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+static void wr32(unsigned char *p, unsigned long v)
+{
+    wr16(p, (unsigned int)(v >> 16));
+    wr16(p + 2, (unsigned int)v);
+}
+
+static unsigned long csum_add(unsigned long sum, const unsigned char *p, unsigned int len)
+{
+    while (len > 1) {
+        sum += rd16(p);
+        p += 2;
+        len -= 2;
+    }
+    if (len) sum += (unsigned long)p[0] << 8;
+    return sum;
+}
+
+static unsigned int csum_fold(unsigned long sum)
+{
+    while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    return (unsigned int)(~sum & 0xFFFF);
+}
+
+/* ホスト → GR-SAKURA へ 1 フレーム */
+static void host_send(const unsigned char *f, unsigned int len)
+{
+    struct frame *fr = malloc(sizeof(*fr));
+    uint64_t start = sim_now() + HOST_DELAY_US;
+
+    memcpy(fr->data, f, len);
+    while (len < ETH_FRAME_MIN) fr->data[len++] = 0;
+    fr->len = len;
+    if (wire_free_in > start) start = wire_free_in;
+    wire_free_in = start + wire_time(len);
+    sim_at(wire_free_in, rx_arrive, fr);
+}
+
+static void send_arp(int op, const unsigned char *dst_mac)
+{
+    unsigned char f[42];
+
+    memcpy(f, op == 1 ? (const unsigned char *)"\xff\xff\xff\xff\xff\xff" : dst_mac, 6);
+    memcpy(f + 6, host_mac, 6);
+    wr16(f + 12, 0x0806);
+    wr16(f + 14, 1);            /* Ethernet */
+    wr16(f + 16, 0x0800);
+    f[18] = 6;
+    f[19] = 4;
+    wr16(f + 20, (unsigned int)op);
+    memcpy(f + 22, host_mac, 6);
+    memcpy(f + 28, host_ip, 4);
+    memcpy(f + 32, op == 1 ? (const unsigned char *)"\0\0\0\0\0\0" : dst_mac, 6);
+    memcpy(f + 38, rx_ip, 4);
+    host_send(f, sizeof(f));
+}
+
+/* IPv4 ヘッダ (20 バイト) を f + 14 に書いて Ethernet ヘッダを付ける */
+static void ip_header(unsigned char *f, int proto, unsigned int payload)
+{
+    static unsigned int ip_id = 1;
+    unsigned char *ip = f + 14;
+
+    memcpy(f, rx_mac, 6);
+    memcpy(f + 6, host_mac, 6);
+    wr16(f + 12, 0x0800);
+    memset(ip, 0, 20);
+    ip[0] = 0x45;
+    wr16(ip + 2, 20 + payload);
+    wr16(ip + 4, ip_id++);
+    ip[8] = 64;
+    ip[9] = (unsigned char)proto;
+    memcpy(ip + 12, host_ip, 4);
+    memcpy(ip + 16, rx_ip, 4);
+    wr16(ip + 10, csum_fold(csum_add(0, ip, 20)));
+}
+
+/* ------------------------------------------------------------ ホスト: TCP クライアント */
+
+enum { TCP_IDLE, TCP_SYN_SENT, TCP_ESTABLISHED, TCP_FIN_WAIT };
+
+static struct {
+    int           state;
+    unsigned int  port;
+    unsigned long snd_nxt;
+    unsigned long rcv_nxt;
+    char          rx[CMD_LINE_MAX];
+    int           rx_len;
+} tcp;
+
+static char cmd_q[CMD_QUEUE][CMD_LINE_MAX];
+static int  cmd_head = 0, cmd_count = 0;
+static unsigned long tcp_sessions = 0;
+static unsigned long tcp_failures = 0;
+
+static void tcp_send(int flags, const char *data, unsigned int len)
+{
+    unsigned char f[14 + 20 + 20 + CMD_LINE_MAX];
+    unsigned char *t = f + 34;
+    unsigned char pseudo[12];
+    unsigned long sum;
+
+    ip_header(f, 6, 20 + len);
+    memset(t, 0, 20);
+    wr16(t, tcp.port);
+    wr16(t + 2, NET_CMD_PORT);
+    wr32(t + 4, tcp.snd_nxt);
+    wr32(t + 8, (flags & 0x10) ? tcp.rcv_nxt : 0);
+    t[12] = 5 << 4;
+    t[13] = (unsigned char)flags;
+    wr16(t + 14, 8192);
+    if (len) memcpy(t + 20, data, len);
+
+    memcpy(pseudo, host_ip, 4);
+    memcpy(pseudo + 4, rx_ip, 4);
+    pseudo[8] = 0;
+    pseudo[9] = 6;
+    wr16(pseudo + 10, 20 + len);
+    sum = csum_add(csum_add(0, pseudo, 12), t, 20 + len);
+    wr16(t + 16, csum_fold(sum));
+
+    host_send(f, 34 + 20 + len);
+}
+
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_PSH 0x08
+#define TCP_ACK 0x10
+
+static void tcp_start(void *arg);
+
+static void tcp_finish(int ok)
+{
+    if (!ok) tcp_failures++;
+    tcp.state = TCP_IDLE;
+    cmd_head = (cmd_head + 1) % CMD_QUEUE;
+    cmd_count--;
+    if (cmd_count > 0) sim_at(sim_now() + HOST_DELAY_US, tcp_start, NULL);
+}
+
+/* arg はセッション番号 (もう終わったセッションなら何もしない) */
+static void tcp_timeout(void *arg)
+{
+    if (tcp.state == TCP_IDLE || tcp_sessions != (unsigned long)(uintptr_t)arg) return;
+    tcp_send(TCP_RST | TCP_ACK, NULL, 0);
+    tcp_finish(0);
+}
+
+static void tcp_start(void *arg)
+{
+    (void)arg;
+    if (tcp.state != TCP_IDLE || cmd_count == 0) return;
+    if (!rx_mac_known) {
+        /* ARP の答えで rx_mac_known が立ったらやり直す */
+        send_arp(1, NULL);
+        return;
+    }
+    tcp.port = HOST_PORT_BASE + (unsigned int)(tcp_sessions % 20000);
+    tcp.snd_nxt = 1000UL * (tcp_sessions + 1);
+    tcp.rcv_nxt = 0;
+    tcp.rx_len = 0;
+    tcp.state = TCP_SYN_SENT;
+    tcp_sessions++;
+    tcp_send(TCP_SYN, NULL, 0);
+    tcp.snd_nxt++;
+    sim_at(sim_now() + CMD_TIMEOUT_US, tcp_timeout, (void *)(uintptr_t)tcp_sessions);
+}
+
+static void tcp_receive(const unsigned char *t, unsigned int len)
+{
+    unsigned int hlen = (unsigned int)(t[12] >> 4) * 4;
+    int flags = t[13];
+    unsigned long seq = rd32(t + 4);
+    unsigned long ack = rd32(t + 8);
+    const unsigned char *data = t + hlen;
+    unsigned int dlen = len > hlen ? len - hlen : 0;
+    unsigned int i;
+
+    if (tcp.state == TCP_IDLE || rd16(t + 2) != tcp.port) return;
+    if (flags & TCP_RST) {
+        tcp_finish(0);
+        return;
+    }
+
+    if (tcp.state == TCP_SYN_SENT) {
+        const char *line = cmd_q[cmd_head];
+
+        if ((flags & (TCP_SYN | TCP_ACK)) != (TCP_SYN | TCP_ACK) || ack != tcp.snd_nxt) return;
+        tcp.rcv_nxt = (seq + 1) & 0xFFFFFFFFUL;
+        tcp.state = TCP_ESTABLISHED;
+        tcp_send(TCP_ACK | TCP_PSH, line, (unsigned int)strlen(line));
+        tcp.snd_nxt += strlen(line);
+        return;
+    }
+
+    if (dlen > 0 && seq == tcp.rcv_nxt) {
+        tcp.rcv_nxt = (tcp.rcv_nxt + dlen) & 0xFFFFFFFFUL;
+        for (i = 0; i < dlen; i++) {
+            if (data[i] == '\n') {
+                tcp.rx[tcp.rx_len] = '\0';
+                if (line_cb) line_cb(SIM_ETH_ACK, tcp.rx, (size_t)tcp.rx_len);
+                tcp.rx_len = 0;
+            } else if (tcp.rx_len < CMD_LINE_MAX - 1) {
+                tcp.rx[tcp.rx_len++] = (char)data[i];
+            }
+        }
+    }
+    if (flags & TCP_FIN) tcp.rcv_nxt = (tcp.rcv_nxt + 1) & 0xFFFFFFFFUL;
+
+    if (tcp.state == TCP_ESTABLISHED && (dlen > 0 || (flags & TCP_FIN))) {
+        /* ack を受け取ったら (または向こうが閉じたら) こちらも閉じる */
+        tcp_send(TCP_FIN | TCP_ACK, NULL, 0);
+        tcp.snd_nxt++;
+        tcp.state = TCP_FIN_WAIT;
+        if (flags & TCP_FIN) tcp_finish(0);
+    } else if (tcp.state == TCP_FIN_WAIT) {
+        if (dlen > 0 || (flags & TCP_FIN)) tcp_send(TCP_ACK, NULL, 0);
+        if (flags & TCP_FIN) tcp_finish(1);
+    }
+}
+
+/* ------------------------------------------------------------ ホスト: 受信 */
+
+static void host_receive(const unsigned char *f, unsigned int len)
+{
+    const unsigned char *ip, *l4;
+    unsigned int type, ihl, iplen;
+
+    if (len < 42) return;
+    type = rd16(f + 12);
+
+    if (type == 0x0806) {
+        /* ARP: 自分宛ての問い合わせに答え、GR-SAKURA の MAC を覚える */
+        if (memcmp(f + 28, rx_ip, 4) != 0) return;
+        memcpy(rx_mac, f + 22, 6);
+        if (!rx_mac_known) {
+            rx_mac_known = 1;
+            sim_at(sim_now() + HOST_DELAY_US, tcp_start, NULL);
+        }
+        if (rd16(f + 20) == 1 && memcmp(f + 38, host_ip, 4) == 0) send_arp(2, f + 22);
+        return;
+    }
+    if (type != 0x0800) return;
+
+    ip = f + 14;
+    ihl = (unsigned int)(ip[0] & 0x0F) * 4;
+    iplen = rd16(ip + 2);
+    if (ihl < 20 || 14 + iplen > len || csum_fold(csum_add(0, ip, ihl)) != 0) return;
+    l4 = ip + ihl;
+
+    if (ip[9] == 17 && rd16(l4 + 2) == NET_TELEM_PORT) {
+        unsigned int ulen = rd16(l4 + 4);
+        const char *data = (const char *)l4 + 8;
+        unsigned int dlen = ulen >= 8 ? ulen - 8 : 0;
+
+        while (dlen > 0 && (data[dlen - 1] == '\n' || data[dlen - 1] == '\r')) dlen--;
+        if (line_cb) line_cb(SIM_ETH_TELEM, data, dlen);
+    } else if (ip[9] == 6 && memcmp(ip + 16, host_ip, 4) == 0) {
+        tcp_receive(l4, iplen - ihl);
+    }
+}
+
+/* ------------------------------------------------------------ sim_main 向け */
+
+static void parse_ip(const char *s, unsigned char out[4])
+{
+    unsigned int a, b, c, d;
+
+    if (sscanf(s, "%u.%u.%u.%u", &a, &b, &c, &d) != 4) a = b = c = d = 0;
+    out[0] = (unsigned char)a;
+    out[1] = (unsigned char)b;
+    out[2] = (unsigned char)c;
+    out[3] = (unsigned char)d;
+}
+
+void sim_rx_eth_attach(sim_rx_eth_line_fn fn)
+{
+    line_cb = fn;
+    parse_ip(NET_IP, rx_ip);
+    memcpy(host_ip, rx_ip, 4);
+    host_ip[3] = 10;
+}
+
+void sim_rx_eth_command(const char *line)
+{
+    char *q;
+
+    if (cmd_count == CMD_QUEUE) {
+        tcp_failures++;
+        return;
+    }
+    q = cmd_q[(cmd_head + cmd_count) % CMD_QUEUE];
+    snprintf(q, CMD_LINE_MAX, "%s\n", line);
+    cmd_count++;
+    sim_at(sim_now(), tcp_start, NULL);
+}
+
+void sim_rx_eth_stats(unsigned long *sessions, unsigned long *failures,
+                      unsigned long *rx_nobuf)
+{
+    *sessions = tcp_sessions;
+    *failures = tcp_failures;
+    *rx_nobuf = stats.rx_nobuf;
+}
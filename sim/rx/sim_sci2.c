@@ -0,0 +1,159 @@
+/*
+ * sim_sci2.c - SCI2 UART (sci2_uart.h) の仮想版
+ *
+ * 受信: sim_rx_uart_receive() が割り込み相当で 256 バイトリングへ
+ *       速度の合わないバイトは sim_rx_uart_error() (ERI2 相当) で数えるだけ
+ * 送信: 実機はポーリングで TDRE を待つので、送り終えるまで呼び出しタスクを止める
+ * ボーレートは実機と同じ式 (PCLKB / CKS / ABCS / BRR) で実際の値を決める
+ */
+
+#include "FreeRTOS.h"
+#include "sci2_uart.h"
+#include "sim_board.h"
+#include "sim_kernel.h"
+#include <string.h>
+
+#define RX_BUF_SIZE 256
+#define RX_BUF_MASK (RX_BUF_SIZE - 1)
+
+static unsigned char rx_buf[RX_BUF_SIZE];
+static unsigned int  rx_head = 0;
+static unsigned int  rx_tail = 0;
+static unsigned long rx_overruns = 0;
+static unsigned long rx_errors = 0;
+static sim_waitq_t   rx_wait;
+static unsigned long cur_baud = 0;
+
+void sim_rx_uart_receive(const char *data, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        unsigned int next = (rx_head + 1) & RX_BUF_MASK;
+        if (next == rx_tail) {
+            rx_overruns++;
+            continue;
+        }
+        rx_buf[rx_head] = (unsigned char)data[i];
+        rx_head = next;
+    }
+    sim_wake_all(&rx_wait);
+}
+
+unsigned long sim_rx_uart_overruns(void)
+{
+    return rx_overruns;
+}
+
+void sim_rx_uart_error(size_t n)
+{
+    rx_errors += n;
+}
+
+/* 実機 (sci2_uart.c の brr_calc) と同じ探索で実際のボーレートを求める */
+static unsigned long baud_calc(unsigned long baud)
+{
+    unsigned long best = 0, best_err = 0xFFFFFFFFUL;
+    int n, abcs;
+
+    if (baud == 0) return 0;
+    for (n = 0; n < 4; n++) {
+        for (abcs = 0; abcs <= 1; abcs++) {
+            unsigned long div = (abcs ? 16UL : 32UL) << (2 * n);
+            unsigned long nplus1 = (SCI2_PCLK_HZ + div * baud / 2) / (div * baud);
+            unsigned long actual, err;
+
+            if (nplus1 < 1 || nplus1 > 256) continue;
+            actual = SCI2_PCLK_HZ / (div * nplus1);
+            err = actual > baud ? actual - baud : baud - actual;
+            if (err < best_err) {
+                best_err = err;
+                best = actual;
+            }
+        }
+    }
+    return best;
+}
+
+void sci2_init(void)
+{
+    cur_baud = baud_calc(SCI2_BAUD_BASE);
+    sim_rx_uart_set_baud(cur_baud);
+}
+
+unsigned long sci2_baud_actual(unsigned long baud, unsigned long max_err_ppm)
+{
+    unsigned long actual = baud_calc(baud);
+    unsigned long err;
+
+    if (actual == 0) return 0;
+    err = actual > baud ? actual - baud : baud - actual;
+    if (err > baud / 1000 * max_err_ppm / 1000) return 0;
+    return actual;
+}
+
+unsigned long sci2_set_baud(unsigned long baud)
+{
+    unsigned long actual = baud_calc(baud);
+
+    if (actual == 0) return 0;
+    /* 送信中のバイトを出し切ってから (TEND 待ち相当) */
+    sim_block(NULL, sim_rx_uart_set_baud(actual));
+    cur_baud = actual;
+    rx_tail = rx_head;
+    return actual;
+}
+
+unsigned long sci2_get_baud(void)
+{
+    return cur_baud;
+}
+
+unsigned long sci2_rx_errors(void)
+{
+    return rx_errors;
+}
+
+void sci2_putc(char c)
+{
+    sim_block(NULL, sim_rx_uart_send(&c, 1));
+}
+
+void sci2_puts(const char *s)
+{
+    sim_block(NULL, sim_rx_uart_send(s, strlen(s)));
+}
+
+int sci2_getc_timeout(unsigned long timeout_ms)
+{
+    uint64_t deadline = sim_now() + (uint64_t)timeout_ms * 1000;
+    unsigned char c;
+
+    while (rx_head == rx_tail) {
+        if (sim_now() >= deadline) return -1;
+        sim_block(&rx_wait, deadline);
+    }
+    c = rx_buf[rx_tail];
+    rx_tail = (rx_tail + 1) & RX_BUF_MASK;
+    return (int)c;
+}
+
+/* 行の組み立ては実機 (sci2_uart.c) と同じ */
+int sci2_readline(char *buf, int maxlen, unsigned long timeout_ms)
+{
+    int pos = 0;
+    while (pos < maxlen - 1) {
+        int c = sci2_getc_timeout(timeout_ms);
+        if (c < 0) return -1;
+        if (c == '\n' || c == '\r') {
+            if (pos > 0) {
+                buf[pos] = '\0';
+                return pos;
+            }
+            continue;
+        }
+        buf[pos++] = (char)c;
+    }
+    buf[pos] = '\0';
+    return pos;
+}
@@ -0,0 +1,143 @@
+/*
+ * sim_sd_card.c - microSD (sd_card.h) の仮想版: ファイルをカードに見立てる
+ *
+ * 1 ブロック = ファイルの 512 バイト (pwrite / pread)。書き込み / 読み出しは
+ * 呼んだタスクを仮想時刻で待たせる:
+ *   転送     コマンド + 512 バイト @ 12.5MHz
+ *   ビジー   マルチブロックの続きは短く、新しく開くときは長め
+ *            まれに長いビジー (ウェアレベリング / 消去。SD の上限 250ms まで)
+ *   閉じる   sd_card_sync() のストップトークン後のビジー
+ * 乱数は固定シードの xorshift なので、同じ引数なら毎回同じになる。
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include "FreeRTOS.h"
+#include "sd_card.h"
+#include "sim_board.h"
+#include "sim_kernel.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define XFER_US         370         /* CMD + トークン + 512 バイト + CRC + 応答 */
+#define BUSY_NEXT_US    250         /* CMD25 の続きのブロック */
+#define BUSY_OPEN_US    900         /* CMD25 を開いた最初のブロック */
+#define BUSY_STOP_US    400
+#define READ_US         450
+#define STALL_EVERY     400         /* 平均この回数に 1 回 */
+#define STALL_MIN_US    20000
+#define STALL_MAX_US    250000
+
+static int           fd = -1;
+static unsigned long blocks = 0;
+static int           in_write = 0;
+static unsigned long next_lba = 0;
+static uint64_t      rng = 0x9E3779B97F4A7C15ULL;
+static sim_sd_stats_t st;
+
+static uint64_t xorshift(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static void wait_us(uint64_t us)
+{
+    sim_block(NULL, sim_now() + us);
+}
+
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int sim_sd_card_open(const char *path, unsigned long nblocks, uint64_t seed)
+{
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    blocks = nblocks;
+    if (seed) rng = seed;
+    /* まだ書いていない所は 0 (疎なファイル) */
+    if (ftruncate(fd, (off_t)nblocks * SD_BLOCK_SIZE) != 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+void sim_sd_card_stats(sim_sd_stats_t *out)
+{
+    *out = st;
+}
+
+int sd_card_init(void)
+{
+    if (fd < 0) return -1;
+    in_write = 0;
+    wait_us(200000);                    /* ACMD41 の待ち */
+    return 0;
+}
+
+unsigned long sd_card_blocks(void)
+{
+    return fd < 0 ? 0 : blocks;
+}
+
+int sd_card_read(unsigned long lba, unsigned char *buf)
+{
+    if (fd < 0 || lba >= blocks) return -1;
+    if (sd_card_sync() != 0) return -1;
+    wait_us(READ_US);
+    if (pread(fd, buf, SD_BLOCK_SIZE, (off_t)lba * SD_BLOCK_SIZE) != SD_BLOCK_SIZE) return -1;
+    st.reads++;
+    return 0;
+}
+
+int sd_card_write(unsigned long lba, const unsigned char *buf)
+{
+    uint64_t t0 = sim_now(), busy, h;
+
+    if (fd < 0 || lba >= blocks) return -1;
+    if (in_write && lba != next_lba) sd_card_sync();
+
+    busy = in_write ? BUSY_NEXT_US : BUSY_OPEN_US;
+    if (xorshift() % STALL_EVERY == 0) {
+        busy = STALL_MIN_US + xorshift() % (STALL_MAX_US - STALL_MIN_US);
+        st.stalls++;
+    }
+
+    h = host_ns();
+    if (pwrite(fd, buf, SD_BLOCK_SIZE, (off_t)lba * SD_BLOCK_SIZE) != SD_BLOCK_SIZE) return -1;
+    h = host_ns() - h;
+    if (h > st.host_write_max_ns) st.host_write_max_ns = h;
+
+    /* 転送中は DMA 待ち、ビジーは 1ms ずつポーリング (sd_card.c と同じ) */
+    wait_us(XFER_US + busy);
+
+    in_write = 1;
+    next_lba = lba + 1;
+    st.writes++;
+    st.write_total_us += sim_now() - t0;
+    if (sim_now() - t0 > st.write_max_us) st.write_max_us = sim_now() - t0;
+    return 0;
+}
+
+int sd_card_sync(void)
+{
+    if (!in_write) return 0;
+    in_write = 0;
+    wait_us(BUSY_STOP_US);
+    st.syncs++;
+    return 0;
+}
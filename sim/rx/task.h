@@ -0,0 +1,23 @@
+/*
+ * task.h - FreeRTOS タスク API (仮想時刻カーネル版)
+ */
+
+#ifndef SIM_RX_TASK_H
+#define SIM_RX_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+
+/* usStackDepth はワード単位 (ホストでは無視して既定サイズ) */
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint16_t usStackDepth,
+                       void *arg, UBaseType_t prio, TaskHandle_t *handle);
+void       vTaskDelay(TickType_t ticks);
+void       vTaskDelayUntil(TickType_t *prevWake, TickType_t period);
+TickType_t xTaskGetTickCount(void);
+
+/* タスクは待ちでしか切り替わらないのでクリティカルセクションは要らない */
+#define taskENTER_CRITICAL()    ((void)0)
+#define taskEXIT_CRITICAL()     ((void)0)
+
+#endif /* SIM_RX_TASK_H */
@@ -0,0 +1,303 @@
+/*
+ * iodefine.h - iot-demo-rx のドライバをホストで動かすための RX63N レジスタの模型
+ *
+ * ドライバが触るレジスタだけを、実物 (iot-demo-rx/generate/iodefine.h) と同じ名前と
+ * ビット位置で置く。実体は sim_regs.c。書いた値はそのまま残るだけで、
+ * 周辺の動き (DTC 転送, 割り込み要求) はテストが sim_regs.h の関数で起こす。
+ * IR() / IEN() / IPR() / DTCE() / VECT() は実物と同じ組み立て方。
+ */
+
+#ifndef SIM_RX63N_IODEFINE_H
+#define SIM_RX63N_IODEFINE_H
+
+/* ---------------------------------------------------------------- ICU の番号 */
+
+enum enum_ir   { IR_S12AD_S12ADI0 = 102, IR_SCI2_TXI2 = 221 };
+enum enum_dtce { DTCE_S12AD_S12ADI0 = 102, DTCE_SCI2_TXI2 = 221 };
+enum enum_ier  { IER_S12AD_S12ADI0 = 0x0C, IER_SCI2_TXI2 = 0x1B };
+enum enum_ipr  { IPR_S12AD_S12ADI0 = 102, IPR_SCI2_TXI2 = 220 };
+#define IEN_S12AD_S12ADI0   IEN6
+#define IEN_SCI2_TXI2       IEN5
+#define VECT_S12AD_S12ADI0  102
+#define VECT_SCI2_TXI2      221
+
+#define __IR( x )       ICU.IR[ IR ## x ].BIT.IR
+#define  _IR( x )       __IR( x )
+#define   IR( x , y )   _IR( _ ## x ## _ ## y )
+#define __DTCE( x )     ICU.DTCER[ DTCE ## x ].BIT.DTCE
+#define  _DTCE( x )     __DTCE( x )
+#define   DTCE( x , y ) _DTCE( _ ## x ## _ ## y )
+#define __IEN( x )      ICU.IER[ IER ## x ].BIT.IEN ## x
+#define  _IEN( x )      __IEN( x )
+#define   IEN( x , y )  _IEN( _ ## x ## _ ## y )
+#define __IPR( x )      ICU.IPR[ IPR ## x ].BIT.IPR
+#define  _IPR( x )      __IPR( x )
+#define   IPR( x , y )  _IPR( _ ## x ## _ ## y )
+#define __VECT( x )     VECT ## x
+#define  _VECT( x )     __VECT( x )
+#define   VECT( x , y ) _VECT( _ ## x ## _ ## y )
+
+/* ---------------------------------------------------------------- 共通 */
+
+typedef union {
+    unsigned char BYTE;
+    struct {
+        unsigned char B0:1;
+        unsigned char B1:1;
+        unsigned char B2:1;
+        unsigned char B3:1;
+        unsigned char B4:1;
+        unsigned char B5:1;
+        unsigned char B6:1;
+        unsigned char B7:1;
+    } BIT;
+} sim_reg8_t;
+
+struct st_port {
+    sim_reg8_t PDR;
+    sim_reg8_t PODR;
+    sim_reg8_t PIDR;
+    sim_reg8_t PMR;
+};
+
+/* ---------------------------------------------------------------- ICU */
+
+struct st_icu {
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char IR:1;
+            unsigned char :7;
+        } BIT;
+    } IR[256];
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char DTCE:1;
+            unsigned char :7;
+        } BIT;
+    } DTCER[256];
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char IEN0:1;
+            unsigned char IEN1:1;
+            unsigned char IEN2:1;
+            unsigned char IEN3:1;
+            unsigned char IEN4:1;
+            unsigned char IEN5:1;
+            unsigned char IEN6:1;
+            unsigned char IEN7:1;
+        } BIT;
+    } IER[32];
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char IPR:4;
+            unsigned char :4;
+        } BIT;
+    } IPR[256];
+};
+
+/* ---------------------------------------------------------------- SYSTEM */
+
+struct st_system {
+    union {
+        unsigned short WORD;
+    } PRCR;
+    union {
+        unsigned long LONG;
+        struct {
+            unsigned long :5;
+            unsigned long MSTPA5:1;
+            unsigned long :11;
+            unsigned long MSTPA17:1;
+            unsigned long :10;
+            unsigned long MSTPA28:1;
+            unsigned long :3;
+        } BIT;
+    } MSTPCRA;
+    union {
+        unsigned long LONG;
+        struct {
+            unsigned long :29;
+            unsigned long MSTPB29:1;
+            unsigned long :2;
+        } BIT;
+    } MSTPCRB;
+};
+
+/* ---------------------------------------------------------------- MPC */
+
+typedef union {
+    unsigned char BYTE;
+    struct {
+        unsigned char PSEL:5;
+        unsigned char :1;
+        unsigned char ISEL:1;
+        unsigned char ASEL:1;
+    } BIT;
+} sim_pfs_t;
+
+struct st_mpc {
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char :6;
+            unsigned char PFSWE:1;
+            unsigned char B0WI:1;
+        } BIT;
+    } PWPR;
+    sim_pfs_t P40PFS;
+    sim_pfs_t P41PFS;
+    sim_pfs_t P50PFS;
+    sim_pfs_t P52PFS;
+};
+
+/* ---------------------------------------------------------------- DTC */
+
+struct st_dtc {
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char :4;
+            unsigned char RRS:1;
+            unsigned char :3;
+        } BIT;
+    } DTCCR;
+    void *DTCVBR;
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char SHORT:1;
+            unsigned char :7;
+        } BIT;
+    } DTCADMOD;
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char DTCST:1;
+            unsigned char :7;
+        } BIT;
+    } DTCST;
+};
+
+/* ---------------------------------------------------------------- S12AD */
+
+struct st_s12ad {
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char EXTRG:1;
+            unsigned char TRGE:1;
+            unsigned char CKS:2;
+            unsigned char ADIE:1;
+            unsigned char :1;
+            unsigned char ADCS:1;
+            unsigned char ADST:1;
+        } BIT;
+    } ADCSR;
+    union {
+        unsigned short WORD;
+    } ADANS0;
+    union {
+        unsigned short WORD;
+    } ADADS0;
+    union {
+        unsigned short WORD;
+    } ADCER;
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char ADSTRS:4;
+            unsigned char :4;
+        } BIT;
+    } ADSTRGR;
+    unsigned short ADDR0;       /* ADDR0 / ADDR1 は並び (DTC のブロック転送元) */
+    unsigned short ADDR1;
+};
+
+/* ---------------------------------------------------------------- SCI2 */
+
+struct st_sci {
+    union {
+        unsigned char BYTE;
+    } SMR;
+    unsigned char BRR;
+    union {
+        unsigned char BYTE;
+    } SCR;
+    unsigned char TDR;
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char MPBT:1;
+            unsigned char MPB:1;
+            unsigned char TEND:1;
+            unsigned char PER:1;
+            unsigned char FER:1;
+            unsigned char ORER:1;
+            unsigned char RDRF:1;
+            unsigned char TDRE:1;
+        } BIT;
+    } SSR;
+    unsigned char RDR;
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char ACS0:1;
+            unsigned char :3;
+            unsigned char ABCS:1;
+            unsigned char NFEN:1;
+            unsigned char :2;
+        } BIT;
+    } SEMR;
+};
+
+/* ---------------------------------------------------------------- TMR0 */
+
+struct st_tmr0 {
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char :3;
+            unsigned char CCLR:2;
+            unsigned char OVIE:1;
+            unsigned char CMIEA:1;
+            unsigned char CMIEB:1;
+        } BIT;
+    } TCR;
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char OSA:2;
+            unsigned char OSB:2;
+            unsigned char ADTE:1;
+            unsigned char :3;
+        } BIT;
+    } TCSR;
+    unsigned char TCORA;
+    unsigned char TCORB;
+    unsigned char TCNT;
+    union {
+        unsigned char BYTE;
+        struct {
+            unsigned char CKS:3;
+            unsigned char CSS:2;
+            unsigned char :2;
+            unsigned char TMRIS:1;
+        } BIT;
+    } TCCR;
+};
+
+extern volatile struct st_icu    ICU;
+extern volatile struct st_system SYSTEM;
+extern volatile struct st_mpc    MPC;
+extern volatile struct st_dtc    DTC;
+extern volatile struct st_s12ad  S12AD;
+extern volatile struct st_tmr0   TMR0;
+extern volatile struct st_sci    SCI2;
+extern volatile struct st_port   PORT4;
+extern volatile struct st_port   PORT5;
+
+#endif /* SIM_RX63N_IODEFINE_H */
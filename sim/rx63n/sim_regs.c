@@ -0,0 +1,140 @@
+/*
+ * sim_regs.c - RX63N レジスタの模型の実体と DTC (フルアドレスモード) の転送
+ *
+ * 転送情報は iot-demo-rx/src/dtc.h の dtc_info_t (MRA / MRB / SAR / DAR / CRA / CRB)。
+ * ノーマル: 1 回 1 単位, CRA で数える
+ * リピート: 1 回 1 単位, CRAL が 0 になると CRAH から戻し、リピート領域の位置も戻す (終わらない)
+ * ブロック: 1 回 CRAL 単位 (= CRAH), 1 ブロックごとにブロック領域の位置を戻し CRB で数える
+ * リピート / ブロック領域は MRB.DTS = 1 なら転送元, 0 なら転送先。
+ * 転送が終わると DTCE を落として CPU へ割り込む。DISEL = 1 なら毎回割り込む。
+ */
+
+#include "iodefine.h"
+#include "dtc.h"
+#include "sim_regs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+volatile struct st_icu    ICU;
+volatile struct st_system SYSTEM;
+volatile struct st_mpc    MPC;
+volatile struct st_dtc    DTC;
+volatile struct st_s12ad  S12AD;
+volatile struct st_tmr0   TMR0;
+volatile struct st_sci    SCI2;
+volatile struct st_port   PORT4;
+volatile struct st_port   PORT5;
+
+static unsigned long dtc_units;
+
+void sim_regs_reset(void)
+{
+    memset((void *)&ICU, 0, sizeof(ICU));
+    memset((void *)&SYSTEM, 0, sizeof(SYSTEM));
+    memset((void *)&MPC, 0, sizeof(MPC));
+    memset((void *)&DTC, 0, sizeof(DTC));
+    memset((void *)&S12AD, 0, sizeof(S12AD));
+    memset((void *)&TMR0, 0, sizeof(TMR0));
+    memset((void *)&SCI2, 0, sizeof(SCI2));
+    memset((void *)&PORT4, 0, sizeof(PORT4));
+    memset((void *)&PORT5, 0, sizeof(PORT5));
+    dtc_units = 0;
+}
+
+unsigned long sim_dtc_units(void)
+{
+    return dtc_units;
+}
+
+static void bad(int vect, const char *why)
+{
+    fprintf(stderr, "sim_regs: DTC vector %d: %s\n", vect, why);
+    abort();
+}
+
+/* SM / DM: 0x = 固定, 10 = 増, 11 = 減 */
+static unsigned long step(unsigned long addr, int mode, int size)
+{
+    if ((mode & 2) == 0) return addr;
+    return (mode & 1) ? addr - (unsigned long)size : addr + (unsigned long)size;
+}
+
+static void move1(dtc_info_t *d, int size, int sm, int dm)
+{
+    memcpy((void *)d->dar, (const void *)d->sar, (size_t)size);
+    d->sar = step(d->sar, sm, size);
+    d->dar = step(d->dar, dm, size);
+    dtc_units++;
+}
+
+/* 1 回の起動分を転送する。1: 転送が終わった */
+static int dtc_run(int vect, dtc_info_t *d)
+{
+    unsigned int mra = (unsigned int)(d->mode >> 24) & 0xFF;
+    unsigned int mrb = (unsigned int)(d->mode >> 16) & 0xFF;
+    unsigned int cra = (unsigned int)(d->count >> 16) & 0xFFFF;
+    unsigned int crb = (unsigned int)d->count & 0xFFFF;
+    int md = (mra >> 6) & 3, sz = (mra >> 4) & 3, sm = (mra >> 2) & 3;
+    int dts = (mrb >> 4) & 1, dm = (mrb >> 2) & 3;
+    int size = sz == 0 ? 1 : sz == 1 ? 2 : 4;
+    unsigned int n, k;
+    int done = 0;
+
+    if (sz == 3 || md == 3) bad(vect, "reserved MRA.SZ / MRA.MD");
+    if (mrb & 0xC0) bad(vect, "chain transfer is not modelled");
+    if (d->sar == 0 || d->dar == 0) bad(vect, "SAR / DAR not set");
+
+    if (md == 0) {                              /* ノーマル */
+        move1(d, size, sm, dm);
+        cra = (cra - 1) & 0xFFFF;
+        done = cra == 0;
+    } else {
+        unsigned int reload = (cra >> 8) & 0xFF, cnt = cra & 0xFF;
+        unsigned long *area = dts ? &d->sar : &d->dar;
+        unsigned long start = *area;
+
+        if (reload == 0 || cnt == 0) bad(vect, "CRAH / CRAL is 0 in repeat / block mode");
+        n = md == 2 ? cnt : 1;
+        for (k = 0; k < n; k++)
+            move1(d, size, sm, dm);
+        if (md == 1) {                          /* リピート */
+            cnt -= 1;
+            if (cnt == 0) {
+                int am = dts ? sm : dm;
+                unsigned long span = (unsigned long)(reload - 1) * (unsigned long)size;
+
+                cnt = reload;
+                if (am & 2)
+                    *area = (am & 1) ? start + span : start - span;
+            }
+        } else {                                /* ブロック */
+            *area = start;
+            crb = (crb - 1) & 0xFFFF;
+            done = crb == 0;
+        }
+        cra = (reload << 8) | cnt;
+    }
+    d->count = ((unsigned long)cra << 16) | crb;
+    return done;
+}
+
+int sim_intc_request(int vect)
+{
+    if (ICU.DTCER[vect].BIT.DTCE && DTC.DTCST.BIT.DTCST) {
+        const unsigned long *table = (const unsigned long *)DTC.DTCVBR;
+        dtc_info_t *d;
+        int done;
+
+        if (DTC.DTCADMOD.BIT.SHORT) bad(vect, "short address mode is not modelled");
+        if (table == NULL || table[vect] == 0) bad(vect, "no transfer information");
+        d = (dtc_info_t *)table[vect];
+        done = dtc_run(vect, d);
+        if (done)
+            ICU.DTCER[vect].BIT.DTCE = 0;
+        else if (((d->mode >> 16) & DTC_MRB_DISEL) == 0)
+            return 0;
+    }
+    ICU.IR[vect].BIT.IR = 1;
+    return 1;
+}
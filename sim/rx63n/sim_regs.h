@@ -0,0 +1,22 @@
+/*
+ * sim_regs.h - RX63N レジスタの模型 (iodefine.h) の実体と DTC の動き
+ *
+ * 周辺の割り込み要因はテストが sim_intc_request() で起こす。
+ * ICU.DTCER が立っていれば DTC が転送情報 (DTCVBR のベクタ表) どおりに転送し、
+ * 転送の終わり (または DISEL) で CPU への割り込みになる。
+ */
+
+#ifndef SIM_REGS_H
+#define SIM_REGS_H
+
+/* 全レジスタを 0 に (リセット相当) */
+void sim_regs_reset(void);
+
+/* vect の割り込み要因が出た。CPU への割り込みになれば IR を立てて 1 を返す
+ * (DTC が転送して、まだ終わっていなければ 0)。転送情報が変なら abort */
+int  sim_intc_request(int vect);
+
+/* DTC が転送した単位数の合計 */
+unsigned long sim_dtc_units(void);
+
+#endif /* SIM_REGS_H */
@@ -0,0 +1,221 @@
+/*
+ * sci0_dtc_test - SCI2 送信の DTC 転送とダブルバッファ (iot-demo-rx/src/sci0_uart.c) のホスト検証
+ *
+ * sci0_uart.c をこのファイルに取り込み (static の tx_buf / tx_fill / dtc_tx_info を直接見る)、
+ * dtc.c はそのまま、レジスタは rx63n/ の模型。
+ * 線路は 1 文字時間ごとに TDR を 1 バイト取り出して TXI2 を起こす。
+ * DTCE が立っていれば模型の DTC が次のバイトを TDR に書き、転送が終わると sci0_txi_isr() に入る。
+ *
+ *   1. 初期化: BRR / SEMR / SCR, P50 / P52 の端子機能, ベクタ表の転送情報, DTCE / IEN / IPR
+ *   2. 1 バイト: DTC を使わず TDR に書くだけ, 割り込み 1 回
+ *   3. 1 フレーム: 転送モード (ノーマル / バイト / SAR 増 / DAR 固定), SAR = 面の 2 バイト目,
+ *      DAR = TDR, CRA = 長さ - 1, DTCE。線路に全部出て割り込みは 2 回
+ *   4. 面の切り替え: 送信中に書いた分はもう一方の面にたまり、転送完了の割り込みで
+ *      その面を DTC に渡して書き込み面が入れ替わる。切り替え後に書いた分も続く
+ *   5. 満杯: 256 バイトずつ 2 面
+ * 終了コード: どれか合わなければ 1
+ *
+ * 実行: make sci0_dtc_test && ./sci0_dtc_test
+ */
+
+#include "sci0_uart.c"
+
+#include "sim_regs.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+static int failures = 0;
+static int isr_calls = 0;
+
+static char wire[4 * SCI0_TX_BUF_SIZE];
+static int nwire = 0;
+
+static void fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    fputs("NG: ", stdout);
+    vprintf(fmt, ap);
+    fputc('\n', stdout);
+    va_end(ap);
+    failures++;
+}
+
+#define CHECK(cond, ...)    do { if (!(cond)) fail(__VA_ARGS__); } while (0)
+
+/* 1 文字時間: TDR → 線路, TDR 空きで TXI2。0: 送信するものがない */
+static int wire_step(void)
+{
+    if (sci0_tx_done())
+        return 0;
+    if (nwire < (int)sizeof(wire))
+        wire[nwire++] = (char)SCI2.TDR;
+    if (sim_intc_request(VECT(SCI2, TXI2)) && IEN(SCI2, TXI2)) {
+        IR(SCI2, TXI2) = 0;
+        isr_calls++;
+        sci0_txi_isr();
+    }
+    return 1;
+}
+
+static void drain(void)
+{
+    int guard = 0;
+
+    while (wire_step())
+        if (++guard > (int)sizeof(wire)) {
+            fail("drain: transmitter never goes idle");
+            return;
+        }
+}
+
+static void wire_reset(void)
+{
+    nwire = 0;
+    isr_calls = 0;
+}
+
+static void check_wire(const char *what, const char *want)
+{
+    int n = (int)strlen(want);
+
+    CHECK(nwire == n && memcmp(wire, want, (size_t)n) == 0,
+          "%s: wire has %d bytes (want %d)", what, nwire, n);
+}
+
+static const dtc_info_t *tx_desc(void)
+{
+    const unsigned long *table = (const unsigned long *)DTC.DTCVBR;
+
+    return table ? (const dtc_info_t *)table[VECT(SCI2, TXI2)] : NULL;
+}
+
+static void check_desc(const char *what, int face, unsigned int offset, unsigned int count)
+{
+    const dtc_info_t *d = tx_desc();
+
+    CHECK(d->mode == DTC_MODE(DTC_MRA_MD_NORMAL | DTC_MRA_SZ_BYTE | DTC_MRA_SM_INC, DTC_MRB_DM_FIXED),
+          "%s: mode %08lx", what, d->mode);
+    CHECK(d->sar == (unsigned long)&tx_buf[face][offset], "%s: SAR is not tx_buf[%d] + %u", what, face, offset);
+    CHECK(d->dar == (unsigned long)&SCI2.TDR, "%s: DAR is not TDR", what);
+    CHECK(d->count == DTC_COUNT(count, 0), "%s: count %08lx (want CRA %u)", what, d->count, count);
+    CHECK(DTCE(SCI2, TXI2) == 1, "%s: DTCE not set", what);
+}
+
+static void test_init(void)
+{
+    CHECK(SYSTEM.MSTPCRB.BIT.MSTPB29 == 0, "init: SCI2 still in module stop");
+    CHECK(SCI2.BRR == 26 && SCI2.SEMR.BIT.ABCS == 1 && SCI2.SMR.BYTE == 0x00,
+          "init: BRR %u / ABCS %u", SCI2.BRR, SCI2.SEMR.BIT.ABCS);
+    CHECK(SCI2.SCR.BYTE == 0xB0, "init: SCR %02x", SCI2.SCR.BYTE);
+    CHECK(MPC.P50PFS.BIT.PSEL == 0x0A && MPC.P52PFS.BIT.PSEL == 0x0A &&
+          PORT5.PMR.BIT.B0 == 1 && PORT5.PMR.BIT.B2 == 1, "init: P50 / P52 pin function");
+    CHECK(MPC.PWPR.BIT.PFSWE == 0 && MPC.PWPR.BIT.B0WI == 1, "init: PFS write protect left open");
+    CHECK(DTC.DTCST.BIT.DTCST == 1, "init: DTC not started");
+    CHECK(tx_desc() == &dtc_tx_info, "init: vector table entry for TXI2 is not dtc_tx_info");
+    CHECK(DTCE(SCI2, TXI2) == 0, "init: DTCE set before anything to send");
+    CHECK(IEN(SCI2, TXI2) == 1 && IPR(SCI2, TXI2) == 4 && IR(SCI2, TXI2) == 0, "init: IEN / IPR / IR");
+    CHECK(sci0_tx_done(), "init: not idle");
+}
+
+static void test_single_byte(void)
+{
+    unsigned long units = sim_dtc_units();
+
+    wire_reset();
+    sci0_putc('A');
+    CHECK(SCI2.TDR == 'A' && DTCE(SCI2, TXI2) == 0, "single: TDR %02x, DTCE %d", SCI2.TDR, DTCE(SCI2, TXI2));
+    drain();
+    check_wire("single", "A");
+    CHECK(isr_calls == 1, "single: %d interrupts (want 1)", isr_calls);
+    CHECK(sim_dtc_units() == units, "single: DTC moved %lu bytes", sim_dtc_units() - units);
+}
+
+static void test_frame(void)
+{
+    static const char frame[] = "{\"t\":2498}\r\n";
+    unsigned long units = sim_dtc_units();
+    int face = tx_fill;
+
+    wire_reset();
+    sci0_puts(frame);
+    CHECK(SCI2.TDR == frame[0], "frame: first byte not written by the CPU");
+    check_desc("frame", face, 1, sizeof(frame) - 2);
+    CHECK(tx_fill == (face ^ 1) && tx_len[tx_fill] == 0, "frame: fill face not swapped");
+    drain();
+    check_wire("frame", frame);
+    CHECK(isr_calls == 2, "frame: %d interrupts (want 2)", isr_calls);
+    CHECK(sim_dtc_units() - units == sizeof(frame) - 2, "frame: DTC moved %lu bytes", sim_dtc_units() - units);
+    CHECK(DTCE(SCI2, TXI2) == 0, "frame: DTCE still set after the transfer");
+}
+
+static void test_swap(void)
+{
+    int face = tx_fill;
+    int i;
+
+    wire_reset();
+    sci0_puts("first,");
+    check_desc("swap: first", face, 1, 5);
+    for (i = 0; i < 2; i++)
+        wire_step();
+
+    /* 送信中の追加は書き込み面にたまるだけ */
+    sci0_puts("second,");
+    sci0_puts("third,");
+    CHECK(tx_fill == (face ^ 1) && tx_len[tx_fill] == 13, "swap: fill face %d len %u", tx_fill, tx_len[tx_fill]);
+    CHECK(tx_desc()->sar == (unsigned long)&tx_buf[face][3], "swap: DTC left the first face");
+
+    /* "first," の DTC が終わる割り込みで、たまった面を渡して書き込み面を入れ替える */
+    while (isr_calls == 0 && wire_step())
+        ;
+    CHECK(nwire == 5, "swap: first transfer completed after %d bytes on the wire", nwire);
+    check_desc("swap: second", face ^ 1, 0, 13);
+    CHECK(tx_fill == face && tx_len[face] == 0, "swap: fill face %d len %u after swap", tx_fill, tx_len[face]);
+
+    /* 切り替え後の追加は元の面へ */
+    sci0_puts("fourth");
+    CHECK(tx_len[face] == 6, "swap: fourth went to face %d", tx_fill);
+    drain();
+    check_wire("swap", "first,second,third,fourth");
+    CHECK(isr_calls == 4, "swap: %d interrupts (want 4)", isr_calls);
+}
+
+static void test_full(void)
+{
+    static char a[SCI0_TX_BUF_SIZE + 1], b[SCI0_TX_BUF_SIZE + 1];
+    static char both[2 * SCI0_TX_BUF_SIZE + 1];
+    int face = tx_fill;
+
+    memset(a, 'a', SCI0_TX_BUF_SIZE);
+    memset(b, 'b', SCI0_TX_BUF_SIZE);
+    a[SCI0_TX_BUF_SIZE - 1] = '\n';
+    b[SCI0_TX_BUF_SIZE - 1] = '\n';
+    snprintf(both, sizeof(both), "%s%s", a, b);
+
+    wire_reset();
+    sci0_puts(a);
+    check_desc("full", face, 1, SCI0_TX_BUF_SIZE - 1);
+    sci0_puts(b);
+    CHECK(tx_len[face ^ 1] == SCI0_TX_BUF_SIZE, "full: second face has %u", tx_len[face ^ 1]);
+    drain();
+    check_wire("full", both);
+}
+
+int main(void)
+{
+    sim_regs_reset();
+    SYSTEM.MSTPCRB.BIT.MSTPB29 = 1;     /* リセット直後はモジュールストップ */
+    sci0_init();
+
+    test_init();
+    test_single_byte();
+    test_frame();
+    test_swap();
+    test_full();
+
+    printf("%s\n", failures ? "NG" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,255 @@
+/*
+ * sdlog_bench - microSD ログ (iot-demo-rx-test/src/sd_log.c) の書き込み性能と読み戻し
+ *
+ * sd_log.c をそのまま、カードは rx/sim_sd_card.c (ファイル + 仮想時刻の遅れ) で動かす。
+ * 書き込みタスク (優先度 1) の上で、優先度 2 のタスクが 1ms ごとに
+ * CTRL レコードを --rate 件/秒になるよう入れ続ける。値はレコードの通し番号 n
+ * (temp = n の下位 15 ビット, sp = 上位, duty = n % 10001) なので、
+ * 読み戻したイメージから欠け / 順序 / 捨てた数をそのまま確かめられる。
+ *
+ * 出力: 件数 / 秒と KB / 秒, 捨てた件数, 1 ブロックの書き込み時間 (仮想, 最大と平均),
+ *       pwrite の実時間の最大, sdlog_ctrl() 1 回の CPU 時間 (ホスト), 読み戻しの結果
+ *       CPU 時間は 1ms ごとのまとめ入れを測るので、件数が少ないとキャッシュミス込みになる
+ * 終了コード: 読み戻しが合わなければ 1
+ *
+ * 実行: make sdlog_bench && ./sdlog_bench --seconds 600 --rate 1000
+ *       ./sdlog_bench --seconds 60 --append    (同じイメージで再起動: 続きの seq から書くか)
+ *       ./sdlog_bench --card-blocks 3000       (リングより小さいカード: カードの終わりまでで一周するか)
+ */
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sd_log.h"
+#include "sd_card.h"
+#include "sim_board.h"
+#include "sim_kernel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PRODUCER_PRIO   2
+#define SEC             1000000ULL
+
+static double        rate = 1000;
+static uint64_t      run_us;
+static unsigned long produced = 0;
+static uint64_t      call_ns = 0;
+static uint64_t      block_max_us = 0;      /* sdlog_ctrl() の中で進んだ仮想時刻 */
+
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void producer(void *arg)
+{
+    TickType_t wake = xTaskGetTickCount();
+    double acc = 0;
+
+    (void)arg;
+    while (sim_now() < run_us) {
+        unsigned long k, n;
+        uint64_t t, v;
+
+        vTaskDelayUntil(&wake, 1);
+        acc += rate / 1000.0;
+        n = (unsigned long)acc;
+        acc -= n;
+
+        v = sim_now();
+        t = host_ns();
+        for (k = 0; k < n; k++, produced++) {
+            sdlog_ctrl((long)(produced & 0x7FFF), (long)((produced >> 15) & 0x7FFF),
+                       (long)(produced % 10001));
+        }
+        call_ns += host_ns() - t;
+        if (sim_now() - v > block_max_us) block_max_us = sim_now() - v;
+    }
+    for (;;) vTaskDelay(portMAX_DELAY);
+}
+
+/* ------------------------------------------------------------ 読み戻し */
+
+static unsigned short crc16(unsigned short crc, const unsigned char *p, unsigned int n)
+{
+    int i;
+
+    while (n--) {
+        crc ^= (unsigned short)(*p++ << 8);
+        for (i = 0; i < 8; i++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static unsigned long le(const unsigned char *p, int n)
+{
+    unsigned long v = 0;
+
+    while (n--) v = (v << 8) | p[n];
+    return v;
+}
+
+typedef struct {
+    unsigned long seq;
+    unsigned long index;
+} blk_t;
+
+static int by_seq(const void *a, const void *b)
+{
+    unsigned long x = ((const blk_t *)a)->seq, y = ((const blk_t *)b)->seq;
+
+    return x < y ? -1 : x > y;
+}
+
+/* このプロセスで書いた分 (最後の BOOT 以降) を確かめる。0 = 合っている */
+static int verify(const char *path, const sdlog_stats_t *ls)
+{
+    FILE *f = fopen(path, "rb");
+    static unsigned char blk[SD_BLOCK_SIZE];
+    unsigned long ring = ls->ring_blocks;
+    blk_t *list = malloc(sizeof(blk_t) * (ring ? ring : 1));
+    unsigned long i, nb = 0, bad = 0, gaps = 0, boots = 0;
+    unsigned long found = 0, missing = 0, order_err = 0;
+    long prev = -1;
+    int err = 0;
+
+    if (!f || !list) {
+        perror(path);
+        return 1;
+    }
+    for (i = 0; i < ring; i++) {
+        unsigned int used;
+
+        if (fseek(f, (long)((SDLOG_LBA_BASE + i) * SD_BLOCK_SIZE), SEEK_SET) != 0 ||
+            fread(blk, 1, SD_BLOCK_SIZE, f) != SD_BLOCK_SIZE) break;
+        if (le(blk, 4) != SDLOG_MAGIC) continue;
+        used = (unsigned int)le(blk + 12, 2);
+        if (used < SDLOG_HDR_SIZE || used > SD_BLOCK_SIZE ||
+            crc16(crc16(0xFFFF, blk, 14), blk + SDLOG_HDR_SIZE, used - SDLOG_HDR_SIZE) != le(blk + 14, 2) ||
+            le(blk + 4, 4) % ring != i) {
+            bad++;
+            continue;
+        }
+        list[nb].seq = le(blk + 4, 4);
+        list[nb].index = i;
+        nb++;
+    }
+    qsort(list, nb, sizeof(blk_t), by_seq);
+    for (i = 1; i < nb; i++) {
+        if (list[i].seq != list[i - 1].seq + 1) gaps++;
+    }
+
+    /* seq 順に全レコードを読む。BOOT で数え直す (最後の BOOT 以降が今回) */
+    for (i = 0; i < nb; i++) {
+        unsigned int p, used;
+
+        fseek(f, (long)((SDLOG_LBA_BASE + list[i].index) * SD_BLOCK_SIZE), SEEK_SET);
+        if (fread(blk, 1, SD_BLOCK_SIZE, f) != SD_BLOCK_SIZE) break;
+        used = (unsigned int)le(blk + 12, 2);
+        for (p = SDLOG_HDR_SIZE; p < used && blk[p] != SDLOG_T_PAD; ) {
+            unsigned char type = blk[p];
+
+            if (type == SDLOG_T_BOOT) {
+                boots++;
+                found = missing = order_err = 0;
+                prev = -1;
+                p += 3;
+            } else if (type == SDLOG_T_CTRL) {
+                long n = (long)(le(blk + p + 3, 2) | (le(blk + p + 5, 2) << 15));
+
+                if ((unsigned long)n % 10001 != le(blk + p + 7, 2) || n <= prev) {
+                    order_err++;
+                } else {
+                    missing += (unsigned long)(n - prev - 1);
+                }
+                prev = n;
+                found++;
+                p += 3 + 6;
+            } else if (type == SDLOG_T_SENSOR) {
+                p += 3 + 8;
+            } else if (type == SDLOG_T_STATUS) {
+                p += 3 + 1 + blk[p + 3];
+            } else {
+                order_err++;
+                break;
+            }
+        }
+    }
+    fclose(f);
+    if (prev >= 0) missing += produced - 1 - (unsigned long)prev;
+
+    printf("  読み戻し: ブロック %lu (壊れ %lu, seq の切れ目 %lu), seq %lu..%lu, 起動 %lu 回\n",
+           nb, bad, gaps, nb ? list[0].seq : 0, nb ? list[nb - 1].seq : 0, boots);
+    printf("    今回の CTRL %lu 件 / 入れた %lu 件, 欠け %lu (捨てた %lu), 順序 / 値の誤り %lu\n",
+           found, produced, missing, ls->dropped, order_err);
+
+    /* リングが一周していなければ欠け = 捨てた数。一周していれば古い方が消えている */
+    if (ring == 0 || bad || order_err || gaps > 1) err = 1;
+    if (nb < ring && (boots == 0 || missing != ls->dropped)) err = 1;
+    if (nb && list[nb - 1].seq + 1 != ls->next_seq) err = 1;
+    printf("  => %s\n", err ? "NG" : "OK");
+    free(list);
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    const char *image = "build/sdlog_bench.img";
+    double seconds = 60;
+    uint64_t seed = 0;
+    unsigned long card_blocks = SDLOG_LBA_BASE + SDLOG_LBA_COUNT;
+    int i, append = 0;
+    sdlog_stats_t ls;
+    sim_sd_stats_t cs;
+
+    for (i = 1; i < argc; i++) {
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!strcmp(argv[i], "--append")) {
+            append = 1;
+        } else if (v && !strcmp(argv[i], "--image")) {
+            image = argv[++i];
+        } else if (v && !strcmp(argv[i], "--seconds")) {
+            seconds = atof(argv[++i]);
+        } else if (v && !strcmp(argv[i], "--rate")) {
+            rate = atof(argv[++i]);
+        } else if (v && !strcmp(argv[i], "--card-blocks")) {
+            card_blocks = strtoul(argv[++i], NULL, 0);
+        } else if (v && !strcmp(argv[i], "--seed")) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "usage: sdlog_bench [--seconds S] [--rate N] [--seed N] "
+                            "[--card-blocks N] [--image FILE] [--append]\n");
+            return 2;
+        }
+    }
+    if (!append) remove(image);
+    if (sim_sd_card_open(image, card_blocks, seed) != 0) return 2;
+
+    run_us = (uint64_t)(seconds * SEC);
+    sdlog_init();
+    xTaskCreate(producer, "producer", 256, NULL, PRODUCER_PRIO, NULL);
+    /* 止めてから途中書き出しが 1 回済むまで */
+    sim_run(run_us + (SDLOG_FLUSH_MS + 1000) * 1000ULL);
+
+    sdlog_get_stats(&ls);
+    sim_sd_card_stats(&cs);
+    printf("=== sdlog_bench: 仮想 %.0f s, %.0f 件/秒 要求, リング %lu ブロック ===\n",
+           seconds, rate, ls.ring_blocks);
+    printf("  レコード %lu 件 (%.0f 件/秒), 捨てた %lu 件 (%.3f%%)\n",
+           ls.records, ls.records / seconds, ls.dropped,
+           100.0 * ls.dropped / (ls.records + ls.dropped ? ls.records + ls.dropped : 1));
+    printf("  ブロック 満杯 %lu + 途中 %lu, カードへ %.1f KB/秒, 誤り %lu\n",
+           ls.blocks, ls.flushes, cs.writes * (double)SD_BLOCK_SIZE / 1024 / seconds, ls.errors);
+    printf("  1 ブロックの書き込み: 平均 %.0f us, 最大 %.1f ms (長いビジー %lu 回), "
+           "pwrite 最大 %.1f us\n",
+           cs.writes ? (double)cs.write_total_us / cs.writes : 0, cs.write_max_us / 1000.0,
+           cs.stalls, cs.host_write_max_ns / 1000.0);
+    printf("  sdlog_ctrl(): %.0f ns/回 (ホスト), 呼んだ側が待った最大 %llu us\n",
+           produced ? (double)call_ns / produced : 0, (unsigned long long)block_max_us);
+    return verify(image, &ls);
+}
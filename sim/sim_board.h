@@ -0,0 +1,69 @@
+/*
+ * sim_board.h - GR-SAKURA 側 (C) と配線 / プラント (sim_main.cpp) の間
+ */
+
+#ifndef SIM_BOARD_H
+#define SIM_BOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* GR-SAKURA の FreeRTOS main 相当: 共有データを初期化してタスクを作る */
+void rx_start(void);
+
+/* SCI2 送信: ESP32 へ流し、最後のバイトを送り終える時刻 [us] を返す */
+uint64_t sim_rx_uart_send(const char *data, size_t len);
+
+/* SCI2 受信割り込み相当: ESP32 から届いたバイトをリングへ */
+void sim_rx_uart_receive(const char *data, size_t len);
+
+/* SCI2 受信エラー割り込み相当: 速度の合わないバイト n 個 */
+void sim_rx_uart_error(size_t n);
+
+/* リングが一杯で捨てたバイト数 */
+unsigned long sim_rx_uart_overruns(void);
+
+/* SCI2 のボーレート変更: 送信中のデータを送り終えた時刻 [us] に切り替わる */
+uint64_t sim_rx_uart_set_baud(unsigned long baud);
+
+/* ---- Ethernet (make ETH=1, rx/sim_etherc.c) ---- */
+
+/* 相手のホストが受け取った行 (改行なし) */
+enum { SIM_ETH_TELEM, SIM_ETH_ACK };
+typedef void (*sim_rx_eth_line_fn)(int kind, const char *line, size_t len);
+
+/* ホストを線につなぐ (rx_start より前に呼ぶ) */
+void sim_rx_eth_attach(sim_rx_eth_line_fn fn);
+
+/* ホストから TCP でコマンド 1 行を送る (1 行 1 接続, "cid" 付きで ack を待つ) */
+void sim_rx_eth_command(const char *line);
+
+/* TCP の接続数 / 失敗数と、記述子が空で落ちた受信フレーム数 */
+void sim_rx_eth_stats(unsigned long *sessions, unsigned long *failures,
+                      unsigned long *rx_nobuf);
+
+/* ---- microSD ログ (make SDLOG=1, rx/sim_sd_card.c) ---- */
+
+typedef struct {
+    unsigned long writes;
+    unsigned long reads;
+    unsigned long syncs;
+    unsigned long stalls;           /* 長いビジーを入れた回数 */
+    uint64_t write_total_us;        /* 仮想時刻 */
+    uint64_t write_max_us;
+    uint64_t host_write_max_ns;     /* pwrite の実時間 */
+} sim_sd_stats_t;
+
+/* path をカード (nblocks ブロック) として開く (rx_start より前)。seed 0 で既定の乱数 */
+int  sim_sd_card_open(const char *path, unsigned long nblocks, uint64_t seed);
+void sim_sd_card_stats(sim_sd_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_BOARD_H */
@@ -0,0 +1,278 @@
+/*
+ * sim_kernel.c - 仮想時刻の離散イベント + 協調タスク (ucontext)
+ *
+ * タイマーはタスクのタイムアウトとイベントを 1 本の二分ヒープで持つ。
+ * 早く起こされたタスクの古いタイムアウトは世代番号で見分けて捨てる。
+ */
+
+#define _XOPEN_SOURCE 700   /* ucontext */
+
+#include "sim_kernel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+#define SIM_STACK_DEFAULT (256 * 1024)
+
+enum { TASK_READY, TASK_RUNNING, TASK_BLOCKED, TASK_DEAD };
+
+struct sim_task {
+    const char *name;
+    int prio;
+    int state;
+    void (*fn)(void *);
+    void *arg;
+    void *user;
+    ucontext_t uc;
+    sim_waitq_t *waitq;         /* 待っている行列 (NULL = 時刻待ちのみ) */
+    sim_task_t *next;           /* 実行待ち / 待ち行列のリンク */
+    sim_task_t *all_next;       /* 全タスク (統計用) */
+    unsigned long gen;          /* 待ちの世代: 起こされたら進めてタイムアウトを無効に */
+    int woken;
+    uint64_t wakes;
+};
+
+typedef struct {
+    uint64_t t;
+    uint64_t seq;               /* 同時刻は登録順 */
+    sim_task_t *task;           /* タイムアウト (fn == NULL) */
+    unsigned long gen;
+    void (*fn)(void *);         /* イベント */
+    void *arg;
+} sim_timer_t;
+
+static uint64_t now_us;
+static uint64_t timer_seq;
+static uint64_t n_switches;
+static uint64_t n_events;
+
+static ucontext_t sched_uc;
+static sim_task_t *current;
+static sim_task_t *ready_head;
+static sim_task_t *all_head;
+static sim_task_t *all_tail;
+
+static sim_timer_t *heap;
+static size_t heap_n;
+static size_t heap_cap;
+
+static void die(const char *msg)
+{
+    fprintf(stderr, "sim_kernel: %s\n", msg);
+    abort();
+}
+
+/* ------------------------------------------------------------ タイマーヒープ */
+
+static int timer_before(const sim_timer_t *a, const sim_timer_t *b)
+{
+    return a->t < b->t || (a->t == b->t && a->seq < b->seq);
+}
+
+static void heap_push(sim_timer_t e)
+{
+    size_t i;
+
+    if (heap_n == heap_cap) {
+        heap_cap = heap_cap ? heap_cap * 2 : 64;
+        heap = realloc(heap, heap_cap * sizeof(*heap));
+        if (!heap) die("out of memory");
+    }
+    e.seq = timer_seq++;
+    i = heap_n++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!timer_before(&e, &heap[parent])) break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = e;
+}
+
+static sim_timer_t heap_pop(void)
+{
+    sim_timer_t top = heap[0];
+    sim_timer_t last = heap[--heap_n];
+    size_t i = 0;
+
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= heap_n) break;
+        if (c + 1 < heap_n && timer_before(&heap[c + 1], &heap[c])) c++;
+        if (!timer_before(&heap[c], &last)) break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    if (heap_n > 0) heap[i] = last;
+    return top;
+}
+
+/* ------------------------------------------------------------ タスク */
+
+/* 優先度の高い順、同じ優先度は到着順 */
+static void make_ready(sim_task_t *t)
+{
+    sim_task_t **p = &ready_head;
+
+    while (*p && (*p)->prio >= t->prio) p = &(*p)->next;
+    t->next = *p;
+    *p = t;
+    t->state = TASK_READY;
+}
+
+static void waitq_remove(sim_waitq_t *q, sim_task_t *t)
+{
+    sim_task_t *prev = NULL;
+    sim_task_t *p;
+
+    for (p = q->head; p; prev = p, p = p->next) {
+        if (p != t) continue;
+        if (prev) prev->next = p->next;
+        else q->head = p->next;
+        if (q->tail == p) q->tail = prev;
+        return;
+    }
+}
+
+static void trampoline(void)
+{
+    sim_task_t *t = current;
+
+    t->fn(t->arg);
+    t->state = TASK_DEAD;
+    swapcontext(&t->uc, &sched_uc);
+}
+
+sim_task_t *sim_spawn(const char *name, int prio, void (*fn)(void *), void *arg,
+                      size_t stack)
+{
+    sim_task_t *t = calloc(1, sizeof(*t));
+
+    if (!t) die("out of memory");
+    if (stack == 0) stack = SIM_STACK_DEFAULT;
+    t->name = name;
+    t->prio = prio;
+    t->fn = fn;
+    t->arg = arg;
+
+    getcontext(&t->uc);
+    t->uc.uc_stack.ss_sp = malloc(stack);
+    t->uc.uc_stack.ss_size = stack;
+    t->uc.uc_link = NULL;
+    if (!t->uc.uc_stack.ss_sp) die("out of memory");
+    makecontext(&t->uc, trampoline, 0);
+
+    if (all_tail) all_tail->all_next = t;
+    else all_head = t;
+    all_tail = t;
+
+    make_ready(t);
+    return t;
+}
+
+sim_task_t *sim_current(void) { return current; }
+void sim_set_user(sim_task_t *t, void *user) { t->user = user; }
+void *sim_user(const sim_task_t *t) { return t->user; }
+
+int sim_block(sim_waitq_t *q, uint64_t deadline)
+{
+    sim_task_t *t = current;
+
+    if (!t) die("sim_block outside a task");
+    t->state = TASK_BLOCKED;
+    t->gen++;
+    t->woken = 0;
+    t->waitq = q;
+    if (q) {
+        t->next = NULL;
+        if (q->tail) q->tail->next = t;
+        else q->head = t;
+        q->tail = t;
+    }
+    if (deadline != SIM_FOREVER) {
+        sim_timer_t e = { 0 };
+        e.t = deadline < now_us ? now_us : deadline;
+        e.task = t;
+        e.gen = t->gen;
+        heap_push(e);
+    }
+    swapcontext(&t->uc, &sched_uc);
+    return t->woken;
+}
+
+static void wake(sim_task_t *t)
+{
+    t->gen++;
+    t->woken = 1;
+    t->waitq = NULL;
+    make_ready(t);
+}
+
+void sim_wake_one(sim_waitq_t *q)
+{
+    sim_task_t *t = q->head;
+
+    if (!t) return;
+    q->head = t->next;
+    if (!q->head) q->tail = NULL;
+    wake(t);
+}
+
+void sim_wake_all(sim_waitq_t *q)
+{
+    while (q->head) sim_wake_one(q);
+}
+
+/* ------------------------------------------------------------ 実行 */
+
+uint64_t sim_now(void) { return now_us; }
+
+void sim_at(uint64_t t, void (*fn)(void *), void *arg)
+{
+    sim_timer_t e = { 0 };
+
+    e.t = t < now_us ? now_us : t;
+    e.fn = fn;
+    e.arg = arg;
+    heap_push(e);
+}
+
+void sim_run(uint64_t until)
+{
+    for (;;) {
+        while (ready_head) {
+            sim_task_t *t = ready_head;
+            ready_head = t->next;
+            t->state = TASK_RUNNING;
+            t->wakes++;
+            current = t;
+            n_switches++;
+            swapcontext(&sched_uc, &t->uc);
+            current = NULL;
+        }
+        if (heap_n == 0 || heap[0].t > until) {
+            now_us = until;
+            return;
+        }
+
+        sim_timer_t e = heap_pop();
+        now_us = e.t;
+        if (e.fn) {
+            n_events++;
+            e.fn(e.arg);
+        } else if (e.task->state == TASK_BLOCKED && e.task->gen == e.gen) {
+            /* タイムアウト */
+            if (e.task->waitq) waitq_remove(e.task->waitq, e.task);
+            e.task->gen++;
+            e.task->waitq = NULL;
+            make_ready(e.task);
+        }
+    }
+}
+
+uint64_t sim_switches(void) { return n_switches; }
+uint64_t sim_events(void) { return n_events; }
+sim_task_t *sim_task_first(void) { return all_head; }
+sim_task_t *sim_task_next(const sim_task_t *t) { return t->all_next; }
+const char *sim_task_name(const sim_task_t *t) { return t->name; }
+uint64_t sim_task_wakes(const sim_task_t *t) { return t->wakes; }
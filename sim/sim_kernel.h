@@ -0,0 +1,65 @@
+/*
+ * sim_kernel.h - 仮想時刻の離散イベント + 協調タスク
+ *
+ * GR-SAKURA / ESP32 の全タスクを 1 スレッドで順に動かす。
+ * タスクは sim_block() でしか CPU を手放さず、実行中に時刻は進まない。
+ * 誰も実行可能でなくなったら、次の期限 (待ちのタイムアウト / sim_at のイベント)
+ * まで時刻を飛ばす。同時刻は優先度 → 登録順で、実行順は毎回同じ (決定的)。
+ */
+
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM_FOREVER UINT64_MAX
+
+typedef struct sim_task sim_task_t;
+
+/* 待ち行列 (ゼロ初期化で使える) */
+typedef struct {
+    sim_task_t *head;
+    sim_task_t *tail;
+} sim_waitq_t;
+
+/* 現在の仮想時刻 [us] */
+uint64_t sim_now(void);
+
+/* タスク生成。prio が大きいほど同時刻で先に走る。stack 0 で既定 (256KB) */
+sim_task_t *sim_spawn(const char *name, int prio, void (*fn)(void *), void *arg,
+                      size_t stack);
+/* 実行中のタスク (イベント処理中は NULL) */
+sim_task_t *sim_current(void);
+void        sim_set_user(sim_task_t *t, void *user);
+void       *sim_user(const sim_task_t *t);
+
+/* q で待つ (NULL なら時刻待ちのみ)。deadline [us] で打ち切り
+ * 戻り値: 1 = sim_wake_* で起こされた, 0 = タイムアウト */
+int  sim_block(sim_waitq_t *q, uint64_t deadline);
+void sim_wake_one(sim_waitq_t *q);
+void sim_wake_all(sim_waitq_t *q);
+
+/* 時刻 t にスケジューラ文脈で fn(arg) を呼ぶ (割り込み相当。中で待ってはいけない) */
+void sim_at(uint64_t t, void (*fn)(void *), void *arg);
+
+/* 仮想時刻 until まで進める */
+void sim_run(uint64_t until);
+
+/* 統計 */
+uint64_t     sim_switches(void);
+uint64_t     sim_events(void);
+sim_task_t  *sim_task_first(void);
+sim_task_t  *sim_task_next(const sim_task_t *t);
+const char  *sim_task_name(const sim_task_t *t);
+uint64_t     sim_task_wakes(const sim_task_t *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_KERNEL_H */
@@ -0,0 +1,591 @@
+/**
+ * cosim - GR-SAKURA + ESP32 + 温度プラントの仮想時刻協調シミュレーション
+ *
+ * 両ファームウェアのソースをそのままリンクし、周辺だけを差し替える:
+ *   GR-SAKURA  iot-demo-rx-test の解析 / PID / 異常検知 / 各タスク
+ *              FreeRTOS と SCI2 は sim/rx (sim_kernel のタスク)
+ *   ESP32      iot-demo-esp32-test/src 全体 (setup / loop, UART 受信タスク, ログ)
+ *              周辺は native/fakes, 時刻と FreeRTOS は sim/esp
+ *   UART       送信側のボーレートどおりの転送時間 (書き込み単位で最後のバイトの時刻に到着)
+ *              受信側と速度が合わなければフレーミングエラー (ボーレート交渉も実物どおり動く)
+ *   プラント   1 次遅れの熱モデル: LEDC デューティ → 温度 → BME280
+ *   ブラウザ   WebSocket クライアント 1 台。シナリオのコマンドを送り、配信を受ける
+ *   Ethernet   make ETH=1 のときだけ。GR-SAKURA の lwIP と線でつながったホスト 1 台
+ *              (rx/sim_etherc.c)。UDP の配信を受け、--ethcmd の行を TCP で送る
+ *   microSD    make SDLOG=1 のときだけ。--sdlog のファイルをカードにする (rx/sim_sd_card.c)
+ *
+ * 全部 1 スレッドの離散イベントで進むので、24 時間が数秒で終わり、
+ * 同じ引数なら毎回同じトレース (末尾のハッシュ) になる。
+ *
+ * 実行: make && ./cosim --hours 24 --trace run.tsv
+ *       ./cosim --hours 2 --cmd 600:'{"type":"cmd","cmd":"set_target","sp":35,"cid":1}'
+ *       ./cosim --outage 1h:30 --lid 2h:120 --glitch 3h:300 --metrics
+ */
+
+#include <Arduino.h>
+#include "fake_hw.h"
+#include "heater_pwm.h"
+#include "metrics.h"
+#include "uart_comm.h"
+#include "sim_board.h"
+#include "sim_kernel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+extern "C" unsigned long sci2_rx_errors(void);     // sci2_uart.h (sim/rx/sim_sci2.c)
+
+#define SIM_PLANT_STEP_US  100000ULL     // プラントの積分周期 (100ms)
+#define SIM_WS_CONNECT_US  2000000ULL    // ブラウザ接続 (setup 完了後)
+#define SIM_PLANT_TRACE_US 60000000ULL   // プラント状態のトレース周期 (60s)
+
+static const uint64_t SEC = 1000000ULL;
+
+// ---------------------------------------------------------------- トレース
+// "秒.マイクロ秒 <TAB> 経路 <TAB> 行" を書き出し、全行の FNV-1a ハッシュを取る
+
+class Trace {
+public:
+    void open(const char *path) {
+        file_ = fopen(path, "w");
+        if (!file_) perror(path);
+    }
+    void line(const char *src, const char *msg, size_t len) {
+        char head[48];
+        uint64_t t = sim_now();
+        int n = snprintf(head, sizeof(head), "%llu.%06llu\t%s\t",
+                         (unsigned long long)(t / SEC), (unsigned long long)(t % SEC), src);
+        hash(head, n);
+        hash(msg, len);
+        hash("\n", 1);
+        lines_++;
+        if (file_) {
+            fwrite(head, 1, n, file_);
+            fwrite(msg, 1, len, file_);
+            fputc('\n', file_);
+        }
+    }
+    void line(const char *src, const std::string &msg) { line(src, msg.data(), msg.size()); }
+    void close() {
+        if (file_) fclose(file_);
+        file_ = nullptr;
+    }
+    uint64_t hashValue() const { return hash_; }
+    uint64_t lines() const { return lines_; }
+private:
+    void hash(const char *p, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            hash_ ^= (uint8_t)p[i];
+            hash_ *= 0x100000001b3ULL;
+        }
+    }
+    FILE *file_ = nullptr;
+    uint64_t hash_ = 0xcbf29ce484222325ULL;
+    uint64_t lines_ = 0;
+};
+
+static Trace trace;
+
+// ---------------------------------------------------------------- 集計
+
+// 1 行の JSON から "key": の値を取り出す (ファームウェアが出す平坦な JSON 用)
+static bool jsonValue(const std::string &s, const char *key, std::string *out) {
+    std::string pat = std::string("\"") + key + "\":";
+    size_t p = s.find(pat);
+    if (p == std::string::npos) return false;
+    p += pat.size();
+    if (p < s.size() && s[p] == '"') {
+        size_t e = s.find('"', p + 1);
+        if (e == std::string::npos) return false;
+        *out = s.substr(p + 1, e - p - 1);
+    } else {
+        size_t e = s.find_first_of(",}", p);
+        *out = s.substr(p, e == std::string::npos ? std::string::npos : e - p);
+    }
+    return true;
+}
+
+struct Stats {
+    std::map<std::string, uint64_t> rxMsgs;     // GR-SAKURA → ESP32 の type / status
+    std::map<std::string, uint64_t> wsMsgs;     // ESP32 → ブラウザの type / link
+    std::map<std::string, uint64_t> ethMsgs;    // GR-SAKURA → ホスト (UDP / TCP ack) の type
+    double setpoint = 28.0;
+    uint64_t settleUs = 1800 * SEC;
+    uint64_t samples = 0;
+    uint64_t inBand = 0;
+    double absErr = 0;
+    double maxErr = 0;
+} stats;
+
+static void countRxLine(const std::string &line) {
+    std::string type, v;
+    if (!jsonValue(line, "type", &type)) type = "?";
+    if (type == "ctrl" && jsonValue(line, "sp", &v)) stats.setpoint = atof(v.c_str());
+    if (type == "status" && jsonValue(line, "msg", &v)) type += ":" + v;
+    stats.rxMsgs[type]++;
+}
+
+static void countWsMessage(const std::string &msg) {
+    std::string type, v;
+    if (!jsonValue(msg, "type", &type)) type = "?";
+    if (type == "link" && jsonValue(msg, "state", &v)) type += ":" + v;
+    stats.wsMsgs[type]++;
+}
+
+// ---------------------------------------------------------------- UART
+// 送信側の速度で転送時間を決め、到着時に受信側の速度と SIM_UART_TOL 以上ずれていれば
+// (交渉の切替途中など) 受信側ではフレーミングエラーになり、データは届かない
+
+#define SIM_UART_TOL 0.03
+
+class UartLink {
+public:
+    typedef void (*Deliver)(const char *data, size_t len);
+    typedef void (*OnLine)(const std::string &line);
+    typedef uint32_t (*Baud)();
+    typedef void (*Garbled)(size_t len);
+
+    UartLink(const char *name, Baud txBaud, Baud rxBaud, Deliver deliver, Garbled garbled,
+             OnLine onLine)
+        : name_(name), txBaud_(txBaud), rxBaud_(rxBaud), deliver_(deliver),
+          garbled_(garbled), onLine_(onLine) {}
+
+    // 断線中に送られた / 伝送中だったバイトは失われる
+    void setCut(bool cut) { cut_ = cut; }
+    // UART_BAUD より速い間はすべて化ける (長い配線で高速が通らない状態)
+    void setGlitch(bool glitch) { glitch_ = glitch; }
+
+    // 送信キューの後ろに並べ、最後のバイトが届く時刻を返す (8N1 = 10 bit/byte)
+    uint64_t send(const char *data, size_t len) {
+        uint32_t baud = txBaud_();
+        uint64_t start = idleAt();
+        busyUntil_ = start + ((uint64_t)len * 10 * SEC + baud - 1) / baud;
+        sim_at(busyUntil_, arrive, new Chunk{this, std::string(data, len), baud});
+        return busyUntil_;
+    }
+    // 送信中のデータを送り終える時刻
+    uint64_t idleAt() const { return std::max(sim_now(), busyUntil_); }
+
+    uint64_t bytes() const { return bytes_; }
+    uint64_t lost() const { return lost_; }
+    uint64_t garbled() const { return garbledBytes_; }
+    uint64_t lines() const { return lines_; }
+    uint64_t fastBytes() const { return fastBytes_; }
+private:
+    struct Chunk {
+        UartLink *link;
+        std::string data;
+        uint32_t baud;
+    };
+
+    static void arrive(void *arg) {
+        Chunk *c = static_cast<Chunk *>(arg);
+        UartLink *l = c->link;
+        size_t n = c->data.size();
+        uint32_t rx = l->rxBaud_();
+        bool mismatch = fabs((double)c->baud - rx) > rx * SIM_UART_TOL;
+        if (l->cut_) {
+            l->lost_ += n;
+        } else if (mismatch || (l->glitch_ && c->baud > UART_BAUD)) {
+            l->garbledBytes_ += n;
+            l->partial_.clear();
+            l->garbled_(n);
+        } else {
+            l->bytes_ += n;
+            if (c->baud > UART_BAUD) l->fastBytes_ += n;
+            l->deliver_(c->data.data(), n);
+            l->collect(c->data);
+        }
+        delete c;
+    }
+
+    void collect(const std::string &data) {
+        for (char ch : data) {
+            if (ch == '\r') continue;
+            if (ch != '\n') {
+                partial_ += ch;
+                continue;
+            }
+            if (partial_.empty()) continue;
+            lines_++;
+            trace.line(name_, partial_);
+            if (onLine_) onLine_(partial_);
+            partial_.clear();
+        }
+    }
+
+    const char *name_;
+    Baud txBaud_;
+    Baud rxBaud_;
+    Deliver deliver_;
+    Garbled garbled_;
+    OnLine onLine_;
+    bool cut_ = false;
+    bool glitch_ = false;
+    uint64_t busyUntil_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t lost_ = 0;
+    uint64_t garbledBytes_ = 0;
+    uint64_t fastBytes_ = 0;
+    uint64_t lines_ = 0;
+    std::string partial_;
+};
+
+static uint32_t rxBaud = UART_BAUD;
+static uint32_t espBaud() { return fake::uartBaud(UART_PORT); }
+static uint32_t sciBaud() { return rxBaud; }
+
+static UartLink espToRx("esp>rx", espBaud, sciBaud, sim_rx_uart_receive, sim_rx_uart_error,
+                        nullptr);
+static UartLink rxToEsp("rx>esp", sciBaud, espBaud,
+                        [](const char *d, size_t n) { fake::uartFeed(UART_PORT, d, n); },
+                        [](size_t) { fake::uartFrameError(UART_PORT); }, countRxLine);
+
+extern "C" uint64_t sim_rx_uart_send(const char *data, size_t len) {
+    return rxToEsp.send(data, len);
+}
+
+// 送信中の分は旧速度のまま。実機は TEND を待ってから切り替える
+extern "C" uint64_t sim_rx_uart_set_baud(unsigned long baud) {
+    uint64_t at = rxToEsp.idleAt();
+    if (at > sim_now()) {
+        sim_at(at, [](void *arg) { rxBaud = (uint32_t)(uintptr_t)arg; }, (void *)(uintptr_t)baud);
+    } else {
+        rxBaud = baud;
+    }
+    return at;
+}
+
+// ---------------------------------------------------------------- プラント
+// C dT/dt = P·duty − (T − Tamb) / R · lid。蓋開放中は放熱が LID_LOSS 倍
+
+#define PLANT_AMBIENT   22.0    // ℃
+#define PLANT_CAP_J_K   400.0   // 熱容量 [J/K]
+#define PLANT_R_K_W     2.0     // 周囲への熱抵抗 [K/W]
+#define PLANT_HEATER_W  30.0    // ヒーター最大出力 [W]
+#define PLANT_LID_LOSS  5.0
+
+struct Plant {
+    double temp = PLANT_AMBIENT;
+    double lid = 1.0;
+    double energyJ = 0;
+    uint64_t rng = 1;
+
+    void step(double dt, double duty) {
+        double p = PLANT_HEATER_W * duty;
+        double loss = (temp - PLANT_AMBIENT) / PLANT_R_K_W * lid;
+        temp += (p - loss) / PLANT_CAP_J_K * dt;
+        energyJ += p * dt;
+    }
+
+    // xorshift64* の一様乱数 4 個の和で近似した N(0, 1)
+    double noise() {
+        double sum = 0;
+        for (int i = 0; i < 4; i++) {
+            rng ^= rng >> 12;
+            rng ^= rng << 25;
+            rng ^= rng >> 27;
+            sum += (double)((rng * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+        }
+        return (sum - 2.0) * 1.7320508;
+    }
+} plant;
+
+static void plantStep(void *) {
+    double duty = (double)fake::ledcDuty(HEATER_PWM_CH) / HEATER_PWM_MAX;
+    plant.step(SIM_PLANT_STEP_US / (double)SEC, duty);
+    fake::bmeSet((float)(plant.temp + 0.02 * plant.noise()),
+                 (float)(50.0 + 0.2 * plant.noise()), (float)(1013.25 + 0.02 * plant.noise()));
+
+    uint64_t now = sim_now();
+    if (now >= stats.settleUs) {
+        double err = fabs(plant.temp - stats.setpoint);
+        stats.samples++;
+        stats.absErr += err;
+        stats.maxErr = std::max(stats.maxErr, err);
+        if (err <= 0.5) stats.inBand++;
+    }
+    if (now % SIM_PLANT_TRACE_US == 0) {
+        char buf[96];
+        int n = snprintf(buf, sizeof(buf), "{\"temp\":%.3f,\"duty\":%.4f,\"lid\":%.0f}",
+                         plant.temp, duty, plant.lid);
+        trace.line("plant", buf, n);
+    }
+    sim_at(now + SIM_PLANT_STEP_US, plantStep, nullptr);
+}
+
+#if USE_ETHERNET
+static void countEthLine(const std::string &line) {
+    std::string type;
+    if (!jsonValue(line, "type", &type)) type = "?";
+    stats.ethMsgs[type]++;
+}
+#endif
+
+// ---------------------------------------------------------------- シナリオ
+
+struct Action {
+    enum Kind { Cmd, Outage, Lid, Glitch, EthCmd } kind;
+    uint64_t at;
+    uint64_t len;
+    std::string json;
+};
+
+static std::vector<Action> actions;
+static AsyncWebSocketClient *browser = nullptr;
+
+static void connectBrowser(void *) {
+    browser = fake::wsConnect();
+    trace.line("scenario", browser ? "ws connect" : "ws connect failed");
+}
+
+static void runAction(void *arg) {
+    Action *a = static_cast<Action *>(arg);
+    switch (a->kind) {
+    case Action::Cmd:
+        trace.line("ws>esp", a->json);
+        if (browser) fake::wsSend(browser, a->json.c_str());
+        break;
+    case Action::EthCmd:
+#if USE_ETHERNET
+        trace.line("srv>rx", a->json);
+        sim_rx_eth_command(a->json.c_str());
+#endif
+        break;
+    case Action::Outage:
+        if (a->len) {
+            trace.line("scenario", "uart cut");
+            espToRx.setCut(true);
+            rxToEsp.setCut(true);
+            sim_at(sim_now() + a->len, runAction, new Action{Action::Outage, 0, 0, ""});
+        } else {
+            trace.line("scenario", "uart restored");
+            espToRx.setCut(false);
+            rxToEsp.setCut(false);
+            delete a;
+        }
+        break;
+    case Action::Lid:
+        if (a->len) {
+            trace.line("scenario", "lid open");
+            plant.lid = PLANT_LID_LOSS;
+            sim_at(sim_now() + a->len, runAction, new Action{Action::Lid, 0, 0, ""});
+        } else {
+            trace.line("scenario", "lid closed");
+            plant.lid = 1.0;
+            delete a;
+        }
+        break;
+    case Action::Glitch:
+        if (a->len) {
+            trace.line("scenario", "uart glitch");
+            espToRx.setGlitch(true);
+            rxToEsp.setGlitch(true);
+            sim_at(sim_now() + a->len, runAction, new Action{Action::Glitch, 0, 0, ""});
+        } else {
+            trace.line("scenario", "uart glitch end");
+            espToRx.setGlitch(false);
+            rxToEsp.setGlitch(false);
+            delete a;
+        }
+        break;
+    }
+}
+
+// "90" / "90s" / "15m" / "6h" → us
+static uint64_t parseTime(const std::string &s) {
+    char *end = nullptr;
+    double v = strtod(s.c_str(), &end);
+    double scale = 1;
+    if (end && *end == 'm') scale = 60;
+    if (end && *end == 'h') scale = 3600;
+    return (uint64_t)(v * scale * SEC);
+}
+
+// "時刻:残り" を分ける (残りは JSON か長さ)
+static bool splitArg(const char *arg, uint64_t *at, std::string *rest) {
+    const char *colon = strchr(arg, ':');
+    if (!colon) return false;
+    *at = parseTime(std::string(arg, colon - arg));
+    *rest = colon + 1;
+    return true;
+}
+
+// シナリオ指定がないときの 1 日: 目標変更, 蓋開放, UART 断 (RX は非常停止・ESP32 は代替制御),
+// ゲイン変更, 停止 / 再開
+static void defaultScenario() {
+    const uint64_t H = 3600 * SEC, M = 60 * SEC;
+    actions = {
+        {Action::Cmd,    2 * H,         0,        R"({"type":"cmd","cmd":"set_target","sp":35.0,"cid":1})"},
+        {Action::Lid,    6 * H,         120 * SEC, ""},
+        {Action::Outage, 10 * H,        30 * SEC, ""},
+        {Action::Glitch, 12 * H,        300 * SEC, ""},
+        {Action::Cmd,    10 * H + M,    0,        R"({"type":"cmd","cmd":"start","cid":2})"},
+        {Action::Cmd,    14 * H,        0,        R"({"type":"cmd","cmd":"set_pid","kp":500,"ki":80,"kd":20,"cid":3})"},
+        {Action::Cmd,    18 * H,        0,        R"({"type":"cmd","cmd":"stop","cid":4})"},
+        {Action::Cmd,    18 * H + 30 * M, 0,      R"({"type":"cmd","cmd":"start","cid":5})"},
+        {Action::Cmd,    20 * H,        0,        R"({"type":"cmd","cmd":"set_target","sp":28.0,"cid":6})"},
+    };
+#if USE_ETHERNET
+    actions.push_back({Action::EthCmd, 16 * H, 0, R"({"type":"cmd","cmd":"set_target","sp":32.0,"cid":7})"});
+#endif
+}
+
+// ---------------------------------------------------------------- ESP32 loopTask
+
+static void loopTask(void *) {
+    setup();
+    for (;;) loop();
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: cosim [--hours H] [--seed N] [--trace FILE] [--settle SEC] [--metrics]\n"
+            "             [--cmd T:JSON]... [--outage T:LEN]... [--lid T:LEN]... [--glitch T:LEN]...\n"
+#if USE_ETHERNET
+            "             [--ethcmd T:JSON]...\n"
+#endif
+#if USE_SDLOG
+            "             [--sdlog FILE]\n"
+#endif
+            "  T / LEN は秒 (90, 15m, 6h も可)。シナリオ指定がなければ既定の 1 日\n");
+}
+
+int main(int argc, char **argv) {
+    double hours = 24;
+    bool dumpMetrics = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+        uint64_t at;
+        std::string rest;
+        if (a == "--metrics") {
+            dumpMetrics = true;
+            continue;
+        }
+        if (!v) {
+            usage();
+            return 2;
+        }
+        i++;
+        if (a == "--hours") {
+            hours = atof(v);
+        } else if (a == "--seed") {
+            plant.rng = strtoull(v, nullptr, 0) | 1;
+        } else if (a == "--trace") {
+            trace.open(v);
+        } else if (a == "--settle") {
+            stats.settleUs = parseTime(v);
+        } else if (a == "--cmd" && splitArg(v, &at, &rest)) {
+            actions.push_back({Action::Cmd, at, 0, rest});
+#if USE_ETHERNET
+        } else if (a == "--ethcmd" && splitArg(v, &at, &rest)) {
+            actions.push_back({Action::EthCmd, at, 0, rest});
+#endif
+#if USE_SDLOG
+        } else if (a == "--sdlog") {
+            // sd_log.h の既定のリング (SDLOG_LBA_BASE + SDLOG_LBA_COUNT) が入る大きさ (疎なファイル)
+            if (sim_sd_card_open(v, 2048UL + 1024UL * 1024UL, 0) != 0) return 2;
+#endif
+        } else if ((a == "--outage" || a == "--lid" || a == "--glitch") &&
+                   splitArg(v, &at, &rest)) {
+            Action::Kind kind = a == "--lid" ? Action::Lid
+                              : a == "--glitch" ? Action::Glitch : Action::Outage;
+            actions.push_back({kind, at, parseTime(rest), ""});
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (actions.empty()) defaultScenario();
+
+    // 配線
+    fake::uartOnWrite(UART_PORT, [](const char *d, size_t n) { espToRx.send(d, n); });
+    fake::wsOnText([](uint32_t id, const char *msg, size_t len) {
+        (void)id;
+        trace.line("esp>ws", msg, len);
+        countWsMessage(std::string(msg, len));
+    });
+    fake::bmeSet(PLANT_AMBIENT, 50.0f, 1013.25f);
+#if USE_ETHERNET
+    sim_rx_eth_attach([](int kind, const char *line, size_t len) {
+        trace.line(kind == SIM_ETH_ACK ? "rx>srv:tcp" : "rx>srv", line, len);
+        countEthLine(std::string(line, len));
+    });
+#endif
+
+    // 起動: GR-SAKURA のタスク, ESP32 の loopTask (Arduino コアと同じ優先度 1)
+    rx_start();
+    xTaskCreatePinnedToCore(loopTask, "loopTask", 8192, nullptr, 1, nullptr, 1);
+    sim_at(SIM_PLANT_STEP_US, plantStep, nullptr);
+    sim_at(SIM_WS_CONNECT_US, connectBrowser, nullptr);
+    for (Action &a : actions) sim_at(a.at, runAction, new Action(a));
+
+    uint64_t end = (uint64_t)(hours * 3600 * SEC);
+    auto w0 = std::chrono::steady_clock::now();
+    sim_run(end);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - w0).count();
+    trace.close();
+
+    printf("\n=== cosim: 仮想 %.2f h / 実時間 %.2f s (%.0f 倍) ===\n", hours, wall,
+           hours * 3600 / std::max(wall, 1e-6));
+    printf("  カーネル: 切替 %llu 回, イベント %llu 件\n",
+           (unsigned long long)sim_switches(), (unsigned long long)sim_events());
+    for (sim_task_t *t = sim_task_first(); t; t = sim_task_next(t)) {
+        printf("    %-14s 起床 %llu\n", sim_task_name(t), (unsigned long long)sim_task_wakes(t));
+    }
+    printf("  UART 最終 ESP32 %lu / GR-SAKURA %lu bps, 交渉 確定 %lu 不成立 %lu 戻し %lu\n",
+           (unsigned long)espBaud(), (unsigned long)rxBaud, (unsigned long)Metrics.uartBaudUp.get(),
+           (unsigned long)Metrics.uartBaudFail.get(), (unsigned long)Metrics.uartBaudFallback.get());
+    printf("    esp>rx %llu 行 %llu B (高速 %llu B, 断線で欠落 %llu B, 化け %llu B, "
+           "RX リング溢れ %lu B, RX 受信エラー %lu)\n",
+           (unsigned long long)espToRx.lines(), (unsigned long long)espToRx.bytes(),
+           (unsigned long long)espToRx.fastBytes(), (unsigned long long)espToRx.lost(),
+           (unsigned long long)espToRx.garbled(), sim_rx_uart_overruns(), sci2_rx_errors());
+    printf("    rx>esp %llu 行 %llu B (高速 %llu B, 断線で欠落 %llu B, 化け %llu B, "
+           "ESP32 行欠落 %lu, フレーミング %lu)\n",
+           (unsigned long long)rxToEsp.lines(), (unsigned long long)rxToEsp.bytes(),
+           (unsigned long long)rxToEsp.fastBytes(), (unsigned long long)rxToEsp.lost(),
+           (unsigned long long)rxToEsp.garbled(), (unsigned long)Metrics.uartDropped.get(),
+           (unsigned long)Metrics.uartFrameErr.get());
+    printf("  GR-SAKURA →");
+    for (auto &kv : stats.rxMsgs) printf(" %s=%llu", kv.first.c_str(), (unsigned long long)kv.second);
+    printf("\n  ブラウザ  ←");
+    for (auto &kv : stats.wsMsgs) printf(" %s=%llu", kv.first.c_str(), (unsigned long long)kv.second);
+    printf("\n");
+#if USE_ETHERNET
+    unsigned long ethSessions, ethFailures, ethNobuf;
+    sim_rx_eth_stats(&ethSessions, &ethFailures, &ethNobuf);
+    printf("  Ethernet  →");
+    for (auto &kv : stats.ethMsgs) printf(" %s=%llu", kv.first.c_str(), (unsigned long long)kv.second);
+    printf("\n    TCP 接続 %lu (失敗 %lu), 受信記述子不足 %lu\n", ethSessions, ethFailures, ethNobuf);
+#endif
+#if USE_SDLOG
+    sim_sd_stats_t sd;
+    sim_sd_card_stats(&sd);
+    printf("  microSD   書き込み %lu ブロック (最大 %.1f ms, 長いビジー %lu 回), 閉じ %lu 回\n",
+           sd.writes, sd.write_max_us / 1000.0, sd.stalls, sd.syncs);
+#endif
+    if (stats.samples) {
+        printf("  温度 (%.0f 分以降): 目標との差 平均 %.3f ℃ 最大 %.2f ℃, ±0.5℃ 内 %.1f%%\n",
+               stats.settleUs / 60.0 / SEC, stats.absErr / stats.samples, stats.maxErr,
+               100.0 * stats.inBand / stats.samples);
+    }
+    printf("  ヒーター電力量 %.1f Wh, 最終温度 %.2f ℃\n", plant.energyJ / 3600, plant.temp);
+    printf("  トレース %llu 行 hash=%016llx\n", (unsigned long long)trace.lines(),
+           (unsigned long long)trace.hashValue());
+
+    if (dumpMetrics) {
+        std::string body;
+        fake::httpGet("/metrics", &body);
+        printf("\n%s", body.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,496 @@
+#!/usr/bin/env python3
+"""
+fwdelta.py - GR-SAKURA (iot-demo-rx-test) の差分ファームウェア更新
+
+動いているイメージとの差分を作り、ESP32 の WebSocket (または SCI2 直結の
+シリアル) 経由で常駐ブートローダー (iot-demo-rx-test/boot) へ送る。
+スライドスイッチの WRITE 切替も USB の挿し直しも要らない。
+
+使い方:
+    python fwdelta.py diff old.mot new.mot               # 差分の大きさと転送時間の見積り
+    python fwdelta.py diff old.mot new.mot -o up.fwd     # 差分をファイルへ
+    python fwdelta.py send old.mot new.mot --wifi 192.168.4.1
+    python fwdelta.py send old.mot new.mot --port COM5   # USB-UART を SCI2 に直結
+    python fwdelta.py merge boot/boot.mot firmware.mot -o full.mot   # 初回の rfp-cli 用
+
+old.mot は今書き込まれているもの (make FW_UPDATE=1 の firmware.mot)。
+ブートローダーが報告するイメージの CRC と合わなければ送らない。
+
+差分の形式 (boot/src/fw_delta.h と同じ):
+    0x00-0x7F  LIT   op+1 バイトをそのまま
+    0x80-0x9F  OLD   旧イメージからコピー。長さの後に旧位置の増分 (zigzag varint)
+    0xA0-0xBF  NEW   新イメージの書き終えた部分からコピー。長さの後に距離 (varint)
+    0xC0       FILL  長さ (varint) + 1 バイト
+    0xC1       END
+    OLD / NEW の長さ: 下位 5 ビット + 4 (31 なら varint を足す)
+
+必要ライブラリ:
+    pip install pyserial websockets     (send のみ)
+"""
+
+import argparse
+import base64
+import json
+import sys
+import time
+import zlib
+
+APP_BASE   = 0xFFF00000           # アプリ領域 (512KB, 32KB ブロック)
+APP_MAGIC  = 0x414D4153           # "SAMA" (リンカスクリプト rx63n_app.ld の先頭)
+IMAGE_MAX  = 0x74000              # 仮置き領域 480KB - 記録用の最後の 16KB
+CHUNK      = 128                  # 1 行あたりの差分バイト数 (ESP32 のコマンド枠 256 に収まる)
+MIN_MATCH  = 4
+MAX_CHAIN  = 32                   # 一致候補をたどる数
+UART_BAUD  = 115200
+FLASH_BPS  = 10000                # 仮置きへの書き込み (消去込み) の控えめな見積り [B/s]
+
+OP_OLD, OP_NEW, OP_FILL, OP_END = 0x80, 0xA0, 0xC0, 0xC1
+
+
+# ============================================================
+# S レコード / イメージ
+# ============================================================
+def read_srec(path: str) -> dict:
+    """S1/S2/S3 レコードを {アドレス: バイト列} に"""
+    chunks = {}
+    with open(path) as f:
+        for n, line in enumerate(f, 1):
+            line = line.strip()
+            if len(line) < 4 or line[0] != "S" or line[1] not in "123":
+                continue
+            raw = bytes.fromhex(line[2:])
+            if (sum(raw) & 0xFF) != 0xFF:
+                raise ValueError(f"{path}:{n}: チェックサム不一致")
+            alen = {"1": 2, "2": 3, "3": 4}[line[1]]
+            addr = int.from_bytes(raw[1:1 + alen], "big")
+            chunks[addr] = raw[1 + alen:-1]
+    return chunks
+
+
+def app_image(path: str) -> bytes:
+    """アプリ領域をヘッダの長さで切り出す (隙間は 0xFF)"""
+    chunks = read_srec(path)
+    buf = bytearray(b"\xff" * IMAGE_MAX)
+    for addr, data in chunks.items():
+        off = addr - APP_BASE
+        if 0 <= off < IMAGE_MAX:
+            buf[off:off + len(data)] = data[:IMAGE_MAX - off]
+    magic = int.from_bytes(buf[0:4], "little")
+    length = int.from_bytes(buf[8:12], "little")
+    if magic != APP_MAGIC:
+        raise ValueError(f"{path}: アプリヘッダがない (make FW_UPDATE=1 でビルドしたもの?)")
+    if not 16 <= length <= IMAGE_MAX:
+        raise ValueError(f"{path}: イメージ長 {length} が範囲外 (最大 {IMAGE_MAX})")
+    return bytes(buf[:length])
+
+
+def crc32(data: bytes) -> int:
+    return zlib.crc32(data) & 0xFFFFFFFF
+
+
+# ============================================================
+# 差分
+# ============================================================
+def _varint(v: int) -> bytes:
+    out = bytearray()
+    while v >= 0x80:
+        out.append((v & 0x7F) | 0x80)
+        v >>= 7
+    out.append(v)
+    return bytes(out)
+
+
+def _zigzag(v: int) -> int:
+    return (v << 1) if v >= 0 else ((-v << 1) - 1)
+
+
+def _op_len(base: int, length: int) -> bytes:
+    n = length - MIN_MATCH
+    if n < 31:
+        return bytes([base | n])
+    return bytes([base | 31]) + _varint(n - 31)
+
+
+def _match_len(a: bytes, ai: int, b: bytes, bi: int, limit: int) -> int:
+    n = 0
+    while n < limit and a[ai + n] == b[bi + n]:
+        n += 1
+    return n
+
+
+def encode(old: bytes, new: bytes) -> bytes:
+    """old を参照して new を作る差分 (貪欲法)"""
+    index_old = {}
+    for i in range(len(old) - MIN_MATCH + 1):
+        index_old.setdefault(old[i:i + MIN_MATCH], []).append(i)
+    index_new = {}
+
+    out = bytearray()
+    lit = bytearray()
+    old_pos = 0
+    pos = 0
+
+    def flush_lit():
+        for k in range(0, len(lit), 128):
+            part = lit[k:k + 128]
+            out.append(len(part) - 1)
+            out.extend(part)
+        lit.clear()
+
+    def index_upto(end):
+        nonlocal indexed
+        while indexed < end and indexed + MIN_MATCH <= len(new):
+            index_new.setdefault(new[indexed:indexed + MIN_MATCH], []).append(indexed)
+            indexed += 1
+    indexed = 0
+
+    while pos < len(new):
+        limit = len(new) - pos
+        # 0xFF (消去済み) などの連続
+        run = 1
+        while run < limit and new[pos + run] == new[pos]:
+            run += 1
+        if run >= 8:
+            flush_lit()
+            out.append(OP_FILL)
+            out.extend(_varint(run))
+            out.append(new[pos])
+            pos += run
+            index_upto(pos)
+            continue
+
+        best_len, best_gain, best_op = 0, 0, None
+        key = new[pos:pos + MIN_MATCH]
+        if len(key) == MIN_MATCH:
+            # 旧イメージ: 続きの位置を最初に (命令が同じ並びなら増分 0 で済む)
+            cands = [("old", c) for c in index_old.get(key, [])[-MAX_CHAIN:]]
+            if old[old_pos:old_pos + MIN_MATCH] == key:
+                cands.insert(0, ("old", old_pos))
+            cands += [("new", c) for c in reversed(index_new.get(key, [])[-MAX_CHAIN:])]
+            for kind, c in cands:
+                if kind == "old":
+                    n = _match_len(old, c, new, pos, min(limit, len(old) - c))
+                    cost = 1 + len(_varint(_zigzag(c - old_pos)))
+                else:
+                    n = _match_len(new, c, new, pos, limit)
+                    cost = 1 + len(_varint(pos - c))
+                if n >= MIN_MATCH and n - cost > best_gain:
+                    best_len, best_gain, best_op = n, n - cost, (kind, c)
+
+        if best_op is None:
+            lit.append(new[pos])
+            pos += 1
+            index_upto(pos)
+            continue
+
+        flush_lit()
+        kind, src = best_op
+        if kind == "old":
+            out.extend(_op_len(OP_OLD, best_len))
+            out.extend(_varint(_zigzag(src - old_pos)))
+            old_pos = src + best_len
+        else:
+            out.extend(_op_len(OP_NEW, best_len))
+            out.extend(_varint(pos - src))
+        pos += best_len
+        index_upto(pos)
+
+    flush_lit()
+    out.append(OP_END)
+    return bytes(out)
+
+
+def decode(old: bytes, delta: bytes, marks: list = None) -> bytes:
+    """ブートローダーと同じ手順で差分を当てる (作った差分の確認用)
+
+    marks を渡すと op ごとに (差分の位置, 出力の長さ) を足していく"""
+    out = bytearray()
+    i = 0
+    old_pos = 0
+
+    def varint():
+        nonlocal i
+        v = shift = 0
+        while True:
+            b = delta[i]
+            i += 1
+            v |= (b & 0x7F) << shift
+            shift += 7
+            if b < 0x80:
+                return v
+
+    while True:
+        if marks is not None:
+            marks.append((i, len(out)))
+        op = delta[i]
+        i += 1
+        if op < 0x80:
+            out += delta[i:i + op + 1]
+            i += op + 1
+        elif op < OP_FILL:
+            n = op & 0x1F
+            length = (n if n < 31 else 31 + varint()) + MIN_MATCH
+            if op < OP_NEW:
+                z = varint()
+                old_pos += (z >> 1) if not z & 1 else -((z + 1) >> 1)
+                out += old[old_pos:old_pos + length]
+                old_pos += length
+            else:
+                src = len(out) - varint()
+                for k in range(length):
+                    out.append(out[src + k])
+        elif op == OP_FILL:
+            length = varint()
+            out += bytes([delta[i]]) * length
+            i += 1
+        elif op == OP_END:
+            return bytes(out)
+        else:
+            raise ValueError(f"未知の op 0x{op:02x}")
+
+
+def make_delta(old_path: str, new_path: str):
+    old = app_image(old_path)
+    new = app_image(new_path)
+    delta = encode(old, new)
+    if decode(old, delta) != new:
+        raise RuntimeError("差分の確認に失敗 (encode / decode の不一致)")
+    return old, new, delta
+
+
+def transfer_estimate(delta_len: int) -> float:
+    """115200bps で 1 行ずつ ack を待つときの秒数 (WiFi の往復は含まない)"""
+    chunks = (delta_len + CHUNK - 1) // CHUNK
+    line = 64 + 4 * ((CHUNK + 2) // 3)          # JSON + base64
+    ack = 48
+    return chunks * (line + ack) * 10 / UART_BAUD
+
+
+# ============================================================
+# 転送路
+# ============================================================
+class SerialLink:
+    """SCI2 に直結した USB-UART"""
+
+    def __init__(self, port: str):
+        import serial
+        self.ser = serial.Serial(port, UART_BAUD, timeout=0.1)
+
+    def send(self, msg: dict):
+        self.ser.write((json.dumps(msg, separators=(",", ":")) + "\n").encode())
+
+    def recv(self, timeout: float):
+        end = time.monotonic() + timeout
+        while time.monotonic() < end:
+            line = self.ser.readline().decode("utf-8", errors="replace").strip()
+            if line.startswith("{"):
+                try:
+                    return json.loads(line)
+                except json.JSONDecodeError:
+                    pass
+        return None
+
+    def close(self):
+        self.ser.close()
+
+
+class WsLink:
+    """ESP32 の WebSocket (行をそのまま UART へ中継する)"""
+
+    def __init__(self, host: str):
+        from websockets.sync.client import connect
+        url = host if host.startswith("ws") else f"ws://{host}/ws"
+        self.ws = connect(url)
+
+    def send(self, msg: dict):
+        self.ws.send(json.dumps(msg, separators=(",", ":")))
+
+    def recv(self, timeout: float):
+        end = time.monotonic() + timeout
+        while True:
+            left = end - time.monotonic()
+            if left <= 0:
+                return None
+            try:
+                raw = self.ws.recv(timeout=left)
+            except TimeoutError:
+                return None
+            try:
+                return json.loads(raw)
+            except json.JSONDecodeError:
+                pass
+
+    def close(self):
+        self.ws.close()
+
+
+def _wait_fw(link, op: str, timeout: float, **match):
+    """{"type":"fw","op":op,...} を待つ (sensor / ctrl などは読み捨てる)"""
+    end = time.monotonic() + timeout
+    while time.monotonic() < end:
+        msg = link.recv(end - time.monotonic())
+        if not msg or msg.get("type") != "fw":
+            continue
+        if msg.get("op") == "err" and all(msg.get(k) == v for k, v in match.items()):
+            return msg
+        if msg.get("op") == op and all(msg.get(k) == v for k, v in match.items()):
+            return msg
+    return None
+
+
+def send(link, old: bytes, new: bytes, delta: bytes, retries: int = 5):
+    # 1. アプリならブートローダーへ (ブートローダーなら ready がすでに流れている)
+    ready = _wait_fw(link, "ready", 1.5)
+    if ready is None:
+        print("[FW] アプリへ fw_update を送信")
+        link.send({"type": "cmd", "cmd": "fw_update", "cid": 1})
+        ready = _wait_fw(link, "ready", 15.0)
+    if ready is None:
+        raise RuntimeError("ブートローダーが応答しない")
+    if ready.get("base_len") == 0 and old:
+        # アプリ領域が空 / 壊れている: 空イメージとの差分 (全体) を送る
+        print("[FW] アプリ領域にイメージがない → 全体を送る")
+        old = b""
+        delta = encode(old, new)
+    base_crc = f"{crc32(old):08x}"
+    if ready.get("base_crc") != base_crc:
+        link.send({"type": "fw", "op": "boot"})
+        raise RuntimeError(f"書き込まれているイメージが違う (crc {ready.get('base_crc')}, "
+                           f"old.mot {base_crc}) — rfp-cli で書き直すか正しい old を指定")
+    print(f"[FW] ブートローダー ready (旧 {ready.get('base_len')} B, crc {base_crc})")
+
+    # 2. 開始
+    begin = {"type": "fw", "op": "begin", "base_crc": base_crc, "new_len": len(new),
+             "new_crc": f"{crc32(new):08x}", "delta_len": len(delta)}
+    for _ in range(retries):
+        link.send(begin)
+        r = _wait_fw(link, "ok", 3.0, to="begin")
+        if r and r.get("op") == "ok":
+            break
+        if r:
+            raise RuntimeError(f"begin を拒否: {r.get('msg')}")
+    else:
+        raise RuntimeError("begin に応答がない")
+
+    # 3. 差分 (1 行ずつ ok を待つ。ESP32 のコマンド枠は 1 つなので重ねない)
+    #    1 行で何 KB も展開される (OLD の長いコピー) 行は書き込みの分だけ長く待つ
+    t0 = time.monotonic()
+    chunks = (len(delta) + CHUNK - 1) // CHUNK
+    marks = []
+    decode(old, delta, marks)
+    out_end = []                        # 各行の終わりまでに展開される出力の長さ
+    j = n = 0
+    for seq in range(chunks):
+        while j < len(marks) and marks[j][0] <= (seq + 1) * CHUNK:
+            n = marks[j][1]
+            j += 1
+        out_end.append(n)
+    resent = 0
+    for seq in range(chunks):
+        part = delta[seq * CHUNK:(seq + 1) * CHUNK]
+        msg = {"type": "fw", "op": "data", "seq": seq, "c": f"{crc32(part):08x}",
+               "d": base64.b64encode(part).decode()}
+        timeout = 2.0 + (out_end[seq] - (out_end[seq - 1] if seq else 0)) / FLASH_BPS
+        for attempt in range(retries):
+            link.send(msg)
+            r = _wait_fw(link, "ok", timeout, to="data", seq=seq)
+            if r and r.get("op") == "ok":
+                break
+            if r and r.get("msg") not in ("crc", "format"):
+                raise RuntimeError(f"seq {seq} を拒否: {r.get('msg')}")
+            resent += 1
+        else:
+            raise RuntimeError(f"seq {seq} に応答がない")
+        if seq % 16 == 15 or seq == chunks - 1:
+            print(f"\r[FW] {seq + 1}/{chunks} 行 ({(seq + 1) * 100 // chunks}%)", end="", flush=True)
+    print()
+
+    # 4. 検証して入れ替え (仮置き → アプリ領域のコピーに数秒かかる)
+    link.send({"type": "fw", "op": "end"})
+    r = _wait_fw(link, "done", 30.0)
+    if r is None or r.get("op") != "done":
+        raise RuntimeError(f"検証に失敗: {r.get('msg') if r else '応答なし'}")
+    dt = time.monotonic() - t0
+    print(f"[FW] 完了: {len(delta)} B を {dt:.1f} 秒 ({len(delta) / max(dt, 1e-6):.0f} B/s), "
+          f"再送 {resent}, 新イメージ crc {r.get('crc')}")
+
+
+# ============================================================
+# コマンド
+# ============================================================
+def cmd_diff(args):
+    old, new, delta = make_delta(args.old, args.new)
+    print(f"旧 {len(old)} B (crc {crc32(old):08x}) → 新 {len(new)} B (crc {crc32(new):08x})")
+    print(f"差分 {len(delta)} B (新イメージの {100 * len(delta) / len(new):.1f}%, "
+          f"zlib 単体なら {len(zlib.compress(new, 9))} B)")
+    print(f"転送 {(len(delta) + CHUNK - 1) // CHUNK} 行, UART 115200bps で約 "
+          f"{transfer_estimate(len(delta)):.1f} 秒 (全体書き込みなら約 "
+          f"{transfer_estimate(len(encode(b'', new))):.1f} 秒)")
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(delta)
+        print(f"→ {args.output}")
+
+
+def cmd_send(args):
+    old, new, delta = make_delta(args.old, args.new)
+    print(f"[FW] 差分 {len(delta)} B / 新イメージ {len(new)} B")
+    link = WsLink(args.wifi) if args.wifi else SerialLink(args.port)
+    try:
+        send(link, old, new, delta)
+    finally:
+        link.close()
+
+
+def cmd_merge(args):
+    """S レコードを 1 つに (S0 / 終端は先頭 / 末尾のファイルのものだけ残す)"""
+    lines = []
+    for k, path in enumerate(args.inputs):
+        with open(path) as f:
+            for line in f:
+                line = line.strip()
+                if not line.startswith("S"):
+                    continue
+                if line[1] == "0" and k > 0:
+                    continue
+                if line[1] in "789" and k < len(args.inputs) - 1:
+                    continue
+                lines.append(line)
+    with open(args.output, "w") as f:
+        f.write("\n".join(lines) + "\n")
+    print(f"→ {args.output} ({len(lines)} レコード)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="GR-SAKURA 差分ファームウェア更新")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("diff", help="差分を作って大きさを表示")
+    p.add_argument("old")
+    p.add_argument("new")
+    p.add_argument("-o", "--output", help="差分の書き出し先")
+    p.set_defaults(func=cmd_diff)
+
+    p = sub.add_parser("send", help="差分を作ってブートローダーへ送る")
+    p.add_argument("old")
+    p.add_argument("new")
+    g = p.add_mutually_exclusive_group(required=True)
+    g.add_argument("--wifi", "-w", help="ESP32 の IP (例: 192.168.4.1)")
+    g.add_argument("--port", "-p", help="SCI2 直結のシリアルポート")
+    p.set_defaults(func=cmd_send)
+
+    p = sub.add_parser("merge", help="ブートローダーとアプリの .mot を結合 (初回書き込み用)")
+    p.add_argument("inputs", nargs="+")
+    p.add_argument("-o", "--output", required=True)
+    p.set_defaults(func=cmd_merge)
+
+    args = parser.parse_args()
+    try:
+        args.func(args)
+    except (OSError, ValueError, RuntimeError) as e:
+        print(f"エラー: {e}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
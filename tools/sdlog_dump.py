@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""
+sdlog_dump.py - GR-SAKURA の microSD ログ (iot-demo-rx-test/src/sd_log.h) を読む
+
+FAT は使っていないので、カード全体のイメージ (dd で吸い出したもの) か
+デバイスそのもの (/dev/sdX, 要 root) をそのまま読む。ホストの cosim の
+--sdlog / sdlog_bench のイメージも同じ形式。
+
+使い方:
+    python sdlog_dump.py card.img                    # 要約 (ブロック数, 起動回数, 期間)
+    python sdlog_dump.py card.img --csv log.csv      # 全レコードを CSV へ
+    python sdlog_dump.py card.img --tail 20          # 最後の 20 件を表示
+    sudo dd if=/dev/sdX of=card.img bs=1M count=600  # 吸い出し (先頭 1MB + 512MB)
+
+リングの大きさはイメージの大きさから決める (513MB より小さいカードは
+カードの終わりまでがリング)。小さいカードは途中で切らずに全体を吸い出すか --count で指定する。
+
+ブロック (512 バイト, リトルエンディアン):
+    u32 "SDLG"  u32 seq  u32 t_ms  u16 used  u16 CRC-16/CCITT
+    レコード u8 type, u16 dt_ms
+      1 BOOT    (なし)
+      2 CTRL    i16 temp_x100, i16 sp_x100, u16 duty (0-10000)
+      3 SENSOR  i16 temp_x100, u16 humi_x100, u32 pres_x100
+      4 STATUS  u8 len, 文字列
+時刻 t_ms は起動からの ms (FreeRTOS のティック)。BOOT で 0 に戻る。
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+BLOCK      = 512
+HDR        = 16
+MAGIC      = 0x474C4453           # "SDLG"
+LBA_BASE   = 2048                 # sd_log.h の SDLOG_LBA_BASE
+LBA_COUNT  = 1024 * 1024          # sd_log.h の SDLOG_LBA_COUNT (カードが小さければカードの終わりまで)
+
+T_PAD, T_BOOT, T_CTRL, T_SENSOR, T_STATUS = range(5)
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def ring_count(path, base):
+    """sd_log.c と同じリングの大きさ: SDLOG_LBA_COUNT と (容量 - base) の小さい方"""
+    with open(path, "rb") as f:
+        size = f.seek(0, 2) // BLOCK      # ブロックデバイスでも末尾まで seek できる
+    return max(0, min(LBA_COUNT, size - base))
+
+
+def read_blocks(path, base, count):
+    """正しいブロックを seq 順に返す [(seq, t_ms, payload)]"""
+    blocks = []
+    bad = 0
+    with open(path, "rb") as f:
+        f.seek(base * BLOCK)
+        for i in range(count):
+            blk = f.read(BLOCK)
+            if len(blk) < BLOCK:
+                break
+            magic, seq, t_ms, used, crc = struct.unpack_from("<IIIHH", blk)
+            if magic != MAGIC:
+                continue
+            if not HDR <= used <= BLOCK or crc16(blk[HDR:used], crc16(blk[:14])) != crc \
+                    or seq % count != i:
+                bad += 1
+                continue
+            blocks.append((seq, t_ms, blk[HDR:used]))
+    blocks.sort()
+    return blocks, bad
+
+
+def records(blocks):
+    """(seq, t_ms, kind, dict) を順に返す"""
+    for seq, t_ms, data in blocks:
+        t = t_ms
+        p = 0
+        while p + 3 <= len(data) and data[p] != T_PAD:
+            kind, dt = struct.unpack_from("<BH", data, p)
+            p += 3
+            t += dt
+            if kind == T_BOOT:
+                yield seq, t, "boot", {}
+            elif kind == T_CTRL:
+                temp, sp, duty = struct.unpack_from("<hhH", data, p)
+                p += 6
+                yield seq, t, "ctrl", {"temp": temp / 100, "sp": sp / 100, "duty": duty / 100}
+            elif kind == T_SENSOR:
+                temp, humi, pres = struct.unpack_from("<hHI", data, p)
+                p += 8
+                yield seq, t, "sensor", {"temp": temp / 100, "humi": humi / 100,
+                                         "pres": pres / 100}
+            elif kind == T_STATUS:
+                n = data[p]
+                msg = data[p + 1:p + 1 + n].decode("ascii", "replace")
+                p += 1 + n
+                yield seq, t, "status", {"msg": msg}
+            else:
+                print(f"seq {seq}: 不明な type {kind} (ブロックの残りは読まない)", file=sys.stderr)
+                break
+
+
+def fmt(rec):
+    seq, t, kind, v = rec
+    body = " ".join(f"{k}={x}" for k, x in v.items())
+    return f"{seq:8d} {t / 1000:12.3f}s {kind:6s} {body}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="GR-SAKURA microSD ログの読み出し")
+    parser.add_argument("image", help="カードのイメージ / デバイス")
+    parser.add_argument("--csv", help="全レコードを CSV へ")
+    parser.add_argument("--tail", type=int, default=0, help="最後の N 件を表示")
+    parser.add_argument("--base", type=int, default=LBA_BASE, help="リングの先頭 LBA")
+    parser.add_argument("--count", type=int, help="リングのブロック数 (既定はイメージの大きさから)")
+    args = parser.parse_args()
+
+    count = args.count if args.count else ring_count(args.image, args.base)
+    blocks, bad = read_blocks(args.image, args.base, count)
+    if not blocks:
+        sys.exit("ログのブロックがない")
+
+    gaps = sum(1 for a, b in zip(blocks, blocks[1:]) if b[0] != a[0] + 1)
+    counts = {}
+    recs = []
+    for r in records(blocks):
+        counts[r[2]] = counts.get(r[2], 0) + 1
+        if args.tail or args.csv:
+            recs.append(r)
+
+    print(f"ブロック {len(blocks)} (壊れ {bad}, seq の切れ目 {gaps}), "
+          f"seq {blocks[0][0]}..{blocks[-1][0]}")
+    print("レコード " + ", ".join(f"{k}={n}" for k, n in sorted(counts.items())))
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as f:
+            w = csv.writer(f)
+            w.writerow(["seq", "t_s", "type", "temp", "sp", "duty", "humi", "pres", "msg"])
+            for seq, t, kind, v in recs:
+                w.writerow([seq, f"{t / 1000:.3f}", kind] +
+                           [v.get(k, "") for k in ("temp", "sp", "duty", "humi", "pres", "msg")])
+        print(f"CSV: {args.csv} ({len(recs)} 行)")
+    for r in recs[-args.tail:] if args.tail else []:
+        print(fmt(r))
+
+
+if __name__ == "__main__":
+    main()